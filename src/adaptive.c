@@ -0,0 +1,562 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Adaptive frequency sweep, enabled by --adaptive-sweep <tol>.
+ * Only some of the frequency steps are solved: a first round of
+ * evenly spread steps, then rounds of steps half way between solved
+ * ones, where two rational (Thiele continued fraction) interpolants
+ * of the input impedance and of the maximum gain, fitted to the
+ * ADAPTIVE_ORDER and ADAPTIVE_ORDER-1 nearest solved steps, differ
+ * by more than the tolerance. The impedance and the radiation
+ * patterns of the steps left unsolved are interpolated, so the
+ * plots and the output files see data for all the steps.
+ *
+ * The frequency loop drives a sweep like this:
+ *
+ *   Adaptive_Sweep_Start();
+ *   do
+ *   {
+ *     while( (fstep = Adaptive_Sweep_Next()) >= 0 )
+ *       solve fstep;
+ *     Adaptive_Sweep_Fill();
+ *   }
+ *   while( Adaptive_Sweep_Refine() );
+ */
+
+#include "adaptive.h"
+#include "shared.h"
+
+/* Solved (or handed out) frequency steps, in step order */
+static int  *adapt_node = NULL;
+static int   adapt_num_nodes = 0;
+
+/* Steps of the current round and the next one to hand out */
+static int  *adapt_round = NULL;
+static int   adapt_num_round  = 0;
+static int   adapt_next_round = 0;
+
+/* Flags of steps in adapt_node and the number of steps */
+static char *adapt_solved = NULL;
+static int   adapt_num_steps = 0;
+
+/* Windows the unsolved steps were last interpolated from,
+ * ADAPTIVE_ORDER per step, and the number of steps in each */
+static int  *adapt_win = NULL;
+static int  *adapt_num_win = NULL;
+static gboolean adapt_win_rdpat = FALSE;
+
+/* Offset and scale of the interpolation variable */
+static double adapt_fmin = 0.0, adapt_fscale = 1.0;
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_X()
+ *
+ * Returns the interpolation variable of frequency step fstep
+ */
+  static inline double
+Adaptive_X( int fstep )
+{
+  return( (save.freq[fstep] - adapt_fmin) / adapt_fscale );
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Rdpat()
+ *
+ * Returns TRUE if the steps solved have radiation patterns
+ */
+  static gboolean
+Adaptive_Rdpat( void )
+{
+  return( (rad_pattern != NULL) && (gnd.ifar != 1) &&
+      isFlagSet(ENABLE_RDPAT) && (fpat.nth * fpat.nph > 0) );
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Thiele_Coeffs()
+ *
+ * Replaces the values f[] at the n points x[] with the
+ * inverse differences of Thiele's continued fraction
+ */
+  static void
+Thiele_Coeffs( const double *x, complex double *f, int n )
+{
+  int i, j;
+  complex double d;
+
+  for( j = 1; j < n; j++ )
+    for( i = j; i < n; i++ )
+    {
+      d = f[i] - f[j-1];
+      if( d == 0.0 )
+        f[i] = THIELE_HUGE;
+      else
+        f[i] = (x[i] - x[j-1]) / d;
+    }
+
+} /* Thiele_Coeffs() */
+
+/*------------------------------------------------------------------------*/
+
+/* Thiele_Eval()
+ *
+ * Evaluates at xi the continued fraction of Thiele_Coeffs()
+ */
+  static complex double
+Thiele_Eval( const double *x, const complex double *a, int n, double xi )
+{
+  int j;
+  complex double r = a[n-1];
+
+  for( j = n-2; j >= 0; j-- )
+  {
+    if( r == 0.0 ) r = 1.0 / THIELE_HUGE;
+    r = a[j] + (xi - x[j]) / r;
+  }
+
+  return( r );
+} /* Thiele_Eval() */
+
+/*------------------------------------------------------------------------*/
+
+/* Thiele_Coeffs_Real()
+ *
+ * As Thiele_Coeffs() for real values
+ */
+  static void
+Thiele_Coeffs_Real( const double *x, double *f, int n )
+{
+  int i, j;
+  double d;
+
+  for( j = 1; j < n; j++ )
+    for( i = j; i < n; i++ )
+    {
+      d = f[i] - f[j-1];
+      if( d == 0.0 )
+        f[i] = THIELE_HUGE;
+      else
+        f[i] = (x[i] - x[j-1]) / d;
+    }
+
+} /* Thiele_Coeffs_Real() */
+
+/*------------------------------------------------------------------------*/
+
+/* Thiele_Eval_Real()
+ *
+ * As Thiele_Eval() for real values
+ */
+  static double
+Thiele_Eval_Real( const double *x, const double *a, int n, double xi )
+{
+  int j;
+  double r = a[n-1];
+
+  for( j = n-2; j >= 0; j-- )
+  {
+    if( r == 0.0 ) r = 1.0 / THIELE_HUGE;
+    r = a[j] + (xi - x[j]) / r;
+  }
+
+  return( r );
+} /* Thiele_Eval_Real() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Window()
+ *
+ * Fills win[] with up to ADAPTIVE_ORDER solved steps nearest in
+ * frequency to step fstep, nearest first, and their interpolation
+ * variables in x[]. Steps at a frequency already in win[] are
+ * skipped. Returns the number of steps in win[]
+ */
+  static int
+Adaptive_Window( int fstep, int *win, double *x )
+{
+  int lo, hi, mid, cnt, node, i;
+  double xf = Adaptive_X( fstep );
+
+  /* First node after fstep, the nodes are in step order */
+  lo = 0;
+  hi = adapt_num_nodes;
+  while( lo < hi )
+  {
+    mid = (lo + hi) / 2;
+    if( adapt_node[mid] > fstep ) hi = mid;
+    else lo = mid + 1;
+  }
+  hi = lo;
+  lo = hi - 1;
+
+  /* Take the nearer of the nodes on either side */
+  cnt = 0;
+  while( (cnt < ADAPTIVE_ORDER) && ((lo >= 0) || (hi < adapt_num_nodes)) )
+  {
+    if( (hi >= adapt_num_nodes) ||
+        ((lo >= 0) && (fabs(Adaptive_X(adapt_node[lo]) - xf) <=
+                       fabs(Adaptive_X(adapt_node[hi]) - xf))) )
+      node = adapt_node[lo--];
+    else
+      node = adapt_node[hi++];
+
+    for( i = 0; i < cnt; i++ )
+      if( save.freq[win[i]] == save.freq[node] ) break;
+    if( i < cnt ) continue;
+
+    win[cnt] = node;
+    x[cnt]   = Adaptive_X( node );
+    cnt++;
+  }
+
+  return( cnt );
+} /* Adaptive_Window() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Impedance()
+ *
+ * Interpolates the input impedance at step fstep from
+ * the n steps in win[], with fewer if the fraction fails
+ */
+  static complex double
+Adaptive_Impedance( int fstep, const int *win, const double *x, int n )
+{
+  int i;
+  complex double a[ADAPTIVE_ORDER], z;
+
+  do
+  {
+    for( i = 0; i < n; i++ )
+      a[i] = impedance_data.zreal[win[i]] + I*impedance_data.zimag[win[i]];
+    Thiele_Coeffs( x, a, n );
+    z = Thiele_Eval( x, a, n, Adaptive_X(fstep) );
+  }
+  while( !isfinite(creal(z) + cimag(z)) && (--n > 0) );
+
+  if( n == 0 )
+    z = impedance_data.zreal[win[0]] + I*impedance_data.zimag[win[0]];
+
+  return( z );
+} /* Adaptive_Impedance() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Max_Gain()
+ *
+ * Interpolates the maximum total gain at step fstep
+ * from the n steps in win[]
+ */
+  static double
+Adaptive_Max_Gain( int fstep, const int *win, const double *x, int n )
+{
+  int i;
+  double a[ADAPTIVE_ORDER];
+
+  for( i = 0; i < n; i++ )
+    a[i] = rad_pattern[win[i]].max_gain[POL_TOTAL];
+  Thiele_Coeffs_Real( x, a, n );
+
+  return( Thiele_Eval_Real(x, a, n, Adaptive_X(fstep)) );
+} /* Adaptive_Max_Gain() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Pattern()
+ *
+ * Interpolates the gain of the radiation pattern at step fstep
+ * in each direction from the n steps in win[]. Where the fractions
+ * of n and n-1 steps differ by more than the gain tolerance, as
+ * they may near a pole or a null, and the first one strays from
+ * the line through the two nearest steps by more than their
+ * difference, the gain on that line is used instead. The
+ * polarization data are those of the nearest step
+ */
+  static void
+Adaptive_Pattern( int fstep, const int *win, const double *x, int n, double gtol )
+{
+  int idx, i, ndir;
+  double a[ADAPTIVE_ORDER], b[ADAPTIVE_ORDER], g, lin, d;
+  double xf = Adaptive_X( fstep );
+  rad_pattern_t *rp = &rad_pattern[fstep];
+
+  /* Bring the patterns into memory if they are kept in the store */
+  for( i = 0; i < n; i++ )
+    Rdpat_Store_Load( win[i] );
+  Rdpat_Store_New( fstep );
+
+  ndir = fpat.nth * fpat.nph;
+  for( idx = 0; idx < ndir; idx++ )
+  {
+    for( i = 0; i < n; i++ )
+      a[i] = b[i] = rad_pattern[win[i]].gtot[idx];
+
+    g = lin = a[0];
+    if( n > 1 )
+    {
+      d = a[1] - a[0];
+      g = lin = a[0] + d * (xf - x[0]) / (x[1] - x[0]);
+    }
+
+    if( n > 2 )
+    {
+      Thiele_Coeffs_Real( x, a, n );
+      Thiele_Coeffs_Real( x, b, n-1 );
+      g = Thiele_Eval_Real( x, a, n, xf );
+      if( !(fabs(g - Thiele_Eval_Real(x, b, n-1, xf)) <= gtol) &&
+          !(fabs(g - lin) <= fabs(d)) )
+        g = lin;
+    }
+    rp->gtot[idx] = g;
+  }
+
+  memcpy( rp->axrt, rad_pattern[win[0]].axrt, (size_t)ndir * sizeof(double) );
+  memcpy( rp->tilt, rad_pattern[win[0]].tilt, (size_t)ndir * sizeof(double) );
+  memcpy( rp->sens, rad_pattern[win[0]].sens, (size_t)ndir * sizeof(int) );
+
+  Rdpat_Set_Extremes( fstep );
+
+} /* Adaptive_Pattern() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Error()
+ *
+ * Returns the difference at step fstep between the interpolants
+ * of order ADAPTIVE_ORDER and one less, relative to the tolerance.
+ * The gain tolerance is the impedance tolerance as a power ratio
+ */
+  static double
+Adaptive_Error( int fstep )
+{
+  int win[ADAPTIVE_ORDER], n;
+  double x[ADAPTIVE_ORDER], err, gerr, gtol;
+  complex double za, zb;
+
+  n = Adaptive_Window( fstep, win, x );
+  if( n < 3 ) return( 2.0 );
+
+  za = Adaptive_Impedance( fstep, win, x, n );
+  zb = Adaptive_Impedance( fstep, win, x, n-1 );
+  err = cabs( za - zb ) / ( cabs(za) + fabs(calc_data.zo) ) / rc_config.adaptive_tol;
+
+  if( Adaptive_Rdpat() )
+  {
+    gtol = db10( 1.0 + rc_config.adaptive_tol );
+    gerr = fabs( Adaptive_Max_Gain(fstep, win, x, n) -
+                 Adaptive_Max_Gain(fstep, win, x, n-1) ) / gtol;
+    if( !(gerr <= err) ) err = gerr;
+  }
+
+  if( !isfinite(err) ) err = 2.0;
+
+  return( err );
+} /* Adaptive_Error() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Queue()
+ *
+ * Adds step fstep to the current round
+ */
+  static void
+Adaptive_Queue( int fstep )
+{
+  adapt_round[adapt_num_round++] = fstep;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Sweep_Start()
+ *
+ * Starts an adaptive sweep of the calc_data.steps_total steps at
+ * the frequencies in save.freq[] and queues its first round
+ */
+  void
+Adaptive_Sweep_Start( void )
+{
+  int idx, fstep, last, nstart;
+  double fmax;
+  size_t mreq;
+
+  adapt_num_steps = calc_data.steps_total;
+  mreq = (size_t)adapt_num_steps * sizeof(int);
+  mem_realloc( (void **)&adapt_node,  mreq, "in adaptive.c" );
+  mem_realloc( (void **)&adapt_round, mreq, "in adaptive.c" );
+  mem_realloc( (void **)&adapt_num_win, mreq, "in adaptive.c" );
+  memset( adapt_num_win, 0, mreq );
+  adapt_win_rdpat = FALSE;
+  mreq *= ADAPTIVE_ORDER;
+  mem_realloc( (void **)&adapt_win, mreq, "in adaptive.c" );
+  mreq = (size_t)adapt_num_steps * sizeof(char);
+  mem_realloc( (void **)&adapt_solved, mreq, "in adaptive.c" );
+  memset( adapt_solved, 0, mreq );
+  adapt_num_nodes  = 0;
+  adapt_num_round  = 0;
+  adapt_next_round = 0;
+
+  /* Scale the frequencies to 0..1 */
+  adapt_fmin = fmax = save.freq[0];
+  for( idx = 1; idx < adapt_num_steps; idx++ )
+  {
+    if( adapt_fmin > save.freq[idx] ) adapt_fmin = save.freq[idx];
+    if( fmax < save.freq[idx] ) fmax = save.freq[idx];
+  }
+  adapt_fscale = fmax - adapt_fmin;
+  if( adapt_fscale <= 0.0 ) adapt_fscale = 1.0;
+
+  /* First round of evenly spread steps, or all of them */
+  nstart = ADAPTIVE_START_NODES;
+  if( adapt_num_steps <= 2 * nstart )
+    nstart = adapt_num_steps;
+
+  last = -1;
+  for( idx = 0; idx < nstart; idx++ )
+  {
+    fstep = 0;
+    if( nstart > 1 )
+      fstep = (int)( (double)idx * (double)(adapt_num_steps-1) /
+          (double)(nstart-1) + 0.5 );
+    if( fstep == last ) continue;
+    Adaptive_Queue( fstep );
+    last = fstep;
+  }
+
+} /* Adaptive_Sweep_Start() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Sweep_Next()
+ *
+ * Returns the next step of the current round to be
+ * solved, or -1 if all its steps were handed out
+ */
+  int
+Adaptive_Sweep_Next( void )
+{
+  int fstep, idx;
+
+  if( adapt_next_round >= adapt_num_round )
+    return( -1 );
+  fstep = adapt_round[adapt_next_round++];
+
+  /* Insert in the nodes, in step order */
+  adapt_solved[fstep] = 1;
+  idx = adapt_num_nodes++;
+  while( (idx > 0) && (adapt_node[idx-1] > fstep) )
+  {
+    adapt_node[idx] = adapt_node[idx-1];
+    idx--;
+  }
+  adapt_node[idx] = fstep;
+
+  return( fstep );
+} /* Adaptive_Sweep_Next() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Sweep_Fill()
+ *
+ * Interpolates the impedance and radiation pattern of all
+ * the steps not solved yet and marks them as done in save.fstep[].
+ * Steps whose window of solved steps is the same as in the last
+ * round are left as they are, so a round only interpolates again
+ * the steps near the ones it solved
+ */
+  void
+Adaptive_Sweep_Fill( void )
+{
+  int fstep, n, win[ADAPTIVE_ORDER];
+  double x[ADAPTIVE_ORDER];
+  double gtol = db10( 1.0 + rc_config.adaptive_tol );
+  gboolean rdpat = Adaptive_Rdpat();
+  complex double z;
+
+  /* Patterns were not interpolated in the last round */
+  if( rdpat && !adapt_win_rdpat )
+    memset( adapt_num_win, 0, (size_t)adapt_num_steps * sizeof(int) );
+  adapt_win_rdpat = rdpat;
+
+  for( fstep = 0; fstep < adapt_num_steps; fstep++ )
+  {
+    if( adapt_solved[fstep] ) continue;
+
+    n = Adaptive_Window( fstep, win, x );
+    if( n == 0 ) continue;
+
+    if( (n == adapt_num_win[fstep]) &&
+        (memcmp(win, &adapt_win[fstep * ADAPTIVE_ORDER],
+                (size_t)n * sizeof(int)) == 0) )
+      continue;
+    memcpy( &adapt_win[fstep * ADAPTIVE_ORDER], win, (size_t)n * sizeof(int) );
+    adapt_num_win[fstep] = n;
+
+    z = Adaptive_Impedance( fstep, win, x, n );
+    impedance_data.zreal[fstep]  = creal( z );
+    impedance_data.zimag[fstep]  = cimag( z );
+    impedance_data.zmagn[fstep]  = cabs( z );
+    impedance_data.zphase[fstep] = cang( z );
+
+    if( (calc_data.iped == 1) &&
+        (impedance_data.zmagn[fstep] > calc_data.zpnorm) )
+      calc_data.zpnorm = impedance_data.zmagn[fstep];
+
+    if( rdpat )
+      Adaptive_Pattern( fstep, win, x, n, gtol );
+
+    save.fstep[fstep] = 1;
+  }
+
+  pr_info("adaptive sweep: %d of %d frequency steps solved\n",
+      adapt_num_nodes, adapt_num_steps);
+
+} /* Adaptive_Sweep_Fill() */
+
+/*------------------------------------------------------------------------*/
+
+/* Adaptive_Sweep_Refine()
+ *
+ * Queues a new round of the steps half way between solved steps
+ * where the interpolants disagree, returns FALSE if there are none
+ */
+  gboolean
+Adaptive_Sweep_Refine( void )
+{
+  int idx, mid;
+
+  adapt_num_round  = 0;
+  adapt_next_round = 0;
+
+  for( idx = 1; idx < adapt_num_nodes; idx++ )
+  {
+    if( adapt_node[idx] - adapt_node[idx-1] < 2 )
+      continue;
+
+    mid = (adapt_node[idx] + adapt_node[idx-1]) / 2;
+    if( Adaptive_Error(mid) > 1.0 )
+      Adaptive_Queue( mid );
+  }
+
+  return( adapt_num_round > 0 );
+} /* Adaptive_Sweep_Refine() */
+
+/*------------------------------------------------------------------------*/
+
@@ -0,0 +1,37 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef ADAPTIVE_H
+#define ADAPTIVE_H    1
+
+#include "common.h"
+
+/* Number of solved steps the rational interpolant is fitted to */
+#define ADAPTIVE_ORDER        6
+
+/* Number of evenly spread steps solved in the first round,
+ * sweeps of up to twice as many steps are solved in full */
+#define ADAPTIVE_START_NODES  9
+
+/* Inverse difference used in place of a division by zero,
+ * it ends the continued fraction at that term */
+#define THIELE_HUGE           1.0e30
+
+#endif
+
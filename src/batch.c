@@ -0,0 +1,640 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* xnec2c-batch: runs the frequency loop of one NEC2 input file
+ * and writes the requested output files, without the GUI. It is
+ * built from the same solver sources as xnec2c with XNEC2C_BATCH
+ * defined, and does not initialize or link against GTK. With
+ * --benchmark it runs any number of input files instead, and
+ * writes the time of each solver phase, see perf.c, and with
+ * --optimizer-socket it runs the models an optimizer sends it,
+ * see opt_socket.c, and with --sweep it runs the variants of the
+ * input file for a range of values of its SY variables, see sweep.c. */
+
+#include "common.h"
+#include "shared.h"
+#include "mathlib.h"
+#include "perf.h"
+
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+enum XNEC2C_BATCH_OPTS {
+	// Start at 128 after all single-digit opts:
+	OPT_FIRST_OPT = 128,
+
+	OPT_FILL_THREADS,
+	OPT_MATRIX_CACHE,
+	OPT_MATRIX_CACHE_DISK,
+	OPT_SOMNEC_CACHE_DIR,
+	OPT_ADAPTIVE_SWEEP,
+	OPT_MATRIX_INTERP,
+	OPT_MIXED_PRECISION,
+	OPT_OUT_OF_CORE,
+	OPT_RDPAT_MB,
+	OPT_STATS,
+
+	OPT_BENCHMARK,
+	OPT_BENCHMARK_BASELINE,
+	OPT_BENCHMARK_TOLERANCE,
+
+	OPT_OPTIMIZER_SOCKET,
+	OPT_SWEEP,
+	OPT_SWEEP_JOBS,
+
+	OPT_WRITE_CSV,
+	OPT_WRITE_S1P,
+	OPT_WRITE_S2P_MAX_GAIN,
+	OPT_WRITE_S2P_VIEWER_GAIN,
+	OPT_WRITE_RDPAT,
+	OPT_WRITE_CURRENTS,
+	OPT_WRITE_RDPAT_BIN,
+	OPT_WRITE_CURRENTS_BIN,
+
+	OPT_MAX_OPTS
+};
+
+static struct option long_options[] = {
+		{  "input",                  required_argument,   NULL,  'i'                        },
+		{  "help",                   no_argument,         NULL,  'h'                        },
+		{  "verbose",                no_argument,         NULL,  'v'                        },
+		{  "debug",                  no_argument,         NULL,  'd'                        },
+		{  "quiet",                  no_argument,         NULL,  'q'                        },
+		{  "version",                no_argument,         NULL,  'V'                        },
+
+		{  "fill-threads",           required_argument,   NULL,  OPT_FILL_THREADS           },
+		{  "matrix-cache",           required_argument,   NULL,  OPT_MATRIX_CACHE           },
+		{  "matrix-cache-disk",      required_argument,   NULL,  OPT_MATRIX_CACHE_DISK      },
+		{  "somnec-cache-dir",       required_argument,   NULL,  OPT_SOMNEC_CACHE_DIR       },
+		{  "adaptive-sweep",         required_argument,   NULL,  OPT_ADAPTIVE_SWEEP         },
+		{  "matrix-interp",          required_argument,   NULL,  OPT_MATRIX_INTERP          },
+		{  "mixed-precision",        no_argument,         NULL,  OPT_MIXED_PRECISION        },
+		{  "out-of-core",            required_argument,   NULL,  OPT_OUT_OF_CORE            },
+		{  "rdpat-mb",               required_argument,   NULL,  OPT_RDPAT_MB               },
+		{  "stats",                  required_argument,   NULL,  OPT_STATS                  },
+
+		{  "benchmark",              required_argument,   NULL,  OPT_BENCHMARK              },
+		{  "benchmark-baseline",     required_argument,   NULL,  OPT_BENCHMARK_BASELINE     },
+		{  "benchmark-tolerance",    required_argument,   NULL,  OPT_BENCHMARK_TOLERANCE    },
+
+		{  "optimizer-socket",       required_argument,   NULL,  OPT_OPTIMIZER_SOCKET       },
+		{  "sweep",                  required_argument,   NULL,  OPT_SWEEP                  },
+		{  "sweep-jobs",             required_argument,   NULL,  OPT_SWEEP_JOBS             },
+
+		{  "write-csv",              required_argument,   NULL,  OPT_WRITE_CSV              },
+		{  "write-s1p",              required_argument,   NULL,  OPT_WRITE_S1P              },
+		{  "write-s2p-max-gain",     required_argument,   NULL,  OPT_WRITE_S2P_MAX_GAIN     },
+		{  "write-s2p-viewer-gain",  required_argument,   NULL,  OPT_WRITE_S2P_VIEWER_GAIN  },
+		{  "write-rdpat",            required_argument,   NULL,  OPT_WRITE_RDPAT            },
+		{  "write-currents",         required_argument,   NULL,  OPT_WRITE_CURRENTS         },
+		{  "write-rdpat-bin",        required_argument,   NULL,  OPT_WRITE_RDPAT_BIN        },
+		{  "write-currents-bin",     required_argument,   NULL,  OPT_WRITE_CURRENTS_BIN     },
+
+		{  NULL,                     0,                   NULL,  0                          }
+	};
+
+char *orig_numeric_locale = NULL;
+
+/*------------------------------------------------------------------------*/
+
+/*  Batch_Usage()
+ *
+ *  Prints usage information of xnec2c-batch
+ */
+  static void
+Batch_Usage( void )
+{
+  fprintf(stdout, "Usage: xnec2c-batch [options] <input-file-name>\n"
+		"       xnec2c-batch --benchmark <file> [options] <input-file-name>...\n"
+		"       xnec2c-batch --optimizer-socket <path> [options] [<input-file-name>]\n"
+		"  -i|--input <input-file-name>\n"
+		"     --fill-threads <N>: threads for the matrix and field patterns (0 = all CPUs)\n"
+		"     --matrix-cache <MB>: memory to cache factored matrices (0 = off)\n"
+		"     --matrix-cache-disk <MB>: disk space for matrices spilled from the cache\n"
+		"     --somnec-cache-dir <dir>: directory of saved Sommerfeld ground grids\n"
+		"                       (default ~/.xnec2c/somnec, \"\" to not save them)\n"
+		"     --adaptive-sweep <tol>: solve only some frequency steps and interpolate\n"
+		"                       the others, to a relative impedance error of tol\n"
+		"     --matrix-interp <tol>: interpolate the interaction matrix between a few\n"
+		"                       frequencies of the sweep, to a relative error of tol\n"
+		"     --mixed-precision: factor the matrix in single precision and refine\n"
+		"                       the solutions to double precision (no matrix cache)\n"
+		"     --out-of-core <MB>: keep larger interaction matrices in a temporary\n"
+		"                       file and factor them by panels within MB of memory\n"
+		"     --rdpat-mb <MB>: keep the radiation patterns of the frequency steps in\n"
+		"                       a temporary file when they need more than MB of memory\n"
+		"     --stats <file>: write the time of each solver phase to file, in JSON\n"
+		"                       format, after each frequency loop\n"
+		"     --benchmark <file>: run each input file and write the time of the\n"
+		"                       solver phases to file, in JSON format\n"
+		"     --benchmark-baseline <file>: compare the times with a previous\n"
+		"                       --benchmark file, exit with status 2 if slower\n"
+		"     --benchmark-tolerance <percent>: slowdown of a phase reported\n"
+		"                       as a regression (default 10)\n"
+		"     --optimizer-socket <path>: serve an optimizer on the unix socket path,\n"
+		"                       which sends the models to run and receives their\n"
+		"                       measurements, starting from the input file if given\n"
+		"     --sweep <name=start:stop:count>: run the input file for count values\n"
+		"                       of its SY variable name, from start to stop. Given\n"
+		"                       for more variables, all their combinations are run.\n"
+		"                       The --write-csv file has a row for each of them and\n"
+		"                       each frequency step, after the values of the variables\n"
+		"     --sweep-jobs <N>: processes that run the variants (0 = all CPUs)\n"
+		"  -h|--help:         print usage information and exit\n"
+		"  -V|--version:      print xnec2c version number and exit\n"
+		"  -v|--verbose:      increase verbosity, can be specified multiple times\n"
+		"  -d|--debug:        enable debug output (-dd includes backtraces)\n"
+		"  -q|--quiet:        suppress debug/verbose output\n"
+		"\n"
+		"The following arguments write to an output file after the frequency loop\n"
+		"completes.  At least one of them should be given:\n"
+		"\n"
+		"  --write-csv             <filename>  - write CSV file of measurements\n"
+		"  --write-s1p             <filename>  - write S1P file of S-parameters\n"
+		"  --write-s2p-max-gain    <filename>  - write S2P file, port-2 is max-gain\n"
+		"  --write-s2p-viewer-gain <filename>  - write S2P file, port-2 is viewer-gain\n"
+		"  --write-rdpat           <filename>  - write CSV of the radiation pattern\n"
+		"  --write-currents        <filename>  - write CSV of currents and charges\n"
+		"\n"
+		"The following arguments write NumPy .npy files of the same columns, with\n"
+		"the rows of each frequency step appended as soon as it is calculated:\n"
+		"\n"
+		"  --write-rdpat-bin       <filename>  - write .npy of the radiation pattern\n"
+		"  --write-currents-bin    <filename>  - write .npy of currents and charges\n");
+
+} /* Batch_Usage() */
+
+/*------------------------------------------------------------------------*/
+
+/*  Set_Input_File()
+ *
+ *  Copies the input file path name to rc_config, exits if too long
+ */
+  static void
+Set_Input_File( const char *fname )
+{
+  size_t siz = sizeof( rc_config.input_file );
+
+  if( strlen(fname) >= siz )
+  {
+    pr_crit("input file path name too long ( > %d char )\n", (int)siz - 1);
+    exit(1);
+  }
+
+  Strlcpy( rc_config.input_file, fname, siz );
+
+} /* Set_Input_File() */
+
+/*------------------------------------------------------------------------*/
+
+/*  Run_Input_File()
+ *
+ *  Reads the input file and runs its frequency loop,
+ *  returns FALSE on failure after printing the reason
+ */
+  static gboolean
+Run_Input_File( void )
+{
+  Get_Dirname( rc_config.input_file, rc_config.working_dir, NULL );
+
+  /* Read the input file, Stop() has printed the reason of a failure */
+  if( !Open_File(&input_fp, rc_config.input_file, "r") )
+    return( FALSE );
+  if( !Read_Comments() || !Read_Geometry() || !Read_Commands() )
+    return( FALSE );
+  Close_File( &input_fp );
+
+  if( !Run_Frequency_Loop() )
+  {
+    pr_crit("frequency loop did not complete: %s\n", rc_config.input_file);
+    return( FALSE );
+  }
+
+  return( TRUE );
+} /* Run_Input_File() */
+
+/*------------------------------------------------------------------------*/
+
+/*  Benchmark_Model()
+ *
+ *  Runs input file fname in a child process, so that each model
+ *  starts from a clean state, and returns the times of its solver
+ *  phases in mod. The total is measured here, from fork to exit
+ */
+  static void
+Benchmark_Model( char *fname, perf_model_t *mod )
+{
+  struct timespec start, end;
+  struct rusage usage;
+  perf_model_t res;
+  int pfd[2], status;
+  pid_t pid;
+
+  memset( mod, 0, sizeof(perf_model_t) );
+  Strlcpy( mod->file, fname, sizeof(mod->file) );
+
+  if( pipe(pfd) < 0 )
+  {
+    perror("xnec2c-batch: pipe()");
+    return;
+  }
+
+  fflush( stdout );
+  fflush( stderr );
+  clock_gettime( CLOCK_MONOTONIC, &start );
+
+  pid = fork();
+  if( pid < 0 )
+  {
+    perror("xnec2c-batch: fork()");
+    close( pfd[0] );
+    close( pfd[1] );
+    return;
+  }
+
+  /* Child runs the model and passes its phase times back */
+  if( pid == 0 )
+  {
+    close( pfd[0] );
+    res = *mod;
+    Set_Input_File( fname );
+    res.ok       = Run_Input_File();
+    res.segments = data.n;
+    res.patches  = data.m;
+    res.steps    = calc_data.steps_total;
+    Perf_Get( res.phase );
+    if( write(pfd[1], &res, sizeof(res)) != (ssize_t)sizeof(res) )
+      _exit(1);
+    _exit(0);
+  }
+
+  close( pfd[1] );
+  if( read(pfd[0], &res, sizeof(res)) == (ssize_t)sizeof(res) )
+    *mod = res;
+  close( pfd[0] );
+
+  if( wait4(pid, &status, 0, &usage) < 0 )
+  {
+    perror("xnec2c-batch: wait4()");
+    mod->ok = 0;
+    return;
+  }
+  clock_gettime( CLOCK_MONOTONIC, &end );
+
+  if( !WIFEXITED(status) || (WEXITSTATUS(status) != 0) )
+    mod->ok = 0;
+
+  mod->total.wall = (double)(end.tv_sec - start.tv_sec) +
+    (double)(end.tv_nsec - start.tv_nsec) / 1.0E9;
+  mod->total.cpu =
+    (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+    (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1.0E6;
+  mod->total.count = 1;
+
+} /* Benchmark_Model() */
+
+/*------------------------------------------------------------------------*/
+
+/*  Benchmark()
+ *
+ *  Runs the num input files in files and writes their times to
+ *  fname, then compares them to baseline if not NULL. Returns
+ *  the exit status: 1 on errors, 2 if a phase is slower than
+ *  in the baseline by more than tol percent, 0 otherwise
+ */
+  static int
+Benchmark( char *fname, char *baseline, double tol, char **files, int num )
+{
+  perf_model_t *models = NULL, *base = NULL;
+  int idx, nbase, failed = 0, regress = 0;
+  size_t mreq;
+
+  mreq = (size_t)num * sizeof(perf_model_t);
+  mem_alloc( (void **)&models, mreq, "in batch.c" );
+
+  for( idx = 0; idx < num; idx++ )
+  {
+    pr_notice("benchmark %d/%d: %s\n", idx + 1, num, files[idx]);
+    Benchmark_Model( files[idx], &models[idx] );
+    if( !models[idx].ok )
+    {
+      pr_err("%s: benchmark run failed\n", files[idx]);
+      failed++;
+    }
+  }
+
+  if( !Perf_Write_Bench(fname, models, num) )
+    failed++;
+
+  if( baseline != NULL )
+  {
+    nbase = Perf_Read_Bench( baseline, &base );
+    if( nbase < 0 )
+      failed++;
+    else
+      regress = Perf_Compare_Bench( models, num, base, nbase, tol );
+    free_ptr( (void **)&base );
+  }
+
+  free_ptr( (void **)&models );
+
+  if( failed )
+    return( 1 );
+  if( regress )
+  {
+    pr_notice("%d phases slower than in %s by more than %.1f%%\n",
+        regress, baseline, tol);
+    return( 2 );
+  }
+
+  return( 0 );
+} /* Benchmark() */
+
+/*------------------------------------------------------------------------*/
+
+/* Tests for child process, xnec2c-batch does not fork */
+  gboolean
+isChild(void)
+{
+  return( FALSE );
+}
+
+/*------------------------------------------------------------------------*/
+
+  int
+main( int argc, char *argv[] )
+{
+  int option, option_index = 0;
+  char *input_arg = NULL;
+  char *bench_file = NULL, *bench_baseline = NULL;
+  double bench_tol = PERF_TOLERANCE;
+  char *opt_socket = NULL;
+  gboolean sweep = FALSE;
+  int sweep_jobs = 0;
+
+  // Print all notices that may occur before getopt parsing:
+  rc_config.verbose = 9;
+
+  // Keep a copy of the system numeric locale, the writers
+  // switch to "C" and back while printing numbers:
+  setlocale(LC_ALL, "");
+  char *l = setlocale(LC_NUMERIC, NULL);
+  mem_alloc((void**)&orig_numeric_locale, strlen(l)+1, __LOCATION__);
+  strcpy(orig_numeric_locale, l);
+
+  /* Process command line options */
+  calc_data.num_jobs  = 1;
+  calc_data.zo = 50.0;
+  calc_data.freq_loop_data = NULL;
+  rc_config.fill_threads = 1;
+  rc_config.matrix_cache_mb = 0;
+  rc_config.matrix_cache_disk_mb = 0;
+  rc_config.adaptive_tol = 0.0;
+  rc_config.matrix_interp_tol = 0.0;
+  rc_config.mixed_precision = 0;
+  rc_config.ooc_mb = 0;
+  rc_config.rdpat_mb = 0;
+  rc_config.input_file[0] = '\0';
+  rc_config.batch_mode = 1;
+
+  // default to show warnings or more important errors.
+  rc_config.verbose = 4;
+
+  while( (option = getopt_long(argc, argv, "i:hvdqV", long_options, &option_index) ) != -1 )
+  {
+    switch( option )
+    {
+      case 'i': /* specify input file name */
+        Set_Input_File( optarg );
+        input_arg = optarg;
+        break;
+
+      case 'v': /* increase verbosity */
+        rc_config.verbose++;
+        break;
+
+      case 'd': /* debug */
+        rc_config.debug++;
+        rc_config.verbose += 3;
+        break;
+
+      case 'q': /* quiet */
+        rc_config.debug = 0;
+        rc_config.verbose = 0;
+        break;
+
+      case 'h': /* print usage and exit */
+        Batch_Usage();
+        exit(0);
+        break;
+
+      case 'V': /* print xnec2c version */
+        puts( PACKAGE_STRING );
+        exit(0);
+        break;
+
+      case OPT_FILL_THREADS: /* number of matrix fill threads */
+        rc_config.fill_threads = atoi( optarg );
+        break;
+
+      case OPT_MATRIX_CACHE: /* memory budget of factored matrix cache */
+        rc_config.matrix_cache_mb = atoi( optarg );
+        break;
+
+      case OPT_MATRIX_CACHE_DISK: /* disk budget of factored matrix cache */
+        rc_config.matrix_cache_disk_mb = atoi( optarg );
+        break;
+
+      case OPT_SOMNEC_CACHE_DIR: /* directory of Sommerfeld ground grid files */
+        rc_config.somnec_cache_dir = optarg;
+        break;
+
+      case OPT_ADAPTIVE_SWEEP: /* tolerance of adaptive frequency sweep */
+        rc_config.adaptive_tol = Strtod( optarg, NULL );
+        break;
+
+      case OPT_MATRIX_INTERP: /* tolerance of interpolated interaction matrices */
+        rc_config.matrix_interp_tol = Strtod( optarg, NULL );
+        break;
+
+      case OPT_MIXED_PRECISION: /* single precision LU with refinement */
+        rc_config.mixed_precision = 1;
+        break;
+
+      case OPT_OUT_OF_CORE: /* memory budget of out-of-core matrices */
+        rc_config.ooc_mb = atoi( optarg );
+        break;
+
+      case OPT_RDPAT_MB: /* memory budget of radiation patterns */
+        rc_config.rdpat_mb = atoi( optarg );
+        break;
+
+      case OPT_STATS: /* write solver phase times after each loop */
+        rc_config.filename_stats = optarg;
+        break;
+
+      case OPT_BENCHMARK: /* time the solver phases of input files */
+        bench_file = optarg;
+        break;
+
+      case OPT_BENCHMARK_BASELINE: /* previous benchmark to compare with */
+        bench_baseline = optarg;
+        break;
+
+      case OPT_BENCHMARK_TOLERANCE: /* slowdown in percent of a regression */
+        bench_tol = Strtod( optarg, NULL );
+        break;
+
+      case OPT_OPTIMIZER_SOCKET: /* serve an optimizer on a unix socket */
+        opt_socket = optarg;
+        break;
+
+      case OPT_SWEEP: /* variable of a parameter sweep */
+        if( !Sweep_Add_Var(optarg) )
+          exit(1);
+        sweep = TRUE;
+        break;
+
+      case OPT_SWEEP_JOBS: /* processes of the parameter sweep */
+        sweep_jobs = atoi( optarg );
+        break;
+
+      case OPT_WRITE_CSV:
+        rc_config.filename_csv = optarg;
+        break;
+
+      case OPT_WRITE_S1P:
+        rc_config.filename_s1p = optarg;
+        break;
+
+      case OPT_WRITE_S2P_MAX_GAIN:
+        rc_config.filename_s2p_max_gain = optarg;
+        break;
+
+      case OPT_WRITE_S2P_VIEWER_GAIN:
+        rc_config.filename_s2p_viewer_gain = optarg;
+        break;
+
+      case OPT_WRITE_RDPAT:
+        rc_config.filename_rdpat = optarg;
+        break;
+
+      case OPT_WRITE_CURRENTS:
+        rc_config.filename_currents = optarg;
+        break;
+
+      case OPT_WRITE_RDPAT_BIN:
+        rc_config.filename_rdpat_bin = optarg;
+        break;
+
+      case OPT_WRITE_CURRENTS_BIN:
+        rc_config.filename_currents_bin = optarg;
+        break;
+
+      default:
+        Batch_Usage();
+        exit(1);
+        break;
+
+    } /* switch( option ) */
+  } /* while( (option = getopt_long(...)) != -1 ) */
+
+  /* All the arguments are input files to benchmark */
+  char **bench_inputs = NULL;
+  int bench_num = 0;
+  if( bench_file != NULL )
+  {
+    size_t mreq = (size_t)(argc - optind + 1) * sizeof(char *);
+    mem_alloc( (void **)&bench_inputs, mreq, "in batch.c" );
+    if( input_arg != NULL )
+      bench_inputs[bench_num++] = input_arg;
+    while( optind < argc )
+      bench_inputs[bench_num++] = argv[optind++];
+  }
+
+  /* Read input file path name if not supplied by -i option */
+  if( (strlen(rc_config.input_file) == 0) && (optind < argc) )
+    Set_Input_File( argv[optind++] );
+
+  while( optind < argc )
+  {
+    pr_warn("unexpected argument: %s\n", argv[optind]);
+    optind++;
+  }
+
+  if( (strlen(rc_config.input_file) == 0) &&
+      (bench_num == 0) && (opt_socket == NULL) )
+  {
+    pr_crit("an input file is required\n");
+    Batch_Usage();
+    exit(1);
+  }
+
+  if( (bench_file == NULL) && (opt_socket == NULL) &&
+      !sweep && !opt_have_files_to_save() )
+    pr_warn("no --write-* option given, results will not be saved\n");
+
+  /* --fill-threads 0 uses all the processors */
+  if( rc_config.fill_threads < 1 )
+  {
+    rc_config.fill_threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    if( rc_config.fill_threads < 1 )
+      rc_config.fill_threads = 1;
+    pr_info("Using %d matrix fill threads\n", rc_config.fill_threads);
+  }
+
+  /* Initialize the external math libraries */
+  init_mathlib();
+
+  if( bench_file != NULL )
+  {
+    int ret = Benchmark( bench_file, bench_baseline,
+        bench_tol, bench_inputs, bench_num );
+    free_ptr( (void **)&bench_inputs );
+    free_ptr( (void **)&orig_numeric_locale );
+    exit( ret );
+  }
+
+  /* The optimizer sends the models to run, the input
+   * file if given is only the first of them */
+  if( opt_socket != NULL )
+  {
+    int ret = Opt_Socket_Serve( opt_socket );
+    free_ptr( (void **)&orig_numeric_locale );
+    exit( ret );
+  }
+
+  /* Run the variants of the input file */
+  if( sweep )
+  {
+    int ret = Sweep_Run( rc_config.input_file, sweep_jobs );
+    free_ptr( (void **)&orig_numeric_locale );
+    exit( ret );
+  }
+
+  if( !Run_Input_File() )
+    exit(1);
+
+  Write_Optimizer_Data();
+
+  free_ptr((void**)&orig_numeric_locale);
+
+  return 0;
+} // main()
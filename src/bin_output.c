@@ -0,0 +1,410 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Binary output of the radiation pattern and of the currents and
+ * charges, written with --write-rdpat-bin and --write-currents-bin.
+ * Each file is a NumPy .npy file (format version 1.0) of a one
+ * dimensional array of records, with the same columns as the CSV
+ * files of --write-rdpat and --write-currents, in the byte order
+ * of the machine. The rows of each frequency step are appended
+ * as soon as the step is calculated, in the order the steps are
+ * finished, and the row count in the header is rewritten after
+ * each step so that the file can be read at any time. Steps that
+ * an adaptive sweep interpolates have no pattern or currents and
+ * are not written. In Python the file is mapped by:
+ *
+ *   numpy.load( "file.npy", mmap_mode="r" )
+ */
+
+#include "bin_output.h"
+#include "shared.h"
+#include <fcntl.h>
+
+/* Columns of the radiation pattern file, as bin_rdpat_row_t */
+static const bin_column_t rdpat_cols[] =
+{
+  { "mhz",        "f8" },
+  { "phi",        "f8" },
+  { "theta",      "f8" },
+  { "gain_total", "f8" },
+  { "gain_horiz", "f8" },
+  { "gain_vert",  "f8" },
+  { "gain_rhcp",  "f8" },
+  { "gain_lhcp",  "f8" }
+};
+
+/* Columns of the currents file, as bin_currents_row_t */
+static const bin_column_t currents_cols[] =
+{
+  { "mhz",          "f8" },
+  { "seg",          "i4" },
+  { "tag",          "i4" },
+  { "current_real", "f8" },
+  { "current_imag", "f8" },
+  { "current_mag",  "f8" },
+  { "charge_real",  "f8" },
+  { "charge_imag",  "f8" },
+  { "charge_mag",   "f8" },
+  { "x1",           "f8" },
+  { "y1",           "f8" },
+  { "z1",           "f8" },
+  { "x2",           "f8" },
+  { "y2",           "f8" },
+  { "z2",           "f8" }
+};
+
+static bin_output_t
+  bin_rdpat    = { .fd = -1 },
+  bin_currents = { .fd = -1 };
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Header()
+ *
+ * Writes the .npy header of file bo, for its current row count,
+ * padded to bo->header_len if that is set. Returns FALSE on error
+ */
+  static gboolean
+Bin_Header( bin_output_t *bo )
+{
+  char hdr[1024], rows[32];
+  const char *order;
+  size_t len, pad;
+  int idx;
+
+  order = (G_BYTE_ORDER == G_LITTLE_ENDIAN) ? "<" : ">";
+
+  /* Magic, version 1.0 and the header length filled in below */
+  memcpy( hdr, NPY_MAGIC, NPY_MAGIC_LEN );
+  hdr[6] = 1;
+  hdr[7] = 0;
+  len = NPY_PREFIX_LEN;
+
+  len += (size_t)snprintf( &hdr[len], sizeof(hdr) - len, "{'descr': [" );
+  for( idx = 0; idx < bo->ncols; idx++ )
+    len += (size_t)snprintf( &hdr[len], sizeof(hdr) - len, "('%s', '%s%s'), ",
+        bo->cols[idx].name, order, bo->cols[idx].type );
+
+  /* The row count is right aligned in a fixed width */
+  snprintf( rows, sizeof(rows), "%" G_GUINT64_FORMAT, bo->rows );
+  len += (size_t)snprintf( &hdr[len], sizeof(hdr) - len,
+      "], 'fortran_order': False, 'shape': (%*s,), }",
+      NPY_ROWS_DIGITS, rows );
+
+  /* Padded with spaces and ended with a newline */
+  if( bo->header_len == 0 )
+    bo->header_len = (len + 1 + NPY_HEADER_ALIGN - 1) &
+      ~(size_t)(NPY_HEADER_ALIGN - 1);
+  if( bo->header_len > sizeof(hdr) )
+  {
+    pr_err( "binary output: header too long\n" );
+    return( FALSE );
+  }
+  pad = bo->header_len - len - 1;
+  memset( &hdr[len], ' ', pad );
+  hdr[bo->header_len - 1] = '\n';
+
+  len = bo->header_len - NPY_PREFIX_LEN;
+  hdr[8] = (char)( len & 0xff );
+  hdr[9] = (char)( len >> 8 );
+
+  if( pwrite(bo->fd, hdr, bo->header_len, 0) != (ssize_t)bo->header_len )
+  {
+    pr_err( "binary output: write(): %s\n", strerror(errno) );
+    return( FALSE );
+  }
+
+  return( TRUE );
+} /* Bin_Header() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Close()
+ *
+ * Closes the binary output file bo
+ */
+  static void
+Bin_Close( bin_output_t *bo )
+{
+  if( bo->fd >= 0 )
+  {
+    close( bo->fd );
+    pr_debug( "binary output: %" G_GUINT64_FORMAT " rows written\n", bo->rows );
+  }
+  bo->fd = -1;
+  free_ptr( (void **)&bo->buf );
+  bo->buf_size = 0;
+
+} /* Bin_Close() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Open()
+ *
+ * Creates the binary output file bo, of ncols columns cols and
+ * rows of row_size bytes, and writes its header with no rows
+ */
+  static void
+Bin_Open( bin_output_t *bo, const char *filename,
+    const bin_column_t *cols, int ncols, size_t row_size )
+{
+  size_t size = 0;
+  int idx;
+
+  Bin_Close( bo );
+
+  /* The columns must be packed in the row struct */
+  for( idx = 0; idx < ncols; idx++ )
+    size += (size_t)( cols[idx].type[1] - '0' );
+  if( size != row_size )
+  {
+    pr_err( "binary output: row of %s is not packed\n", filename );
+    return;
+  }
+
+  bo->cols       = cols;
+  bo->ncols      = ncols;
+  bo->row_size   = row_size;
+  bo->rows       = 0;
+  bo->header_len = 0;
+
+  bo->fd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+  if( bo->fd < 0 )
+  {
+    pr_err( "binary output: %s: %s\n", filename, strerror(errno) );
+    return;
+  }
+
+  if( !Bin_Header(bo) )
+    Bin_Close( bo );
+
+} /* Bin_Open() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Rows()
+ *
+ * Returns the row buffer of bo with room for nrows rows
+ */
+  static char *
+Bin_Rows( bin_output_t *bo, size_t nrows )
+{
+  size_t mreq = nrows * bo->row_size;
+
+  if( mreq > bo->buf_size )
+  {
+    mem_realloc( (void **)&bo->buf, mreq, "in bin_output.c" );
+    bo->buf_size = mreq;
+  }
+
+  return( bo->buf );
+} /* Bin_Rows() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Append()
+ *
+ * Appends nrows rows from the row buffer of bo to its
+ * file and updates the row count in the header
+ */
+  static void
+Bin_Append( bin_output_t *bo, size_t nrows )
+{
+  size_t len = nrows * bo->row_size;
+  off_t offset;
+
+  offset = (off_t)bo->header_len + (off_t)(bo->rows * bo->row_size);
+  if( pwrite(bo->fd, bo->buf, len, offset) != (ssize_t)len )
+  {
+    pr_err( "binary output: write(): %s\n", strerror(errno) );
+    Bin_Close( bo );
+    return;
+  }
+
+  bo->rows += nrows;
+  if( !Bin_Header(bo) )
+    Bin_Close( bo );
+
+} /* Bin_Append() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Rdpat_Step()
+ *
+ * Appends the radiation pattern of frequency step fstep
+ */
+  static void
+Bin_Rdpat_Step( int fstep )
+{
+  bin_rdpat_row_t *row;
+  double theta, phi, dth, dph;
+  int idx, nph, nth, pol;
+
+  if( isFlagClear(ENABLE_RDPAT) || !Rdpat_Store_Load(fstep) )
+    return;
+
+  row = (bin_rdpat_row_t *)Bin_Rows( &bin_rdpat,
+      (size_t)fpat.nph * (size_t)fpat.nth );
+
+  /* theta and phi step in rads */
+  dth = (double)fpat.dth * (double)TORAD;
+  dph = (double)fpat.dph * (double)TORAD;
+
+  idx = 0;
+  phi = (double)fpat.phis * (double)TORAD;
+  for( nph = 0; nph < fpat.nph; nph++ )
+  {
+    theta = (double)fpat.thets * (double)TORAD;
+    for( nth = 0; nth < fpat.nth; nth++ )
+    {
+      row->mhz   = save.freq[fstep];
+      row->phi   = phi * TODEG;
+      row->theta = theta * TODEG;
+      for( pol = 0; pol < NUM_POL; pol++ )
+        row->gain[pol] = rad_pattern[fstep].gtot[idx] +
+          Polarization_Factor( pol, fstep, idx );
+
+      theta += dth;
+      row++;
+      idx++;
+    }
+    phi += dph;
+  }
+
+  Bin_Append( &bin_rdpat, (size_t)idx );
+
+} /* Bin_Rdpat_Step() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Currents_Step()
+ *
+ * Appends the currents and charges of frequency step fstep
+ */
+  static void
+Bin_Currents_Step( int fstep )
+{
+  bin_currents_row_t *row;
+  double fmhz, wavelength, charge_scale;
+  complex double charge;
+  int idx;
+
+  if( !crnt.valid || (data.n == 0) )
+    return;
+
+  fmhz = save.freq[fstep];
+  wavelength   = CVEL / fmhz;
+  charge_scale = 1.0E-6 / fmhz;
+
+  row = (bin_currents_row_t *)Bin_Rows( &bin_currents, (size_t)data.n );
+  for( idx = 0; idx < data.n; idx++ )
+  {
+    row->mhz = fmhz;
+    row->seg = idx + 1;
+    row->tag = data.itag[idx];
+
+    row->current[0] = creal( crnt.cur[idx] ) * wavelength;
+    row->current[1] = cimag( crnt.cur[idx] ) * wavelength;
+    row->current[2] = cabs( crnt.cur[idx] ) * wavelength;
+
+    charge = cmplx( crnt.bir[idx], crnt.bii[idx] ) * charge_scale;
+    row->charge[0] = creal( charge );
+    row->charge[1] = cimag( charge );
+    row->charge[2] = cabs( charge );
+
+    row->x1 = data.x1[idx];
+    row->y1 = data.y1[idx];
+    row->z1 = data.z1[idx];
+    row->x2 = data.x2[idx];
+    row->y2 = data.y2[idx];
+    row->z2 = data.z2[idx];
+    row++;
+  }
+
+  Bin_Append( &bin_currents, (size_t)data.n );
+
+} /* Bin_Currents_Step() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Output_Open()
+ *
+ * Creates the binary output files at the start of a frequency
+ * loop. Like the files of the other --write-* options, they
+ * are only written in batch mode or with the optimizer on
+ */
+  void
+Bin_Output_Open( void )
+{
+  Bin_Output_Close();
+
+  if( !rc_config.batch_mode && isFlagClear(OPTIMIZER_OUTPUT) )
+    return;
+
+  if( rc_config.filename_rdpat_bin )
+    Bin_Open( &bin_rdpat, rc_config.filename_rdpat_bin, rdpat_cols,
+        (int)(sizeof(rdpat_cols) / sizeof(rdpat_cols[0])),
+        sizeof(bin_rdpat_row_t) );
+
+  if( rc_config.filename_currents_bin )
+    Bin_Open( &bin_currents, rc_config.filename_currents_bin, currents_cols,
+        (int)(sizeof(currents_cols) / sizeof(currents_cols[0])),
+        sizeof(bin_currents_row_t) );
+
+} /* Bin_Output_Open() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Output_Step()
+ *
+ * Appends the rows of frequency step fstep, just calculated,
+ * to the binary output files. Called with the step's data in
+ * the global structures, as left by New_Frequency() or by
+ * Get_Freq_Data() for a step of a child process
+ */
+  void
+Bin_Output_Step( int fstep )
+{
+  if( (fstep < 0) || (fstep >= calc_data.steps_total) )
+    return;
+
+  if( bin_rdpat.fd >= 0 )
+    Bin_Rdpat_Step( fstep );
+
+  if( bin_currents.fd >= 0 )
+    Bin_Currents_Step( fstep );
+
+} /* Bin_Output_Step() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Bin_Output_Close()
+ *
+ * Closes the binary output files at the end of a frequency loop
+ */
+  void
+Bin_Output_Close( void )
+{
+  Bin_Close( &bin_rdpat );
+  Bin_Close( &bin_currents );
+
+} /* Bin_Output_Close() */
+
+/*-----------------------------------------------------------------------*/
+
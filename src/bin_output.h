@@ -0,0 +1,83 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef BIN_OUTPUT_H
+#define BIN_OUTPUT_H    1
+
+#include "common.h"
+#include <stdint.h>
+
+/* Version 1.0 of the NumPy .npy format: magic string, major
+ * and minor version, little endian header length and header */
+#define NPY_MAGIC         "\x93NUMPY"
+#define NPY_MAGIC_LEN     6
+#define NPY_PREFIX_LEN    10
+
+/* The header is padded to a multiple of this, with room for the
+ * digits of the largest row count so that it can be rewritten
+ * in place as rows are appended */
+#define NPY_HEADER_ALIGN  64
+#define NPY_ROWS_DIGITS   20
+
+/* A column of a binary output file, its
+ * name and NumPy type without the byte order */
+typedef struct
+{
+  const char *name;
+  const char *type;
+
+} bin_column_t;
+
+/* Row of the radiation pattern file */
+typedef struct
+{
+  double mhz, phi, theta;
+  double gain[NUM_POL];
+
+} bin_rdpat_row_t;
+
+/* Row of the currents and charges file */
+typedef struct
+{
+  double mhz;
+  int32_t seg, tag;
+  double current[3], charge[3];
+  double x1, y1, z1, x2, y2, z2;
+
+} bin_currents_row_t;
+
+/* A binary output file being written */
+typedef struct
+{
+  const bin_column_t *cols;
+  int ncols;
+  size_t row_size;
+
+  int fd;
+  size_t header_len;
+  guint64 rows;
+
+  /* Rows of the current step, reused between steps */
+  char *buf;
+  size_t buf_size;
+
+} bin_output_t;
+
+#endif
+
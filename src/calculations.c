@@ -585,26 +585,16 @@ double db20( double x )
 void intrp( double x, double y, complex double *f1,
     complex double *f2, complex double *f3, complex double *f4 )
 {
-  static int ix, iy, ixs=-10, iys=-10, igrs=-10, ixeg=0, iyeg=0;
-  static int nxm2, nym2, nxms, nyms, nd, ndp;
-  static int *nda = NULL, *ndpa = NULL;
+  /* Interpolation region is cached per thread for the cmset() fill threads */
+  static __thread int ix, iy, ixs=-10, iys=-10, igrs=-10, ixeg=0, iyeg=0;
+  static __thread int nxm2, nym2, nxms, nyms, nd, ndp;
+  static const int nda[3] = { 11, 17, 9 }, ndpa[3] = { 110, 85, 72 };
   int jump;
-  static double dx = 1.0, dy = 1.0, xs = 0.0, ys = 0.0, xz, yz;
+  static __thread double dx = 1.0, dy = 1.0, xs = 0.0, ys = 0.0, xz, yz;
   double xx, yy;
-  static complex double a[4][4], b[4][4], c[4][4], d[4][4];
+  static __thread complex double a[4][4], b[4][4], c[4][4], d[4][4];
   complex double p1=CPLX_00, p2=CPLX_00, p3=CPLX_00, p4=CPLX_00;
   complex double fx1, fx2, fx3, fx4;
-  static gboolean first_call = TRUE;
-
-  if( first_call )
-  {
-    first_call = FALSE;
-    size_t mreq = 3*sizeof(int);
-    mem_alloc( (void **)&nda,  mreq, _("in calculations.c"));
-    mem_alloc( (void **)&ndpa, mreq, _("in calculations.c"));
-    nda[0] = 11; nda[1] = 17; nda[2] = 9;
-    ndpa[0] = 110; ndpa[1] = 85; ndpa[2] = 72;
-  }
 
   jump = FALSE;
   if( (x < xs) || (y < ys) )
@@ -240,6 +240,9 @@ typedef struct Segment
 // Enable Optimizer Output
 #define OPTIMIZER_OUTPUT    0x0080000000000000ll
 
+/* Stop() returns on errors in batch servers, instead of exiting */
+#define STOP_RETURNS        0x0100000000000000ll
+
 #define ALL_FLAGS           0xFFFFFFFFFFFFFFFFll
 
 /* Type of near field data requested */
@@ -337,6 +340,9 @@ typedef struct
   /* Preferred mathlib index, if available */
   int mathlib_idx, mathlib_batch_idx;
 
+  /* BLAS threads of the batch mathlib, 0 for the library default */
+  int mathlib_batch_threads;
+
   /* See enum GAIN_SCALE */
   int gain_style;
 
@@ -347,6 +353,38 @@ typedef struct
   /* if true, exit after the first frequency loop iteration */
   int batch_mode;
 
+  /* Threads used by cmset() to fill the matrix, by
+   * factrs()/solves() for the symmetry mode blocks
+   * and by rdpat()/nfpat() for the field patterns */
+  int fill_threads;
+
+  /* Memory and disk budgets in MB of the factored matrix cache */
+  int matrix_cache_mb, matrix_cache_disk_mb;
+
+  /* Relative impedance tolerance of the adaptive
+   * frequency sweep, 0 to solve all the steps */
+  double adaptive_tol;
+
+  /* Relative error tolerance of the interaction matrices
+   * interpolated over a frequency sweep, 0 to fill them all */
+  double matrix_interp_tol;
+
+  /* Factor the interaction matrix in single precision and
+   * refine the solutions to double precision if true */
+  int mixed_precision;
+
+  /* Memory budget in MB of the interaction matrix, above
+   * which it is kept in a file and factored by panels, 0 off */
+  int ooc_mb;
+
+  /* Memory budget in MB of the radiation patterns, above which
+   * those of the frequency steps are kept in a file, 0 off */
+  int rdpat_mb;
+
+  /* Directory of the Sommerfeld ground grid files, NULL
+   * for ~/.xnec2c/somnec and empty to keep grids in memory only */
+  char *somnec_cache_dir;
+
   /* verbose and debug levels, see console.h */
   int verbose, debug;
 
@@ -369,6 +407,15 @@ typedef struct
   char *filename_s2p_viewer_gain;
   char *filename_rdpat;
   char *filename_currents;
+
+  /* Binary files written as each frequency step is done,
+   * set by --write-rdpat-bin and --write-currents-bin */
+  char *filename_rdpat_bin;
+  char *filename_currents_bin;
+
+  /* Solver phase times are written to this file
+   * after each frequency loop, set by --stats */
+  char *filename_stats;
 } rc_config_t;
 
 typedef struct {
@@ -876,7 +923,9 @@ typedef struct
 
 } impedance_data_t;
 
-/* Radiation pattern data */
+/* Radiation pattern data. With --rdpat-mb the buffers of the
+ * full pattern (gtot, tilt, axrt and sens) are NULL unless
+ * Rdpat_Store_Load() has brought it into memory */
 typedef struct
 {
   double
@@ -885,12 +934,14 @@ typedef struct
     *min_gain,      /* Minimum gain for each polarization type */
     *max_gain_tht,  /* Theta angle where maximum gain occurs */
     *max_gain_phi,  /*   Phi angle where maximum gain occurs */
+    *back_gain,     /* Gain opposite the maximum, for the F/B ratio */
     *tilt,          /* Tilt angle of polarization ellipse  */
     *axrt;          /* Elliptic axial ratio of pol ellipse */
 
   int
     *max_gain_idx,  /* Where in rad_pattern.gtot the max value occurs */
     *min_gain_idx,  /* Where in rad_pattern.gtot the min value occurs */
+    *back_gain_idx, /* Where the back gain is, -1 if there is no F/B */
     *sens;          /* Polarization sense (vertical, horizontal, elliptic etc) */
 
 } rad_pattern_t;
@@ -921,6 +972,10 @@ typedef struct
   char newer; /* New data available */
   char valid; /* Available data valid */
 
+  /* Field points of the E and H grids computed so far, which
+   * are drawn while nfpat() is still running (partial is set) */
+  gint done_er, done_hr, partial;
+
 } near_field_t;
 
 /* Forked processes data */
@@ -938,6 +993,63 @@ typedef struct
 
 } forked_proc_data_t;
 
+/* Solver phases timed by Perf_Start() and Perf_Stop() */
+enum PERF_PHASE
+{
+  PERF_GEOMETRY = 0,  /* Reading and frequency scaling of geometry */
+  PERF_CONECT,        /* Segment and patch connections */
+  PERF_GROUND,        /* Ground parameters and Sommerfeld grids */
+  PERF_FILL,          /* Interaction matrix fill */
+  PERF_FACTOR,        /* Interaction matrix factoring */
+  PERF_SOLVE,         /* Network and current solution */
+  PERF_RDPAT,         /* Radiation pattern */
+  PERF_NFPAT,         /* Near field patterns */
+  PERF_IPC,           /* Frequency data transfer between processes */
+  PERF_NUM_PHASES
+};
+
+/* Accumulated time of a solver phase */
+typedef struct
+{
+  double
+    wall,   /* Elapsed time in seconds */
+    cpu;    /* CPU time of the process in seconds */
+
+  guint64
+    count,  /* Number of times the phase was timed */
+    bytes;  /* Data moved, for the ipc phase */
+
+} perf_phase_t;
+
+/* Start of a timed phase, see Perf_Start() */
+typedef struct perf_mark
+{
+  double
+    wall, cpu,    /* Clocks at the start */
+    child_wall,   /* Time of the phases nested in it */
+    child_cpu;
+
+  struct perf_mark *parent; /* Phase it is nested in */
+
+} perf_mark_t;
+
+/* Benchmark results of a model, see xnec2c-batch --benchmark */
+typedef struct
+{
+  char file[FILENAME_LEN];  /* Input file */
+
+  int
+    ok,         /* Frequency loop completed */
+    segments,   /* Number of wire segments */
+    patches,    /* Number of surface patches */
+    steps;      /* Number of frequency steps */
+
+  perf_phase_t
+    total,                    /* Whole run of the model */
+    phase[PERF_NUM_PHASES];   /* Solver phases */
+
+} perf_model_t;
+
 enum
 {
   MAIN_WINDOW = 1,
@@ -946,6 +1058,15 @@ enum
 };
 
 /* Function prototypes produced by cproto */
+/* adaptive.c */
+void Adaptive_Sweep_Start(void);
+int Adaptive_Sweep_Next(void);
+void Adaptive_Sweep_Fill(void);
+gboolean Adaptive_Sweep_Refine(void);
+/* bin_output.c */
+void Bin_Output_Open(void);
+void Bin_Output_Step(int fstep);
+void Bin_Output_Close(void);
 /* calculations.c */
 void qdsrc(int is, _Complex double v, _Complex double *e);
 void cabc(_Complex double *curx);
@@ -1344,18 +1465,13 @@ void Cairo_Draw_Lines(cairo_t *cr, GdkPoint *points, int npoints);
 /* draw_radiation.c */
 int Draw_Radiation(cairo_t *cr);
 gboolean Animate_Near_Field(gpointer udata);
-double Polarization_Factor(int pol_type, int fstep, int idx);
 void Set_Polarization(int pol);
 void Set_Gain_Style(int gs);
 void New_Radiation_Projection_Angle(void);
 gboolean Redo_Radiation_Pattern(gpointer udata);
-double Viewer_Gain(projection_parameters_t proj_parameters, int fstep);
 void Rdpattern_Window_Killed(void);
 void Set_Window_Labels(void);
-void Alloc_Rdpattern_Buffers(int nfrq, int nth, int nph);
-void Alloc_Nearfield_Buffers(int n1, int n2, int n3);
 void Free_Draw_Buffers(void);
-double Scale_Gain( double gain, int fstep, int idx );
 /* draw_structure.c */
 void Draw_Structure(cairo_t *cr);
 void New_Patch_Data(void);
@@ -1375,13 +1491,19 @@ void gwave(_Complex double *erv, _Complex double *ezv, _Complex double *erh, _Co
 void gx(double zz, double rh, double xk, _Complex double *gz, _Complex double *gzp);
 void hintg(double xi, double yi, double zi);
 void hsfld(double xi, double yi, double zi, double ai);
+void Nfpat_Init(void);
 void nfpat(int nfeh);
 void pcint(double xi, double yi, double zi, double cabi, double sabi, double salpi, _Complex double *e);
 void unere(double xob, double yob, double zob);
 /* fork.c */
+void Freq_Slots_Open(void);
+void Freq_Slots_Map(void);
+gboolean Freq_Slot_Rdpattern(int fstep, rad_pattern_t *rdpat);
+gboolean Freq_Queue_Start(double *freq, int *fstep, int nsteps, int njobs);
+void Freq_Queue_Stop(void);
 void Child_Process(int num_child);
 ssize_t Write_Pipe(int idx, char *str, ssize_t len, gboolean err);
-int Get_Freq_Data(int idx, int fstep);
+int Get_Freq_Data(int idx, int *fstep);
 /* geom_edit.c */
 void Wire_Editor(int action);
 void Patch_Editor(int action);
@@ -1422,6 +1544,7 @@ void sflds(double t, _Complex double *e);
 gboolean Read_Comments(void);
 gboolean Read_Geometry(void);
 gboolean Read_Commands(void);
+gboolean Read_Input_Text(char *text, size_t len);
 gboolean readmn(char *mn, int *i1, int *i2, int *i3, int *i4, double *f1, double *f2, double *f3, double *f4, double *f5, double *f6);
 gboolean readgm(char *gm, int *i1, int *i2, double *x1, double *y1, double *z1, double *x2, double *y2, double *z2, double *rad);
 /* interface.c */
@@ -1458,11 +1581,13 @@ GtkWidget *create_ground2_command(GtkBuilder **builder);
 GtkWidget *create_gend_editor(GtkBuilder **builder);
 GtkWidget *create_aboutdialog(GtkBuilder **builder);
 GtkWidget *create_nec2_save_dialog(GtkBuilder **builder);
+GtkWidget *create_perf_window(GtkBuilder **builder);
 /* main.c */
 int main(int argc, char *argv[]);
 gboolean Open_Input_File(gpointer udata);
 gboolean isChild(void);
 /* matrix.c */
+void cmset_columns(int nrow, _Complex double *cmx, int i1, int i2, double rkhx, int iexkx, gboolean trans);
 void cmset(int nrow, _Complex double *cmx, double rkhx, int iexkx);
 void cmsw(int j1, int j2, int i1, int i2, _Complex double *cmx, _Complex double *cw, int ncw, int nrow, int itrp);
 void etmns(double p1, double p2, double p3, double p4, double p5, double p6, int ipr, _Complex double *e);
@@ -1473,18 +1598,56 @@ void fblock(int nrow, int ncol, int imax, int ipsym);
 int solve(int n, _Complex double *a, int *ip, _Complex double *b, int ndim);
 int solve_gauss_elim( int n, complex double *a, int *ip, complex double *b, int ndim );
 void solves(_Complex double *a, int *ip, _Complex double *b, int neq, int nrh, int np, int n, int mp, int m);
+/* matrix_cache.c */
+gboolean Matrix_Cache_Load(_Complex double *cmx, int *ip);
+void Matrix_Cache_Store(_Complex double *cmx, int *ip);
+/* matrix_interp.c */
+gboolean Matrix_Interp_Fill(int nrow, _Complex double *cmx, void (*fill)(double fmhz, _Complex double *cmx));
+int Matrix_Interp_Segment(double fmhz);
+/* matrix_lu.c */
+void Matrix_Lu_Set_Threads(int threads);
+void Matrix_Lu_Set_Concurrent(int num);
+void Matrix_Lu_Swap(_Complex double *a, int lda, int ncol, const int *ip, int k1, int k2);
+void Matrix_Lu_Gemm(int m, int n, int k, const _Complex double *a, int lda, const _Complex double *b, int ldb, _Complex double *c, int ldc);
+void Matrix_Lu_Trsm(int n, int ncol, const _Complex double *l, int ldl, _Complex double *b, int ldb);
+int Matrix_Lu_Factor(int m, int n, _Complex double *a, int lda, int *ip);
+int Matrix_Lu_Solve(int n, int nrhs, _Complex double *a, int lda, int *ip, _Complex double *b, int ldb);
+/* matrix_ooc.c */
+gboolean Matrix_Ooc_Open(int nrow, int ncol);
+void Matrix_Ooc_Close(void);
+gboolean Matrix_Ooc_Active(void);
+gboolean Matrix_Ooc_Failed(void);
+void Matrix_Ooc_Fill_Factor(int np, int nrow, int *ip, double rkh, int iexk);
+void Matrix_Ooc_Solve(int blk, int np, int *ip, _Complex double *b, int nrh, int ldb);
 /* nec2_model.c */
 void Zero_Store(GtkListStore *store, GtkTreeIter *iter, int ncols, int start_idx, int stop_idx);
 void Nec2_Input_File_Treeview(int action);
 void cell_edited_callback(GtkCellRendererText *cell, gchar *path, gchar *new_text, gpointer user_data);
 void Save_Nec2_Input_File(GtkWidget *treeview_window, char *nec2_file);
 /* network.c */
-void netwk(_Complex double *cmx, int *ip, _Complex double *einc);
+void netwk(_Complex double *cmx, int *ip, _Complex double *einc, int solved);
 void load(int *ldtyp, int *ldtag, int *ldtagf, int *ldtagt, double *zlr, double *zli, double *zlc);
+/* opt_socket.c */
+int Opt_Socket_Serve(char *path);
 /* optimize.c */
 void Write_Optimizer_Data(void);
 void *Optimizer_Output(void *arg);
 int opt_have_files_to_save(void);
+/* perf.c */
+void Perf_Start(perf_mark_t *mark);
+void Perf_Stop(perf_mark_t *mark, int phase);
+void Perf_Count_Bytes(int phase, size_t bytes);
+void Perf_Reset(void);
+void Perf_Get(perf_phase_t *phases);
+void Perf_Add(perf_phase_t *phases);
+const char *Perf_Phase_Name(int phase);
+gboolean Perf_Write_Bench(char *fname, perf_model_t *models, int num);
+int Perf_Read_Bench(char *fname, perf_model_t **models);
+int Perf_Compare_Bench(perf_model_t *models, int num, perf_model_t *base, int nbase, double tol);
+void Perf_Write_Stats(double wall);
+void on_main_performance_activate(GtkMenuItem *menuitem, gpointer user_data);
+void on_perf_window_destroy(GObject *object, gpointer user_data);
+void on_perf_reset_button_clicked(GtkButton *button, gpointer user_data);
 /* plot_freqdata.c */
 void Plot_Frequency_Data(cairo_t *cr);
 void Plots_Window_Killed(void);
@@ -1492,19 +1655,47 @@ void Set_Frequency_On_Click(GdkEvent *event);
 int freqplots_click_pending(void);
 /* radiation.c */
 void rdpat(void);
+void Rdpat_Set_Extremes(int fstep);
+double Polarization_Factor(int pol_type, int fstep, int idx);
+double Scale_Gain(double gain, int fstep, int idx);
+void Rdpattern_Slots_Remap(void);
+void Alloc_Rdpattern_Buffers(int nfrq, int nth, int nph);
+void Alloc_Nearfield_Buffers(int n1, int n2, int n3);
+double Viewer_Gain(projection_parameters_t proj_parameters, int fstep);
 /* rc_config.c */
 gboolean Create_Default_Config(void);
 void Set_Window_Geometry(GtkWidget *window, gint x, gint y, gint width, gint height);
 gboolean Read_Config(void);
 void Get_GUI_State(void);
 gboolean Save_Config(void);
+/* rdpat_store.c */
+void Rdpat_Store_Open(void);
+gboolean Rdpat_Store_Needed(int nfrq, int nth, int nph);
+void Rdpat_Store_Unmap(void);
+gboolean Rdpat_Store_Map(int nfrq, int nth, int nph);
+size_t Rdpat_Store_Write(int fstep, int dst);
+gboolean Rdpat_Store_Load(int fstep);
+void Rdpat_Store_New(int fstep);
+void Rdpat_Store_Drop(int fstep);
+void Rdpat_Store_Point(int fstep, int idx, double *gtot, double *axrt, double *tilt);
 /* shared.c */
 /* somnec.c */
 void somnec(double epr, double sig, double fmhz);
 void fbar(_Complex double p, _Complex double *fbar);
+/* sweep.c */
+gboolean Sweep_Add_Var(char *spec);
+int Sweep_Run(char *fname, int jobs);
+/* symbols.c */
+gboolean Sym_Eval(const char *text, double *val);
+gboolean Sym_Assign(const char *text);
+gboolean Sym_Fields(const char *text, int *iarr, int nint, double *rarr, int nflt);
+void Sym_Override(const char *name, double value);
+void Sym_Clear(gboolean overrides);
+int Sym_Count(void);
 /* utils.c */
 void usage(void);
 int Stop(char *mesg, int err);
+const char *Stop_Message(void);
 int Notice(char *title, char *message,  GtkButtonsType buttons);
 gboolean Nec2_Save_Warn(const gchar *mesg);
 int Load_Line(char *buff, FILE *pfile);
@@ -1515,6 +1706,7 @@ void mem_obj_dump(void *ptr);
 void free_ptr(void **ptr);
 gboolean Open_File(FILE **fp, char *fname, const char *mode);
 void Close_File(FILE **fp);
+gboolean Load_File(char *fname, size_t max, char **text, size_t *len);
 void Display_Fstep(GtkEntry *entry, int fstep);
 int isFlagSet(unsigned long long int flag);
 int isFlagClear(unsigned long long int flag);
@@ -1525,6 +1717,7 @@ void SaveFlag(unsigned long long int *flag, unsigned long long int mask);
 void Strlcpy(char *dest, const char *src, size_t n);
 void Strlcat(char *dest, const char *src, size_t n);
 double Strtod(char *nptr, char **endptr);
+guint64 Hash_Bytes(guint64 h, const void *buf, size_t cnt);
 char *str_append(char *dst, char *a, char *b, size_t n);
 void Get_Dirname(char *fpath, char *dirname, int *fname_idx);
 void xnec2_widget_queue_draw(GtkWidget *w);
@@ -1544,5 +1737,6 @@ gboolean Start_Frequency_Loop(void);
 void Stop_Frequency_Loop(void);
 void Incident_Field_Loop(void);
 int set_freq_step(void);
+gboolean Run_Frequency_Loop(void);
 
 #endif
@@ -38,47 +38,6 @@ static point_3d_t *point_3d = NULL;
 
 /*-----------------------------------------------------------------------*/
 
-/* Scale_Gain()
- *
- * Scales radiation pattern gain according to selected style
- * ( ARRL style, logarithmic or linear voltage/power )
- */
-double Scale_Gain( double gain, int fstep, int idx )
-{
-  /* Scaled rad pattern gain and pol factor */
-  double scaled_rad = 0.0;
-
-  gain += Polarization_Factor( calc_data.pol_type, fstep, idx );
-
-  switch( rc_config.gain_style )
-  {
-    case GS_LINP:
-      scaled_rad = pow(10.0, (gain/10.0));
-      break;
-
-    case GS_LINV:
-      scaled_rad = pow(10.0, (gain/20.0));
-      break;
-
-    case GS_ARRL:
-      scaled_rad = exp( 0.058267 * gain );
-      break;
-
-    case GS_LOG:
-      scaled_rad = gain;
-      if( scaled_rad < -40 )
-        scaled_rad = 0.0;
-      else
-        scaled_rad = scaled_rad /40.0 + 1.0;
-
-  } /* switch( rc_config.gain_style ) */
-
-  return( scaled_rad );
-
-} /* Scale_Gain() */
-
-/*-----------------------------------------------------------------------*/
-
 /* Draw_Radiation_Pattern()
  *
  * Draws the radiation pattern as a frame of line
@@ -117,6 +76,10 @@ Draw_Radiation_Pattern( cairo_t *cr )
   if( isFlagClear(ENABLE_RDPAT) || (fstep < 0) )
     return;
 
+  /* Bring the pattern into memory if it is kept in the store */
+  if( !Rdpat_Store_Load(fstep) )
+    return;
+
   pol = calc_data.pol_type;
 
   /* Change drawing if newer rad pattern data */
@@ -354,6 +317,7 @@ Draw_Radiation_Pattern( cairo_t *cr )
 Draw_Near_Field( cairo_t *cr )
 {
   int idx, npts; /* Number of points to plot */
+  int ne, nh, np; /* Points of E/H field and Poynting vector done */
   double
     fx, fy, fz, /* Co-ordinates of "free" end of field lines */
     fscale;     /* Scale factor for equalizing field line segments */
@@ -379,7 +343,8 @@ Draw_Near_Field( cairo_t *cr )
   double xred = 0.0, xgrn = 0.0, xblu = 0.0;
 
   /* Abort if drawing a near field pattern is not possible */
-  if( isFlagClear(ENABLE_NEAREH) || !near_field.valid )
+  if( isFlagClear(ENABLE_NEAREH) ||
+      !(near_field.valid || g_atomic_int_get(&near_field.partial)) )
     return;
 
   /* Initialize projection parameters */
@@ -429,12 +394,24 @@ Draw_Near_Field( cairo_t *cr )
     structure_proj_params = params;
   } /* if( isFlagSet(OVERLAY_STRUCT) ) */
 
-  /* Step thru near field values */
+  /* Step thru near field values, only those
+   * done so far while nfpat() is still running */
   npts = fpat.nrx * fpat.nry * fpat.nrz;
+  ne = nh = npts;
+  if( g_atomic_int_get(&near_field.partial) )
+  {
+    ne = g_atomic_int_get( &near_field.done_er );
+    nh = g_atomic_int_get( &near_field.done_hr );
+  }
+  /* The minimum is taken only over the grids being computed */
+  np = npts;
+  if( (fpat.nfeh & NEAR_EFIELD) && (np > ne) ) np = ne;
+  if( (fpat.nfeh & NEAR_HFIELD) && (np > nh) ) np = nh;
+
   for( idx = 0; idx < npts; idx++ )
   {
     /*** Draw Near E Field ***/
-    if( isFlagSet(DRAW_EFIELD) && (fpat.nfeh & NEAR_EFIELD) )
+    if( isFlagSet(DRAW_EFIELD) && (fpat.nfeh & NEAR_EFIELD) && (idx < ne) )
     {
       /* Set gc attributes for segment */
       Value_to_Color( &xred, &xgrn, &xblu,
@@ -465,7 +442,7 @@ Draw_Near_Field( cairo_t *cr )
     } /* if( isFlagSet(DRAW_EFIELD) && (fpat.nfeh & NEAR_EFIELD) ) */
 
     /*** Draw Near H Field ***/
-    if( isFlagSet(DRAW_HFIELD) && (fpat.nfeh & NEAR_HFIELD) )
+    if( isFlagSet(DRAW_HFIELD) && (fpat.nfeh & NEAR_HFIELD) && (idx < nh) )
     {
       /* Set gc attributes for segment */
       Value_to_Color( &xred, &xgrn, &xblu,
@@ -498,7 +475,8 @@ Draw_Near_Field( cairo_t *cr )
     /*** Draw Poynting Vector ***/
     if( isFlagSet(DRAW_POYNTING)  &&
         (fpat.nfeh & NEAR_EFIELD) &&
-        (fpat.nfeh & NEAR_HFIELD) )
+        (fpat.nfeh & NEAR_HFIELD) &&
+        (idx < np) )
     {
       int ipv; /* Mem request and index */
       static size_t mreq = 0;
@@ -516,7 +494,7 @@ Draw_Near_Field( cairo_t *cr )
 
       /* Calculate Poynting vector and its max and min */
       pov_max = 0;
-      for( ipv = 0; ipv < npts; ipv++ )
+      for( ipv = 0; ipv < np; ipv++ )
       {
         pov_x[ipv] =
           near_field.ery[ipv] * near_field.hrz[ipv] -
@@ -533,7 +511,7 @@ Draw_Near_Field( cairo_t *cr )
             pov_z[ipv] * pov_z[ipv] );
         if( pov_max < pov_r[ipv] )
           pov_max = pov_r[ipv];
-      } /* for( ipv = 0; ipv < npts; ipv++ ) */
+      } /* for( ipv = 0; ipv < np; ipv++ ) */
 
       /* Set gc attributes for segment */
       Value_to_Color( &xred, &xgrn, &xblu, pov_r[idx], pov_max );
@@ -644,7 +622,23 @@ int Draw_Radiation( cairo_t *cr )
 
 	need_rdpat_redraw = 0;
 
-	g_mutex_lock(&freq_data_lock);
+	// While nfpat() runs it holds freq_data_lock, so draw the near
+	// field points it has published instead of waiting for all of them.
+	// near_field_lock keeps Near_Field_Pattern() from returning meanwhile:
+	if (!g_mutex_trylock(&freq_data_lock))
+	{
+		g_mutex_lock(&near_field_lock);
+		if (g_atomic_int_get(&near_field.partial) && isFlagSet(DRAW_EHFIELD))
+		{
+			ret = _Draw_Radiation( cr );
+			g_mutex_unlock(&near_field_lock);
+			return ret;
+		}
+		g_mutex_unlock(&near_field_lock);
+
+		g_mutex_lock(&freq_data_lock);
+	}
+
 	ret = _Draw_Radiation( cr );
 	g_mutex_unlock(&freq_data_lock);
 
@@ -720,58 +714,6 @@ Animate_Near_Field( gpointer udata )
 
 /*-----------------------------------------------------------------------*/
 
-/* Polarization_Factor()
- *
- * Calculates polarization factor from axial
- * ratio and tilt of polarization ellipse
- */
-  double
-Polarization_Factor( int pol_type, int fstep, int idx )
-{
-  double axrt, axrt2, tilt2, polf = 1.0;
-
-  switch( pol_type )
-  {
-    case POL_TOTAL:
-      polf = 1.0;
-      break;
-
-    case POL_HORIZ:
-      axrt2  = rad_pattern[fstep].axrt[idx];
-      axrt2 *= axrt2;
-      tilt2  = sin( rad_pattern[fstep].tilt[idx] );
-      tilt2 *= tilt2;
-      polf = (axrt2 + (1.0 - axrt2) * tilt2) / (1.0 + axrt2);
-      break;
-
-    case POL_VERT:
-      axrt2  = rad_pattern[fstep].axrt[idx];
-      axrt2 *= axrt2;
-      tilt2  = cos( rad_pattern[fstep].tilt[idx] );
-      tilt2 *= tilt2;
-      polf = (axrt2 + (1.0 - axrt2) * tilt2) / (1.0 + axrt2);
-      break;
-
-    case POL_LHCP:
-      axrt  = rad_pattern[fstep].axrt[idx];
-      axrt2 = axrt * axrt;
-      polf  = (1.0 + 2.0 * axrt + axrt2) / 2.0 / (1.0 + axrt2);
-      break;
-
-    case POL_RHCP:
-      axrt  = rad_pattern[fstep].axrt[idx];
-      axrt2 = axrt * axrt;
-      polf  = (1.0 - 2.0 * axrt + axrt2) / 2.0 / (1.0 + axrt2);
-  }
-
-  if( polf < 1.0E-200 ) polf = 1.0E-200;
-  polf = 10.0 * log10( polf );
-
-  return( polf );
-} /* Polarization_Factor() */
-
-/*-----------------------------------------------------------------------*/
-
 /* Set_Polarization()
  *
  * Sets the polarization type of gain to be plotted
@@ -903,61 +845,6 @@ Redo_Radiation_Pattern( gpointer udata )
 
 /*-----------------------------------------------------------------------*/
 
-/* Viewer_Gain()
- *
- * Calculate gain in direction of viewer
- * (e.g. Perpenticular to the Screen)
- */
-  double
-Viewer_Gain( projection_parameters_t proj_parameters, int fstep )
-{
-  double phi, gain;
-  int nth, nph, idx;
-
-  /* Calculate theta step from proj params */
-  phi = proj_parameters.Wr;
-  if( fpat.dth == 0.0 ) nth = 0;
-  else
-  {
-    double theta;
-    theta = fabs( 90.0 - proj_parameters.Wi );
-    if( theta > 180.0 )
-    {
-      theta = 360.0 - theta;
-      phi  -= 180.0;
-    }
-
-    if( (gnd.ksymp == 2) &&
-        (theta > 90.01)  &&
-        (gnd.ifar != 1) )
-      return( -999.99 );
-
-    nth = (int)( (theta - fpat.thets) / fpat.dth + 0.5 );
-    if( (nth >= fpat.nth) || (nth < 0) )
-      nth = fpat.nth-1;
-  }
-
-  /* Calculate phi step from proj params */
-  if( fpat.dph == 0.0 ) nph = 0;
-  else
-  {
-    while( phi < 0.0 ) phi += 360.0;
-    nph = (int)( (phi - fpat.phis) / fpat.dph + 0.5 );
-    if( (nph >= fpat.nph) || (nph < 0) )
-      nph = fpat.nph-1;
-  }
-
-  idx = nth + nph * fpat.nth;
-  gain = rad_pattern[fstep].gtot[idx] +
-    Polarization_Factor(calc_data.pol_type, fstep, idx);
-  if( gain < -999.99 ) gain = -999.99;
-
-  return( gain );
-
-} /* Viewer_Gain() */
-
-/*-----------------------------------------------------------------------*/
-
 /* Rdpattern_Window_Killed()
  *
  * Cleans up after the rad pattern window is closed
@@ -1061,131 +948,6 @@ Set_Window_Labels( void )
 
 /*-----------------------------------------------------------------------*/
 
-/* Alloc_Rdpattern_Buffers
- *
- * Allocates memory to the radiation pattern buffers
- */
-  void
-_Alloc_Rdpattern_Buffers( int nfrq, int nth, int nph )
-{
-  int idx;
-  size_t mreq;
-  static int last_nfrq = 0;
-
-  /* Free old gain buffers first */
-  for( idx = 0; idx < last_nfrq; idx++ )
-  {
-    free_ptr( (void **)&rad_pattern[idx].gtot );
-    free_ptr( (void **)&rad_pattern[idx].max_gain );
-    free_ptr( (void **)&rad_pattern[idx].min_gain );
-    free_ptr( (void **)&rad_pattern[idx].max_gain_tht );
-    free_ptr( (void **)&rad_pattern[idx].max_gain_phi );
-    free_ptr( (void **)&rad_pattern[idx].max_gain_idx );
-    free_ptr( (void **)&rad_pattern[idx].min_gain_idx );
-    free_ptr( (void **)&rad_pattern[idx].axrt );
-    free_ptr( (void **)&rad_pattern[idx].tilt );
-    free_ptr( (void **)&rad_pattern[idx].sens );
-  }
-  last_nfrq = nfrq;
-
-  /* Allocate rad pattern buffers */
-  mreq = (size_t)nfrq * sizeof(rad_pattern_t);
-  mem_realloc( (void **)&rad_pattern, mreq, "in draw_radiation.c" );
-  for( idx = 0; idx < nfrq; idx++ )
-  {
-    /* Memory request for allocs */
-    mreq = (size_t)(nph * nth) * sizeof(double);
-    rad_pattern[idx].gtot = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].gtot), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].axrt = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].axrt), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].tilt = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].tilt), mreq, "in draw_radiation.c" );
-
-    mreq = NUM_POL * sizeof(double);
-    rad_pattern[idx].max_gain = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].max_gain), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].min_gain = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].min_gain), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].max_gain_tht = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].max_gain_tht), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].max_gain_phi = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].max_gain_phi), mreq, "in draw_radiation.c" );
-
-    mreq = NUM_POL * sizeof(int);
-    rad_pattern[idx].max_gain_idx = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].max_gain_idx), mreq, "in draw_radiation.c" );
-    rad_pattern[idx].min_gain_idx = NULL;
-    mem_alloc( (void **)&(rad_pattern[idx].min_gain_idx), mreq, "in draw_radiation.c" );
-
-    rad_pattern[idx].sens = NULL;
-    mreq = (size_t)(nph * nth) * sizeof(int);
-    mem_alloc( (void **)&(rad_pattern[idx].sens), mreq, "in draw_radiation.c" );
-  }
-
-} /* Alloc_Rdpattern_Buffers() */
-
-void Alloc_Rdpattern_Buffers( int nfrq, int nth, int nph )
-{
-	g_mutex_lock(&freq_data_lock);
-	_Alloc_Rdpattern_Buffers(nfrq, nth, nph);
-	g_mutex_unlock(&freq_data_lock);
-}
-
-/*-----------------------------------------------------------------------*/
-
-/* Alloc_Nearfield_Buffers
- *
- * Allocates memory to the radiation pattern buffers
- */
-  void
-Alloc_Nearfield_Buffers( int n1, int n2, int n3 )
-{
-  size_t mreq;
-
-  if( isFlagClear(ALLOC_NEAREH_BUFF) ) return;
-  ClearFlag( ALLOC_NEAREH_BUFF );
-
-  /* Memory request for allocations */
-  mreq = (size_t)(n1 * n2 * n3) * sizeof( double );
-
-  /* Allocate near field buffers */
-  if( fpat.nfeh & NEAR_EFIELD )
-  {
-    mem_realloc( (void **)&near_field.ex,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.ey,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.ez,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fex, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fey, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fez, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.erx, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.ery, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.erz, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.er,  mreq, "in draw_radiation.c" );
-  }
-
-  if( fpat.nfeh & NEAR_HFIELD )
-  {
-    mem_realloc( (void **)&near_field.hx,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hy,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hz,  mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fhx, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fhy, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.fhz, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hrx, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hry, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hrz, mreq, "in draw_radiation.c" );
-    mem_realloc( (void **)&near_field.hr,  mreq, "in draw_radiation.c" );
-  }
-
-  mem_realloc( (void **)&near_field.px, mreq, "in draw_radiation.c" );
-  mem_realloc( (void **)&near_field.py, mreq, "in draw_radiation.c" );
-  mem_realloc( (void **)&near_field.pz, mreq, "in draw_radiation.c" );
-
-} /* Alloc_Nearfield_Buffers() */
-
-/*-----------------------------------------------------------------------*/
-
 /* Inverse_Scale_Gain()
  *
  * Calculates the actual dB value from a scaled gain value
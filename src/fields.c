@@ -44,12 +44,13 @@
 
 #include "fields.h"
 #include "shared.h"
+#include <pthread.h>
 
 /* common  /tmi/ */
-static tmi_t tmi;
+static __thread tmi_t tmi;
 
 /*common  /tmh/ */
-static tmh_t tmh;
+static __thread tmh_t tmh;
 
 /*-------------------------------------------------------------------*/
 
@@ -271,10 +272,7 @@ efld( double xi, double yi,
   double xymag, xspec = 0.0, yspec = 0.0, rhospc = 0.0, dmin;
   complex double epx, epy, refs, refps, zrsin, zratx = 0.0, zscrn = 0.0;
   complex double tezs, ters, tezc = 0.0, terc = 0.0, tezk = 0.0, terk = 0.0;
-  static complex double *egnd = NULL;
-
-  size_t mreq = 9 * sizeof(complex double);
-  mem_alloc( (void **)&egnd, mreq, "in fields.c");
+  complex double egnd[9];
 
   xij= xi- dataj.xj;
   yij= yi- dataj.yj;
@@ -1495,8 +1493,9 @@ nhfld( double xob, double yob,
 /* Near_Field_Total()
  *
  * Calculates the value of Total Near Field vector
+ * and returns its magnitude
  */
-  static void
+  static double
 Near_Field_Total(
     complex double ex,
     complex double ey,
@@ -1518,8 +1517,7 @@ Near_Field_Total(
           near_field.hrx[idx] * near_field.hrx[idx] +
           near_field.hry[idx] * near_field.hry[idx] +
           near_field.hrz[idx] * near_field.hrz[idx] );
-      if( near_field.max_hr < near_field.hr[idx] )
-        near_field.max_hr = near_field.hr[idx];
+      return( near_field.hr[idx] );
     }
     else /* Electric field */
     {
@@ -1534,8 +1532,7 @@ Near_Field_Total(
           near_field.erx[idx] * near_field.erx[idx] +
           near_field.ery[idx] * near_field.ery[idx] +
           near_field.erz[idx] * near_field.erz[idx] );
-      if( near_field.max_er < near_field.er[idx] )
-        near_field.max_er = near_field.er[idx];
+      return( near_field.er[idx] );
     } /* if( nfeh == 1 ) */
 
   } /* if( isFlagSet(NEAREH_SNAPSHOT) ) */
@@ -1578,8 +1575,7 @@ Near_Field_Total(
 
       /* Near total magnetic field vector, peak value */
       near_field.hr[idx]  = sqrt( (exm2 + eym2 + ezm2 + tp)/2.0 );
-      if( near_field.max_hr < near_field.hr[idx] )
-        near_field.max_hr = near_field.hr[idx];
+      return( near_field.hr[idx] );
     }
     else /* Electric field */
     {
@@ -1590,8 +1586,7 @@ Near_Field_Total(
 
       /* Near total electric field vector, peak value */
       near_field.er[idx]  = sqrt( (exm2 + eym2 + ezm2 + tp)/2.0 );
-      if( near_field.max_er < near_field.er[idx] )
-        near_field.max_er = near_field.er[idx];
+      return( near_field.er[idx] );
     }
   }
 
@@ -1599,26 +1594,169 @@ Near_Field_Total(
 
 /*-----------------------------------------------------------------------*/
 
-/* compute near e or h fields over a range of points */
+/* Nfpat_Publish()
+ *
+ * Marks a row of the near field grid as done, merges its max
+ * field strength and publishes the rows done so far in grid
+ * order. A redraw is requested when a whole z slab is added
+ */
+  static void
+Nfpat_Publish( nfpat_job_t *job, int row, double max )
+{
+  int slabs;
+
+  g_mutex_lock( &job->lock );
+
+  job->row_done[row] = 1;
+  if( job->nfeh == 1 )
+  {
+    if( near_field.max_hr < max )
+      near_field.max_hr = max;
+  }
+  else
+  {
+    if( near_field.max_er < max )
+      near_field.max_er = max;
+  }
+
+  slabs = job->published / fpat.nry;
+  while( (job->published < job->nrows) && job->row_done[job->published] )
+    job->published++;
+
+  if( job->nfeh == 1 )
+    g_atomic_int_set( &near_field.done_hr, job->published * fpat.nrx );
+  else
+    g_atomic_int_set( &near_field.done_er, job->published * fpat.nrx );
+  slabs = job->published / fpat.nry - slabs;
+
+  g_mutex_unlock( &job->lock );
+
+#ifndef XNEC2C_BATCH
+  if( slabs && !CHILD && isFlagSet(DRAW_ENABLED) )
+    xnec2_widget_queue_draw( rdpattern_drawingarea );
+#endif
+
+} /* Nfpat_Publish() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Nfpat_Rows()
+ *
+ * Computes the near field at the rows of field points
+ * taken from the job, until none are left
+ */
+  static void
+Nfpat_Rows( nfpat_job_t *job )
+{
+  int row, kk, idx;
+  double tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, max;
+  complex double ex, ey, ez;
+
+  while( (row = g_atomic_int_add(&job->next, 1)) < job->nrows )
+  {
+    max = 0.0;
+    idx = row * fpat.nrx;
+    for( kk = 0; kk < fpat.nrx; kk++, idx++ )
+    {
+      tmp1= near_field.px[idx]/ data.wlam;
+      tmp2= near_field.py[idx]/ data.wlam;
+      tmp3= near_field.pz[idx]/ data.wlam;
+
+      if( job->nfeh == 1 ) /* Magnetic field */
+        nhfld( tmp1, tmp2, tmp3, &ex, &ey, &ez);
+      else /* Electric field */
+        nefld( tmp1, tmp2, tmp3, &ex, &ey, &ez);
+
+      /* Calculate total field vector */
+      tmp1 = Near_Field_Total( ex, ey, ez, job->nfeh, idx );
+      if( max < tmp1 )
+        max = tmp1;
+
+      tmp1= cabs(ex);
+      tmp2= cang (ex);
+      tmp3= cabs(ey);
+      tmp4= cang (ey);
+      tmp5= cabs(ez);
+      tmp6= cang (ez);
+
+      if( job->nfeh == 1 ) /* Magnetic field */
+      {
+        near_field.hx[idx]  = (double)tmp1;
+        near_field.hy[idx]  = (double)tmp3;
+        near_field.hz[idx]  = (double)tmp5;
+        near_field.fhx[idx] = (double)(tmp2 * TORAD);
+        near_field.fhy[idx] = (double)(tmp4 * TORAD);
+        near_field.fhz[idx] = (double)(tmp6 * TORAD);
+      }
+      else /* Electric field */
+      {
+        near_field.ex[idx]  = (double)tmp1;
+        near_field.ey[idx]  = (double)tmp3;
+        near_field.ez[idx]  = (double)tmp5;
+        near_field.fex[idx] = (double)(tmp2 * TORAD);
+        near_field.fey[idx] = (double)(tmp4 * TORAD);
+        near_field.fez[idx] = (double)(tmp6 * TORAD);
+      }
+
+    } /* for( kk = 0; kk < fpat.nrx; kk++, idx++ ) */
+
+    Nfpat_Publish( job, row, max );
+
+  } /* while( (row = ...) < job->nrows ) */
+
+} /* Nfpat_Rows() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Nfpat_Thread()
+ *
+ * Entry point of the nfpat() threads. Each thread points
+ * the source segment commons at its own copy of the caller's
+ */
+  static void *
+Nfpat_Thread( void *arg )
+{
+  nfpat_job_t *job = (nfpat_job_t *)arg;
+  dataj_t dataj_thr = job->caller_dataj;
+  incom_t incom_thr = job->caller_incom;
+  gwav_t  gwav_thr  = job->caller_gwav;
+
+  dataj_p = &dataj_thr;
+  incom_p = &incom_thr;
+  gwav_p  = &gwav_thr;
+
+  Nfpat_Rows( job );
+
+  return( NULL );
+} /* Nfpat_Thread() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Nfpat_Init()
+ *
+ * Allocates the near field buffers, resets the E and H
+ * grids and saves the field point co-ordinates, so that
+ * the drawing scale is known before any field is done.
+ * Called with near_field_lock held, before partial is set
+ */
   void
-nfpat( int nfeh )
+Nfpat_Init( void )
 {
   int i, j, kk, idx;
   double znrt, cth=0.0, sth=0.0, ynrt, cph=0.0, sph=0.0, yob;
-  double xnrt, xob,zob, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6;
-  complex double ex, ey, ez;
+  double xnrt, xob,zob;
   double r; /* Distance of field point from xyz origin */
 
 
   Alloc_Nearfield_Buffers( fpat.nrx, fpat.nry, fpat.nrz );
 
-  /* Initialize according to E/H flag */
-  if( nfeh == 1 )
-    near_field.max_hr = 0.0;
-  else
-    near_field.max_er = 0.0;
-  near_field.r_max = 0.0;
+  near_field.max_er = 0.0;
+  near_field.max_hr = 0.0;
+  near_field.r_max  = 0.0;
+  g_atomic_int_set( &near_field.done_er, 0 );
+  g_atomic_int_set( &near_field.done_hr, 0 );
 
+  /* Save field point co-ordinates */
   idx = 0;
   znrt= fpat.znr- fpat.dznr;
   for( i = 0; i < fpat.nrz; i++ )
@@ -1657,18 +1795,6 @@ nfpat( int nfeh )
           zob= znrt;
         }
 
-        tmp1= xob/ data.wlam;
-        tmp2= yob/ data.wlam;
-        tmp3= zob/ data.wlam;
-
-        if( nfeh == 1 ) /* Magnetic field */
-          nhfld( tmp1, tmp2, tmp3, &ex, &ey, &ez);
-        else /* Electric field */
-          nefld( tmp1, tmp2, tmp3, &ex, &ey, &ez);
-
-        /* Calculate total field vector */
-        Near_Field_Total( ex, ey, ez, nfeh, idx );
-
         /* Save field point co-ordinates */
         near_field.px[idx] = (double)xob;
         near_field.py[idx] = (double)yob;
@@ -1682,32 +1808,6 @@ nfpat( int nfeh )
         if( near_field.r_max < r )
           near_field.r_max = r;
 
-        tmp1= cabs(ex);
-        tmp2= cang (ex);
-        tmp3= cabs(ey);
-        tmp4= cang (ey);
-        tmp5= cabs(ez);
-        tmp6= cang (ez);
-
-        if( nfeh == 1 ) /* Magnetic field */
-        {
-          near_field.hx[idx]  = (double)tmp1;
-          near_field.hy[idx]  = (double)tmp3;
-          near_field.hz[idx]  = (double)tmp5;
-          near_field.fhx[idx] = (double)(tmp2 * TORAD);
-          near_field.fhy[idx] = (double)(tmp4 * TORAD);
-          near_field.fhz[idx] = (double)(tmp6 * TORAD);
-        }
-        else /* Electric field */
-        {
-          near_field.ex[idx]  = (double)tmp1;
-          near_field.ey[idx]  = (double)tmp3;
-          near_field.ez[idx]  = (double)tmp5;
-          near_field.fex[idx] = (double)(tmp2 * TORAD);
-          near_field.fey[idx] = (double)(tmp4 * TORAD);
-          near_field.fez[idx] = (double)(tmp6 * TORAD);
-        }
-
         idx++;
 
       } /* for( kk = 0; kk < fpat.nrx; kk++ ) */
@@ -1716,6 +1816,64 @@ nfpat( int nfeh )
 
   } /* for( i = 0; i < fpat.nrz; i++ ) */
 
+  /* New drawing scale for the rows to be published */
+  SetFlag( DRAW_NEW_EHFIELD );
+
+} /* Nfpat_Init() */
+
+/*-----------------------------------------------------------------------*/
+
+/* compute near e or h fields over a range of points,
+ * the field points are set up by Nfpat_Init() */
+  void
+nfpat( int nfeh )
+{
+  int idx, nthr;
+  pthread_t *thrd = NULL;
+  nfpat_job_t job;
+  size_t mreq;
+
+
+  /* Rows of field points are shared out to the
+   * threads, the calling thread computes rows too */
+  job.nfeh  = nfeh;
+  job.nrows = fpat.nry * fpat.nrz;
+  job.next  = 0;
+  job.published = 0;
+  job.row_done  = NULL;
+  job.caller_dataj = dataj;
+  job.caller_incom = incom;
+  job.caller_gwav  = gwav;
+  mreq = (size_t)job.nrows * sizeof(char);
+  mem_alloc( (void **)&job.row_done, mreq, "in fields.c" );
+  g_mutex_init( &job.lock );
+
+  nthr = rc_config.fill_threads;
+  if( nthr > job.nrows )
+    nthr = job.nrows;
+
+  idx = 0;
+  if( nthr > 1 )
+  {
+    mreq = (size_t)(nthr-1) * sizeof(pthread_t);
+    mem_alloc( (void **)&thrd, mreq, "in fields.c" );
+    for( idx = 0; idx < nthr-1; idx++ )
+      if( pthread_create(&thrd[idx], NULL, Nfpat_Thread, &job) != 0 )
+      {
+        perror( "xnec2c: pthread_create()" );
+        break;
+      }
+  }
+
+  Nfpat_Rows( &job );
+
+  while( idx-- > 0 )
+    pthread_join( thrd[idx], NULL );
+
+  free_ptr( (void **)&thrd );
+  free_ptr( (void **)&job.row_done );
+  g_mutex_clear( &job.lock );
+
   /* Signal new valid near field data */
   near_field.newer = near_field.valid = 1;
 
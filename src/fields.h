@@ -47,5 +47,30 @@ typedef struct
 
 } tmh_t;
 
+/* Near field grid job shared by the nfpat() threads. The threads
+ * take one row of nrx field points at a time, and the rows done
+ * are published in grid order so the GUI can draw them early */
+typedef struct
+{
+  int
+    nfeh,   /* Near E (0) or H (1) field */
+    nrows;  /* Rows of field points in the grid, nry * nrz */
+
+  /* Next row to compute */
+  gint next;
+
+  /* Rows completed and rows published in grid order,
+   * guarded by lock like the max field strength */
+  char *row_done;
+  int published;
+  GMutex lock;
+
+  /* Source segment state of the calling thread */
+  dataj_t caller_dataj;
+  incom_t caller_incom;
+  gwav_t  caller_gwav;
+
+} nfpat_job_t;
+
 #endif
 
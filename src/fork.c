@@ -17,9 +17,13 @@
  *    https://www.xnec2c.org/
  */
 
+#define _GNU_SOURCE
+
 #include "fork.h"
 #include "shared.h"
 #include "mathlib.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*-----------------------------------------------------------------------*/
 
@@ -165,215 +169,688 @@ Read_Pipe( int idx, char *str, ssize_t len, gboolean err )
 
 /*------------------------------------------------------------------------*/
 
-/* Mem_Copy()
+/* Frequency data of each step is handed from the child processes
+ * to the parent in a shared memory file, with one result slot per
+ * frequency step. The pipe only carries the completion notice.
+ * The file starts with the queue of frequency steps to calculate.
+ * The currents and near field, which the parent only keeps for
+ * the latest step, are passed in a small ring of entries for each
+ * child instead, which the parent copies out of and releases */
+static int     slots_fd   = -1;
+static char   *slots_mem  = NULL;
+static size_t  slots_size = 0;
+static size_t  slot_size  = 0;
+static size_t  ring_size  = 0;
+static size_t  queue_size = 0;
+static size_t  rings_size = 0;
+static int     slots_num  = 0;
+static int     rings_num  = 0;
+
+static freq_queue_t *queue = NULL;
+static double *queue_freq  = NULL;
+static int    *queue_fstep = NULL;
+static freq_ring_t *rings  = NULL;
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Slots_Open()
  *
- * Copies between buffers using memcpy()
+ * Creates the shared memory file for frequency data slots.
+ * Must be called before forking so that children inherit it
  */
-  static void
-Mem_Copy( char *buff, char *var, size_t cnt, gboolean wrt )
+  void
+Freq_Slots_Open( void )
 {
-  static int idx;
+#ifdef HAVE_MEMFD_CREATE
+  slots_fd = memfd_create( "xnec2c-freq-slots", MFD_CLOEXEC );
+#else
+  FILE *fp = tmpfile();
+  if( fp != NULL )
+  {
+    slots_fd = dup( fileno(fp) );
+    fclose( fp );
+  }
+#endif
 
-  /* Clear idx to buffer */
-  if( !cnt )
+  if( slots_fd < 0 )
   {
-    idx = 0;
-    return;
+    perror( "xnec2c: Freq_Slots_Open()" );
+    pr_crit( "cannot create shared memory for frequency data\n" );
+    exit( -1 );
   }
 
-  /* If child process writing data */
-  if( wrt )
-    memcpy( &buff[idx], var, cnt );
-  else /* Parent reading data */
-    memcpy( var, &buff[idx], cnt );
-  idx += (int)cnt;
+} /* Freq_Slots_Open() */
+
+/*------------------------------------------------------------------------*/
 
-} /* Mem_Copy() */
+/* Slot_Array()
+ *
+ * Returns the array of cnt bytes at *idx in a slot (NULL if
+ * slot or cnt is 0) and advances *idx past it, kept aligned
+ */
+  static void *
+Slot_Array( char *slot, size_t *idx, size_t cnt )
+{
+  void *ptr = NULL;
+
+  if( cnt == 0 ) return( NULL );
+  if( slot != NULL ) ptr = &slot[*idx];
+  *idx += (cnt + 15) & ~(size_t)15;
+
+  return( ptr );
+} /* Slot_Array() */
 
 /*------------------------------------------------------------------------*/
 
-/* Pass_Freq_Data()
+/* Freq_Slot_Layout()
  *
- * Passes frequency-dependent data (current, charge density,
- * input impedances etc) from child processes to parent.
+ * Sets pointers to the data arrays in a frequency data
+ * slot and returns the size of the slot. The layout only
+ * depends on the input file so it is the same in all processes
  */
-  static void
-Pass_Freq_Data( void )
+  static size_t
+Freq_Slot_Layout( char *slot, freq_slot_view_t *view )
 {
-  char *buff = NULL, flag;
-  size_t cnt, buff_size;
-
-  /*** Total of bytes to read/write thru pipe ***/
-  buff_size =
-    /* Current & charge data (a, b, c, ir & ii) */
-    (size_t)(6 * data.npm) * sizeof( double ) +
-    /* Complex current (crnt.cur) */
-    (size_t)data.np3m * sizeof( complex double ) +
-    /* newer and valid flags */
-    2 * sizeof(char) +
-    /* Impedance data */
-    4 * sizeof(double) +
-    /* Network data */
-    sizeof(complex double);
+  size_t idx = 0, cnt;
+  size_t nrp = 0, nfull = 0;
 
-  /* Radiation pattern data if enabled */
+  /* Full patterns kept in the store file are written there by
+   * the children, the slots only carry their summaries */
   if( isFlagSet(ENABLE_RDPAT) )
   {
-    buff_size +=
-      /* Gain total, tilt, axial ratio */
-      (size_t)(3 * fpat.nph * fpat.nth) * sizeof(double) +
-      /* max & min gain, tht & phi angles */
-      (size_t)(4 * NUM_POL) * sizeof(double) +
-      /* max and min gain index */
-      (size_t)(2 * NUM_POL) * sizeof(int) +
-      /* Polarization sens */
-      (size_t)(fpat.nph * fpat.nth) * sizeof(int) +
-      /* New pattern flag */
-      sizeof( char );
+    nrp = (size_t)( fpat.nph * fpat.nth );
+    if( !Rdpat_Store_Needed(calc_data.steps_total + 1, fpat.nth, fpat.nph) )
+      nfull = nrp;
   }
 
-  /* Near field data if enabled */
-  if( isFlagSet(DRAW_EHFIELD) )
+  memset( view, 0, sizeof(freq_slot_view_t) );
+  view->hdr = Slot_Array( slot, &idx, sizeof(freq_slot_t) );
+
+  /* Gain total, tilt, axial ratio */
+  cnt = nfull * sizeof( double );
+  view->rdpat.gtot = Slot_Array( slot, &idx, cnt );
+  view->rdpat.tilt = Slot_Array( slot, &idx, cnt );
+  view->rdpat.axrt = Slot_Array( slot, &idx, cnt );
+
+  /* max & min gain, tht & phi angles */
+  cnt = nrp ? NUM_POL * sizeof( double ) : 0;
+  view->rdpat.max_gain     = Slot_Array( slot, &idx, cnt );
+  view->rdpat.min_gain     = Slot_Array( slot, &idx, cnt );
+  view->rdpat.max_gain_tht = Slot_Array( slot, &idx, cnt );
+  view->rdpat.max_gain_phi = Slot_Array( slot, &idx, cnt );
+  view->rdpat.back_gain    = Slot_Array( slot, &idx, cnt );
+
+  /* max and min gain index */
+  cnt = nrp ? NUM_POL * sizeof( int ) : 0;
+  view->rdpat.max_gain_idx  = Slot_Array( slot, &idx, cnt );
+  view->rdpat.min_gain_idx  = Slot_Array( slot, &idx, cnt );
+  view->rdpat.back_gain_idx = Slot_Array( slot, &idx, cnt );
+
+  /* Polarization sens */
+  cnt = nfull * sizeof( int );
+  view->rdpat.sens = Slot_Array( slot, &idx, cnt );
+
+  return( idx );
+} /* Freq_Slot_Layout() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Ring_Layout()
+ *
+ * Sets pointers to the current and near field arrays in an
+ * entry of a child's ring and returns the size of the entry,
+ * laid out like the frequency data slots
+ */
+  static size_t
+Freq_Ring_Layout( char *entry, freq_ring_view_t *view )
+{
+  size_t idx = 0, cnt, nnf = 0;
+
+  if( fpat.nfeh )
+    nnf = (size_t)( fpat.nrx * fpat.nry * fpat.nrz );
+
+  memset( view, 0, sizeof(freq_ring_view_t) );
+
+  /* Current & charge data (a, b, c, ir & ii) */
+  cnt = (size_t)data.npm * sizeof( double );
+  view->crnt.air = Slot_Array( entry, &idx, cnt );
+  view->crnt.aii = Slot_Array( entry, &idx, cnt );
+  view->crnt.bir = Slot_Array( entry, &idx, cnt );
+  view->crnt.bii = Slot_Array( entry, &idx, cnt );
+  view->crnt.cir = Slot_Array( entry, &idx, cnt );
+  view->crnt.cii = Slot_Array( entry, &idx, cnt );
+
+  /* Complex current (crnt.cur) */
+  cnt = (size_t)data.np3m * sizeof( complex double );
+  view->crnt.cur = Slot_Array( entry, &idx, cnt );
+
+  /* Magnitude and phase of E field */
+  cnt = (fpat.nfeh & NEAR_EFIELD) ? nnf * sizeof( double ) : 0;
+  view->near_field.ex  = Slot_Array( entry, &idx, cnt );
+  view->near_field.ey  = Slot_Array( entry, &idx, cnt );
+  view->near_field.ez  = Slot_Array( entry, &idx, cnt );
+  view->near_field.fex = Slot_Array( entry, &idx, cnt );
+  view->near_field.fey = Slot_Array( entry, &idx, cnt );
+  view->near_field.fez = Slot_Array( entry, &idx, cnt );
+  view->near_field.erx = Slot_Array( entry, &idx, cnt );
+  view->near_field.ery = Slot_Array( entry, &idx, cnt );
+  view->near_field.erz = Slot_Array( entry, &idx, cnt );
+  view->near_field.er  = Slot_Array( entry, &idx, cnt );
+
+  /* Magnitude and phase of H field */
+  cnt = (fpat.nfeh & NEAR_HFIELD) ? nnf * sizeof( double ) : 0;
+  view->near_field.hx  = Slot_Array( entry, &idx, cnt );
+  view->near_field.hy  = Slot_Array( entry, &idx, cnt );
+  view->near_field.hz  = Slot_Array( entry, &idx, cnt );
+  view->near_field.fhx = Slot_Array( entry, &idx, cnt );
+  view->near_field.fhy = Slot_Array( entry, &idx, cnt );
+  view->near_field.fhz = Slot_Array( entry, &idx, cnt );
+  view->near_field.hrx = Slot_Array( entry, &idx, cnt );
+  view->near_field.hry = Slot_Array( entry, &idx, cnt );
+  view->near_field.hrz = Slot_Array( entry, &idx, cnt );
+  view->near_field.hr  = Slot_Array( entry, &idx, cnt );
+
+  /* Co-ordinates of field points */
+  cnt = nnf * sizeof( double );
+  view->near_field.px = Slot_Array( entry, &idx, cnt );
+  view->near_field.py = Slot_Array( entry, &idx, cnt );
+  view->near_field.pz = Slot_Array( entry, &idx, cnt );
+
+  return( idx );
+} /* Freq_Ring_Layout() */
+
+/*------------------------------------------------------------------------*/
+
+/* Slots_Map()
+ *
+ * (Re)maps the frequency data slots, for Freq_Slots_Map()
+ */
+  static void
+Slots_Map( void )
+{
+  freq_slot_view_t view;
+  freq_ring_view_t rview;
+  struct stat sb;
+  size_t size;
+
+  if( slots_fd < 0 ) return;
+
+  if( slots_mem != NULL )
+  {
+    munmap( slots_mem, slots_size );
+    slots_mem  = NULL;
+    slots_size = 0;
+  }
+
+  slots_num   = 0;
+  rings_num   = 0;
+  queue       = NULL;
+  queue_freq  = NULL;
+  queue_fstep = NULL;
+  rings       = NULL;
+  slot_size   = Freq_Slot_Layout( NULL, &view );
+  ring_size   = Freq_Ring_Layout( NULL, &rview );
+  if( slot_size * (size_t)calc_data.steps_total == 0 ) return;
+
+  /* Frequency queue header, the frequencies and steps queued
+   * and the counts of the children's rings, then the entries
+   * of the rings and last the slots of the frequency steps */
+  queue_size = 0;
+  Slot_Array( NULL, &queue_size, sizeof(freq_queue_t) );
+  Slot_Array( NULL, &queue_size, (size_t)calc_data.steps_total * sizeof(double) );
+  Slot_Array( NULL, &queue_size, (size_t)calc_data.steps_total * sizeof(int) );
+  Slot_Array( NULL, &queue_size, (size_t)calc_data.num_jobs * sizeof(freq_ring_t) );
+  rings_size = (size_t)calc_data.num_jobs * FREQ_RING_DEPTH * ring_size;
+  size = queue_size + rings_size + slot_size * (size_t)calc_data.steps_total;
+
+  if( CHILD )
+  {
+    if( (fstat(slots_fd, &sb) < 0) || ((size_t)sb.st_size < size) )
+    {
+      pr_err( "frequency data slots not sized by parent\n" );
+      return;
+    }
+  }
+  else if( ftruncate(slots_fd, (off_t)size) < 0 )
+  {
+    perror( "xnec2c: ftruncate()" );
+    return;
+  }
+
+  slots_mem = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, slots_fd, 0 );
+  if( slots_mem == MAP_FAILED )
   {
-    /* Notify parent to read near field data */
-    Write_Pipe( num_child_procs, "nfeh", 4, TRUE );
-
-    /* Near E field data */
-    if( fpat.nfeh & NEAR_EFIELD )
-      buff_size +=
-        (size_t)( 10 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double);
-    /* Near H field data */
-    if( fpat.nfeh & NEAR_HFIELD )
-      buff_size +=
-        (size_t)( 10 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double);
-    /* Co-ordinates of field points */
-    buff_size +=
-      (size_t)( 3 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double) +
-      /* newer & valid flags */
-      2 * sizeof(char);
+    perror( "xnec2c: mmap()" );
+    slots_mem = NULL;
+    return;
   }
-  else /* Notify parent not to read near field data */
-    Write_Pipe( num_child_procs, "noeh", 4, TRUE );
 
-  /* Allocate data buffers */
-  mem_alloc( (void **)&buff, buff_size, "in fork.c" );
+  slots_size = size;
+  slots_num  = calc_data.steps_total;
+  rings_num  = calc_data.num_jobs;
+  size = 0;
+  queue       = Slot_Array( slots_mem, &size, sizeof(freq_queue_t) );
+  queue_freq  = Slot_Array( slots_mem, &size, (size_t)slots_num * sizeof(double) );
+  queue_fstep = Slot_Array( slots_mem, &size, (size_t)slots_num * sizeof(int) );
+  rings       = Slot_Array( slots_mem, &size, (size_t)rings_num * sizeof(freq_ring_t) );
 
-  /* Clear buffer index in this function */
-  Mem_Copy( buff, buff, 0, WRITE );
+  /* Rings start empty, children only map them while idle */
+  if( !CHILD )
+    memset( rings, 0, (size_t)rings_num * sizeof(freq_ring_t) );
 
-  /* Pass on current and charge data */
-  cnt =  (size_t)data.npm * sizeof( double );
-  Mem_Copy( buff, (char *)crnt.air, cnt, WRITE );
-  Mem_Copy( buff, (char *)crnt.aii, cnt, WRITE );
-  Mem_Copy( buff, (char *)crnt.bir, cnt, WRITE );
-  Mem_Copy( buff, (char *)crnt.bii, cnt, WRITE );
-  Mem_Copy( buff, (char *)crnt.cir, cnt, WRITE );
-  Mem_Copy( buff, (char *)crnt.cii, cnt, WRITE );
+} /* Slots_Map() */
 
-  cnt = (size_t)data.np3m * sizeof( complex double );
-  Mem_Copy( buff, (char *)crnt.cur, cnt, WRITE );
+/*------------------------------------------------------------------------*/
 
-  cnt = sizeof( char );
-  Mem_Copy( buff, &crnt.newer, cnt, WRITE );
-  Mem_Copy( buff, &crnt.valid, cnt, WRITE );
+/* Freq_Slots_Map()
+ *
+ * (Re)maps the frequency data slots after an input file is
+ * read. The parent sizes the shared file, children map it.
+ * The radiation patterns used in place in the old slots are
+ * pointed to the new ones, or cleared if not there anymore
+ */
+  void
+Freq_Slots_Map( void )
+{
+  Slots_Map();
+  Rdpattern_Slots_Remap();
+} /* Freq_Slots_Map() */
 
-  /* Impedance data */
-  cnt = sizeof(double);
-  Mem_Copy( buff, (char *)&impedance_data.zreal[0],  cnt, WRITE );
-  Mem_Copy( buff, (char *)&impedance_data.zimag[0],  cnt, WRITE );
-  Mem_Copy( buff, (char *)&impedance_data.zmagn[0],  cnt, WRITE );
-  Mem_Copy( buff, (char *)&impedance_data.zphase[0], cnt, WRITE );
+/*------------------------------------------------------------------------*/
 
-  /* Network data */
-  cnt = sizeof(complex double);
-  Mem_Copy( buff, (char *)&netcx.zped, cnt, WRITE );
+/* Freq_Slot()
+ *
+ * Sets the pointers of view to the slot of frequency step fstep
+ */
+  static gboolean
+Freq_Slot( int fstep, freq_slot_view_t *view )
+{
+  if( (slots_mem == NULL) || (fstep < 0) || (fstep >= slots_num) )
+    return( FALSE );
 
-  /* Pass on radiation pattern data if enabled */
-  if( isFlagSet(ENABLE_RDPAT) )
+  Freq_Slot_Layout(
+      &slots_mem[queue_size + rings_size + (size_t)fstep * slot_size], view );
+  return( TRUE );
+} /* Freq_Slot() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Ring()
+ *
+ * Sets the pointers of view to entry of the ring of child
+ */
+  static gboolean
+Freq_Ring( int child, int entry, freq_ring_view_t *view )
+{
+  size_t off;
+
+  if( (rings == NULL) || (child < 0) || (child >= rings_num) ||
+      (entry < 0) || (entry >= FREQ_RING_DEPTH) )
+    return( FALSE );
+
+  off = ( (size_t)child * FREQ_RING_DEPTH + (size_t)entry ) * ring_size;
+  Freq_Ring_Layout( &slots_mem[queue_size + off], view );
+  return( TRUE );
+} /* Freq_Ring() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Ring_Take()
+ *
+ * Waits in a child until the parent has released an entry
+ * of the child's ring and returns it, or -1 with no rings
+ */
+  static int
+Freq_Ring_Take( int child )
+{
+  freq_ring_t *ring;
+  pid_t parent = getppid();
+
+  if( (rings == NULL) || (child < 0) || (child >= rings_num) )
+    return( -1 );
+  ring = &rings[child];
+
+  while( g_atomic_int_get(&ring->sent) -
+      g_atomic_int_get(&ring->released) >= FREQ_RING_DEPTH )
   {
-    cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(double);
-    Mem_Copy( buff, (char *)rad_pattern[0].gtot, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].tilt, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].axrt, cnt, WRITE );
+    /* Parent gone, nobody is left to release entries */
+    if( getppid() != parent ) _exit( 0 );
+    usleep( 1000 );
+  }
+
+  return( g_atomic_int_get(&ring->sent) % FREQ_RING_DEPTH );
+} /* Freq_Ring_Take() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Ring_Release()
+ *
+ * Releases the oldest entry of the ring of child once the
+ * parent has read the notice of the step passed in it
+ */
+  static void
+Freq_Ring_Release( int child )
+{
+  if( (rings != NULL) && (child >= 0) && (child < rings_num) )
+    g_atomic_int_add( &rings[child].released, 1 );
+} /* Freq_Ring_Release() */
 
-    cnt = (size_t)NUM_POL * sizeof(double);
-    Mem_Copy( buff, (char *)rad_pattern[0].max_gain, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].min_gain, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].max_gain_tht, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].max_gain_phi, cnt, WRITE );
+/*------------------------------------------------------------------------*/
 
-    cnt = (size_t)NUM_POL * sizeof(int);
-    Mem_Copy( buff, (char *)rad_pattern[0].max_gain_idx, cnt, WRITE );
-    Mem_Copy( buff, (char *)rad_pattern[0].min_gain_idx, cnt, WRITE );
+/* Freq_Slot_Rdpattern()
+ *
+ * Points rdpat to the radiation pattern kept in the slot of
+ * frequency step fstep, so that the parent uses it in place
+ */
+  gboolean
+Freq_Slot_Rdpattern( int fstep, rad_pattern_t *rdpat )
+{
+  freq_slot_view_t view;
 
-    cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(int);
-    Mem_Copy( buff, (char *)rad_pattern[0].sens, cnt, WRITE );
+  if( !FORKED || !Freq_Slot(fstep, &view) || (view.rdpat.gtot == NULL) )
+    return( FALSE );
 
-    if( isFlagSet(DRAW_NEW_RDPAT) )
-      flag = 1;
-    else
-      flag = 0;
-    cnt = sizeof( char );
-    Mem_Copy( buff, &flag, cnt, WRITE );
+  *rdpat = view.rdpat;
+  return( TRUE );
+} /* Freq_Slot_Rdpattern() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Queue_Start()
+ *
+ * Queues the nsteps frequency steps in fstep, at the frequencies
+ * in freq[fstep], for the njobs child processes to take steps
+ * from. If fstep is NULL steps 0 to nsteps-1 are queued
+ */
+  gboolean
+Freq_Queue_Start( double *freq, int *fstep, int nsteps, int njobs )
+{
+  int idx;
+
+  if( (queue == NULL) || (nsteps > slots_num) )
+    return( FALSE );
+
+  for( idx = 0; idx < nsteps; idx++ )
+  {
+    queue_fstep[idx] = (fstep == NULL) ? idx : fstep[idx];
+    queue_freq[idx]  = freq[ queue_fstep[idx] ];
   }
+  queue->nsteps = nsteps;
+  queue->njobs  = njobs;
+  g_atomic_int_set( &queue->next, 0 );
+
+  return( TRUE );
+} /* Freq_Queue_Start() */
+
+/*------------------------------------------------------------------------*/
 
-  /* Near field data */
-  if( isFlagSet(DRAW_EHFIELD) )
+/* Freq_Queue_Stop()
+ *
+ * Empties the frequency queue, children finish
+ * the steps they have taken and then go idle
+ */
+  void
+Freq_Queue_Stop( void )
+{
+  if( queue != NULL )
+    g_atomic_int_set( &queue->next, queue->nsteps );
+} /* Freq_Queue_Stop() */
+
+/*------------------------------------------------------------------------*/
+
+/* Freq_Queue_Take()
+ *
+ * Takes the next chunk of frequency steps from the queue,
+ * returns FALSE when it is empty. Chunks shrink as the
+ * queue drains so no child is left with a long tail
+ */
+  static gboolean
+Freq_Queue_Take( int *first, int *last )
+{
+  gint next, chunk;
+  int seg;
+
+  if( queue == NULL ) return( FALSE );
+
+  do
   {
-    /* Magnitude and phase of E field */
-    if( fpat.nfeh & NEAR_EFIELD )
-    {
-      cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-      Mem_Copy( buff, (char *)near_field.ex, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.ey, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.ez, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fex, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fey, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fez, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.erx, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.ery, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.erz, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.er, cnt, WRITE );
-      cnt = sizeof(double);
-      Mem_Copy( buff, (char *)&near_field.max_er, cnt, WRITE );
-    }
+    next = g_atomic_int_get( &queue->next );
+    if( next >= queue->nsteps ) return( FALSE );
+
+    chunk = (queue->nsteps - next) / (FREQ_QUEUE_CHUNK_DIV * queue->njobs);
+    if( chunk < 1 ) chunk = 1;
 
-    /* Magnitude and phase of H fields */
-    if( fpat.nfeh & NEAR_HFIELD )
+    /* With --matrix-interp whole segments of the sweep are
+     * taken, so that their anchors are filled by one child */
+    seg = Matrix_Interp_Segment( queue_freq[next] );
+    if( seg >= 0 )
     {
-      cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-      Mem_Copy( buff, (char *)near_field.hx, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hy, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hz, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fhx, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fhy, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.fhz, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hrx, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hry, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hrz, cnt, WRITE );
-      Mem_Copy( buff, (char *)near_field.hr, cnt, WRITE );
-      cnt = sizeof(double);
-      Mem_Copy( buff, (char *)&near_field.max_hr, cnt, WRITE );
+      chunk = 1;
+      while( (next + chunk < queue->nsteps) &&
+          (Matrix_Interp_Segment(queue_freq[next + chunk]) == seg) )
+        chunk++;
     }
+  }
+  while( !g_atomic_int_compare_and_exchange(&queue->next, next, next + chunk) );
 
-    /* Co-ordinates of field points */
-    cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-    Mem_Copy( buff, (char *)near_field.px, cnt, WRITE );
-    Mem_Copy( buff, (char *)near_field.py, cnt, WRITE );
-    Mem_Copy( buff, (char *)near_field.pz, cnt, WRITE );
-    cnt = sizeof(double);
-    Mem_Copy( buff, (char *)&near_field.r_max, cnt, WRITE );
+  *first = next;
+  *last  = next + chunk;
 
-    cnt = sizeof( char );
-    Mem_Copy( buff, &near_field.newer, cnt, WRITE );
-    Mem_Copy( buff, &near_field.valid, cnt, WRITE );
+  return( TRUE );
+} /* Freq_Queue_Take() */
 
-  } /* if( isFlagSet(DRAW_EHFIELD) ) */
+/*------------------------------------------------------------------------*/
 
-  /* Pass data accumulated in buffer if child */
-  Write_Pipe( num_child_procs, buff, (ssize_t)buff_size, TRUE );
+/* Copy_Rdpattern()
+ *
+ * Copies radiation pattern data between
+ * buffers, returns the number of bytes copied
+ */
+  static size_t
+Copy_Rdpattern( rad_pattern_t *dst, rad_pattern_t *src )
+{
+  size_t cnt, bytes = 0;
+
+  /* max & min gain, tht & phi angles, back gain */
+  cnt = NUM_POL * sizeof(double);
+  memcpy( dst->max_gain,     src->max_gain,     cnt );
+  memcpy( dst->min_gain,     src->min_gain,     cnt );
+  memcpy( dst->max_gain_tht, src->max_gain_tht, cnt );
+  memcpy( dst->max_gain_phi, src->max_gain_phi, cnt );
+  memcpy( dst->back_gain,    src->back_gain,    cnt );
+  bytes += 5 * cnt;
+
+  /* max and min gain index, back gain index */
+  cnt = NUM_POL * sizeof(int);
+  memcpy( dst->max_gain_idx,  src->max_gain_idx,  cnt );
+  memcpy( dst->min_gain_idx,  src->min_gain_idx,  cnt );
+  memcpy( dst->back_gain_idx, src->back_gain_idx, cnt );
+  bytes += 3 * cnt;
+
+  /* Only the summaries if the full pattern is in the store file */
+  if( (dst->gtot == NULL) || (src->gtot == NULL) )
+    return( bytes );
+
+  /* Gain total, tilt, axial ratio */
+  cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(double);
+  memcpy( dst->gtot, src->gtot, cnt );
+  memcpy( dst->tilt, src->tilt, cnt );
+  memcpy( dst->axrt, src->axrt, cnt );
+  bytes += 3 * cnt;
+
+  /* Polarization sens */
+  cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(int);
+  memcpy( dst->sens, src->sens, cnt );
+  bytes += cnt;
+
+  return( bytes );
+} /* Copy_Rdpattern() */
+
+/*------------------------------------------------------------------------*/
+
+/* Copy_Near_Field()
+ *
+ * Copies near field data arrays between
+ * buffers, returns the number of bytes copied
+ */
+  static size_t
+Copy_Near_Field( near_field_t *dst, near_field_t *src )
+{
+  size_t cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
+  size_t bytes = 3 * cnt;
+
+  /* Magnitude and phase of E field */
+  if( fpat.nfeh & NEAR_EFIELD )
+  {
+    memcpy( dst->ex,  src->ex,  cnt );
+    memcpy( dst->ey,  src->ey,  cnt );
+    memcpy( dst->ez,  src->ez,  cnt );
+    memcpy( dst->fex, src->fex, cnt );
+    memcpy( dst->fey, src->fey, cnt );
+    memcpy( dst->fez, src->fez, cnt );
+    memcpy( dst->erx, src->erx, cnt );
+    memcpy( dst->ery, src->ery, cnt );
+    memcpy( dst->erz, src->erz, cnt );
+    memcpy( dst->er,  src->er,  cnt );
+    bytes += 10 * cnt;
+  }
+
+  /* Magnitude and phase of H field */
+  if( fpat.nfeh & NEAR_HFIELD )
+  {
+    memcpy( dst->hx,  src->hx,  cnt );
+    memcpy( dst->hy,  src->hy,  cnt );
+    memcpy( dst->hz,  src->hz,  cnt );
+    memcpy( dst->fhx, src->fhx, cnt );
+    memcpy( dst->fhy, src->fhy, cnt );
+    memcpy( dst->fhz, src->fhz, cnt );
+    memcpy( dst->hrx, src->hrx, cnt );
+    memcpy( dst->hry, src->hry, cnt );
+    memcpy( dst->hrz, src->hrz, cnt );
+    memcpy( dst->hr,  src->hr,  cnt );
+    bytes += 10 * cnt;
+  }
 
-  free_ptr( (void **)&buff );
+  /* Co-ordinates of field points */
+  memcpy( dst->px, src->px, cnt );
+  memcpy( dst->py, src->py, cnt );
+  memcpy( dst->pz, src->pz, cnt );
+
+  return( bytes );
+} /* Copy_Near_Field() */
+
+/*------------------------------------------------------------------------*/
+
+/* Copy_Currents()
+ *
+ * Copies current and charge density data between
+ * buffers, returns the number of bytes copied
+ */
+  static size_t
+Copy_Currents( crnt_t *dst, crnt_t *src )
+{
+  size_t cnt, bytes;
+
+  /* Current & charge data (a, b, c, ir & ii) */
+  cnt = (size_t)data.npm * sizeof( double );
+  memcpy( dst->air, src->air, cnt );
+  memcpy( dst->aii, src->aii, cnt );
+  memcpy( dst->bir, src->bir, cnt );
+  memcpy( dst->bii, src->bii, cnt );
+  memcpy( dst->cir, src->cir, cnt );
+  memcpy( dst->cii, src->cii, cnt );
+  bytes = 6 * cnt;
+
+  /* Complex current (crnt.cur) */
+  cnt = (size_t)data.np3m * sizeof( complex double );
+  memcpy( dst->cur, src->cur, cnt );
+  bytes += cnt;
+
+  return( bytes );
+} /* Copy_Currents() */
+
+/*------------------------------------------------------------------------*/
+
+/* Pass_Freq_Data()
+ *
+ * Passes frequency-dependent data (current, charge density,
+ * input impedances etc) from child processes to parent, by
+ * writing it to the shared slot of frequency step fstep and
+ * the currents and near field to an entry of the child's ring
+ */
+  static void
+Pass_Freq_Data( int fstep )
+{
+  freq_slot_view_t slot;
+  freq_ring_view_t ring;
+  freq_slot_t *hdr;
+  perf_mark_t mark;
+  size_t bytes;
+  int entry = -1;
+
+  if( Freq_Slot(fstep, &slot) )
+    entry = Freq_Ring_Take( num_child_procs );
+
+  if( (entry < 0) || !Freq_Ring(num_child_procs, entry, &ring) )
+  {
+    pr_err( "no shared data slot for frequency step %d\n", fstep );
+    Write_Pipe( num_child_procs, FREQ_DATA_FAIL, 4, TRUE );
+    Write_Pipe( num_child_procs, (char *)&fstep, sizeof(fstep), TRUE );
+    return;
+  }
+  hdr = slot.hdr;
+  Perf_Start( &mark );
+
+  /* Current & charge data */
+  bytes = Copy_Currents( &ring.crnt, &crnt );
+  hdr->ring  = entry;
+  hdr->newer = crnt.newer;
+  hdr->valid = crnt.valid;
+
+  /* Impedance data */
+  hdr->zreal  = impedance_data.zreal[0];
+  hdr->zimag  = impedance_data.zimag[0];
+  hdr->zmagn  = impedance_data.zmagn[0];
+  hdr->zphase = impedance_data.zphase[0];
+
+  /* Network data */
+  hdr->zped = netcx.zped;
+
+  /* Radiation pattern data if enabled */
+  hdr->new_rdpat = 0;
+  if( isFlagSet(ENABLE_RDPAT) )
+  {
+    bytes += Copy_Rdpattern( &slot.rdpat, &rad_pattern[0] );
+    bytes += Rdpat_Store_Write( 0, fstep );
+    if( isFlagSet(DRAW_NEW_RDPAT) )
+      hdr->new_rdpat = 1;
+  }
+
+  /* Near field data if enabled */
+  hdr->near_field = 0;
+  if( isFlagSet(DRAW_EHFIELD) && (ring.near_field.px != NULL) )
+  {
+    bytes += Copy_Near_Field( &ring.near_field, &near_field );
+    hdr->max_er   = near_field.max_er;
+    hdr->max_hr   = near_field.max_hr;
+    hdr->r_max    = near_field.r_max;
+    hdr->nf_newer = near_field.newer;
+    hdr->nf_valid = near_field.valid;
+    hdr->near_field = 1;
+  }
+
+  Perf_Stop( &mark, PERF_IPC );
+  Perf_Count_Bytes( PERF_IPC, bytes + sizeof(freq_slot_t) );
+
+  /* Phase times of this step, for the parent to add up */
+  Perf_Get( hdr->perf );
+  Perf_Reset();
+
+  /* Tell parent the slot is filled */
+  hdr->fstep = fstep;
+  g_atomic_int_add( &rings[num_child_procs].sent, 1 );
+  Write_Pipe( num_child_procs, FREQ_DATA_DONE, 4, TRUE );
+  Write_Pipe( num_child_procs, (char *)&fstep, sizeof(fstep), TRUE );
 
 } /* Pass_Freq_Data() */
 
@@ -390,8 +867,9 @@ Child_Process( int num_child )
 {
   ssize_t retval;   /* Return from select()/read() etc */
   char cmnd[8];     /* Command string received from parent */
-  char *buff;       /* Passes address of variables to read()/write() */
   size_t cnt;       /* Size of data buffers for read()/write() */
+  int fstep;        /* Frequency step of data passed to parent */
+  int first, last;  /* Chunk of frequency steps taken from queue */
 
   /* Close unwanted pipe ends */
   close( forked_proc_data[num_child]->pnt2child_pipe[WRITE] );
@@ -420,6 +898,9 @@ Child_Process( int num_child )
         Read_Pipe( num_child,
 			(char*)&rc_config.mathlib_batch_idx,
 			sizeof(rc_config.mathlib_batch_idx), FALSE );
+        Read_Pipe( num_child,
+			(char*)&rc_config.mathlib_batch_threads,
+			sizeof(rc_config.mathlib_batch_threads), FALSE );
 
         // Clear the previous frequency cache to prevent false values from benchmarking:
         if (current_mathlib->idx != rc_config.mathlib_batch_idx)
@@ -428,6 +909,7 @@ Child_Process( int num_child )
         // This says "interactive" mathlib, but since we are forked it is running
         // as a batch from the parent.
         set_mathlib_interactive(NULL, get_mathlib_by_idx(rc_config.mathlib_batch_idx));
+        mathlib_set_threads(rc_config.mathlib_batch_threads);
         break;
 
       case INFILE: /* Read input file */
@@ -436,21 +918,26 @@ Child_Process( int num_child )
         Child_Input_File();
         break;
 
-      case FRQDATA: /* Calculate currents and pass on */
-        /* Get new frequency */
-        buff = (char *) &calc_data.freq_mhz;
-        cnt = sizeof( double );
-        Read_Pipe( num_child, buff, (ssize_t)cnt, TRUE );
-
-        /* Frequency buffers in children are for current frequency only */
-        calc_data.freq_step = 0;
-
+      case FRQDATA: /* Calculate currents of queued frequencies and pass on */
         /* Set flags */
         SetFlag( FREQ_LOOP_RUNNING );
 
-        /* Calculate freq data and pass to parent */
-        New_Frequency();
-        Pass_Freq_Data();
+        /* Take chunks of frequency steps until the queue is empty */
+        while( Freq_Queue_Take(&first, &last) )
+          for( fstep = first; fstep < last; fstep++ )
+          {
+            calc_data.freq_mhz = queue_freq[fstep];
+
+            /* Frequency buffers in children are for current frequency only */
+            calc_data.freq_step = 0;
+
+            /* Calculate freq data and pass to parent */
+            New_Frequency();
+            Pass_Freq_Data( queue_fstep[fstep] );
+          }
+
+        /* Tell parent this child is done */
+        Write_Pipe( num_child, FREQ_DATA_IDLE, 4, TRUE );
         break;
 
       case EHFIELD: /* Calculate near field E/H data */
@@ -561,191 +1048,98 @@ static ssize_t PRead_Pipe(int idx, char *str, ssize_t len, gboolean err)
 /* Get_Freq_Data()
  *
  * Gets frequency-dependent data (current, charge density,
- * input impedances etc) from child processes.
+ * input impedances etc) from child process idx, for the
+ * frequency step it returns in *fstep. The radiation pattern
+ * is used in place in its shared slot, only the data kept
+ * for the latest step are copied out of it and out of the
+ * child's ring, whose entry is then released. Returns
+ * FREQ_CHILD_IDLE if the child has run out of steps instead.
  *
  * Be sure to hold the freq_data_lock mutex when calling this function.
  */
   int
-Get_Freq_Data( int idx, int fstep )
+Get_Freq_Data( int idx, int *fstep )
 {
-  char *buff = NULL, flag;
-  char nfeh[5];
-  size_t cnt, buff_size;
-
-  /*** Total of bytes to read/write thru pipe ***/
-  buff_size =
-    /* Current & charge data (a, b, c ir & ii) */
-    (size_t)(6 * data.npm) * sizeof( double ) +
-    /* Complex current (crnt.cur) */
-    (size_t)data.np3m * sizeof( complex double ) +
-    /* newer and valid flags */
-    2 * sizeof(char) +
-    /* Impedance data */
-    4 * sizeof(double) +
-    /* Network data */
-    sizeof(complex double);
+  freq_slot_view_t slot;
+  freq_ring_view_t ring;
+  freq_slot_t *hdr;
+  perf_mark_t mark;
+  size_t bytes;
+  char mesg[5];
 
-  /* Radiation pattern data if enabled */
-  if( isFlagSet(ENABLE_RDPAT) )
-  {
-    buff_size +=
-      /* Gain total, tilt, axial ratio */
-      (size_t)(3 * fpat.nph * fpat.nth) * sizeof(double) +
-      /* max & min gain, tht & phi angles */
-      (size_t)(4 * NUM_POL) * sizeof(double) +
-      /* max and min gain index */
-      (size_t)(2 * NUM_POL) * sizeof(int) +
-      /* Polarization sens */
-      (size_t)(fpat.nph * fpat.nth) * sizeof(int) +
-      /* New pattern flag */
-      sizeof( char );
-  }
+  /* Wait for the child's notice */
+  if( PRead_Pipe(idx, mesg, 4, TRUE) < 0 )
+    return( FREQ_DATA_ERROR );
+  mesg[4] = '\0';
 
-  /* Notification to read near field data */
-  if (PRead_Pipe( idx, nfeh, 4, TRUE ) < 0)
-	  return 0;
+  if( strcmp(mesg, FREQ_DATA_IDLE) == 0 )
+    return( FREQ_CHILD_IDLE );
 
-  nfeh[4] = '\0';
+  if( PRead_Pipe(idx, (char *)fstep, sizeof(int), TRUE) < 0 )
+    return( FREQ_DATA_ERROR );
 
-  /* Get near field data if enabled */
-  if( strcmp(nfeh, "nfeh") == 0 )
+  if( strcmp(mesg, FREQ_DATA_DONE) != 0 )
   {
-    /* Near E field data */
-    if( fpat.nfeh & NEAR_EFIELD )
-      buff_size +=
-        (size_t)( 10 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double);
-    /* Near H field data */
-    if( fpat.nfeh & NEAR_HFIELD )
-      buff_size +=
-        (size_t)( 10 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double);
-    /* Co-ordinates of field points */
-    buff_size +=
-      (size_t)( 3 * fpat.nrx * fpat.nry * fpat.nrz + 1 ) * sizeof(double) +
-      /* newer & valid flags */
-      2 * sizeof(char);
+    pr_err( "child %d failed frequency step %d\n", idx, *fstep );
+    return( FREQ_DATA_ERROR );
   }
 
-  /* Allocate data buffer */
-  mem_alloc( (void **)&buff, buff_size, "in fork.c" );
-
-  /* Clear buffer index in Mem_Copy()Mem_Copy( */
-  Mem_Copy( NULL, NULL, 0, READ );
-
-  /* Get data accumulated in buffer if child */
-  if (PRead_Pipe( idx, buff, (ssize_t)buff_size, TRUE ) < 0)
+  if( !Freq_Slot(*fstep, &slot) || (slot.hdr->fstep != *fstep) ||
+      !Freq_Ring(idx, slot.hdr->ring, &ring) )
   {
-	  free_ptr((void **)&buff);
-	  return 0;
+    pr_err( "bad shared data slot for frequency step %d\n", *fstep );
+    Freq_Ring_Release( idx );
+    return( FREQ_DATA_ERROR );
   }
+  hdr = slot.hdr;
+  Perf_Start( &mark );
 
-  /* Get current and charge data */
-  cnt =  (size_t)data.npm * sizeof( double );
-  Mem_Copy( buff, (char *)crnt.air, cnt, READ );
-  Mem_Copy( buff, (char *)crnt.aii, cnt, READ );
-  Mem_Copy( buff, (char *)crnt.bir, cnt, READ );
-  Mem_Copy( buff, (char *)crnt.bii, cnt, READ );
-  Mem_Copy( buff, (char *)crnt.cir, cnt, READ );
-  Mem_Copy( buff, (char *)crnt.cii, cnt, READ );
-
-  cnt = (size_t)data.np3m * sizeof( complex double );
-  Mem_Copy( buff, (char *)crnt.cur, cnt, READ );
-
-  cnt = sizeof( char );
-  Mem_Copy( buff, &crnt.newer, cnt, READ );
-  Mem_Copy( buff, &crnt.valid, cnt, READ );
+  /* Current & charge data */
+  bytes = Copy_Currents( &crnt, &ring.crnt );
+  crnt.newer = hdr->newer;
+  crnt.valid = hdr->valid;
 
-  /* Get impedance data */
-  cnt = sizeof(double);
-  Mem_Copy( buff, (char *)&impedance_data.zreal[fstep],  cnt, READ );
-  Mem_Copy( buff, (char *)&impedance_data.zimag[fstep],  cnt, READ );
-  Mem_Copy( buff, (char *)&impedance_data.zmagn[fstep],  cnt, READ );
-  Mem_Copy( buff, (char *)&impedance_data.zphase[fstep], cnt, READ );
+  /* Impedance data */
+  impedance_data.zreal[*fstep]  = hdr->zreal;
+  impedance_data.zimag[*fstep]  = hdr->zimag;
+  impedance_data.zmagn[*fstep]  = hdr->zmagn;
+  impedance_data.zphase[*fstep] = hdr->zphase;
 
-  /* Get network data */
-  cnt = sizeof(complex double);
-  Mem_Copy( buff, (char *)&netcx.zped, cnt, READ );
+  /* Network data */
+  netcx.zped = hdr->zped;
 
-  /* Get radiation pattern data if enabled */
+  /* Radiation pattern data, copied only if not already in the
+   * slot. A pattern in the store file was written there by the
+   * child, so its older copy in memory if any is dropped */
   if( isFlagSet(ENABLE_RDPAT) )
   {
-    cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(double);
-    Mem_Copy( buff, (char *)rad_pattern[fstep].gtot, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].tilt, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].axrt, cnt, READ );
-
-    cnt = (size_t)NUM_POL * sizeof(double);
-    Mem_Copy( buff, (char *)rad_pattern[fstep].max_gain, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].min_gain, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].max_gain_tht, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].max_gain_phi, cnt, READ );
-
-    cnt = (size_t)NUM_POL * sizeof(int);
-    Mem_Copy( buff, (char *)rad_pattern[fstep].max_gain_idx, cnt, READ );
-    Mem_Copy( buff, (char *)rad_pattern[fstep].min_gain_idx, cnt, READ );
-
-    cnt = (size_t)(fpat.nph * fpat.nth) * sizeof(int);
-    Mem_Copy( buff, (char *)rad_pattern[fstep].sens, cnt, READ );
-
-    Mem_Copy( buff, &flag, sizeof(flag), READ );
-    if( flag ) SetFlag( DRAW_NEW_RDPAT );
+    Rdpat_Store_Drop( *fstep );
+    if( rad_pattern[*fstep].max_gain != slot.rdpat.max_gain )
+      bytes += Copy_Rdpattern( &rad_pattern[*fstep], &slot.rdpat );
+    if( hdr->new_rdpat ) SetFlag( DRAW_NEW_RDPAT );
   }
 
-  /* Get near field data if signaled by child */
-  if( strcmp(nfeh, "nfeh") == 0 )
+  /* Get near field data if passed by child */
+  if( hdr->near_field )
   {
-    /* Magnitude and phase of E field */
-    if( fpat.nfeh & NEAR_EFIELD )
-    {
-      cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-      Mem_Copy( buff, (char *)near_field.ex, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.ey, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.ez, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fex, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fey, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fez, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.erx, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.ery, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.erz, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.er, cnt, READ );
-      cnt = sizeof(double);
-      Mem_Copy( buff, (char *)&near_field.max_er, cnt, READ );
-    }
-
-    /* Magnitude and phase of H fields */
-    if( fpat.nfeh & NEAR_HFIELD )
-    {
-      cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-      Mem_Copy( buff, (char *)near_field.hx, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hy, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hz, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fhx, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fhy, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.fhz, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hrx, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hry, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hrz, cnt, READ );
-      Mem_Copy( buff, (char *)near_field.hr, cnt, READ );
-      cnt = sizeof(double);
-      Mem_Copy( buff, (char *)&near_field.max_hr, cnt, READ );
-    }
-
-    /* Co-ordinates of field points */
-    cnt = (size_t)(fpat.nrx * fpat.nry * fpat.nrz) * sizeof(double);
-    Mem_Copy( buff, (char *)near_field.px, cnt, READ );
-    Mem_Copy( buff, (char *)near_field.py, cnt, READ );
-    Mem_Copy( buff, (char *)near_field.pz, cnt, READ );
-    cnt = sizeof(double);
-    Mem_Copy( buff, (char *)&near_field.r_max, cnt, READ );
+    bytes += Copy_Near_Field( &near_field, &ring.near_field );
+    near_field.max_er = hdr->max_er;
+    near_field.max_hr = hdr->max_hr;
+    near_field.r_max  = hdr->r_max;
+    near_field.newer  = hdr->nf_newer;
+    near_field.valid  = hdr->nf_valid;
+  }
 
-    cnt = sizeof( char );
-    Mem_Copy( buff, &near_field.newer, cnt, READ );
-    Mem_Copy( buff, &near_field.valid, cnt, READ );
+  /* The child may fill the ring entry again */
+  Freq_Ring_Release( idx );
 
-  } /*if( isFlagSet(DRAW_EHFIELD) ) */
+  Perf_Stop( &mark, PERF_IPC );
+  Perf_Count_Bytes( PERF_IPC, bytes + sizeof(freq_slot_t) );
 
-  free_ptr( (void **)&buff );
+  /* Phase times of the child for this step */
+  Perf_Add( hdr->perf );
 
-  return 1;
+  return( FREQ_DATA_READ );
 } /* Get_Freq_Data() */
 
 /*------------------------------------------------------------------------*/
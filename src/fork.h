@@ -37,6 +37,98 @@ enum P2CH_COMND
   NUM_FKCMNDS
 };
 
+/* Child to parent notices that a frequency data slot is
+ * filled or could not be, each followed by the frequency step,
+ * and that the frequency queue is empty. These must be 4 bytes long */
+#define FREQ_DATA_DONE  "done"
+#define FREQ_DATA_FAIL  "fail"
+#define FREQ_DATA_IDLE  "idle"
+
+/* Return values of Get_Freq_Data() */
+enum
+{
+  FREQ_DATA_ERROR = 0,
+  FREQ_DATA_READ,
+  FREQ_CHILD_IDLE
+};
+
+/* Chunks taken from the frequency queue are 1/FREQ_QUEUE_CHUNK_DIV
+ * of a child's share of the steps left, so they shrink towards the
+ * end of the loop and the children run out of work together */
+#define FREQ_QUEUE_CHUNK_DIV  4
+
+/* Queue of frequency steps in shared memory, children take
+ * chunks of steps from it until it is empty */
+typedef struct
+{
+  gint next;    /* Next frequency step to take */
+  int  nsteps;  /* Number of frequency steps queued */
+  int  njobs;   /* Number of children taking steps */
+
+} freq_queue_t;
+
+/* Entries in the ring of each child that carries the currents and
+ * near field of its steps, the parent copies them out in turn */
+#define FREQ_RING_DEPTH  2
+
+/* Counts of the entries of a child's ring filled by the
+ * child and copied out and released by the parent */
+typedef struct
+{
+  gint sent;
+  gint released;
+
+} freq_ring_t;
+
+/* Header of a frequency data slot in shared memory,
+ * followed by the arrays laid out by Freq_Slot_Layout() */
+typedef struct
+{
+  int fstep;          /* Frequency step the slot was filled for */
+  int ring;           /* Entry of the child's ring with its currents */
+
+  char
+    newer,            /* crnt.newer */
+    valid,            /* crnt.valid */
+    new_rdpat,        /* New radiation pattern available */
+    near_field,       /* Near field data present */
+    nf_newer,         /* near_field.newer */
+    nf_valid;         /* near_field.valid */
+
+  double
+    zreal,            /* Input impedance */
+    zimag,
+    zmagn,
+    zphase;
+
+  complex double zped; /* Network data */
+
+  double
+    max_er,           /* Near field maxima */
+    max_hr,
+    r_max;
+
+  /* Phase times of the child for this step */
+  perf_phase_t perf[PERF_NUM_PHASES];
+
+} freq_slot_t;
+
+/* Pointers into a frequency data slot */
+typedef struct
+{
+  freq_slot_t   *hdr;
+  rad_pattern_t rdpat;
+
+} freq_slot_view_t;
+
+/* Pointers into an entry of a child's ring */
+typedef struct
+{
+  crnt_t        crnt;
+  near_field_t  near_field;
+
+} freq_ring_view_t;
+
 /* Near Field select flags */
 #define E_HFIELD    0x01
 #define SNAPSHOT    0x02
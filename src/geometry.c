@@ -231,14 +231,193 @@ subph( int nx, int ny )
     data.pz[mi]=10000.0;
 
   /* Process new patches created */
+#ifndef XNEC2C_BATCH
   if( ! CHILD )
     New_Patch_Data();
+#endif
 
   return;
 }
 
 /*-----------------------------------------------------------------------*/
 
+/* Seg_Index_Bucket()
+ *
+ * Returns the hash bucket of the grid cell cx, cy, cz
+ */
+  static guint
+Seg_Index_Bucket( const seg_index_t *sidx, gint64 cx, gint64 cy, gint64 cz )
+{
+  guint64 h;
+
+  h = ((guint64)cx * 73856093u) ^
+      ((guint64)cy * 19349663u) ^
+      ((guint64)cz * 83492791u);
+
+  return( (guint)(h ^ (h >> 32)) & sidx->mask );
+} /* Seg_Index_Bucket() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Seg_Index_Cell()
+ *
+ * Returns the grid cell co-ordinate of x
+ */
+  static gint64
+Seg_Index_Cell( const seg_index_t *sidx, double x )
+{
+  x = floor( x / sidx->cell );
+
+  /* Keep far away points in range, they only share cells */
+  if( x >  1.0e15 ) x =  1.0e15;
+  if( x < -1.0e15 ) x = -1.0e15;
+
+  return( (gint64)x );
+} /* Seg_Index_Cell() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Seg_Index_Build()
+ *
+ * Puts the ends of all the wire segments in the grid hash. The
+ * cells are twice the largest search distance used by conect(),
+ * so that ends within that distance of a point are in the cell
+ * of the point or in a neighbouring one, even after conect()
+ * has moved them onto the ground plane, by less than that
+ */
+  static void
+Seg_Index_Build( seg_index_t *sidx )
+{
+  int e, iseg, nend;
+  double slen, x, y, z;
+  size_t mreq;
+  guint b, nbkt;
+
+  /* Largest search distance, from the segment lengths */
+  sidx->cell = 0.0;
+  for( iseg = 0; iseg < data.n; iseg++ )
+  {
+    slen=( fabs(data.x2[iseg]- data.x1[iseg]) +
+        fabs(data.y2[iseg]- data.y1[iseg]) +
+        fabs(data.z2[iseg]- data.z1[iseg]) )* SMIN;
+    if( sidx->cell < slen )
+      sidx->cell = slen;
+  }
+  sidx->cell *= 2.0;
+  if( sidx->cell <= 0.0 )
+    sidx->cell = 1.0;
+
+  /* About two buckets per segment end */
+  nend = 2 * data.n;
+  for( nbkt = 1; nbkt < (guint)(2 * nend); nbkt <<= 1 );
+  sidx->mask = nbkt - 1;
+
+  sidx->head = NULL;
+  sidx->next = NULL;
+  mreq = (size_t)nbkt * sizeof(int);
+  mem_alloc( (void **)&sidx->head, mreq, "in geometry.c" );
+  mreq = (size_t)nend * sizeof(int);
+  mem_alloc( (void **)&sidx->next, mreq, "in geometry.c" );
+  for( b = 0; b < nbkt; b++ )
+    sidx->head[b] = -1;
+
+  /* Link the ends in reverse so each chain is in end order */
+  for( e = nend-1; e >= 0; e-- )
+  {
+    iseg = e / 2;
+    x = (e & 1) ? data.x2[iseg] : data.x1[iseg];
+    y = (e & 1) ? data.y2[iseg] : data.y1[iseg];
+    z = (e & 1) ? data.z2[iseg] : data.z1[iseg];
+    b = Seg_Index_Bucket( sidx,
+        Seg_Index_Cell(sidx, x), Seg_Index_Cell(sidx, y), Seg_Index_Cell(sidx, z) );
+    sidx->next[e] = sidx->head[b];
+    sidx->head[b] = e;
+  }
+
+} /* Seg_Index_Build() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Seg_Index_Free()
+ *
+ * Frees the buffers of the grid hash
+ */
+  static void
+Seg_Index_Free( seg_index_t *sidx )
+{
+  free_ptr( (void **)&sidx->head );
+  free_ptr( (void **)&sidx->next );
+} /* Seg_Index_Free() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Seg_Index_Find()
+ *
+ * Returns the segment end in contact with the point x, y, z that
+ * the serial search of conect() would have found first, or -1.
+ * For a wire end of segment i the search starts at segment i+1 and
+ * wraps around, with distance slen. For a patch centre (i < 0) it
+ * starts at segment 0, with the distance of each candidate segment.
+ * End 1 of a segment is tried before end 2
+ */
+  static int
+Seg_Index_Find( const seg_index_t *sidx, int i,
+    double x, double y, double z, double slen )
+{
+  int e, ic, dx, dy, dz, best = -1;
+  long key, best_key = 0;
+  double sep, cx, cy, cz, ex, ey, ez;
+  gint64 kx, ky, kz;
+
+  kx = Seg_Index_Cell( sidx, x );
+  ky = Seg_Index_Cell( sidx, y );
+  kz = Seg_Index_Cell( sidx, z );
+
+  for( dx = -1; dx <= 1; dx++ )
+    for( dy = -1; dy <= 1; dy++ )
+      for( dz = -1; dz <= 1; dz++ )
+      {
+        e = sidx->head[ Seg_Index_Bucket(sidx, kx+dx, ky+dy, kz+dz) ];
+        for( ; e >= 0; e = sidx->next[e] )
+        {
+          ic = e / 2;
+          if( ic == i )
+            continue;
+
+          if( e & 1 )
+          {
+            ex = data.x2[ic]; ey = data.y2[ic]; ez = data.z2[ic];
+            cx = data.x1[ic]; cy = data.y1[ic]; cz = data.z1[ic];
+          }
+          else
+          {
+            ex = data.x1[ic]; ey = data.y1[ic]; ez = data.z1[ic];
+            cx = data.x2[ic]; cy = data.y2[ic]; cz = data.z2[ic];
+          }
+
+          /* Patch centres use the length of the candidate segment */
+          if( i < 0 )
+            slen=( fabs(cx- ex) + fabs(cy- ey)+ fabs(cz- ez))* SMIN;
+
+          sep= fabs( x- ex) + fabs( y- ey)+ fabs( z- ez);
+          if( sep > slen )
+            continue;
+
+          /* Position in the order of the serial search */
+          key = 2L * (long)((ic - i - 1 + data.n) % data.n) + (e & 1);
+          if( (best < 0) || (key < best_key) )
+          {
+            best = e;
+            best_key = key;
+          }
+        }
+      }
+
+  return( best );
+} /* Seg_Index_Find() */
+
+/*-----------------------------------------------------------------------*/
+
 /* connect sets up segment connection data in arrays icon1 and */
 /* icon2 by searching for segment ends that are in contact.
  *
@@ -249,10 +428,11 @@ subph( int nx, int ny )
   gboolean
 conect( int ignd )
 {
-  int i, iz, ic, j, jx, ix, ixx, iseg, iend, jend, jump;
+  int i, iz, ic, j, jx, ix, ixx, iseg, iend, jend, jump, e;
   double sep=0.0, xi1, yi1, zi1, xi2, yi2, zi2;
   double slen, xa, ya, za, xs, ys, zs;
   size_t mreq;
+  seg_index_t sidx;
 
   segj.maxcon = 1;
 
@@ -290,6 +470,9 @@ conect( int ignd )
     mem_realloc( (void **)&data.icon1, mreq, "in geometry.c" );
     mem_realloc( (void **)&data.icon2, mreq, "in geometry.c" );
 
+    /* Segment ends are looked up in a grid hash */
+    Seg_Index_Build( &sidx );
+
     for( i = 0; i < data.n; i++ )
     {
       data.icon1[i] = data.icon2[i] = 0;
@@ -312,6 +495,7 @@ conect( int ignd )
           pr_err("geometry data error: segment %d extends below ground\n", iz);
           Stop( _("Geometry data error\n"
                 "Segment extends below ground"), ERR_OK );
+          Seg_Index_Free( &sidx );
           return( FALSE );
         }
 
@@ -325,32 +509,12 @@ conect( int ignd )
 
       } /* if( ignd > 0) */
 
+      /* First segment end in contact, searching from segment i+1 */
       if( ! jump )
       {
-        ic= i;
-        for( j = 1; j < data.n; j++)
-        {
-          ic++;
-          if( ic >= data.n)
-            ic=0;
-
-          sep= fabs( xi1- data.x1[ic]) +
-            fabs(yi1- data.y1[ic])+ fabs(zi1- data.z1[ic]);
-          if( sep <= slen)
-          {
-            data.icon1[i]= -(ic+1);
-            break;
-          }
-
-          sep= fabs( xi1- data.x2[ic]) +
-            fabs(yi1- data.y2[ic])+ fabs(zi1- data.z2[ic]);
-          if( sep <= slen)
-          {
-            data.icon1[i]= (ic+1);
-            break;
-          }
-
-        } /* for( j = 1; j < data.n; j++) */
+        e = Seg_Index_Find( &sidx, i, xi1, yi1, zi1, slen );
+        if( e >= 0 )
+          data.icon1[i]= (e & 1) ? (e/2+1) : -(e/2+1);
 
       } /* if( ! jump ) */
 
@@ -362,6 +526,7 @@ conect( int ignd )
           pr_err("geometry data error: segment %d extends below ground\n", iz);
           Stop( _("Geometry data error\n"
                 "Segment extends below ground"), ERR_OK );
+          Seg_Index_Free( &sidx );
           return( FALSE );
         }
 
@@ -372,6 +537,7 @@ conect( int ignd )
             pr_err("geometry data error: segment %d lies in ground plane\n", iz);
             Stop( _("Geometry data error\n"
                   "Segment lies in ground plane"), ERR_OK );
+            Seg_Index_Free( &sidx );
             return( FALSE );
           }
 
@@ -383,30 +549,10 @@ conect( int ignd )
 
       } /* if( ignd > 0) */
 
-      ic= i;
-      for( j = 1; j < data.n; j++ )
-      {
-        ic++;
-        if( ic >= data.n)
-          ic=0;
-
-        sep= fabs(xi2- data.x1[ic]) +
-          fabs(yi2- data.y1[ic])+ fabs(zi2- data.z1[ic]);
-        if( sep <= slen)
-        {
-          data.icon2[i]= (ic+1);
-          break;
-        }
-
-        sep= fabs(xi2- data.x2[ic]) +
-          fabs(yi2- data.y2[ic])+ fabs(zi2- data.z2[ic]);
-        if( sep <= slen)
-        {
-          data.icon2[i]= -(ic+1);
-          break;
-        }
-
-      } /* for( j = 1; j < data.n; j++ ) */
+      /* First segment end in contact, searching from segment i+1 */
+      e = Seg_Index_Find( &sidx, i, xi2, yi2, zi2, slen );
+      if( e >= 0 )
+        data.icon2[i]= (e & 1) ? -(e/2+1) : (e/2+1);
 
     } /* for( i = 0; i < data.n; i++ ) */
 
@@ -422,45 +568,27 @@ conect( int ignd )
         ys= data.py[ix];
         zs= data.pz[ix];
 
-        for( iseg = 0; iseg < data.n; iseg++ )
-        {
-          xi1= data.x1[iseg];
-          yi1= data.y1[iseg];
-          zi1= data.z1[iseg];
-          xi2= data.x2[iseg];
-          yi2= data.y2[iseg];
-          zi2= data.z2[iseg];
-
-          /* for first end of segment */
-          slen=( fabs(xi2- xi1) +
-              fabs(yi2- yi1)+ fabs(zi2- zi1))* SMIN;
-          sep= fabs(xi1- xs)+ fabs(yi1- ys)+ fabs(zi1- zs);
-
-          /* connection - divide patch into 4
-           * patches at present array loc. */
-          if( sep <= slen)
-          {
-            data.icon1[iseg]=PCHCON+ i;
-            ic=0;
-            subph( i, ic );
-            break;
-          }
-
-          sep= fabs(xi2- xs)+ fabs(yi2- ys)+ fabs(zi2- zs);
-          if( sep <= slen)
-          {
-            data.icon2[iseg]=PCHCON+ i;
-            ic=0;
-            subph( i, ic );
-            break;
-          }
+        /* First segment end in contact, searching from segment 0 */
+        e = Seg_Index_Find( &sidx, -1, xs, ys, zs, 0.0 );
+        if( e < 0 )
+          continue;
 
-        } /* for( iseg = 0; iseg < data.n; iseg++ ) */
+        /* connection - divide patch into 4
+         * patches at present array loc. */
+        iseg = e / 2;
+        if( e & 1 )
+          data.icon2[iseg]=PCHCON+ i;
+        else
+          data.icon1[iseg]=PCHCON+ i;
+        ic=0;
+        subph( i, ic );
 
       } /* while( ++i <= data.m ) */
 
     } /* if( data.m != 0) */
 
+    Seg_Index_Free( &sidx );
+
   } /* if( data.n != 0) */
 
   iseg=( data.n+ data.m)/( data.np+ data.mp);
@@ -22,5 +22,17 @@
 
 #include "common.h"
 
+/* Uniform grid hash of the wire segment ends, used by conect() to
+ * find the ends near a point without scanning all the segments.
+ * End e is end 1 (e even) or end 2 (e odd) of segment e/2 */
+typedef struct
+{
+  double cell;  /* Size of the cubic grid cells */
+  guint mask;   /* Number of hash buckets - 1, a power of 2 - 1 */
+  int *head;    /* First segment end in each bucket, -1 if none */
+  int *next;    /* Next segment end in the same bucket */
+
+} seg_index_t;
+
 #endif
 
@@ -360,6 +360,9 @@ Save_RadPattern_Gnuplot_Data( char *filename )
     double dth = (double)fpat.dth * (double)TORAD;
     double dph = (double)fpat.dph * (double)TORAD;
 
+    /* Bring the pattern into memory if it is kept in the store */
+    Rdpat_Store_Load( fstep );
+
     /* Open gplot file, abort on error */
     if( !Open_File(&fp, filename, "w") )
       return;
@@ -437,6 +440,9 @@ void Save_RadPattern_CSV(char *filename)
 	{
 		for (calc_idx = 0; calc_idx < calc_data.steps_total; calc_idx++)
 		{
+			// Bring the pattern into memory if it is kept in the store
+			Rdpat_Store_Load(calc_idx);
+
 			// Step phi angle
 			idx = 0;
 			phi = (double)fpat.phis * (double)TORAD; // In rads
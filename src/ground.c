@@ -61,25 +61,8 @@ rom2( double a, double b,
   double z, s; /***also global***/
   double rx = 1.0e-4;
   complex double t00, t02, t11;
-  static complex double *g1 = NULL, *g2 = NULL;
-  static complex double *g3 = NULL, *g4 = NULL;
-  static complex double *t01 = NULL, *t10 = NULL;
-  static complex double *t20 = NULL, *g5 = NULL;
-  static gboolean first_call = TRUE;
-
-  if( first_call )
-  {
-    first_call = FALSE;
-    size_t mreq = 9 * sizeof(complex double);
-    mem_alloc( (void **)&g1, mreq, "in ground.c");
-    mem_alloc( (void **)&g2, mreq, "in ground.c");
-    mem_alloc( (void **)&g3, mreq, "in ground.c");
-    mem_alloc( (void **)&g4, mreq, "in ground.c");
-    mem_alloc( (void **)&g5, mreq, "in ground.c");
-    mem_alloc( (void **)&t01, mreq, "in ground.c");
-    mem_alloc( (void **)&t10, mreq, "in ground.c");
-    mem_alloc( (void **)&t20, mreq, "in ground.c");
-  }
+  complex double g1[9], g2[9], g3[9], g4[9], g5[9];
+  complex double t01[9], t10[9], t20[9];
 
   z= a;
   ze= b;
@@ -97,6 +80,9 @@ rom2( double a, double b,
   for( i = 0; i < n; i++ )
     sum[i]=CPLX_00;
 
+  /* Stop() returns in batch servers */
+  if( s < 0.0 ) return;
+
   ns= nx;
   nt=0;
   sflds( z, g1);
@@ -59,6 +59,9 @@ Read_Comments( void )
 {
   char ain[3], line_buf[LINE_LEN];
 
+  /* SY variables of a previous input file */
+  Sym_Clear( FALSE );
+
   /* Look for CM or CE card */
   do
   {
@@ -166,6 +169,8 @@ datagn( void )
   double x3=0, y3=0, z3=0, x4=0, y4=0, z4=0;
   double xw1, xw2, yw1, yw2, zw1, zw2;
   double dummy;
+  perf_mark_t mark;
+  gboolean ok;
 
   data.ipsym=0;
   nwire=0;
@@ -313,16 +318,21 @@ datagn( void )
         continue;
 
       case GE: /* "ge" card, terminate structure geometry input. */
-        /* My addition, for drawing */
-        if( ((data.n > 0) || (data.m > 0)) && !CHILD )
-          Init_Struct_Drawing();
-        else if( (data.n == 0) && (data.m == 0) )
+        if( (data.n == 0) && (data.m == 0) )
         {
           Stop( _("No geometry data cards"), ERR_OK );
           return( FALSE );
         }
 
-        if( !conect(itg) ) return( FALSE );
+        /* My addition, for drawing */
+#ifndef XNEC2C_BATCH
+        if( !CHILD ) Init_Struct_Drawing();
+#endif
+
+        Perf_Start( &mark );
+        ok = conect( itg );
+        Perf_Stop( &mark, PERF_CONECT );
+        if( !ok ) return( FALSE );
 
         gnd.gpflag = itg;
 
@@ -592,11 +602,19 @@ Read_Geometry( void )
 {
   int idx;
   size_t mreq;
+  perf_mark_t mark;
+  gboolean ok;
 
   /* Moved here from Read_Commands() */
   matpar.imat=0;
   data.n = data.m = 0;
-  if( !datagn() ) return( FALSE );
+
+  /* Phase times start over with a new structure */
+  Perf_Reset();
+  Perf_Start( &mark );
+  ok = datagn();
+  Perf_Stop( &mark, PERF_GEOMETRY );
+  if( !ok ) return( FALSE );
 
   /* Memory allocation for temporary buffers */
   mreq = (size_t)data.npm * sizeof(double);
@@ -610,9 +628,15 @@ Read_Geometry( void )
     mem_realloc( (void **)&save.sitemp, mreq, "in input.c" );
   }
 
-  /* Memory allocation for primary interacton matrix. */
-  mreq = (size_t)(data.np2m * (data.np + 2 * data.mp)) * sizeof(complex double);
-  mem_realloc( (void **)&cm, mreq, "in input.c" );
+  /* Memory allocation for primary interacton matrix,
+   * unless it is kept in a file with --out-of-core */
+  if( Matrix_Ooc_Open(data.np2m, data.np + 2 * data.mp) )
+    free_ptr( (void **)&cm );
+  else
+  {
+    mreq = (size_t)(data.np2m * (data.np + 2 * data.mp)) * sizeof(complex double);
+    mem_realloc( (void **)&cm, mreq, "in input.c" );
+  }
 
   /* Memory allocation for current buffers */
   mreq = (size_t)data.npm * sizeof( double);
@@ -1262,8 +1286,7 @@ Read_Commands( void )
          * execution is not triggered by any card */
         continue; /* continue card input loop */
 
-      case SY: /* "sy" TODO Compatibility with 4nec2.
-                  Too difficult, may never happen :-( */
+      case SY: /* "sy" card, variables assigned by readmn() */
         continue;
 
       case XQ: /* "xq" execute card */
@@ -1306,12 +1329,14 @@ Read_Commands( void )
         calc_data.zo = (double)itmp1;
 
         /* Set the Zo spinbutton value */
+#ifndef XNEC2C_BATCH
         if( freqplots_window_builder )
         {
           GtkWidget *spin = Builder_Get_Object(
               freqplots_window_builder, "freqplots_zo_spinbutton" );
           gtk_spin_button_set_value( GTK_SPIN_BUTTON(spin), (gdouble)calc_data.zo );
         }
+#endif
         continue;
 
       default:
@@ -1329,12 +1354,15 @@ Read_Commands( void )
       if (!CHILD) pr_notice("Missing or surface-wave RP card: Radiation pattern and gain calculations disabled\n");
       ClearFlag( ENABLE_RDPAT );
     }
-    else
-    {
-      /* Allocate radiation pattern buffers FIXME */
+    else SetFlag( ENABLE_RDPAT );
+
+    /* Map the frequency data slots shared with the children,
+     * their layout depends on the input file just read */
+    if( FORKED || CHILD ) Freq_Slots_Map();
+
+    /* Allocate radiation pattern buffers FIXME */
+    if( isFlagSet(ENABLE_RDPAT) )
       Alloc_Rdpattern_Buffers( calc_data.steps_total + 1, fpat.nth, fpat.nph );
-      SetFlag( ENABLE_RDPAT );
-    }
 
     return( TRUE );
   } /* while( TRUE ) */
@@ -1345,6 +1373,42 @@ Read_Commands( void )
 
 } /* Read_Commands() */
 
+/*-----------------------------------------------------------------------*/
+
+/* Read_Input_Text()
+ *
+ * Reads an input file of len bytes in memory at text, for a new
+ * frequency loop. Returns FALSE if Stop() was called on an error
+ */
+  gboolean
+Read_Input_Text( char *text, size_t len )
+{
+  gboolean ok;
+
+  /* As in Open_Input_File() */
+  calc_data.freq_step   = -1;
+  calc_data.FR_cards    = 0;
+  calc_data.FR_index    = 0;
+  calc_data.steps_total = 0;
+  calc_data.last_step   = 0;
+
+  Close_File( &input_fp );
+  input_fp = fmemopen( text, len, "r" );
+  if( input_fp == NULL )
+  {
+    pr_err( "cannot read the input file in memory: %s\n", strerror(errno) );
+    return( FALSE );
+  }
+
+  /* Stop() sets FREQ_LOOP_STOP, also where it returns TRUE */
+  ClearFlag( FREQ_LOOP_STOP );
+  ok = Read_Comments() && Read_Geometry() && Read_Commands();
+  Close_File( &input_fp );
+  if( isFlagSet(FREQ_LOOP_STOP) ) ok = FALSE;
+
+  return( ok );
+} /* Read_Input_Text() */
+
 /*-----------------------------------------------------------------------*/
 
   gboolean
@@ -1407,6 +1471,17 @@ readmn( char *mn, int *i1, int *i2, int *i3, int *i4,
   /* extract card's mnemonic code */
   Strlcpy( mn, line_buf, 3 );
 
+  /* Assign SY variables, Read_Commands() skips the card */
+  if( strcmp(mn, "SY") == 0 )
+  {
+    gboolean ok = Sym_Assign( line_buf + 2 );
+    if( !ok )
+      Stop( _("Command data card error\n"
+            "Invalid SY card"), ERR_OK );
+    free_ptr( (void **)&startptr );
+    return( ok );
+  }
+
   /* Return if only mnemonic on card */
   if( len == 2 )
   {
@@ -1421,6 +1496,32 @@ readmn( char *mn, int *i1, int *i2, int *i3, int *i4,
     return( TRUE );
   }
 
+  /* With SY variables the fields may be expressions */
+  if( Sym_Count() > 0 )
+  {
+    if( !Sym_Fields(line_buf + 2, iarr, nint, rarr, nflt) )
+    {
+      pr_err("command data card \"%s\" error: invalid expression\n", mn);
+      Stop( _("Command data card error\n"
+            "Invalid expression in card"), ERR_OK );
+      free_ptr( (void **)&startptr );
+      return( FALSE );
+    }
+
+    *i1= iarr[0];
+    *i2= iarr[1];
+    *i3= iarr[2];
+    *i4= iarr[3];
+    *f1= rarr[0];
+    *f2= rarr[1];
+    *f3= rarr[2];
+    *f4= rarr[3];
+    *f5= rarr[4];
+    *f6= rarr[5];
+    free_ptr( (void **)&startptr );
+    return( TRUE );
+  }
+
   /* check line for spurious characters */
   for( idx = 2; idx < len; idx++ )
   {
@@ -1566,6 +1667,20 @@ readgm( char *gm, int *i1, int *i2, double *x1,
   /* extract card's mnemonic code */
   Strlcpy( gm, line_buf, 3 );
 
+  /* Assign SY variables and go on to the next card */
+  if( strcmp(gm, "SY") == 0 )
+  {
+    if( !Sym_Assign(line_buf + 2) )
+    {
+      Stop( _("Geometry data card error\n"
+            "Invalid SY card"), ERR_OK );
+      free_ptr( (void **)&startptr );
+      return( FALSE );
+    }
+    free_ptr( (void **)&startptr );
+    return( readgm(gm, i1, i2, x1, y1, z1, x2, y2, z2, rad) );
+  }
+
   /* Return if only mnemonic on card */
   if( len == 2 )
   {
@@ -1581,6 +1696,31 @@ readgm( char *gm, int *i1, int *i2, double *x1,
     return( TRUE );
   }
 
+  /* With SY variables the fields may be expressions */
+  if( Sym_Count() > 0 )
+  {
+    if( !Sym_Fields(line_buf + 2, iarr, nint, rarr, nflt) )
+    {
+      pr_err("geometry data card \"%s\" error: invalid expression\n", gm);
+      Stop( _("Geometry data card error\n"
+            "Invalid expression in card"), ERR_OK );
+      free_ptr( (void **)&startptr );
+      return( FALSE );
+    }
+
+    *i1  = iarr[0];
+    *i2  = iarr[1];
+    *x1  = rarr[0];
+    *y1  = rarr[1];
+    *z1  = rarr[2];
+    *x2  = rarr[3];
+    *y2  = rarr[4];
+    *z2  = rarr[5];
+    *rad = rarr[6];
+    free_ptr( (void **)&startptr );
+    return( TRUE );
+  }
+
   /* check line for spurious characters */
   for( idx = 2; idx < len; idx++ )
   {
@@ -394,6 +394,16 @@ create_aboutdialog( GtkBuilder **builder )
   return( ret );
 }
 
+  GtkWidget *
+create_perf_window( GtkBuilder **builder )
+{
+  GtkWidget *ret = NULL;
+  gchar *object_ids[] = { PERF_WINDOW_IDS };
+  Gtk_Builder( builder, object_ids );
+  ret = Builder_Get_Object( *builder, "perf_window" );
+  return( ret );
+}
+
   GtkWidget *
 create_nec2_save_dialog( GtkBuilder **builder )
 {
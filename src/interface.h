@@ -469,6 +469,12 @@ NULL
 "patch_ok_button", \
 NULL
 
+#define PERF_WINDOW_IDS \
+"perf_window", \
+"perf_label", \
+"perf_reset_button", \
+NULL
+
 #define QUIT_DIALOG_IDS \
 "quit_dialog", \
 "quit_cancelbutton", \
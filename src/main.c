@@ -33,6 +33,17 @@ enum XNEC2C_OPTS {
 	OPT_FIRST_OPT = 128,
 
 	OPT_ENABLE_OPTIMIZE,
+	OPT_FILL_THREADS,
+	OPT_MATRIX_CACHE,
+	OPT_MATRIX_CACHE_DISK,
+	OPT_SOMNEC_CACHE_DIR,
+	OPT_ADAPTIVE_SWEEP,
+	OPT_MATRIX_INTERP,
+	OPT_MIXED_PRECISION,
+	OPT_OUT_OF_CORE,
+	OPT_RDPAT_MB,
+	OPT_STATS,
+	OPT_AUTOTUNE,
 
 	OPT_WRITE_CSV,
 	OPT_WRITE_S1P,
@@ -40,6 +51,8 @@ enum XNEC2C_OPTS {
 	OPT_WRITE_S2P_VIEWER_GAIN,
 	OPT_WRITE_RDPAT,
 	OPT_WRITE_CURRENTS,
+	OPT_WRITE_RDPAT_BIN,
+	OPT_WRITE_CURRENTS_BIN,
 
 	OPT_MAX_OPTS
 };
@@ -56,6 +69,17 @@ static struct option long_options[] = {
 		{  "batch",                  no_argument,         NULL,  'b'                        },
 
 		{  "optimize",               no_argument,         NULL,  OPT_ENABLE_OPTIMIZE        },
+		{  "fill-threads",           required_argument,   NULL,  OPT_FILL_THREADS           },
+		{  "matrix-cache",           required_argument,   NULL,  OPT_MATRIX_CACHE           },
+		{  "matrix-cache-disk",      required_argument,   NULL,  OPT_MATRIX_CACHE_DISK      },
+		{  "somnec-cache-dir",       required_argument,   NULL,  OPT_SOMNEC_CACHE_DIR       },
+		{  "adaptive-sweep",         required_argument,   NULL,  OPT_ADAPTIVE_SWEEP         },
+		{  "matrix-interp",          required_argument,   NULL,  OPT_MATRIX_INTERP          },
+		{  "mixed-precision",        no_argument,         NULL,  OPT_MIXED_PRECISION        },
+		{  "out-of-core",            required_argument,   NULL,  OPT_OUT_OF_CORE            },
+		{  "rdpat-mb",               required_argument,   NULL,  OPT_RDPAT_MB               },
+		{  "stats",                  required_argument,   NULL,  OPT_STATS                  },
+		{  "autotune",               no_argument,         NULL,  OPT_AUTOTUNE               },
 
 		{  "write-csv",              required_argument,   NULL,  OPT_WRITE_CSV              },
 		{  "write-s1p",              required_argument,   NULL,  OPT_WRITE_S1P              },
@@ -63,6 +87,8 @@ static struct option long_options[] = {
 		{  "write-s2p-viewer-gain",  required_argument,   NULL,  OPT_WRITE_S2P_VIEWER_GAIN  },
 		{  "write-rdpat",            required_argument,   NULL,  OPT_WRITE_RDPAT            },
 		{  "write-currents",         required_argument,   NULL,  OPT_WRITE_CURRENTS         },
+		{  "write-rdpat-bin",        required_argument,   NULL,  OPT_WRITE_RDPAT_BIN        },
+		{  "write-currents-bin",     required_argument,   NULL,  OPT_WRITE_CURRENTS_BIN     },
 
 		{  NULL,                     0,                   NULL,  0                          }
 	};
@@ -111,6 +137,7 @@ main (int argc, char *argv[])
   /* getopt() variables */
   int option, idx, err;
   int enable_forking = 1;
+  int autotune = 0;
 
   /*** Signal handler related code ***/
   /* new and old actions for sigaction() */
@@ -147,6 +174,14 @@ main (int argc, char *argv[])
 
   /* Process command line options */
   calc_data.num_jobs  = 1;
+  rc_config.fill_threads = 1;
+  rc_config.matrix_cache_mb = 0;
+  rc_config.matrix_cache_disk_mb = 0;
+  rc_config.adaptive_tol = 0.0;
+  rc_config.matrix_interp_tol = 0.0;
+  rc_config.mixed_precision = 0;
+  rc_config.ooc_mb = 0;
+  rc_config.rdpat_mb = 0;
   rc_config.input_file[0] = '\0';
 
   // default to show warnings or more important errors.
@@ -219,6 +254,50 @@ main (int argc, char *argv[])
           SetFlag( OPTIMIZER_OUTPUT );
           break;
 
+      case OPT_FILL_THREADS: /* number of matrix fill threads per job */
+        rc_config.fill_threads = atoi( optarg );
+        break;
+
+      case OPT_MATRIX_CACHE: /* memory budget of factored matrix cache */
+        rc_config.matrix_cache_mb = atoi( optarg );
+        break;
+
+      case OPT_MATRIX_CACHE_DISK: /* disk budget of factored matrix cache */
+        rc_config.matrix_cache_disk_mb = atoi( optarg );
+        break;
+
+      case OPT_SOMNEC_CACHE_DIR: /* directory of Sommerfeld ground grid files */
+        rc_config.somnec_cache_dir = optarg;
+        break;
+
+      case OPT_ADAPTIVE_SWEEP: /* tolerance of adaptive frequency sweep */
+        rc_config.adaptive_tol = Strtod( optarg, NULL );
+        break;
+
+      case OPT_MATRIX_INTERP: /* tolerance of interpolated interaction matrices */
+        rc_config.matrix_interp_tol = Strtod( optarg, NULL );
+        break;
+
+      case OPT_MIXED_PRECISION: /* single precision LU with refinement */
+        rc_config.mixed_precision = 1;
+        break;
+
+      case OPT_OUT_OF_CORE: /* memory budget of out-of-core matrices */
+        rc_config.ooc_mb = atoi( optarg );
+        break;
+
+      case OPT_RDPAT_MB: /* memory budget of radiation patterns */
+        rc_config.rdpat_mb = atoi( optarg );
+        break;
+
+      case OPT_STATS: /* write solver phase times after each loop */
+        rc_config.filename_stats = optarg;
+        break;
+
+      case OPT_AUTOTUNE: /* run the mathlib autotuner trials and exit */
+        autotune = 1;
+        break;
+
       case OPT_WRITE_CSV:
         rc_config.filename_csv = optarg;
         break;
@@ -243,6 +322,14 @@ main (int argc, char *argv[])
         rc_config.filename_currents = optarg;
         break;
 
+      case OPT_WRITE_RDPAT_BIN:
+        rc_config.filename_rdpat_bin = optarg;
+        break;
+
+      case OPT_WRITE_CURRENTS_BIN:
+        rc_config.filename_currents_bin = optarg;
+        break;
+
       default:
         usage();
         exit(0);
@@ -251,6 +338,19 @@ main (int argc, char *argv[])
     } /* switch( option ) */
   } /* while( (option = getopt(argc, argv, "i:o:hv") ) != -1 ) */
 
+  /* The autotuner forks its own trial jobs */
+  if( autotune )
+    enable_forking = 0;
+
+  /* --fill-threads 0 shares the processors between the -j jobs */
+  if( rc_config.fill_threads < 1 )
+  {
+    rc_config.fill_threads = (int)sysconf( _SC_NPROCESSORS_ONLN ) / calc_data.num_jobs;
+    if( rc_config.fill_threads < 1 )
+      rc_config.fill_threads = 1;
+    pr_info("Using %d matrix fill threads per job\n", rc_config.fill_threads);
+  }
+
   if (rc_config.batch_mode && isFlagSet(OPTIMIZER_OUTPUT))
   {
 	  pr_crit("--batch and --optimize are mutual exclusive.\n");
@@ -310,6 +410,12 @@ main (int argc, char *argv[])
       mem_alloc( (void **)&forked_proc_data[idx], mreq, "in main.c" );
     }
 
+    /* Shared memory for frequency data, inherited by children */
+    Freq_Slots_Open();
+
+    /* File of the radiation patterns of --rdpat-mb, also shared */
+    Rdpat_Store_Open();
+
     /* Fork child processes */
     for( idx = 0; idx < calc_data.num_jobs; idx++ )
     {
@@ -380,6 +486,14 @@ main (int argc, char *argv[])
   /* Read GUI state config file and reset geometry */
   Read_Config();
 
+  /* Run the autotuner trials and save the table they fill */
+  if( autotune )
+  {
+    mathlib_autotune();
+    Save_Config();
+    exit( 0 );
+  }
+
   if (rc_config.batch_mode)
 	  rc_config.main_loop_start = 1;
 
@@ -516,6 +630,10 @@ Open_Input_File( gpointer arg )
   // The optimizer can queue multiple calls to this function so protect it with a lock
   g_mutex_lock(&global_lock);
 
+  /* Pick the mathlibs and jobs the autotuner found fastest,
+   * the lock keeps the frequency loop from running meanwhile */
+  mathlib_autotune_select( data.np + 2 * data.mp, calc_data.steps_total );
+
   SetFlag( INPUT_OPENED );
   gtk_widget_show( Builder_Get_Object(main_window_builder, "optimizer_output") );
 
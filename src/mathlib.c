@@ -75,13 +75,27 @@ static mathlib_t mathlibs[] = {
 	{.type = MATHLIB_INTEL, .lib = "libmkl_rt.so", .name = "Intel MKL, GNU Threads", .f_prefix = "LAPACKE_",
 		.init = mathlib_mkl_set_threading_gnu },
 
-	// Default implementation if none of the newer libraries are found.
+	// The original NEC2 functions:
 	{.type = MATHLIB_NEC2, .lib = "(builtin)", .name = "NEC2 Gaussian Elimination"},
 
+	// Default implementation if none of the newer libraries are found,
+	// see matrix_lu.c. New entries go at the end since the config file
+	// saves the selected libraries by their index in this table, but
+	// this one is preferred to NEC2, see mathlib_default_idx():
+	{.type = MATHLIB_BLOCKED, .lib = "(builtin)", .name = "Builtin Blocked LU"},
+
 };
 
 mathlib_t *current_mathlib = NULL;
 
+// The autotuner table, see mathlib_autotune():
+static mathlib_autotune_t autotune[MATHLIB_AUTOTUNE_MAX];
+static int num_autotune = 0;
+
+// The batch mathlib picked by mathlib_autotune_select() for this run,
+// or -1 for rc_config.mathlib_batch_idx, see mathlib_batch_idx():
+static int autotune_batch_idx = -1;
+
 // To add a new mathfunc:
 //   * Update the enum in mathlib.h if the calling convention differs
 //   * Add function pointer typedefs in mathlib.h
@@ -90,7 +104,9 @@ mathlib_t *current_mathlib = NULL;
 //   * Add a prototype for the new func in mathlib.h
 static char *mathfuncs[] = {
 	[MATHLIB_ZGETRF] = "zgetrf",
-	[MATHLIB_ZGETRS] = "zgetrs"
+	[MATHLIB_ZGETRS] = "zgetrs",
+	[MATHLIB_CGETRF] = "cgetrf",
+	[MATHLIB_CGETRS] = "cgetrs"
 };
 
 static int num_mathlibs = sizeof(mathlibs) / sizeof(mathlib_t);
@@ -133,8 +149,8 @@ int open_mathlib(mathlib_t *lib)
 		return 0;
 	}
 
-	// Builtin NEC2 Gaussian Elimination isn't a .so, just return success.
-	if (lib->type == MATHLIB_NEC2)
+	// Builtin NEC2 Gaussian Elimination and blocked LU aren't a .so, just return success.
+	if (lib->type == MATHLIB_NEC2 || lib->type == MATHLIB_BLOCKED)
 		return 1;
 
 	// Set environment if configured:
@@ -189,6 +205,14 @@ int open_mathlib(mathlib_t *lib)
 
 		char *error = dlerror();
 
+		// Single precision functions are optional:
+		if (error != NULL && fidx >= MATHLIB_CGETRF)
+		{
+			pr_info("  %s: no %s, using the builtin one\n", lib->lib, mathfuncs[fidx]);
+			lib->functions[fidx] = NULL;
+			continue;
+		}
+
 		if (error != NULL)
 		{
 			pr_err("  %s: unable to bind %s: %s\n", lib->lib, mathfuncs[fidx], error);
@@ -203,6 +227,97 @@ int open_mathlib(mathlib_t *lib)
 		return 0;
 }
 
+// Returns 1 if the functions of the current mathlib may be called by
+// several threads at once, as the mode blocks in matrix.c are.  Only the
+// builtin functions are known to be: OpenBLAS built without locking and
+// ATLAS are not, so the external libraries are called from one thread
+// and use their own threads, if they have them, instead:
+int mathlib_reentrant(void)
+{
+	return current_mathlib == NULL ||
+		current_mathlib->type == MATHLIB_NEC2 ||
+		current_mathlib->type == MATHLIB_BLOCKED;
+}
+
+// Returns the mathlib of the child processes: the one the autotuner picked
+// for this run if any, else the saved selection of the batch menu:
+int mathlib_batch_idx(void)
+{
+	return autotune_batch_idx >= 0 ? autotune_batch_idx : rc_config.mathlib_batch_idx;
+}
+
+// Closes the current mathlib and opens lib, with global_lock held so
+// that no frequency loop is running:
+static void mathlib_switch(mathlib_t *lib)
+{
+	close_mathlib(current_mathlib);
+	current_mathlib = lib;
+	open_mathlib(lib);
+}
+
+// Sets the number of threads of the current mathlib.  Returns 0 if the
+// library has no runtime setting for it, like ATLAS and the builtin NEC2
+// functions, or if threads < 1 to leave the library default:
+int mathlib_set_threads(int threads)
+{
+	void (*set_num_threads)(int);
+	char *fname;
+
+	if (threads < 1 || current_mathlib == NULL)
+		return 0;
+
+	if (current_mathlib->type == MATHLIB_BLOCKED)
+	{
+		Matrix_Lu_Set_Threads(threads);
+		pr_debug("%s: using %d threads\n", current_mathlib->name, threads);
+		return 1;
+	}
+
+	if (current_mathlib->handle == NULL)
+		return 0;
+
+	if (current_mathlib->type == MATHLIB_OPENBLAS)
+		fname = "openblas_set_num_threads";
+	else if (current_mathlib->type == MATHLIB_INTEL)
+		fname = "MKL_Set_Num_Threads";
+	else
+		return 0;
+
+	// Clear any error state
+	dlerror();
+
+	*(void **) (&set_num_threads) = dlsym(current_mathlib->handle, fname);
+	if (set_num_threads == NULL)
+	{
+		pr_debug("%s: no %s: %s\n", current_mathlib->name, fname, dlerror());
+		return 0;
+	}
+
+	set_num_threads(threads);
+	pr_debug("%s: using %d threads\n", current_mathlib->name, threads);
+
+	return 1;
+}
+
+// The first available library, but the builtin blocked LU
+// rather than the NEC2 functions before it in mathlibs[]:
+static int mathlib_default_idx(void)
+{
+	int libidx, nec2 = 0;
+
+	for (libidx = 0; libidx < num_mathlibs; libidx++)
+	{
+		if (!mathlibs[libidx].available)
+			continue;
+
+		if (mathlibs[libidx].type != MATHLIB_NEC2)
+			return libidx;
+
+		nec2 = libidx;
+	}
+
+	return nec2;
+}
 
 void init_mathlib(void)
 {
@@ -228,8 +343,8 @@ void init_mathlib(void)
 		// At this point the library load was successful, provide detail:
 		pr_notice("%s: loaded\n", mathlibs[libidx].name);
 
-		// Set the default to the first one we find:
-		if (current_mathlib == NULL)
+		// Set the default to the first one we find, see mathlib_default_idx():
+		if (current_mathlib == NULL || current_mathlib->type == MATHLIB_NEC2)
 			current_mathlib = &mathlibs[libidx];
 		else
 			// Otherwise close it for now and re-open on use.
@@ -237,20 +352,10 @@ void init_mathlib(void)
 	}
 
 	if (!mathlibs[rc_config.mathlib_idx].available)
-		for (libidx = 0; libidx < num_mathlibs; libidx++)
-			if (mathlibs[libidx].available)
-			{
-				set_mathlib_interactive(NULL, &mathlibs[libidx]);
-				break;
-			}
+		set_mathlib_interactive(NULL, &mathlibs[mathlib_default_idx()]);
 
 	if (!mathlibs[rc_config.mathlib_batch_idx].available)
-		for (libidx = 0; libidx < num_mathlibs; libidx++)
-			if (mathlibs[libidx].available)
-			{
-				rc_config.mathlib_batch_idx = libidx;
-				break;
-			}
+		rc_config.mathlib_batch_idx = mathlib_default_idx();
 
 }
 
@@ -302,6 +407,41 @@ int mathlib_config_benchmark_save(rc_config_vars_t *v, FILE *fp)
 	return 1;
 }
 
+// The autotuner table is saved as space separated size:jobs:idx:threads:usec
+// entries, the time is in microseconds so it does not depend on the locale:
+int mathlib_config_autotune_parse(rc_config_vars_t *v, char *line)
+{
+	mathlib_autotune_t a;
+	int len;
+
+	num_autotune = 0;
+	while (num_autotune < MATHLIB_AUTOTUNE_MAX &&
+		sscanf(line, "%d:%d:%d:%d:%d%n",
+			&a.size, &a.jobs, &a.idx, &a.threads, &a.usec, &len) == 5)
+	{
+		line += len;
+
+		// Drop entries of libraries that are no longer available:
+		if (a.size > 0 && a.jobs > 0 && a.idx >= 0 && a.idx < num_mathlibs &&
+			mathlibs[a.idx].available)
+			autotune[num_autotune++] = a;
+	}
+
+	return 1;
+}
+
+int mathlib_config_autotune_save(rc_config_vars_t *v, FILE *fp)
+{
+	int i;
+
+	for (i = 0; i < num_autotune; i++)
+		fprintf(fp, "%s%d:%d:%d:%d:%d", i ? " " : "",
+			autotune[i].size, autotune[i].jobs, autotune[i].idx,
+			autotune[i].threads, autotune[i].usec);
+
+	return 1;
+}
+
 
 
 /////////////////////////////////////////////////////////////////////
@@ -309,8 +449,10 @@ int mathlib_config_benchmark_save(rc_config_vars_t *v, FILE *fp)
 
 void set_mathlib_interactive(GtkWidget *widget, mathlib_t *lib)
 {
+#ifndef XNEC2C_BATCH
 	if (widget != NULL && !gtk_check_menu_item_get_active(GTK_CHECK_MENU_ITEM(widget)))
 		return;
+#endif
 
 	if (lib == NULL)
 	{
@@ -328,24 +470,23 @@ void set_mathlib_interactive(GtkWidget *widget, mathlib_t *lib)
 
 		// If the library is unavailable for some reason then clear the one that was
 		// just set and reset the active one:
+#ifndef XNEC2C_BATCH
 		if (!CHILD)
 		{
 			gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(widget), FALSE);
 			gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(current_mathlib->interactive_widget), TRUE);
 		}
+#endif
 		return;
 	}
 
 	if (g_mutex_trylock(&global_lock))
 	{
-		close_mathlib(current_mathlib);
-		current_mathlib = lib;
+		mathlib_switch(lib);
 
 		// Save selection on exit:
 		rc_config.mathlib_idx = current_mathlib->idx;
 
-		open_mathlib(lib);
-
 		g_mutex_unlock(&global_lock);
 	}
 	else
@@ -353,6 +494,9 @@ void set_mathlib_interactive(GtkWidget *widget, mathlib_t *lib)
 
 }
 
+// The menus and benchmarks below need the GUI:
+#ifndef XNEC2C_BATCH
+
 // Set batch mathlib, this will only be used by child processes so
 // don't close and reopen the mathlib:
 void set_mathlib_batch(GtkWidget *widget, mathlib_t *lib)
@@ -372,7 +516,21 @@ void set_mathlib_batch(GtkWidget *widget, mathlib_t *lib)
 			"(However, this selection will be saved for next time xnec2c is opened.)\n"),
 			GTK_BUTTONS_OK);
 
+	// The selection replaces the autotuner's pick for this run:
 	rc_config.mathlib_batch_idx = lib->idx;
+	autotune_batch_idx = -1;
+}
+
+// Shows lib as selected in a radio menu without calling callback,
+// which would save it as the user's selection:
+static void mathlib_menu_sync(GtkWidget *item, gpointer callback, mathlib_t *lib)
+{
+	if (CHILD || item == NULL)
+		return;
+
+	g_signal_handlers_block_by_func(item, callback, lib);
+	gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), TRUE);
+	g_signal_handlers_unblock_by_func(item, callback, lib);
 }
 
 void set_mathlib_benchmark(GtkWidget *widget, mathlib_t *lib)
@@ -487,6 +645,14 @@ void mathlib_help(void)
 		"* The selected \"Batch\" math library is used when -j is specified on the command line to fork "
 		"multiple jobs to run in parallel.\n"
 		"\n"
+		"* \"Builtin Blocked LU\" needs no library and is used if none is found. It is much faster than "
+		"the original \"NEC2 Gaussian Elimination\", and uses --fill-threads threads unless set by the "
+		"autotuner.\n"
+		"\n"
+		"* Run `xnec2c --autotune` to time each library with a few matrix sizes, jobs and threads. "
+		"The libraries, threads and number of jobs (up to -j) are then selected automatically "
+		"from the results when a .NEC file is opened.\n"
+		"\n"
 		"For Intel libraries, only one library can be selected at a time.  Once one of the Intel MKL "
 		"math libraries has been used for EM calculations the other Intel library options will be locked "
 		"until restart.  Since xnec2c remembers the previously selected library it may activate when a "
@@ -744,6 +910,8 @@ void mathlib_benchmark_nj(void)
 	mathlib_benchmark(MATHLIB_BENCHMARK_NJ);
 }
 
+#endif
+
 void mathlib_lock_intel(int locked_idx, int batch)
 {
 	static int warned = 0;
@@ -785,6 +953,7 @@ void mathlib_lock_intel(int locked_idx, int batch)
 		{
 			mathlibs[i].available = 0;
 
+#ifndef XNEC2C_BATCH
 			if (!CHILD)
 			{
 				if (mathlibs[i].interactive_widget != NULL && !batch)
@@ -800,6 +969,7 @@ void mathlib_lock_intel(int locked_idx, int batch)
 					gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(mathlibs[i].benchmark_widget), FALSE);
 				}
 			}
+#endif
 
 		}
 }
@@ -814,6 +984,349 @@ void mathlib_lock_intel_batch(int locked_idx)
 	mathlib_lock_intel(locked_idx, 1);
 }
 
+/////////////////////////////////////////////////////////////////////
+//                                                          AUTOTUNER
+
+// Runs in a process forked by mathlib_autotune_trial(): factors a matrix
+// of order n with lib and threads, repeatedly for MATHLIB_AUTOTUNE_TRIAL
+// seconds, and writes the time of one factorization to fd, or -1 if the
+// library or the number of threads could not be set.  A byte is written
+// to fd when ready, the factorizations start when start_fd is closed.
+static void mathlib_autotune_worker(mathlib_t *lib, int n, int threads, int start_fd, int fd)
+{
+	struct timespec t0, t1;
+	complex double *a = NULL, *a0 = NULL;
+	int32_t *ip = NULL;
+	size_t mreq = (size_t)n * (size_t)n * sizeof(complex double);
+	unsigned int seed = 1;
+	double elapsed = 0, t = -1;
+	int i, reps = 0, ok;
+	char c = 0;
+
+	set_mathlib_interactive(NULL, lib);
+	ok = (current_mathlib == lib) && (threads == 0 || mathlib_set_threads(threads));
+
+	if (ok)
+	{
+		mem_alloc((void **)&a, mreq, __LOCATION__);
+		mem_alloc((void **)&a0, mreq, __LOCATION__);
+		mem_alloc((void **)&ip, (size_t)n * sizeof(int32_t), __LOCATION__);
+
+		// A random matrix with a dominant diagonal, like interaction
+		// matrices it needs little pivoting:
+		for (i = 0; i < n * n; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			a0[i] = (double)((seed >> 16) & 0x7fff) / 16384.0 - 1.0;
+			seed = seed * 1103515245 + 12345;
+			a0[i] += I * ((double)((seed >> 16) & 0x7fff) / 16384.0 - 1.0);
+		}
+
+		for (i = 0; i < n; i++)
+			a0[i * n + i] += n;
+	}
+
+	if (write(fd, &c, 1) != 1 || read(start_fd, &c, 1) < 0)
+		_exit(1);
+
+	while (ok && (reps == 0 || elapsed < MATHLIB_AUTOTUNE_TRIAL))
+	{
+		memcpy(a, a0, mreq);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		ok = (zgetrf(CblasColMajor, n, n, a, n, ip) == 0);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		elapsed += (t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec)/1e9;
+		reps++;
+	}
+
+	if (ok)
+		t = elapsed / reps;
+
+	if (write(fd, &t, sizeof(t)) != sizeof(t))
+		_exit(1);
+
+	_exit(0);
+}
+
+// Times `jobs` processes factoring a matrix of order n at the same time with
+// lib and threads, as -j jobs would.  Returns the time of the slowest one
+// for one factorization, in seconds, or -1 if the trial failed.
+static double mathlib_autotune_trial(mathlib_t *lib, int n, int jobs, int threads)
+{
+	int start[2], res[2], i, num = 0, ok = 1;
+	pid_t *pids = NULL;
+	double t, slowest = 0;
+	char c;
+
+	if (pipe(start) < 0)
+	{
+		pr_err("pipe(): %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (pipe(res) < 0)
+	{
+		pr_err("pipe(): %s\n", strerror(errno));
+		close(start[0]);
+		close(start[1]);
+		return -1;
+	}
+
+	mem_alloc((void **)&pids, (size_t)jobs * sizeof(pid_t), __LOCATION__);
+
+	fflush(stdout);
+	fflush(stderr);
+	for (num = 0; num < jobs; num++)
+	{
+		pids[num] = fork();
+		if (pids[num] < 0)
+		{
+			pr_err("fork(): %s\n", strerror(errno));
+			ok = 0;
+			break;
+		}
+
+		if (pids[num] == 0)
+		{
+			close(start[1]);
+			close(res[0]);
+			mathlib_autotune_worker(lib, n, threads, start[0], res[1]);
+		}
+	}
+
+	close(start[0]);
+	close(res[1]);
+
+	// Start all the workers together once they are ready.  Writes of a
+	// double to a pipe are atomic, so the results do not interleave:
+	for (i = 0; i < num; i++)
+		if (read(res[0], &c, 1) != 1)
+			ok = 0;
+	close(start[1]);
+
+	for (i = 0; i < num; i++)
+	{
+		if (read(res[0], &t, sizeof(t)) != sizeof(t) || t < 0)
+			ok = 0;
+		else if (t > slowest)
+			slowest = t;
+	}
+	close(res[0]);
+
+	for (i = 0; i < num; i++)
+		waitpid(pids[i], NULL, 0);
+	free_ptr((void **)&pids);
+
+	return ok ? slowest : -1;
+}
+
+// Keeps the result of a trial in the autotuner table if it is the fastest
+// for its size and number of jobs:
+static void mathlib_autotune_add(int size, int jobs, mathlib_t *lib, int threads, double t)
+{
+	int i, usec = (int)(t * 1e6 + 0.5);
+
+	for (i = 0; i < num_autotune; i++)
+		if (autotune[i].size == size && autotune[i].jobs == jobs)
+			break;
+
+	if (i == MATHLIB_AUTOTUNE_MAX)
+		return;
+
+	if (i == num_autotune)
+		num_autotune++;
+	else if (autotune[i].usec <= usec)
+		return;
+
+	autotune[i].size = size;
+	autotune[i].jobs = jobs;
+	autotune[i].idx = lib->idx;
+	autotune[i].threads = threads;
+	autotune[i].usec = usec;
+}
+
+// Runs short trials of the factorization of matrices of the orders in
+// MATHLIB_AUTOTUNE_SIZES with each available mathlib, forked into 1, 2, 4...
+// up to one job per CPU and with the CPUs left shared between the BLAS
+// threads of the jobs, or one thread each.  The fastest combination for
+// each size and number of jobs replaces the autotuner table, which
+// mathlib_autotune_select() uses when a structure is read.  Only the
+// first available Intel MKL library is tried, see mathlib_lock_intel().
+void mathlib_autotune(void)
+{
+	struct sigaction sa_new, sa_old;
+	int sizes[] = MATHLIB_AUTOTUNE_SIZES;
+	int num_sizes = sizeof(sizes) / sizeof(int);
+	int ncpu = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	double mem = (double)sysconf(_SC_PHYS_PAGES) * (double)sysconf(_SC_PAGESIZE) / 2;
+	int slow[num_mathlibs], no_threads[num_mathlibs];
+	int s, l, n, jobs, threads, intel = -1;
+	double t;
+
+	if (ncpu < 1)
+		ncpu = 1;
+
+	// Workers are waited for here, the SIGCHLD handler is for -j jobs:
+	memset(&sa_new, 0, sizeof(sa_new));
+	sa_new.sa_handler = SIG_DFL;
+	sigaction(SIGCHLD, &sa_new, &sa_old);
+
+	for (l = 0; l < num_mathlibs; l++)
+	{
+		slow[l] = 0;
+		no_threads[l] = mathlibs[l].type == MATHLIB_ATLAS || mathlibs[l].type == MATHLIB_NEC2;
+
+		if (intel < 0 && mathlibs[l].available && mathlibs[l].type == MATHLIB_INTEL)
+			intel = l;
+	}
+
+	num_autotune = 0;
+	for (s = 0; s < num_sizes; s++)
+	{
+		n = sizes[s];
+		for (l = 0; l < num_mathlibs; l++)
+		{
+			if (!mathlibs[l].available || slow[l] ||
+				(mathlibs[l].type == MATHLIB_INTEL && l != intel))
+				continue;
+
+			for (jobs = 1; jobs <= ncpu; jobs = (jobs < ncpu && jobs * 2 > ncpu) ? ncpu : jobs * 2)
+			{
+				// Each worker keeps two copies of the matrix:
+				if (jobs * 2.0 * n * n * sizeof(complex double) > mem)
+					break;
+
+				// Share the CPUs between the jobs, then try one thread each:
+				threads = no_threads[l] ? 0 : ncpu / jobs;
+				while (1)
+				{
+					t = mathlib_autotune_trial(&mathlibs[l], n, jobs, threads);
+
+					// Retry with the library default if threads cannot be set:
+					if (t < 0 && threads > 0)
+					{
+						no_threads[l] = 1;
+						threads = 0;
+						continue;
+					}
+
+					if (t < 0)
+						pr_err("%s: autotune trial failed (N=%d, -j %d)\n",
+							mathlibs[l].name, n, jobs);
+					else
+					{
+						pr_notice("%s: N=%d, -j %d, %d threads: %f seconds\n",
+							mathlibs[l].name, n, jobs, threads, t);
+						mathlib_autotune_add(n, jobs, &mathlibs[l], threads, t);
+
+						// Do not try the next size if it would take too long, O(N^3):
+						if (jobs == 1 && s + 1 < num_sizes &&
+							t * pow((double)sizes[s + 1] / n, 3) > MATHLIB_AUTOTUNE_MAX_TIME)
+							slow[l] = 1;
+					}
+
+					if (threads <= 1)
+						break;
+
+					threads = 1;
+				}
+
+				if (jobs == ncpu)
+					break;
+			}
+		}
+	}
+
+	sigaction(SIGCHLD, &sa_old, NULL);
+
+	for (l = 0; l < num_autotune; l++)
+		pr_notice("Autotune N=%-5d -j %-3d %s, %d threads: %f seconds\n",
+			autotune[l].size, autotune[l].jobs, mathlibs[autotune[l].idx].name,
+			autotune[l].threads, autotune[l].usec / 1e6);
+}
+
+// Selects the mathlibs, BLAS threads and number of jobs that the autotuner
+// found fastest for a structure with a matrix of order size and a sweep of
+// steps frequency steps.  The trials of the nearest size are used: the
+// interactive mathlib is the fastest with one job, and the batch mathlib
+// the one that gets through the steps fastest with at most -j jobs.
+// The picks are for this run only, the selections saved in rc_config are
+// kept, and the menus show them.  Called with global_lock held.
+void mathlib_autotune_select(int size, int steps)
+{
+	mathlib_autotune_t *best = NULL, *best1 = NULL, *a;
+	double d, dmin = 0, cost, best_cost = 0;
+	int i, near = 0;
+	int max_jobs = FORKED ? num_child_procs : 1;
+
+	if (num_autotune == 0 || size < 1)
+		return;
+
+	if (steps < 1)
+		steps = 1;
+
+	// The nearest size of the trials, on a log scale as the time is O(N^3):
+	for (i = 0; i < num_autotune; i++)
+	{
+		d = fabs(log((double)autotune[i].size / size));
+		if (i == 0 || d < dmin)
+		{
+			dmin = d;
+			near = autotune[i].size;
+		}
+	}
+
+	for (i = 0; i < num_autotune; i++)
+	{
+		a = &autotune[i];
+		if (a->size != near || !mathlibs[a->idx].available)
+			continue;
+
+		if (a->jobs == 1 && (best1 == NULL || a->usec < best1->usec))
+			best1 = a;
+
+		if (a->jobs > max_jobs)
+			continue;
+
+		// The steps are solved `jobs` at a time:
+		cost = (double)((steps + a->jobs - 1) / a->jobs) * a->usec;
+		if (best == NULL || cost < best_cost)
+		{
+			best = a;
+			best_cost = cost;
+		}
+	}
+
+	if (best1 != NULL)
+	{
+		if (current_mathlib != &mathlibs[best1->idx])
+			mathlib_switch(&mathlibs[best1->idx]);
+		mathlib_set_threads(best1->threads);
+#ifndef XNEC2C_BATCH
+		mathlib_menu_sync(current_mathlib->interactive_widget,
+			(gpointer)set_mathlib_interactive, current_mathlib);
+#endif
+		pr_info("Autotune N=%d: %s, %d threads\n",
+			size, mathlibs[best1->idx].name, best1->threads);
+	}
+
+	if (FORKED && best != NULL)
+	{
+		autotune_batch_idx = best->idx;
+		rc_config.mathlib_batch_threads = best->threads;
+		calc_data.num_jobs = best->jobs;
+#ifndef XNEC2C_BATCH
+		mathlib_menu_sync(mathlibs[best->idx].batch_widget,
+			(gpointer)set_mathlib_batch, &mathlibs[best->idx]);
+#endif
+
+		pr_info("Autotune N=%d, %d steps: %s, -j %d, %d threads\n",
+			size, steps, mathlibs[best->idx].name, best->jobs, best->threads);
+	}
+}
+
 void *mathlib_get_func(int f_idx)
 {
 	// Intel libraries can only be set once, so lock it:
@@ -856,6 +1369,8 @@ int32_t zgetrf(int32_t order, int32_t m, int32_t n, complex double *a, int32_t n
 		// use the original NEC2 function
 		return factr_gauss_elim(n, a, (int32_t*)ip, ndim);
 	}
+	else if (current_mathlib->type == MATHLIB_BLOCKED)
+		return Matrix_Lu_Factor(m, n, a, ndim, (int32_t*)ip);
 	else
 		BUG("%s: unsupported mathlib type %d\n", __func__,
 			current_mathlib->type);
@@ -894,12 +1409,208 @@ int32_t zgetrs(int32_t order, int32_t trans, int32_t lda, int32_t nrhs,
 	}
 	else if (current_mathlib->type == MATHLIB_NEC2)
 	{
-		if (lda != ldb)
-			BUG("zgetrs warning: lda(%d) != ldb(%d)\n", lda,
-				ldb);
+		int32_t r, info = 0;
 
-		// use the original NEC2 function
-		return solve_gauss_elim(lda, a, (int32_t*)ip, b, ndim);
+		// use the original NEC2 function, one right hand side at a time
+		for (r = 0; r < nrhs && info == 0; r++)
+			info = solve_gauss_elim(lda, a, (int32_t*)ip, &b[(size_t)r * ldb], ndim);
+
+		return info;
+	}
+	else if (current_mathlib->type == MATHLIB_BLOCKED)
+	{
+		if (trans != CblasNoTrans)
+			BUG("zgetrs: the builtin blocked solver does not transpose\n");
+
+		return Matrix_Lu_Solve(lda, nrhs, a, ndim, (int32_t*)ip, b, ldb);
+	}
+	else
+		BUG("%s: unsupported mathlib type %d\n", __func__,
+			current_mathlib->type);
+
+	return 1;
+}
+
+// Builtin single precision LU factorization with partial pivoting, used by
+// cgetrf() if the library has none. Pivots are 1-based, as from LAPACK.
+static int32_t cgetrf_builtin(int32_t n, complex float *a, int32_t ndim, int32_t *ip)
+{
+	int32_t i, j, k, p, info = 0;
+	float amax, mag;
+	complex float t, *ak, *aj;
+
+	for (k = 0; k < n; k++)
+	{
+		ak = &a[k * ndim];
+
+		// Pivot row:
+		p = k;
+		amax = 0.0f;
+		for (i = k; i < n; i++)
+		{
+			mag = fabsf(crealf(ak[i])) + fabsf(cimagf(ak[i]));
+			if (mag > amax)
+			{
+				amax = mag;
+				p = i;
+			}
+		}
+		ip[k] = p + 1;
+
+		if (amax == 0.0f)
+		{
+			if (info == 0)
+				info = k + 1;
+			continue;
+		}
+
+		if (p != k)
+			for (j = 0; j < n; j++)
+			{
+				t = a[k + j * ndim];
+				a[k + j * ndim] = a[p + j * ndim];
+				a[p + j * ndim] = t;
+			}
+
+		t = 1.0f / ak[k];
+		for (i = k + 1; i < n; i++)
+			ak[i] *= t;
+
+		// Update the trailing columns, the inner loop is contiguous:
+		for (j = k + 1; j < n; j++)
+		{
+			aj = &a[j * ndim];
+			t = aj[k];
+			if (t == 0.0f)
+				continue;
+			for (i = k + 1; i < n; i++)
+				aj[i] -= ak[i] * t;
+		}
+	}
+
+	return info;
+}
+
+// Solves with the factors of cgetrf_builtin()
+static int32_t cgetrs_builtin(int32_t n, int32_t nrhs, complex float *a, int32_t ndim,
+	int32_t *ip, complex float *b, int32_t ldb)
+{
+	int32_t i, k, r;
+	complex float t, *ak, *br;
+
+	for (r = 0; r < nrhs; r++)
+	{
+		br = &b[r * ldb];
+
+		// Row interchanges and forward substitution with the unit lower L:
+		for (k = 0; k < n; k++)
+		{
+			if (ip[k] - 1 != k)
+			{
+				t = br[k];
+				br[k] = br[ip[k] - 1];
+				br[ip[k] - 1] = t;
+			}
+		}
+
+		for (k = 0; k < n; k++)
+		{
+			ak = &a[k * ndim];
+			t = br[k];
+			for (i = k + 1; i < n; i++)
+				br[i] -= ak[i] * t;
+		}
+
+		// Backward substitution with U:
+		for (k = n - 1; k >= 0; k--)
+		{
+			ak = &a[k * ndim];
+			br[k] /= ak[k];
+			t = br[k];
+			for (i = 0; i < k; i++)
+				br[i] -= ak[i] * t;
+		}
+	}
+
+	return 0;
+}
+
+// The library's single precision functions are used only if it has both,
+// as the pivots of one may not suit the other:
+static int mathlib_have_cgetrf(void)
+{
+	return mathlib_get_func(MATHLIB_CGETRF) != NULL &&
+		mathlib_get_func(MATHLIB_CGETRS) != NULL;
+}
+
+int32_t cgetrf(int32_t order, int32_t m, int32_t n, complex float *a, int32_t ndim, int32_t *ip)
+{
+	if (current_mathlib == NULL)
+	{
+		BUG("cgetrf: current_mathlib is NULL, this should never happen.\n");
+		return 1;
+	}
+
+	if (!mathlib_have_cgetrf())
+		return cgetrf_builtin(n, a, ndim, ip);
+
+	void *f_ptr = mathlib_get_func(MATHLIB_CGETRF);
+
+	if (current_mathlib->type == MATHLIB_ATLAS)
+	{
+		cgetrf_atlas_t *f;
+
+		*(void**)(&f) = f_ptr;
+		return f(order, m, n, a, ndim, (int32_t*)ip);
+	}
+	else if (current_mathlib->type == MATHLIB_OPENBLAS || current_mathlib->type == MATHLIB_INTEL)
+	{
+		cgetrf_openblas_t *f;
+
+		*(void**)(&f) = f_ptr;
+		return f(order, m, n, a, ndim, (int32_t*)ip);
+	}
+	else
+		BUG("%s: unsupported mathlib type %d\n", __func__,
+			current_mathlib->type);
+
+	return 1;
+}
+
+int32_t cgetrs(int32_t order, int32_t trans, int32_t lda, int32_t nrhs,
+	complex float *a, int32_t ndim, int32_t *ip, complex float *b, int32_t ldb)
+{
+	if (current_mathlib == NULL)
+	{
+		BUG("cgetrs: current_mathlib is NULL, this should never happen.\n");
+		return 1;
+	}
+
+	if (!mathlib_have_cgetrf())
+	{
+		if (trans != CblasNoTrans)
+			BUG("cgetrs: the builtin solver does not transpose\n");
+
+		return cgetrs_builtin(lda, nrhs, a, ndim, ip, b, ldb);
+	}
+
+	void *f_ptr = mathlib_get_func(MATHLIB_CGETRS);
+
+	if (current_mathlib->type == MATHLIB_ATLAS)
+	{
+		cgetrs_atlas_t *f;
+
+		*(void**)(&f) = f_ptr;
+		return f(order, trans, lda, nrhs, a, ndim, (int32_t*)ip, b, ldb);
+	}
+	else if (current_mathlib->type == MATHLIB_OPENBLAS || current_mathlib->type == MATHLIB_INTEL)
+	{
+		cgetrs_openblas_t *f;
+
+		*(void**)(&f) = f_ptr;
+		return f(order,
+			(trans) == CblasConjTrans ? 'C' : ((trans) == CblasTrans ? 'T' : 'N'),
+			lda, nrhs, a, ndim, (int32_t*)ip, b, ldb);
 	}
 	else
 		BUG("%s: unsupported mathlib type %d\n", __func__,
@@ -24,14 +24,30 @@ enum MATHLIB_TYPES {
 	MATHLIB_ATLAS,
 	MATHLIB_OPENBLAS,
 	MATHLIB_INTEL,
-	MATHLIB_NEC2
+	MATHLIB_NEC2,
+	MATHLIB_BLOCKED
 };
 
 enum MATHLIB_FUNCTIONS {
 	MATHLIB_ZGETRF, 
 	MATHLIB_ZGETRS,
+
+	// Optional, the builtin single precision LU is used if missing:
+	MATHLIB_CGETRF,
+	MATHLIB_CGETRS,
 };
 
+// Matrix orders of the autotuner trials, see mathlib_autotune():
+#define MATHLIB_AUTOTUNE_SIZES     { 200, 500, 1000, 2000 }
+
+// Seconds to repeat the factorization of each trial for, and the longest
+// expected time of a single factorization for a larger size to be tried:
+#define MATHLIB_AUTOTUNE_TRIAL     0.25
+#define MATHLIB_AUTOTUNE_MAX_TIME  2.0
+
+// Most entries in the autotuner table:
+#define MATHLIB_AUTOTUNE_MAX       64
+
 enum MATHLIB_BENCHMARKS
 {
 	MATHLIB_BENCHMARK_PARALLEL,
@@ -81,7 +97,20 @@ typedef struct mathlib_t
 } mathlib_t;
 
 
+// An entry in the autotuner table: the fastest library and number of
+// BLAS threads for `jobs` jobs factoring a matrix of order `size` at the
+// same time, and the time in microseconds that they took.
+typedef struct mathlib_autotune_t
+{
+	int size, jobs;
+	int idx, threads;
+	int usec;
+} mathlib_autotune_t;
+
+
 void init_mathlib(void);
+int mathlib_reentrant(void);
+int mathlib_batch_idx(void);
 void init_mathlib_menu(void);
 mathlib_t *get_mathlib_by_idx(int idx);
 void set_mathlib_interactive(GtkWidget *widget, mathlib_t *lib);
@@ -92,6 +121,12 @@ void mathlib_lock_intel_batch(int locked_idx);
 void mathlib_config_init(rc_config_vars_t *v, char *line);
 int mathlib_config_benchmark_parse(rc_config_vars_t *v, char *line);
 int mathlib_config_benchmark_save(rc_config_vars_t *v, FILE *fp);
+int mathlib_config_autotune_parse(rc_config_vars_t *v, char *line);
+int mathlib_config_autotune_save(rc_config_vars_t *v, FILE *fp);
+
+int mathlib_set_threads(int threads);
+void mathlib_autotune(void);
+void mathlib_autotune_select(int size, int steps);
 
 void mathlib_mkl_set_threading_intel(mathlib_t *lib);
 void mathlib_mkl_set_threading_sequential(mathlib_t *lib);
@@ -104,8 +139,16 @@ typedef int32_t (zgetrf_openblas_t)(int32_t, int32_t, int32_t, complex double *,
 typedef int32_t (zgetrs_atlas_t)(int32_t, int32_t, int32_t, int32_t, complex double *, int32_t, int32_t*, complex double *, int32_t);
 typedef int32_t (zgetrs_openblas_t)(int32_t, char, int32_t, int32_t, complex double *, int32_t, int32_t*, complex double *, int32_t);
 
+typedef int32_t (cgetrf_atlas_t)(int32_t, int32_t, int32_t, complex float *, int32_t, int32_t*);
+typedef int32_t (cgetrf_openblas_t)(int32_t, int32_t, int32_t, complex float *, int32_t, int32_t*);
+
+typedef int32_t (cgetrs_atlas_t)(int32_t, int32_t, int32_t, int32_t, complex float *, int32_t, int32_t*, complex float *, int32_t);
+typedef int32_t (cgetrs_openblas_t)(int32_t, char, int32_t, int32_t, complex float *, int32_t, int32_t*, complex float *, int32_t);
+
 
 int32_t zgetrf(int32_t order, int32_t m, int32_t n, complex double *a, int32_t ndim, int32_t *ip);
 int32_t zgetrs(int32_t order, int32_t trans, int32_t lda, int32_t nrhs, complex double *a, int32_t ndim, int32_t *ip, complex double *b, int32_t ldb);
+int32_t cgetrf(int32_t order, int32_t m, int32_t n, complex float *a, int32_t ndim, int32_t *ip);
+int32_t cgetrs(int32_t order, int32_t trans, int32_t lda, int32_t nrhs, complex float *a, int32_t ndim, int32_t *ip, complex float *b, int32_t ldb);
 
 extern mathlib_t *current_mathlib;
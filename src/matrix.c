@@ -45,6 +45,27 @@
 #include "matrix.h"
 #include "shared.h"
 #include "mathlib.h"
+#include <float.h>
+#include <pthread.h>
+
+/*-------------------------------------------------------------------*/
+
+/* Cm_Source()
+ *
+ * Offset in a matrix filled in column major order, of leading
+ * dimension nr, of the element of source equation jx (from 0)
+ * for the first observation row. The sources of each symmetric
+ * part of the structure are the columns of a square block, below
+ * the block of the previous part, so that the mode blocks combined
+ * from them are ready for the LU factorization without a transpose
+ */
+  static inline size_t
+Cm_Source( int jx, int nr )
+{
+  int npeq = data.np + 2 * data.mp;
+
+  return( (size_t)((jx / npeq) * npeq) + (size_t)(jx % npeq) * (size_t)nr );
+} /* Cm_Source() */
 
 /*-------------------------------------------------------------------*/
 
@@ -65,10 +86,9 @@ cmss( int j1, int j2, int im1, int im2,
     ii1=-3;
 
   /* loop over observation patches */
-  il = -1;
   for( i = i1; i <= i2; i++ )
   {
-    il++;
+    il = i-1;
     icomp += 2;
     ii1 += 2;
     ii2 = ii1+1;
@@ -228,7 +248,7 @@ cmws( int j, int i1, int i2, complex double *cmx,
       for( ij = 0; ij < segj.jsno; ij++ )
       {
         jx= segj.jco[ij]-1;
-        cmx[ipr+jx*nr] += etk* segj.ax[ij] +
+        cmx[ipr+Cm_Source(jx, nr)] += etk* segj.ax[ij] +
           ets* segj.bx[ij]+ etc* segj.cx[ij];
       }
 
@@ -439,7 +459,7 @@ cmww( int j, int i1, int i2, complex double *cmx,
       for( ij = 0; ij < segj.jsno; ij++ )
       {
         jx = segj.jco[ij]-1;
-        cmx[ipr+jx*nr] += etk* segj.ax[ij] +
+        cmx[ipr+Cm_Source(jx, nr)] += etk* segj.ax[ij] +
           ets* segj.bx[ij]+ etc* segj.cx[ij];
       }
       continue;
@@ -480,31 +500,50 @@ cmww( int j, int i1, int i2, complex double *cmx,
 
 /*-----------------------------------------------------------------------*/
 
-/* cmset sets up the complex structure matrix in the array cm */
-  void
-cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
+/* cmset_block fills observations i1 to i2 of the complex */
+/* structure matrix into cmb. If trans, they are columns of */
+/* the matrix transposed, as in NEC2, and cmb points to column */
+/* i1. Else they are rows of the column major matrix of each */
+/* symmetric part, see Cm_Source(), and cmb points to row i1. */
+/* Blocks are independent so that they can be filled */
+/* concurrently by the cmset() threads. scm is scratch memory */
+/* for nrow elements, owned by the thread */
+  static void
+cmset_block( int nrow, complex double *cmb, int i1, int i2,
+    complex double *scm, gboolean trans )
 {
-  int mp2, neq, npeq, it, i, j, i1, i2, in2, im1;
-  int im2, ist, ij, ipr, jss, jm1, jm2, jst, k, ka, kk;
-  complex double zaj, deter, *scm = NULL;
+  int mp2, npeq, i, j, in2, im1, im2, ist, itrp, len, ncol;
+  int ij, ipr, jss, jm1, jm2, jst, k, kk;
+  size_t ldo, jof;
+  complex double zaj, ssx, *cmk, *scmk;
 
   mp2=2* data.mp;
   npeq= data.np+ mp2;
-  neq= data.n+2* data.m;
-  smat.nop = neq/npeq;
 
-  dataj.rkh= rkhx;
-  dataj.iexk= iexkx;
-  it= matpar.nlast;
+  /* itrp is the fill of cmww() etc, ldo the stride between */
+  /* observations, and the symmetry modes are combined from */
+  /* len elements of each submatrix in ncol columns */
+  if( trans )
+  {
+    itrp= 1;
+    ldo = (size_t)nrow;
+    len = npeq;
+    ncol= i2- i1+ 1;
+  }
+  else
+  {
+    itrp= 0;
+    ldo = 1;
+    len = i2- i1+ 1;
+    ncol= npeq;
+  }
 
-  for( i = 0; i < nrow; i++ )
-    for( j = 0; j < it; j++ )
-      cmx[i+j*nrow]= CPLX_00;
+  for( j = 0; j < ncol; j++ )
+    for( kk = 0; kk < smat.nop; kk++ )
+      for( i = 0; i < len; i++ )
+        cmb[kk*npeq+i+j*nrow]= CPLX_00;
 
-  i1= 1;
-  i2= it;
   in2= i2;
-
   if( in2 > data.np)
     in2= data.np;
 
@@ -531,10 +570,10 @@ cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
       }
 
       if( i1 <= in2)
-        cmww( j, i1, in2, cmx, nrow, cmx, nrow,1);
+        cmww( j, i1, in2, cmb, nrow, cmb, nrow, itrp);
 
       if( im1 <= im2)
-        cmws( j, im1, im2, &cmx[(ist-1)*nrow], nrow, cmx, 1);
+        cmws( j, im1, im2, &cmb[(size_t)(ist-1)*ldo], nrow, cmb, itrp);
 
       /* matrix elements modified by loading */
       if( zload.nload == 0)
@@ -544,7 +583,7 @@ cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
         continue;
 
       ipr= j;
-      if( (ipr < 1) || (ipr > it) )
+      if( (ipr < i1) || (ipr > i2) )
         continue;
 
       zaj= zload.zarray[j-1];
@@ -552,7 +591,11 @@ cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
       for( i = 0; i < segj.jsno; i++ )
       {
         jss= segj.jco[i];
-        cmx[(jss-1)+(ipr-1)*nrow] -=
+        if( trans )
+          jof= (size_t)(jss-1);
+        else
+          jof= Cm_Source( jss-1, nrow );
+        cmb[jof+(size_t)(ipr-i1)*ldo] -=
           ( segj.ax[i]+ segj.cx[i])* zaj;
       }
 
@@ -573,13 +616,18 @@ cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
       jm2 += data.mp;
       jst += npeq;
 
+      if( trans )
+        jof= (size_t)(jst-1);
+      else
+        jof= Cm_Source( jst-1, nrow );
+
       if( i1 <= in2)
         cmsw( jm1, jm2, i1, in2,
-            &cmx[(jst-1)], cmx, 0, nrow, 1);
+            &cmb[jof], cmb, 0, nrow, itrp);
 
       if( im1 <= im2)
         cmss( jm1, jm2, im1, im2,
-            &cmx[(jst-1)+(ist-1)*nrow], nrow, 1);
+            &cmb[jof+(size_t)(ist-1)*ldo], nrow, itrp);
     }
 
   } /* if( m != 0) */
@@ -587,64 +635,228 @@ cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
   if( matpar.icase == 1)
     return;
 
-  /* Allocate to scratch memory */
-  size_t mreq = (size_t)data.np2m * sizeof(complex double);
-  mem_alloc( (void **)&scm, mreq, "in matrix.c");
-
-  /* combine elements for symmetry modes */
-  for( i = 0; i < it; i++ )
+  /* combine elements for symmetry modes. The len elements of */
+  /* each submatrix in a column are copied to scm and each mode */
+  /* is summed from them, so that the inner loops run over */
+  /* contiguous rows and can be vectorized */
+  for( i = 0; i < ncol; i++ )
   {
-    for( j = 0; j < npeq; j++ )
+    cmk= &cmb[i*nrow];
+    for( kk = 0; kk < smat.nop; kk++ )
+      memcpy( &scm[kk*len], &cmk[kk*npeq],
+          (size_t)len * sizeof(complex double) );
+
+    /* mode 0 is the sum of the submatrices */
+    for( kk = 1; kk < smat.nop; kk++ )
     {
-      for( k = 0; k < smat.nop; k++ )
+      scmk= &scm[kk*len];
+      for( j = 0; j < len; j++ )
+        cmk[j] += scmk[j];
+    }
+
+    for( k = 1; k < smat.nop; k++ )
+    {
+      cmk= &cmb[k*npeq+i*nrow];
+
+      for( j = 0; j < len; j++ )
+        cmk[j]= scm[j];
+
+      for( kk = 1; kk < smat.nop; kk++ )
       {
-        ka= j+ k*npeq;
-        scm[k]= cmx[ka+i*nrow];
+        ssx= smat.ssx[k+kk*smat.nop];
+        scmk= &scm[kk*len];
+        for( j = 0; j < len; j++ )
+          cmk[j] += scmk[j]* ssx;
       }
 
-      deter= scm[0];
+    } /* for( k = 1; k < smat.nop; k++ ) */
 
-      for( kk = 1; kk < smat.nop; kk++ )
-        deter += scm[kk];
+  } /* for( i = 0; i < ncol; i++ ) */
 
-      cmx[j+i*nrow]= deter;
+  return;
+}
 
-      for( k = 1; k < smat.nop; k++ )
-      {
-        ka= j+ k*npeq;
-        deter= scm[0];
+/*-----------------------------------------------------------------------*/
 
-        for( kk = 1; kk < smat.nop; kk++ )
-        {
-          deter += scm[kk]* smat.ssx[k+kk*smat.nop];
-          cmx[ka+i*nrow]= deter;
-        }
+/* Fill_Chunks()
+ *
+ * Takes chunks of observations from the fill job and
+ * fills them until all observations of the matrix are done
+ */
+  static void
+Fill_Chunks( fill_job_t *job, complex double *scm )
+{
+  complex double *cmb;
+  int i1, i2;
+
+  while( TRUE )
+  {
+    i1 = g_atomic_int_add( &job->next, job->chunk );
+    if( i1 > job->it )
+      break;
+
+    i2 = i1 + job->chunk - 1;
+    if( i2 > job->it )
+      i2 = job->it;
 
-      } /* for( k = 1; k < smat.nop; k++ ) */
+    if( job->trans )
+      cmb = &job->cmx[(size_t)(i1 - job->first) * (size_t)job->nrow];
+    else
+      cmb = &job->cmx[i1 - job->first];
+    cmset_block( job->nrow, cmb, i1, i2, scm, job->trans );
+  }
 
-    } /* for( j = 0; j < npeq; j++ ) */
+} /* Fill_Chunks() */
+
+/*-----------------------------------------------------------------------*/
 
-  } /* for( i = 0; i < it; i++ ) */
+/* Fill_Thread()
+ *
+ * Entry point of the cmset() fill threads. Each thread points the
+ * source segment commons at its own copy of the caller's state
+ */
+  static void *
+Fill_Thread( void *arg )
+{
+  fill_job_t *job = (fill_job_t *)arg;
+  dataj_t dataj_thr = job->caller_dataj;
+  segj_t  segj_thr  = job->caller_segj;
+  incom_t incom_thr = job->caller_incom;
+  gwav_t  gwav_thr  = job->caller_gwav;
+  complex double *scm = NULL;
+  size_t mreq;
+
+  /* Private connection buffers, trio() grows them as needed */
+  segj_thr.jco = NULL;
+  segj_thr.ax  = NULL;
+  segj_thr.bx  = NULL;
+  segj_thr.cx  = NULL;
+  mreq = (size_t)segj_thr.maxcon * sizeof(int);
+  mem_alloc( (void **)&segj_thr.jco, mreq, "in matrix.c" );
+  mreq = (size_t)segj_thr.maxcon * sizeof(double);
+  mem_alloc( (void **)&segj_thr.ax, mreq, "in matrix.c" );
+  mem_alloc( (void **)&segj_thr.bx, mreq, "in matrix.c" );
+  mem_alloc( (void **)&segj_thr.cx, mreq, "in matrix.c" );
+
+  /* Scratch memory for combining symmetry modes */
+  mreq = (size_t)job->nrow * sizeof(complex double);
+  mem_alloc( (void **)&scm, mreq, "in matrix.c" );
+
+  dataj_p = &dataj_thr;
+  segj_p  = &segj_thr;
+  incom_p = &incom_thr;
+  gwav_p  = &gwav_thr;
+
+  Fill_Chunks( job, scm );
 
   free_ptr( (void **)&scm );
+  free_ptr( (void **)&segj_thr.jco );
+  free_ptr( (void **)&segj_thr.ax );
+  free_ptr( (void **)&segj_thr.bx );
+  free_ptr( (void **)&segj_thr.cx );
+
+  return( NULL );
+} /* Fill_Thread() */
+
+/*-----------------------------------------------------------------------*/
+
+/* cmset_columns fills observations i1 to i2 of the complex */
+/* structure matrix into cmx, from its first column if trans */
+/* or else from its first row, see cmset_block() */
+  void
+cmset_columns( int nrow, complex double *cmx, int i1, int i2,
+    double rkhx, int iexkx, gboolean trans )
+{
+  int mp2, neq, npeq, it, nthr, idx;
+  pthread_t *thrd = NULL;
+  fill_job_t job;
+
+  /* Scratch memory of the calling thread, kept between calls */
+  static complex double *scm = NULL;
+
+  mp2=2* data.mp;
+  npeq= data.np+ mp2;
+  neq= data.n+2* data.m;
+  smat.nop = neq/npeq;
+
+  dataj.rkh= rkhx;
+  dataj.iexk= iexkx;
+  it= i2- i1+ 1;
+
+  size_t mreq = (size_t)nrow * sizeof(complex double);
+  mem_realloc( (void **)&scm, mreq, "in matrix.c" );
+
+  nthr = rc_config.fill_threads;
+  if( nthr > it )
+    nthr = it;
+
+  if( nthr <= 1 )
+  {
+    cmset_block( nrow, cmx, i1, i2, scm, trans );
+    return;
+  }
+
+  /* Snapshot of the caller's state, taken before it is
+   * modified by the calling thread's own share of the fill */
+  job.nrow  = nrow;
+  job.first = i1;
+  job.it    = i2;
+  job.cmx   = cmx;
+  job.trans = trans;
+  job.caller_dataj = dataj;
+  job.caller_segj  = segj;
+  job.caller_incom = incom;
+  job.caller_gwav  = gwav;
+
+  /* Several chunks per thread balance wire and patch columns */
+  job.next  = i1;
+  job.chunk = it / (nthr * FILL_CHUNKS_PER_THREAD);
+  if( job.chunk < 1 )
+    job.chunk = 1;
+
+  /* Rows of different threads should not share cache lines */
+  if( !trans )
+    job.chunk = (job.chunk + FILL_CHUNK_ROWS - 1) & ~(FILL_CHUNK_ROWS - 1);
+
+  /* The calling thread fills too, so start one thread less */
+  mreq = (size_t)(nthr-1) * sizeof(pthread_t);
+  mem_alloc( (void **)&thrd, mreq, "in matrix.c" );
+  for( idx = 0; idx < nthr-1; idx++ )
+    if( pthread_create(&thrd[idx], NULL, Fill_Thread, &job) != 0 )
+    {
+      perror( "xnec2c: pthread_create()" );
+      break;
+    }
+
+  Fill_Chunks( &job, scm );
+
+  while( idx-- > 0 )
+    pthread_join( thrd[idx], NULL );
+
+  free_ptr( (void **)&thrd );
 
   return;
 }
 
 /*-----------------------------------------------------------------------*/
 
+/* cmset sets up the complex structure matrix in the array cm, */
+/* in column major order as the LU factorizations expect it */
+  void
+cmset( int nrow, complex double *cmx, double rkhx, int iexkx )
+{
+  cmset_columns( nrow, cmx, 1, matpar.nlast, rkhx, iexkx, FALSE );
+}
+
+/*-----------------------------------------------------------------------*/
+
 /* computes matrix elements for e along wires due to patch current */
   void
 cmsw( int j1, int j2, int i1, int i2, complex double *cmx,
     complex double *cw, int ncw, int nrow, int itrp )
 {
   int jsnox; /* -1 offset to "jsno" for array indexing */
-  static complex double *emel = NULL;
-
-  size_t mreq = 9 * sizeof(complex double);
-  mem_alloc( (void **)&emel, mreq, "in matrix.c");
-
-  jsnox = segj.jsno-1;
+  complex double emel[9];
 
   if( itrp >= 0)
   {
@@ -712,6 +924,7 @@ cmsw( int j1, int j2, int i1, int i2, complex double *cmx,
               dataj.exc= emel[8]* fsign;
 
               trio(i+1);
+              jsnox = segj.jsno-1;
 
               il= i-ncw;
               if( i < data.np)
@@ -1133,14 +1346,14 @@ int factr_gauss_elim( int n, complex double *a, int *ip, int ndim)
   complex double arj, *scm = NULL;
 
   /* Allocate to scratch memory */
-  size_t mreq = (size_t)data.np2m * sizeof(complex double);
+  size_t mreq = (size_t)n * sizeof(complex double);
   mem_alloc( (void **)&scm, mreq, "in matrix.c");
 
   // Notice: Un-transposition of the matrix for Gauss elimination 
   // was previously performed in this function from the original NEC2
-  // code but has been moved to the factr() function because the LAPACK
-  // and OpenBLAS calls need it too.  See the for(i,j) nested loop at the 
-  // top of factr().
+  // code but has been moved out because the LAPACK and OpenBLAS calls
+  // need it too.  The interaction matrix is now filled untransposed by
+  // cmset(), and the network matrix is untransposed by factr().
 
   iflg=FALSE;
   /* step 1 */
@@ -1224,12 +1437,18 @@ int factr_gauss_elim( int n, complex double *a, int *ip, int ndim)
   return 0;
 }
 
-int factr( int n, complex double *a, int *ip, int ndim)
+/* Untranspose()
+ *
+ * Transposes the n x n matrix a in place, the network matrix
+ * is filled transposed but the LU factorizations need it the
+ * right way. cmset() fills the interaction matrix the right way
+ */
+  static void
+Untranspose( int n, complex double *a, int ndim )
 {
   complex double arj;
   int i, j;
 
-  /* Un-transpose the matrix for Gauss elimination */
   for( i = 1; i < n; i++ )
   {
     for( j = 0; j < i; j++ )
@@ -1240,6 +1459,17 @@ int factr( int n, complex double *a, int *ip, int ndim)
     }
   }
 
+} /* Untranspose() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Factr_Double()
+ *
+ * LU factors the untransposed matrix a in double precision
+ */
+  static int
+Factr_Double( int n, complex double *a, int *ip, int ndim )
+{
   int32_t info = zgetrf (CblasColMajor, (int32_t)n, (int32_t)n, (void*) a, (int32_t)ndim, ip);
   
   if (info != 0) {
@@ -1251,26 +1481,244 @@ int factr( int n, complex double *a, int *ip, int ndim)
   }
   
   return info;
+} /* Factr_Double() */
+
+/*-----------------------------------------------------------------------*/
+
+/* factr factors the transposed matrix of the network equations */
+int factr( int n, complex double *a, int *ip, int ndim)
+{
+  /* Un-transpose the matrix for Gauss elimination */
+  Untranspose( n, a, ndim );
+
+  return( Factr_Double(n, a, ip, ndim) );
 }
 
+/*-----------------------------------------------------------------------*/
+
+/* Mode_Blocks()
+ *
+ * Takes symmetry mode blocks from the job and processes
+ * them until none are left, timing each block
+ */
+  static void *
+Mode_Blocks( void *arg )
+{
+  mode_job_t *job = (mode_job_t *)arg;
+  struct timespec start, end;
+  int blk;
+
+  while( (blk = g_atomic_int_add(&job->next, 1)) < job->nblk )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    job->func( job, blk );
+    clock_gettime( CLOCK_MONOTONIC, &end );
+
+    job->secs[blk] = (double)(end.tv_sec - start.tv_sec) +
+      (double)(end.tv_nsec - start.tv_nsec) / 1.0E9;
+  }
+
+  return( NULL );
+} /* Mode_Blocks() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Run_Mode_Blocks()
+ *
+ * Processes the independent symmetry mode blocks of the job
+ * in up to rc_config.fill_threads threads, including the caller,
+ * or only in the caller if the mathlib is not reentrant. The
+ * threads of the builtin LU are divided between the blocks
+ */
+  static void
+Run_Mode_Blocks( mode_job_t *job )
+{
+  pthread_t *thrd = NULL;
+  int nthr, idx;
+  size_t mreq;
+
+  job->next = 0;
+  job->secs = NULL;
+  mreq = (size_t)job->nblk * sizeof(double);
+  mem_alloc( (void **)&job->secs, mreq, "in matrix.c" );
+
+  nthr = rc_config.fill_threads;
+  if( nthr > job->nblk )
+    nthr = job->nblk;
+  if( !mathlib_reentrant() )
+    nthr = 1;
+
+  /* The calling thread takes blocks too */
+  Matrix_Lu_Set_Concurrent( nthr );
+  idx = 0;
+  if( nthr > 1 )
+  {
+    mreq = (size_t)(nthr-1) * sizeof(pthread_t);
+    mem_alloc( (void **)&thrd, mreq, "in matrix.c" );
+    for( idx = 0; idx < nthr-1; idx++ )
+      if( pthread_create(&thrd[idx], NULL, Mode_Blocks, job) != 0 )
+      {
+        perror( "xnec2c: pthread_create()" );
+        break;
+      }
+  }
+
+  Mode_Blocks( job );
+
+  while( idx-- > 0 )
+    pthread_join( thrd[idx], NULL );
+  free_ptr( (void **)&thrd );
+  Matrix_Lu_Set_Concurrent( 1 );
+
+  if( job->nblk > 1 )
+    for( idx = 0; idx < job->nblk; idx++ )
+      pr_debug( "%s: mode block %d/%d (order %d) took %.6f sec\n",
+          job->name, idx+1, job->nblk, job->np, job->secs[idx] );
+
+  free_ptr( (void **)&job->secs );
+
+} /* Run_Mode_Blocks() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Factors of the last factrs() if in mixed precision */
+static mixed_lu_t mixed = { 0, 0, NULL, NULL, NULL, NULL, NULL };
+
+/*-----------------------------------------------------------------------*/
+
+/* Mixed_Free()
+ *
+ * Releases the single precision factors, so that they
+ * do not stay allocated along with the matrix in cm
+ */
+  static void
+Mixed_Free( void )
+{
+  mixed.a = NULL;
+  free_ptr( (void **)&mixed.lu );
+  free_ptr( (void **)&mixed.ip );
+  free_ptr( (void **)&mixed.anorm );
+  free_ptr( (void **)&mixed.dbl );
+
+} /* Mixed_Free() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Factr_Mode_Block()
+ *
+ * Factors the matrix of symmetry mode blk, filled
+ * by cmset() in the column major order of zgetrf()
+ */
+  static void
+Factr_Mode_Block( mode_job_t *job, int blk )
+{
+  int ka= blk* job->np;
+
+  Factr_Double( job->np, &job->a[ka], &job->ip[ka], job->nrow );
+} /* Factr_Mode_Block() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Factr_Mixed_Block()
+ *
+ * Factors the matrix of symmetry mode blk in single precision,
+ * keeping the double precision matrix for the refinement. Falls
+ * back to a double precision factorization if single precision
+ * overflows or the single precision factors are singular
+ */
+  static void
+Factr_Mixed_Block( mode_job_t *job, int blk )
+{
+  int i, j, np = job->np, nrow = job->nrow;
+  complex double *a = &job->a[blk * np];
+  complex float *lu = &mixed.lu[(size_t)blk * (size_t)(np * np)];
+  double anorm = 0.0, *rsum = NULL;
+  int32_t info;
+
+  /* Infinity norm, summed a column at a time */
+  mem_alloc( (void **)&rsum, (size_t)np * sizeof(double), "in matrix.c" );
+  for( j = 0; j < np; j++ )
+    for( i = 0; i < np; i++ )
+    {
+      rsum[i] += cabs( a[i+j*nrow] );
+      lu[i+j*np] = (complex float)a[i+j*nrow];
+    }
+  for( i = 0; i < np; i++ )
+    if( anorm < rsum[i] ) anorm = rsum[i];
+  free_ptr( (void **)&rsum );
+  mixed.anorm[blk] = anorm;
+
+  info = 1;
+  if( anorm < (double)FLT_MAX / (double)np )
+    info = cgetrf( CblasColMajor, np, np, lu, np, &mixed.ip[blk * np] );
+
+  mixed.dbl[blk] = (info != 0);
+  if( mixed.dbl[blk] )
+  {
+    pr_notice( "mode block %d: single precision LU failed, using double\n", blk+1 );
+    Factr_Double( np, a, &job->ip[blk * np], nrow );
+  }
+
+} /* Factr_Mixed_Block() */
 
 /*-----------------------------------------------------------------------*/
 
 /* factrs, for symmetric structure, transforms submatricies to form */
 /* matricies of the symmetric modes and calls routine to factor */
 /* matricies.  if no symmetry, the routine is called to factor the */
-/* complete matrix. */
+/* complete matrix. the mode matricies are independent and are */
+/* factored concurrently, in single precision with --mixed-precision */
   void
 factrs( int np, int nrow, complex double *a, int *ip )
 {
-  int kk, ka;
+  mode_job_t job;
+  size_t mreq;
 
   smat.nop = nrow/np;
-  for( kk = 0; kk < smat.nop; kk++ )
+
+  job.nblk = smat.nop;
+  job.np   = np;
+  job.nrow = nrow;
+  job.a    = a;
+  job.ip   = ip;
+  job.func = Factr_Mode_Block;
+  job.name = "factrs";
+
+  /* The refinement needs the double precision matrix, so the
+   * single precision factors are in addition to it, as in LAPACK
+   * zcgesv, 1.5 times the memory of cm. They are released when
+   * the matrix is factored in double precision instead */
+  mixed.a = NULL;
+  if( !rc_config.mixed_precision )
+    Mixed_Free();
+  else
+  {
+    mixed.a    = a;
+    mixed.nblk = smat.nop;
+    mixed.np   = np;
+    mreq = (size_t)smat.nop * (size_t)np * (size_t)np * sizeof(complex float);
+    mem_realloc( (void **)&mixed.lu, mreq, "in matrix.c" );
+    mreq = (size_t)nrow * sizeof(int32_t);
+    mem_realloc( (void **)&mixed.ip, mreq, "in matrix.c" );
+    mreq = (size_t)smat.nop * sizeof(double);
+    mem_realloc( (void **)&mixed.anorm, mreq, "in matrix.c" );
+    mem_realloc( (void **)&mixed.dbl, (size_t)smat.nop, "in matrix.c" );
+    job.func = Factr_Mixed_Block;
+  }
+
+  Run_Mode_Blocks( &job );
+
+  /* Not needed if all the blocks fell back to double precision */
+  if( mixed.a != NULL )
   {
-    ka= kk* np;
-    factr( np, &a[ka], &ip[ka], nrow );
+    int blk;
+
+    for( blk = 0; blk < mixed.nblk; blk++ )
+      if( !mixed.dbl[blk] ) break;
+    if( blk == mixed.nblk )
+      Mixed_Free();
   }
+
   return;
 }
 
@@ -1418,11 +1866,139 @@ int solve( int n, complex double *a, int *ip,
 }
 
 
+/*-----------------------------------------------------------------------*/
+
+/* Solve_Mixed()
+ *
+ * Solves the matrix equation of mode block blk for right hand
+ * side b with the single precision factors, refining the solution
+ * until its residual against the double precision matrix a is at
+ * the level of double precision rounding. Returns FALSE, with b
+ * unchanged, if the refinement does not converge
+ */
+  static gboolean
+Solve_Mixed( mode_job_t *job, int blk, complex double *a, complex double *b )
+{
+  int i, j, it, np = job->np, nrow = job->nrow;
+  complex float *lu = &mixed.lu[(size_t)blk * (size_t)(np * np)];
+  int32_t *ipb = &mixed.ip[blk * np];
+  complex double *x = NULL, *r = NULL, xj;
+  complex float *rs = NULL;
+  double xnorm, rnorm, cte;
+  gboolean ok = FALSE;
+
+  mem_alloc( (void **)&x,  (size_t)np * sizeof(complex double), "in matrix.c" );
+  mem_alloc( (void **)&r,  (size_t)np * sizeof(complex double), "in matrix.c" );
+  mem_alloc( (void **)&rs, (size_t)np * sizeof(complex float),  "in matrix.c" );
+
+  /* Stopping criterion of LAPACK zcgesv */
+  cte = mixed.anorm[blk] * DBL_EPSILON * sqrt( (double)np );
+
+  for( i = 0; i < np; i++ )
+    rs[i] = (complex float)b[i];
+  cgetrs( CblasColMajor, CblasNoTrans, np, 1, lu, np, ipb, rs, np );
+  for( i = 0; i < np; i++ )
+    x[i] = rs[i];
+
+  for( it = 0; it < MIXED_MAX_ITER; it++ )
+  {
+    /* Residual r = b - a*x, a column at a time */
+    for( i = 0; i < np; i++ )
+      r[i] = b[i];
+    for( j = 0; j < np; j++ )
+    {
+      xj = x[j];
+      for( i = 0; i < np; i++ )
+        r[i] -= a[i+j*nrow] * xj;
+    }
+
+    xnorm = rnorm = 0.0;
+    for( i = 0; i < np; i++ )
+    {
+      if( xnorm < cabs(x[i]) ) xnorm = cabs( x[i] );
+      if( rnorm < cabs(r[i]) ) rnorm = cabs( r[i] );
+    }
+
+    if( rnorm <= xnorm * cte )
+    {
+      ok = TRUE;
+      break;
+    }
+
+    /* Correction from the single precision factors */
+    for( i = 0; i < np; i++ )
+      rs[i] = (complex float)r[i];
+    cgetrs( CblasColMajor, CblasNoTrans, np, 1, lu, np, ipb, rs, np );
+    for( i = 0; i < np; i++ )
+      x[i] += rs[i];
+  }
+
+  if( ok )
+    memcpy( b, x, (size_t)np * sizeof(complex double) );
+
+  free_ptr( (void **)&x );
+  free_ptr( (void **)&r );
+  free_ptr( (void **)&rs );
+
+  return( ok );
+} /* Solve_Mixed() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Solve_Mode_Block()
+ *
+ * Solves the matrix equations of symmetry mode blk for all
+ * the right hand sides of the job, with a single call to
+ * zgetrs() unless the block is factored in mixed precision
+ * or kept out of core
+ */
+  static void
+Solve_Mode_Block( mode_job_t *job, int blk )
+{
+  int ic, info, ia= blk* job->np;
+  complex double *b;
+
+  /* The factors of an out-of-core matrix are read from its file */
+  b  = &job->b[ia];
+  if( Matrix_Ooc_Active() )
+  {
+    Matrix_Ooc_Solve( blk, job->np, &job->ip[ia], b, job->nrh, job->neq );
+    return;
+  }
+
+  /* Refine the single precision solutions, or factor in
+   * double precision if a refinement does not converge */
+  ic = 0;
+  if( (mixed.a == job->a) && !mixed.dbl[blk] )
+  {
+    for( ; ic < job->nrh; ic++ )
+    {
+      b = &job->b[ia+ic*job->neq];
+      if( !Solve_Mixed(job, blk, &job->a[ia], b) )
+        break;
+    }
+    if( ic == job->nrh )
+      return;
+
+    pr_notice( "mode block %d: refinement did not converge, using double\n", blk+1 );
+    mixed.dbl[blk] = TRUE;
+    Factr_Double( job->np, &job->a[ia], &job->ip[ia], job->nrow );
+  }
+
+  /* The remaining right hand sides with the double precision factors */
+  info = zgetrs( CblasColMajor, CblasNoTrans, job->np, job->nrh - ic,
+      &job->a[ia], job->nrow, &job->ip[ia], b, job->neq );
+  if( info != 0 )
+    pr_err("Solving Failed: %d\n", info);
+
+} /* Solve_Mode_Block() */
+
 /*-----------------------------------------------------------------------*/
 
 /* subroutine solves, for symmetric structures, handles the */
 /* transformation of the right hand side vector and solution */
-/* of the matrix eq. */
+/* of the matrix eq. the mode equations are solved concurrently, */
+/* each for all the nrh right hand sides in b at once */
   void
 solves( complex double *a, int *ip,
     complex double *b,  int neq, int nrh,
@@ -1431,6 +2007,7 @@ solves( complex double *a, int *ip,
   int npeq, nrow, ic, i, kk, ia, ib, j, k;
   double fnop, fnorm;
   complex double  sum, *scm = NULL;
+  mode_job_t job;
 
   npeq= np+ 2*mp;
   smat.nop = neq/npeq;
@@ -1516,15 +2093,21 @@ solves( complex double *a, int *ip,
   } /* if( smat.nop != 1) */
 
   /* solve each mode equation */
-  for( kk = 0; kk < smat.nop; kk++ )
-  {
-    ia= kk* npeq;
-    ib= ia;
-
-    for( ic = 0; ic < nrh; ic++ )
-      solve( npeq, &a[ib], &ip[ia], &b[ia+ic*neq], nrow );
-
-  } /* for( kk = 0; kk < smat.nop; kk++ ) */
+  job.nblk = smat.nop;
+  job.np   = npeq;
+  job.nrow = nrow;
+  job.neq  = neq;
+  job.nrh  = nrh;
+  job.a    = a;
+  job.b    = b;
+  job.ip   = ip;
+  job.func = Solve_Mode_Block;
+  job.name = "solves";
+  Run_Mode_Blocks( &job );
+
+  /* Errors of the out-of-core matrix file call Stop() here */
+  if( Matrix_Ooc_Active() )
+    Matrix_Ooc_Failed();
 
   if( smat.nop == 1)
   {
@@ -24,5 +24,82 @@
 
 #define RETA    2.654420938E-3
 
+/* Observations are split into this many chunks per
+ * fill thread to balance the load between the threads */
+#define FILL_CHUNKS_PER_THREAD  4
+
+/* Observation rows of a chunk are a multiple of this, the
+ * complex elements in a cache line, with a column major fill */
+#define FILL_CHUNK_ROWS         4
+
+/* Matrix fill job shared by the cmset() threads */
+typedef struct
+{
+  int
+    nrow,  /* Rows of the matrix */
+    first, /* First observation, at the start of cmx */
+    it;    /* Last observation to fill */
+
+  complex double *cmx;
+
+  /* Observations are columns of the matrix transposed */
+  gboolean trans;
+
+  /* Next observation to fill and observations per chunk */
+  gint next, chunk;
+
+  /* Source segment state of the calling thread */
+  dataj_t caller_dataj;
+  segj_t  caller_segj;
+  incom_t caller_incom;
+  gwav_t  caller_gwav;
+
+} fill_job_t;
+
+/* Symmetry mode blocks factored or solved concurrently
+ * by the factrs() and solves() threads */
+typedef struct mode_job_t
+{
+  int
+    nblk, /* Number of mode blocks (smat.nop) */
+    np,   /* Order of each block */
+    nrow, /* Leading dimension of the matrix */
+    neq,  /* Length of each right hand side */
+    nrh;  /* Number of right hand sides */
+
+  complex double *a, *b;
+  int *ip;
+
+  /* Factors or solves one block */
+  void (*func)( struct mode_job_t *job, int blk );
+  const char *name;
+
+  /* Next block to process and time taken per block */
+  gint next;
+  double *secs;
+
+} mode_job_t;
+
+/* Iterative refinement steps of a mixed precision solution
+ * before its block is factored in double precision instead */
+#define MIXED_MAX_ITER  30
+
+/* Single precision factors of the symmetry mode blocks, made
+ * by factrs() with --mixed-precision. solves() refines their
+ * solutions to double precision against the unfactored matrix */
+typedef struct
+{
+  int
+    nblk, /* Number of mode blocks */
+    np;   /* Order of each block */
+
+  complex double *a;  /* Matrix the factors are of */
+  complex float  *lu; /* Single precision factors of each block */
+  int32_t *ip;        /* Their pivots */
+  double  *anorm;     /* Infinity norm of each block */
+  char    *dbl;       /* Block factored in double precision in a */
+
+} mixed_lu_t;
+
 #endif
 
@@ -0,0 +1,326 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Cache of factored interaction matrices and pivots (cm and
+ * save.ip), keyed by a hash of the frequency and of the geometry,
+ * loading and ground data that the matrix fill depends on. When
+ * the input file is re-read with only excitation, network or
+ * transmission line cards changed, as the optimizer does, the
+ * matrix fill and factorization are skipped on a cache hit.
+ * The memory and disk budgets are set by --matrix-cache and
+ * --matrix-cache-disk, least recently used entries are spilled
+ * from memory to a temporary file and then dropped.
+ */
+
+#include "matrix_cache.h"
+#include "shared.h"
+#include "utils.h"
+#include "mathlib.h"
+
+/* Cache entries and their total sizes in memory and on disk */
+static matrix_cache_t *mcache = NULL;
+static int    mcache_num  = 0;
+static size_t mcache_mem  = 0;
+static size_t mcache_disk = 0;
+
+/* Use counter and key of the last lookup */
+static guint64 mcache_stamp = 0;
+static guint64 mcache_key   = 0;
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Key()
+ *
+ * Hashes the data the interaction matrix depends on. Must be
+ * called after geometry scaling, loading and ground parameters
+ */
+  static guint64
+Matrix_Key( void )
+{
+  guint64 h = HASH_INIT;
+  int n = data.n, m = data.m;
+
+  /* Frequency, kernel and solver */
+  h = HASH_VAR( h, calc_data.freq_mhz );
+  h = HASH_VAR( h, calc_data.rkh );
+  h = HASH_VAR( h, calc_data.iexk );
+  if( current_mathlib != NULL )
+    h = HASH_VAR( h, current_mathlib->idx );
+
+  /* Structure and symmetry */
+  h = HASH_VAR( h, data.n );
+  h = HASH_VAR( h, data.np );
+  h = HASH_VAR( h, data.m );
+  h = HASH_VAR( h, data.mp );
+  h = HASH_VAR( h, data.ipsym );
+  h = HASH_VAR( h, netcx.neq );
+  h = HASH_VAR( h, netcx.npeq );
+
+  /* Wire segments, scaled to the frequency */
+  h = HASH_ARR( h, data.icon1, n );
+  h = HASH_ARR( h, data.icon2, n );
+  h = HASH_ARR( h, data.x,    n );
+  h = HASH_ARR( h, data.y,    n );
+  h = HASH_ARR( h, data.z,    n );
+  h = HASH_ARR( h, data.si,   n );
+  h = HASH_ARR( h, data.bi,   n );
+  h = HASH_ARR( h, data.cab,  n );
+  h = HASH_ARR( h, data.sab,  n );
+  h = HASH_ARR( h, data.salp, n );
+
+  /* Surface patches */
+  h = HASH_ARR( h, data.px,    m );
+  h = HASH_ARR( h, data.py,    m );
+  h = HASH_ARR( h, data.pz,    m );
+  h = HASH_ARR( h, data.pbi,   m );
+  h = HASH_ARR( h, data.t1x,   m );
+  h = HASH_ARR( h, data.t1y,   m );
+  h = HASH_ARR( h, data.t1z,   m );
+  h = HASH_ARR( h, data.t2x,   m );
+  h = HASH_ARR( h, data.t2y,   m );
+  h = HASH_ARR( h, data.t2z,   m );
+  h = HASH_ARR( h, data.psalp, m );
+
+  /* Segment loading is added to the matrix */
+  h = HASH_VAR( h, zload.nload );
+  if( zload.nload != 0 )
+    h = HASH_ARR( h, zload.zarray, n );
+
+  /* Ground */
+  h = HASH_VAR( h, gnd.ksymp );
+  h = HASH_VAR( h, gnd.iperf );
+  h = HASH_VAR( h, gnd.nradl );
+  h = HASH_VAR( h, gnd.t2 );
+  h = HASH_VAR( h, gnd.cl );
+  h = HASH_VAR( h, gnd.ch );
+  h = HASH_VAR( h, gnd.scrwl );
+  h = HASH_VAR( h, gnd.scrwr );
+  h = HASH_VAR( h, gnd.zrati );
+  h = HASH_VAR( h, gnd.zrati2 );
+  h = HASH_VAR( h, gnd.t1 );
+  h = HASH_VAR( h, gnd.frati );
+  h = HASH_VAR( h, save.epsr );
+  h = HASH_VAR( h, save.sig );
+
+  return( h );
+} /* Matrix_Key() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Cache_Drop()
+ *
+ * Removes entry idx from the cache
+ */
+  static void
+Matrix_Cache_Drop( int idx )
+{
+  matrix_cache_t *ent = &mcache[idx];
+
+  if( ent->spill != NULL )
+  {
+    fclose( ent->spill );
+    mcache_disk -= ent->cm_size + ent->ip_size;
+  }
+  else
+  {
+    free_ptr( (void **)&ent->cm );
+    free_ptr( (void **)&ent->ip );
+    mcache_mem -= ent->cm_size + ent->ip_size;
+  }
+
+  mcache[idx] = mcache[--mcache_num];
+
+} /* Matrix_Cache_Drop() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Cache_LRU()
+ *
+ * Returns the least recently used entry in memory
+ * (spilled is FALSE) or on disk, -1 if there is none
+ */
+  static int
+Matrix_Cache_LRU( gboolean spilled )
+{
+  int idx, lru = -1;
+
+  for( idx = 0; idx < mcache_num; idx++ )
+  {
+    if( (mcache[idx].spill != NULL) != spilled )
+      continue;
+    if( (lru < 0) || (mcache[idx].used < mcache[lru].used) )
+      lru = idx;
+  }
+
+  return( lru );
+} /* Matrix_Cache_LRU() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Cache_Spill()
+ *
+ * Moves entry idx from memory to a temporary file if
+ * the disk budget allows, otherwise drops it
+ */
+  static void
+Matrix_Cache_Spill( int idx )
+{
+  matrix_cache_t *ent = &mcache[idx];
+  size_t size = ent->cm_size + ent->ip_size;
+  size_t budget = (size_t)rc_config.matrix_cache_disk_mb << 20;
+  int lru;
+  FILE *fp;
+
+  if( size > budget )
+  {
+    Matrix_Cache_Drop( idx );
+    return;
+  }
+
+  /* Make room on disk */
+  while( mcache_disk + size > budget )
+  {
+    lru = Matrix_Cache_LRU( TRUE );
+    if( lru < 0 ) break;
+    Matrix_Cache_Drop( lru );
+
+    /* Dropping moves the last entry into the freed place */
+    if( idx == mcache_num ) idx = lru;
+    ent = &mcache[idx];
+  }
+
+  fp = tmpfile();
+  if( (fp == NULL) ||
+      (fwrite(ent->cm, 1, ent->cm_size, fp) != ent->cm_size) ||
+      (fwrite(ent->ip, 1, ent->ip_size, fp) != ent->ip_size) )
+  {
+    pr_err( "cannot spill matrix cache entry to disk\n" );
+    if( fp != NULL ) fclose( fp );
+    Matrix_Cache_Drop( idx );
+    return;
+  }
+
+  free_ptr( (void **)&ent->cm );
+  free_ptr( (void **)&ent->ip );
+  ent->spill = fp;
+  mcache_mem  -= size;
+  mcache_disk += size;
+
+} /* Matrix_Cache_Spill() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Cache_Load()
+ *
+ * Looks up the factored matrix for the current frequency and
+ * structure and copies it to cmx and its pivots to ip. Returns
+ * FALSE if it is not cached, the key is kept for the next store
+ */
+  gboolean
+Matrix_Cache_Load( complex double *cmx, int *ip )
+{
+  matrix_cache_t *ent;
+  int idx;
+
+  /* Mixed precision factors are not kept in cm */
+  if( (rc_config.matrix_cache_mb <= 0) || rc_config.mixed_precision )
+    return( FALSE );
+
+  mcache_key = Matrix_Key();
+  for( idx = 0; idx < mcache_num; idx++ )
+    if( mcache[idx].key == mcache_key )
+      break;
+  if( idx == mcache_num )
+    return( FALSE );
+
+  ent = &mcache[idx];
+  if( ent->spill == NULL )
+  {
+    memcpy( cmx, ent->cm, ent->cm_size );
+    memcpy( ip,  ent->ip, ent->ip_size );
+  }
+  else
+  {
+    rewind( ent->spill );
+    if( (fread(cmx, 1, ent->cm_size, ent->spill) != ent->cm_size) ||
+        (fread(ip,  1, ent->ip_size, ent->spill) != ent->ip_size) )
+    {
+      pr_err( "cannot read spilled matrix cache entry\n" );
+      Matrix_Cache_Drop( idx );
+      return( FALSE );
+    }
+  }
+
+  ent->used = ++mcache_stamp;
+  return( TRUE );
+} /* Matrix_Cache_Load() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Cache_Store()
+ *
+ * Stores the factored matrix cmx and pivots ip under the key
+ * of the last Matrix_Cache_Load(), spilling or dropping least
+ * recently used entries to keep within the memory budget
+ */
+  void
+Matrix_Cache_Store( complex double *cmx, int *ip )
+{
+  matrix_cache_t *ent;
+  size_t mreq, budget;
+  size_t cm_size, ip_size;
+  int lru;
+
+  if( (rc_config.matrix_cache_mb <= 0) || rc_config.mixed_precision )
+    return;
+
+  cm_size = (size_t)(data.np2m * (data.np + 2 * data.mp)) * sizeof(complex double);
+  ip_size = (size_t)data.np2m * sizeof(int);
+  budget  = (size_t)rc_config.matrix_cache_mb << 20;
+  if( cm_size + ip_size > budget )
+    return;
+
+  /* Make room in memory */
+  while( mcache_mem + cm_size + ip_size > budget )
+  {
+    lru = Matrix_Cache_LRU( FALSE );
+    if( lru < 0 ) break;
+    Matrix_Cache_Spill( lru );
+  }
+
+  mreq = (size_t)(mcache_num + 1) * sizeof(matrix_cache_t);
+  mem_realloc( (void **)&mcache, mreq, "in matrix_cache.c" );
+  ent = &mcache[mcache_num++];
+
+  ent->key     = mcache_key;
+  ent->used    = ++mcache_stamp;
+  ent->cm_size = cm_size;
+  ent->ip_size = ip_size;
+  ent->spill   = NULL;
+  ent->cm      = NULL;
+  ent->ip      = NULL;
+  mem_alloc( (void **)&ent->cm, cm_size, "in matrix_cache.c" );
+  mem_alloc( (void **)&ent->ip, ip_size, "in matrix_cache.c" );
+  memcpy( ent->cm, cmx, cm_size );
+  memcpy( ent->ip, ip,  ip_size );
+  mcache_mem += cm_size + ip_size;
+
+} /* Matrix_Cache_Store() */
+
+/*-----------------------------------------------------------------------*/
@@ -0,0 +1,43 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef MATRIX_CACHE_H
+#define MATRIX_CACHE_H    1
+
+#include "common.h"
+
+/* A factored interaction matrix and its pivots, kept
+ * in memory or spilled to a temporary file on disk */
+typedef struct
+{
+  guint64
+    key,      /* Hash of everything the matrix depends on */
+    used;     /* Stamp of last use, for LRU eviction */
+
+  size_t
+    cm_size,  /* Bytes of matrix data */
+    ip_size;  /* Bytes of pivot data */
+
+  complex double *cm; /* Matrix, NULL if spilled */
+  int *ip;            /* Pivots, NULL if spilled */
+  FILE *spill;        /* Spill file, NULL if in memory */
+
+} matrix_cache_t;
+
+#endif
@@ -0,0 +1,532 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Interpolation of the interaction matrix over a frequency sweep.
+ * The sweep range is split in segments of up to MINTERP_BANDWIDTH
+ * relative bandwidth, and the matrix is filled by cmset() at the
+ * two ends and the middle of each segment (the anchors). Matrix
+ * elements vary with frequency mostly through the exp(-jkR) phase
+ * of the Green's function, R being the distance between the two
+ * segments or patches, so this phase is taken out of the anchor
+ * matrices, and the remaining smooth part is interpolated with a
+ * quadratic polynomial to the frequencies inside the segment and
+ * multiplied back by exp(-jkR). The interpolation of each segment
+ * is checked against a matrix filled by cmset() where the error
+ * of the quadratic is largest, and if the relative difference is
+ * more than --matrix-interp the segment is filled by cmset() at
+ * every step instead.
+ */
+
+#include "matrix_interp.h"
+#include "shared.h"
+#include "utils.h"
+
+/* State of the error check of a segment */
+enum MINTERP_SEGMENT
+{
+  MINTERP_UNCHECKED = 0,
+  MINTERP_GOOD,
+  MINTERP_BAD
+};
+
+/* Anchor matrices and their use counter */
+static minterp_anchor_t manchor[MINTERP_ANCHORS];
+static guint64 minterp_stamp = 0;
+
+/* Key of the sweep the anchors belong to */
+static guint64 minterp_key = 0;
+
+/* Frequency range of the sweep, ratio of anchor
+ * frequencies and number of interpolated segments */
+static double minterp_fmin, minterp_ratio;
+static int minterp_nseg = 0;
+
+/* Error check state of each segment */
+static char *minterp_check = NULL;
+
+/* Segment or patch of each matrix row and column */
+static int *minterp_elem = NULL;
+static int  minterp_nrow = 0;
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Range()
+ *
+ * Finds the lowest and highest frequencies of the FR cards
+ */
+  static void
+Sweep_Range( double *fmin, double *fmax )
+{
+  freq_loop_data_t *fr;
+  double flast;
+  int idx;
+
+  *fmin = *fmax = calc_data.freq_loop_data[0].min_freq;
+  for( idx = 0; idx < calc_data.FR_cards; idx++ )
+  {
+    fr = &calc_data.freq_loop_data[idx];
+    if( fr->ifreq == 1 )
+      flast = fr->min_freq * pow( fr->delta_freq, fr->freq_steps - 1 );
+    else
+      flast = fr->min_freq + fr->delta_freq * (fr->freq_steps - 1);
+
+    if( *fmin > fr->min_freq ) *fmin = fr->min_freq;
+    if( *fmin > flast ) *fmin = flast;
+    if( *fmax < fr->min_freq ) *fmax = fr->min_freq;
+    if( *fmax < flast ) *fmax = flast;
+  }
+
+} /* Sweep_Range() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Key()
+ *
+ * Hashes the data the interaction matrix depends on, except
+ * the frequency, and the frequency range of the sweep. Unlike
+ * Matrix_Key() in matrix_cache.c, unscaled geometry and the
+ * loading and ground cards are hashed, as they do not change
+ * from step to step
+ */
+  static guint64
+Sweep_Key( double fmin, double fmax )
+{
+  guint64 h = HASH_INIT;
+  int n = data.n, m = data.m, nm = data.n + data.m;
+
+  h = HASH_VAR( h, fmin );
+  h = HASH_VAR( h, fmax );
+  h = HASH_VAR( h, calc_data.steps_total );
+  h = HASH_VAR( h, calc_data.rkh );
+  h = HASH_VAR( h, calc_data.iexk );
+
+  /* Structure and symmetry */
+  h = HASH_VAR( h, data.n );
+  h = HASH_VAR( h, data.np );
+  h = HASH_VAR( h, data.m );
+  h = HASH_VAR( h, data.mp );
+  h = HASH_VAR( h, data.ipsym );
+  h = HASH_VAR( h, netcx.neq );
+  h = HASH_VAR( h, netcx.npeq );
+
+  /* Geometry in meters */
+  h = HASH_ARR( h, save.xtemp,  nm );
+  h = HASH_ARR( h, save.ytemp,  nm );
+  h = HASH_ARR( h, save.ztemp,  nm );
+  h = HASH_ARR( h, save.sitemp, n );
+  h = HASH_ARR( h, save.bitemp, nm );
+  h = HASH_ARR( h, data.icon1, n );
+  h = HASH_ARR( h, data.icon2, n );
+  h = HASH_ARR( h, data.cab,   n );
+  h = HASH_ARR( h, data.sab,   n );
+  h = HASH_ARR( h, data.salp,  n );
+  h = HASH_ARR( h, data.t1x,   m );
+  h = HASH_ARR( h, data.t1y,   m );
+  h = HASH_ARR( h, data.t1z,   m );
+  h = HASH_ARR( h, data.t2x,   m );
+  h = HASH_ARR( h, data.t2y,   m );
+  h = HASH_ARR( h, data.t2z,   m );
+  h = HASH_ARR( h, data.psalp, m );
+
+  /* Loading cards */
+  h = HASH_VAR( h, zload.nload );
+  if( zload.nload != 0 )
+  {
+    h = HASH_ARR( h, calc_data.ldtyp,  zload.nload );
+    h = HASH_ARR( h, calc_data.ldtag,  zload.nload );
+    h = HASH_ARR( h, calc_data.ldtagf, zload.nload );
+    h = HASH_ARR( h, calc_data.ldtagt, zload.nload );
+    h = HASH_ARR( h, calc_data.zlr,    zload.nload );
+    h = HASH_ARR( h, calc_data.zli,    zload.nload );
+    h = HASH_ARR( h, calc_data.zlc,    zload.nload );
+  }
+
+  /* Ground card */
+  h = HASH_VAR( h, gnd.ksymp );
+  h = HASH_VAR( h, gnd.iperf );
+  h = HASH_VAR( h, gnd.nradl );
+  h = HASH_VAR( h, save.epsr );
+  h = HASH_VAR( h, save.sig );
+  h = HASH_VAR( h, save.scrwlt );
+  h = HASH_VAR( h, save.scrwrt );
+
+  return( h );
+} /* Sweep_Key() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Segments()
+ *
+ * Returns the number of segments the sweep from fmin to fmax
+ * is interpolated in, 0 if it is not worth interpolating
+ */
+  static int
+Sweep_Segments( double fmin, double fmax )
+{
+  int nseg;
+
+  /* Segments of equal relative bandwidth, worth interpolating
+   * only if the matrices filled for their anchors and error
+   * checks are fewer than the steps of the sweep */
+  if( fmax <= fmin ) return( 0 );
+  nseg = (int)ceil( log(fmax / fmin) / log(1.0 + MINTERP_BANDWIDTH) );
+  if( calc_data.steps_total <= 3 * nseg + 1 )
+    return( 0 );
+
+  return( nseg );
+} /* Sweep_Segments() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Interp_Enabled()
+ *
+ * Returns TRUE if the matrix may be interpolated in this sweep
+ */
+  static gboolean
+Interp_Enabled( void )
+{
+  if( (rc_config.matrix_interp_tol <= 0.0) ||
+      isFlagClear(FREQ_LOOP_RUNNING) ||
+      (calc_data.freq_loop_data == NULL) )
+    return( FALSE );
+
+  /* Symmetry combines the elements of several segments,
+   * and the Sommerfeld grid is not worth recalculating */
+  if( (netcx.npeq != netcx.neq) ||
+      ((gnd.ksymp != 1) && (gnd.iperf == 2)) )
+    return( FALSE );
+
+  return( TRUE );
+} /* Interp_Enabled() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Interp_Segment()
+ *
+ * Returns the segment of the sweep that frequency fmhz is in,
+ * or -1 if the matrix is not interpolated. The frequency queue
+ * hands out whole segments, so that each child process fills
+ * the anchors of the segments it takes, not of all of them
+ */
+  int
+Matrix_Interp_Segment( double fmhz )
+{
+  double fmin, fmax, pos;
+  int nseg, seg;
+
+  if( !Interp_Enabled() )
+    return( -1 );
+
+  Sweep_Range( &fmin, &fmax );
+  nseg = Sweep_Segments( fmin, fmax );
+  if( (nseg == 0) || (fmhz < fmin) )
+    return( -1 );
+
+  pos = log( fmhz / fmin ) / log( pow(fmax / fmin, 0.5 / nseg) );
+  seg = (int)( pos / 2.0 );
+  if( seg >= nseg ) seg = nseg - 1;
+
+  return( seg );
+} /* Matrix_Interp_Segment() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Interp_Reset()
+ *
+ * Drops the anchor matrices and sets up the segments of a new sweep
+ */
+  static void
+Matrix_Interp_Reset( int nrow, double fmin, double fmax )
+{
+  size_t mreq;
+  int idx, nseg;
+
+  for( idx = 0; idx < MINTERP_ANCHORS; idx++ )
+  {
+    free_ptr( (void **)&manchor[idx].cm );
+    manchor[idx].idx  = -1;
+    manchor[idx].used = 0;
+  }
+  free_ptr( (void **)&minterp_check );
+  minterp_nseg = 0;
+  minterp_nrow = nrow;
+
+  nseg = Sweep_Segments( fmin, fmax );
+  if( nseg == 0 )
+  {
+    pr_info( "matrix interpolation: %d steps are too few to interpolate\n",
+        calc_data.steps_total );
+    return;
+  }
+
+  minterp_nseg  = nseg;
+  minterp_fmin  = fmin;
+  minterp_ratio = pow( fmax / fmin, 0.5 / nseg );
+  mem_alloc( (void **)&minterp_check, (size_t)nseg, "in matrix_interp.c" );
+
+  /* Wire segments are the first rows and columns,
+   * followed by two for each surface patch */
+  mreq = (size_t)nrow * sizeof(int);
+  mem_realloc( (void **)&minterp_elem, mreq, "in matrix_interp.c" );
+  for( idx = 0; idx < nrow; idx++ )
+  {
+    if( idx < data.n )
+      minterp_elem[idx] = idx;
+    else
+      minterp_elem[idx] = data.n + (idx - data.n) / 2;
+  }
+
+  pr_info( "matrix interpolation: %d segments from %.3f to %.3f MHz\n",
+      nseg, fmin, fmax );
+
+} /* Matrix_Interp_Reset() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Apply_Phase()
+ *
+ * Multiplies each element of matrix cmx by exp(-j*2*pi*f*R/c),
+ * R being the distance in meters between the centers of the
+ * segments or patches of its row and column
+ */
+  static void
+Apply_Phase( complex double *cmx, double fmhz )
+{
+  double k = M_2PI * fmhz / CVEL;
+  double xc, yc, zc, dx, dy, dz, r;
+  complex double *col;
+  int i, j, ei, ej;
+
+  for( j = 0; j < minterp_nrow; j++ )
+  {
+    ej  = minterp_elem[j];
+    xc  = save.xtemp[ej];
+    yc  = save.ytemp[ej];
+    zc  = save.ztemp[ej];
+    col = &cmx[j * minterp_nrow];
+
+    for( i = 0; i < minterp_nrow; i++ )
+    {
+      ei = minterp_elem[i];
+      dx = save.xtemp[ei] - xc;
+      dy = save.ytemp[ei] - yc;
+      dz = save.ztemp[ei] - zc;
+      r  = sqrt( dx*dx + dy*dy + dz*dz );
+      col[i] *= cmplx( cos(k * r), -sin(k * r) );
+    }
+  }
+
+} /* Apply_Phase() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Anchor_Freq()
+ *
+ * Returns the frequency of anchor idx, or
+ * between anchors for a fractional idx
+ */
+  static inline double
+Anchor_Freq( double idx )
+{
+  return( minterp_fmin * pow(minterp_ratio, idx) );
+}
+
+/*-----------------------------------------------------------------------*/
+
+/* Get_Anchor()
+ *
+ * Returns the phase extracted matrix of anchor idx, filling
+ * it in the least recently used slot if it is not kept
+ */
+  static minterp_anchor_t *
+Get_Anchor( int idx, minterp_fill_t fill )
+{
+  minterp_anchor_t *anc;
+  perf_mark_t mark;
+  size_t mreq;
+  int slot, lru = 0;
+
+  for( slot = 0; slot < MINTERP_ANCHORS; slot++ )
+  {
+    if( manchor[slot].idx == idx )
+    {
+      manchor[slot].used = ++minterp_stamp;
+      return( &manchor[slot] );
+    }
+    if( manchor[slot].used < manchor[lru].used )
+      lru = slot;
+  }
+
+  anc = &manchor[lru];
+  mreq = (size_t)(minterp_nrow * minterp_nrow) * sizeof(complex double);
+  mem_realloc( (void **)&anc->cm, mreq, "in matrix_interp.c" );
+
+  anc->idx  = idx;
+  anc->fmhz = Anchor_Freq( idx );
+  anc->used = ++minterp_stamp;
+  fill( anc->fmhz, anc->cm );
+
+  /* A negative frequency takes the phase out */
+  Perf_Start( &mark );
+  Apply_Phase( anc->cm, -anc->fmhz );
+  Perf_Stop( &mark, PERF_FILL );
+
+  return( anc );
+} /* Get_Anchor() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Interpolate()
+ *
+ * Interpolates matrix cmx at frequency fmhz from the three
+ * anchors of a segment, with Lagrange's quadratic polynomial
+ */
+  static void
+Interpolate( complex double *cmx, double fmhz, minterp_anchor_t **anc )
+{
+  double f0 = anc[0]->fmhz, f1 = anc[1]->fmhz, f2 = anc[2]->fmhz;
+  double w0, w1, w2;
+  size_t idx, cnt;
+
+  w0 = (fmhz - f1) * (fmhz - f2) / ((f0 - f1) * (f0 - f2));
+  w1 = (fmhz - f0) * (fmhz - f2) / ((f1 - f0) * (f1 - f2));
+  w2 = (fmhz - f0) * (fmhz - f1) / ((f2 - f0) * (f2 - f1));
+
+  cnt = (size_t)minterp_nrow * (size_t)minterp_nrow;
+  for( idx = 0; idx < cnt; idx++ )
+    cmx[idx] = w0 * anc[0]->cm[idx] + w1 * anc[1]->cm[idx] + w2 * anc[2]->cm[idx];
+
+  Apply_Phase( cmx, fmhz );
+
+} /* Interpolate() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Error()
+ *
+ * Returns the Frobenius norm of the difference
+ * of matrices a and b relative to that of b
+ */
+  static double
+Matrix_Error( complex double *a, complex double *b )
+{
+  double num = 0.0, den = 0.0;
+  complex double d;
+  size_t idx, cnt;
+
+  cnt = (size_t)minterp_nrow * (size_t)minterp_nrow;
+  for( idx = 0; idx < cnt; idx++ )
+  {
+    d = a[idx] - b[idx];
+    num += creal(d) * creal(d) + cimag(d) * cimag(d);
+    den += creal(b[idx]) * creal(b[idx]) + cimag(b[idx]) * cimag(b[idx]);
+  }
+
+  if( den == 0.0 ) return( 0.0 );
+  return( sqrt(num / den) );
+} /* Matrix_Error() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Interp_Fill()
+ *
+ * Fills the nrow x nrow interaction matrix cmx at the current
+ * frequency by interpolating it from anchor matrices, which
+ * fill() calculates at the anchor frequencies and times as
+ * PERF_FILL itself, as it also scales the geometry. Returns FALSE
+ * if the matrix is to be filled by cmset() instead: outside a
+ * frequency loop, when --matrix-interp is off, with symmetry or
+ * a Sommerfeld ground, at the anchors themselves and in segments
+ * that failed their error check
+ */
+  gboolean
+Matrix_Interp_Fill( int nrow, complex double *cmx, minterp_fill_t fill )
+{
+  static complex double *scratch = NULL;
+  perf_mark_t mark;
+  minterp_anchor_t *anc[3];
+  double fmin, fmax, fmhz, fchk, pos, err;
+  guint64 key;
+  size_t mreq;
+  int seg, idx;
+
+  if( !Interp_Enabled() )
+    return( FALSE );
+
+  Sweep_Range( &fmin, &fmax );
+  key = Sweep_Key( fmin, fmax );
+  if( (key != minterp_key) || (nrow != minterp_nrow) )
+  {
+    Matrix_Interp_Reset( nrow, fmin, fmax );
+    minterp_key = key;
+  }
+  if( minterp_nseg == 0 )
+    return( FALSE );
+
+  /* Segment of the frequency and position in it */
+  fmhz = calc_data.freq_mhz;
+  pos  = log( fmhz / minterp_fmin ) / log( minterp_ratio );
+  idx  = (int)floor( pos + 0.5 );
+  if( (pos < 0.0) || (idx > 2 * minterp_nseg) )
+    return( FALSE );
+  if( fabs(fmhz - Anchor_Freq(idx)) <= 1.0e-9 * fmhz )
+    return( FALSE );
+
+  seg = (int)( pos / 2.0 );
+  if( seg >= minterp_nseg ) seg = minterp_nseg - 1;
+  if( minterp_check[seg] == MINTERP_BAD )
+    return( FALSE );
+
+  for( idx = 0; idx < 3; idx++ )
+    anc[idx] = Get_Anchor( 2 * seg + idx, fill );
+
+  /* Check the interpolation of a segment against the matrix
+   * filled where the error of the quadratic is largest */
+  if( minterp_check[seg] == MINTERP_UNCHECKED )
+  {
+    fchk = Anchor_Freq( 2 * seg + 1 - 1.0 / sqrt(3.0) );
+    mreq = (size_t)(nrow * nrow) * sizeof(complex double);
+    mem_realloc( (void **)&scratch, mreq, "in matrix_interp.c" );
+    fill( fchk, scratch );
+    Perf_Start( &mark );
+    Interpolate( cmx, fchk, anc );
+    err = Matrix_Error( cmx, scratch );
+    Perf_Stop( &mark, PERF_FILL );
+
+    if( err > rc_config.matrix_interp_tol )
+    {
+      minterp_check[seg] = MINTERP_BAD;
+      pr_notice( "matrix interpolation: error %.2e at %.3f MHz, "
+          "filling %.3f to %.3f MHz\n", err, fchk,
+          Anchor_Freq(2 * seg), Anchor_Freq(2 * seg + 2) );
+      return( FALSE );
+    }
+
+    minterp_check[seg] = MINTERP_GOOD;
+    pr_info( "matrix interpolation: error %.2e at %.3f MHz\n", err, fchk );
+  }
+
+  Perf_Start( &mark );
+  Interpolate( cmx, fmhz, anc );
+  Perf_Stop( &mark, PERF_FILL );
+
+  return( TRUE );
+} /* Matrix_Interp_Fill() */
+
+/*-----------------------------------------------------------------------*/
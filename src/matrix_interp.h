@@ -0,0 +1,47 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef MATRIX_INTERP_H
+#define MATRIX_INTERP_H    1
+
+#include "common.h"
+
+/* Largest bandwidth, relative to its center frequency,
+ * of the part of a sweep interpolated from 3 anchors */
+#define MINTERP_BANDWIDTH   0.1
+
+/* Number of anchor matrices kept in memory */
+#define MINTERP_ANCHORS     3
+
+/* An interaction matrix filled at an anchor frequency,
+ * with the exp(-jkR) phase of its elements taken out */
+typedef struct
+{
+  int idx;            /* Index of the anchor in the sweep, -1 if unused */
+  double fmhz;        /* Frequency of the anchor */
+  guint64 used;       /* Stamp of last use, for LRU replacement */
+  complex double *cm; /* Phase extracted matrix elements */
+
+} minterp_anchor_t;
+
+/* Fills the matrix at a frequency, see Matrix_Interp_Fill() */
+typedef void (*minterp_fill_t)( double fmhz, complex double *cmx );
+
+#endif
+
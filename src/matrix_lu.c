@@ -0,0 +1,892 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Builtin blocked LU factorization, the "Builtin Blocked LU" entry
+ * of the math libraries, for when no accelerated library can be
+ * installed. The columns of the matrix are split recursively in
+ * two halves: the left half is factored, the right half updated
+ * with it and then factored in turn, so that nearly all the work
+ * is in the matrix products of the updates, and so it is for the
+ * triangular solves. The products are blocked for the caches as
+ * in BLIS and GotoBLAS: blocks of A and B are packed into slivers
+ * that a micro-kernel multiplies into a small tile of C held in
+ * registers, with AVX-512 or AVX2 complex FMA if the CPU has them,
+ * and large products are split between pthreads. The number of
+ * threads is set by --fill-threads, or by the autotuner.
+ *
+ * The pivots are 1 based and the factors are the same as those of
+ * zgetrf() of LAPACK, so that the out-of-core factoring can use
+ * the same functions for its panels.
+ */
+
+#include "matrix_lu.h"
+#include "shared.h"
+#include "utils.h"
+
+#ifdef LU_X86
+#include <immintrin.h>
+#endif
+
+/* Complex elements of the packing buffers of a thread */
+#define LU_PACK_SIZE  ( (size_t)LU_KC * (size_t)(LU_MC + LU_NC + LU_NR_MAX) )
+
+/* Threads set by mathlib_set_threads(), 0 for --fill-threads */
+static int lu_threads = 0;
+
+/* Factorizations run at once by Run_Mode_Blocks(), which share the threads */
+static int lu_concurrent = 1;
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Kernel_C()
+ *
+ * Portable micro-kernel for a 4 by 2 tile of C
+ */
+  static void
+Lu_Kernel_C( int kc, const double *ap, const double *bp, double *c, int ldc )
+{
+  double acc[2][8] = { { 0.0 } }, ar, ai, br, bi;
+  int p, i, j;
+
+  for( p = 0; p < kc; p++ )
+  {
+    for( j = 0; j < 2; j++ )
+    {
+      br = bp[2*j];
+      bi = bp[2*j+1];
+      for( i = 0; i < 8; i += 2 )
+      {
+        ar = ap[i];
+        ai = ap[i+1];
+        acc[j][i]   += ar * br - ai * bi;
+        acc[j][i+1] += ar * bi + ai * br;
+      }
+    }
+    ap += 8;
+    bp += 4;
+  }
+
+  for( j = 0; j < 2; j++ )
+    for( i = 0; i < 8; i++ )
+      c[2 * (size_t)j * (size_t)ldc + (size_t)i] -= acc[j][i];
+
+} /* Lu_Kernel_C() */
+
+/*-----------------------------------------------------------------------*/
+
+#ifdef LU_X86
+
+/* The products of a column of A by the real and the imaginary
+ * part of an element of B are accumulated apart, in r and i, and
+ * only combined into the complex product when C is updated */
+
+/* Lu_Sub_Avx2()
+ *
+ * Subtracts the complex products of r and i from 2 elements of c
+ */
+  __attribute__((target("avx2,fma")))
+  static inline void
+Lu_Sub_Avx2( double *c, __m256d r, __m256d i )
+{
+  __m256d x = _mm256_addsub_pd( r, _mm256_permute_pd(i, 0x5) );
+  _mm256_storeu_pd( c, _mm256_sub_pd(_mm256_loadu_pd(c), x) );
+} /* Lu_Sub_Avx2() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Kernel_Avx2()
+ *
+ * AVX2 micro-kernel for a 4 by 3 tile of C, in 12 accumulators
+ */
+  __attribute__((target("avx2,fma")))
+  static void
+Lu_Kernel_Avx2( int kc, const double *ap, const double *bp, double *c, int ldc )
+{
+  __m256d r00, r01, r10, r11, r20, r21;
+  __m256d i00, i01, i10, i11, i20, i21;
+  __m256d a0, a1, b;
+  size_t ld = 2 * (size_t)ldc;
+  int p;
+
+  r00 = r01 = r10 = r11 = r20 = r21 = _mm256_setzero_pd();
+  i00 = i01 = i10 = i11 = i20 = i21 = _mm256_setzero_pd();
+
+  for( p = 0; p < kc; p++ )
+  {
+    a0 = _mm256_loadu_pd( ap );
+    a1 = _mm256_loadu_pd( ap + 4 );
+
+    b   = _mm256_broadcast_sd( bp );
+    r00 = _mm256_fmadd_pd( a0, b, r00 );
+    r01 = _mm256_fmadd_pd( a1, b, r01 );
+    b   = _mm256_broadcast_sd( bp + 1 );
+    i00 = _mm256_fmadd_pd( a0, b, i00 );
+    i01 = _mm256_fmadd_pd( a1, b, i01 );
+
+    b   = _mm256_broadcast_sd( bp + 2 );
+    r10 = _mm256_fmadd_pd( a0, b, r10 );
+    r11 = _mm256_fmadd_pd( a1, b, r11 );
+    b   = _mm256_broadcast_sd( bp + 3 );
+    i10 = _mm256_fmadd_pd( a0, b, i10 );
+    i11 = _mm256_fmadd_pd( a1, b, i11 );
+
+    b   = _mm256_broadcast_sd( bp + 4 );
+    r20 = _mm256_fmadd_pd( a0, b, r20 );
+    r21 = _mm256_fmadd_pd( a1, b, r21 );
+    b   = _mm256_broadcast_sd( bp + 5 );
+    i20 = _mm256_fmadd_pd( a0, b, i20 );
+    i21 = _mm256_fmadd_pd( a1, b, i21 );
+
+    ap += 8;
+    bp += 6;
+  }
+
+  Lu_Sub_Avx2( c,            r00, i00 );
+  Lu_Sub_Avx2( c + 4,        r01, i01 );
+  Lu_Sub_Avx2( c + ld,       r10, i10 );
+  Lu_Sub_Avx2( c + ld + 4,   r11, i11 );
+  Lu_Sub_Avx2( c + 2*ld,     r20, i20 );
+  Lu_Sub_Avx2( c + 2*ld + 4, r21, i21 );
+
+} /* Lu_Kernel_Avx2() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Sub_Avx512()
+ *
+ * Subtracts the complex products of r and i from 4 elements of c
+ */
+  __attribute__((target("avx512f")))
+  static inline void
+Lu_Sub_Avx512( double *c, __m512d r, __m512d i )
+{
+  __m512d x = _mm512_fmaddsub_pd( r, _mm512_set1_pd(1.0),
+      _mm512_permute_pd(i, 0x55) );
+  _mm512_storeu_pd( c, _mm512_sub_pd(_mm512_loadu_pd(c), x) );
+} /* Lu_Sub_Avx512() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Kernel_Avx512()
+ *
+ * AVX-512 micro-kernel for an 8 by 4 tile of C, in 16 accumulators
+ */
+  __attribute__((target("avx512f")))
+  static void
+Lu_Kernel_Avx512( int kc, const double *ap, const double *bp, double *c, int ldc )
+{
+  __m512d r00, r01, r10, r11, r20, r21, r30, r31;
+  __m512d i00, i01, i10, i11, i20, i21, i30, i31;
+  __m512d a0, a1, b;
+  size_t ld = 2 * (size_t)ldc;
+  int p;
+
+  r00 = r01 = r10 = r11 = r20 = r21 = r30 = r31 = _mm512_setzero_pd();
+  i00 = i01 = i10 = i11 = i20 = i21 = i30 = i31 = _mm512_setzero_pd();
+
+  for( p = 0; p < kc; p++ )
+  {
+    a0 = _mm512_loadu_pd( ap );
+    a1 = _mm512_loadu_pd( ap + 8 );
+
+    b   = _mm512_set1_pd( bp[0] );
+    r00 = _mm512_fmadd_pd( a0, b, r00 );
+    r01 = _mm512_fmadd_pd( a1, b, r01 );
+    b   = _mm512_set1_pd( bp[1] );
+    i00 = _mm512_fmadd_pd( a0, b, i00 );
+    i01 = _mm512_fmadd_pd( a1, b, i01 );
+
+    b   = _mm512_set1_pd( bp[2] );
+    r10 = _mm512_fmadd_pd( a0, b, r10 );
+    r11 = _mm512_fmadd_pd( a1, b, r11 );
+    b   = _mm512_set1_pd( bp[3] );
+    i10 = _mm512_fmadd_pd( a0, b, i10 );
+    i11 = _mm512_fmadd_pd( a1, b, i11 );
+
+    b   = _mm512_set1_pd( bp[4] );
+    r20 = _mm512_fmadd_pd( a0, b, r20 );
+    r21 = _mm512_fmadd_pd( a1, b, r21 );
+    b   = _mm512_set1_pd( bp[5] );
+    i20 = _mm512_fmadd_pd( a0, b, i20 );
+    i21 = _mm512_fmadd_pd( a1, b, i21 );
+
+    b   = _mm512_set1_pd( bp[6] );
+    r30 = _mm512_fmadd_pd( a0, b, r30 );
+    r31 = _mm512_fmadd_pd( a1, b, r31 );
+    b   = _mm512_set1_pd( bp[7] );
+    i30 = _mm512_fmadd_pd( a0, b, i30 );
+    i31 = _mm512_fmadd_pd( a1, b, i31 );
+
+    ap += 16;
+    bp += 8;
+  }
+
+  Lu_Sub_Avx512( c,            r00, i00 );
+  Lu_Sub_Avx512( c + 8,        r01, i01 );
+  Lu_Sub_Avx512( c + ld,       r10, i10 );
+  Lu_Sub_Avx512( c + ld + 8,   r11, i11 );
+  Lu_Sub_Avx512( c + 2*ld,     r20, i20 );
+  Lu_Sub_Avx512( c + 2*ld + 8, r21, i21 );
+  Lu_Sub_Avx512( c + 3*ld,     r30, i30 );
+  Lu_Sub_Avx512( c + 3*ld + 8, r31, i31 );
+
+} /* Lu_Kernel_Avx512() */
+
+#endif
+
+/*-----------------------------------------------------------------------*/
+
+/* Micro-kernels, in order of preference */
+static const lu_kernel_desc_t lu_kernels[] =
+{
+#ifdef LU_X86
+  { "AVX-512", 8, 4, Lu_Kernel_Avx512 },
+  { "AVX2",    4, 3, Lu_Kernel_Avx2   },
+#endif
+  { "C",       4, 2, Lu_Kernel_C      }
+};
+
+static const lu_kernel_desc_t *lu_kernel = NULL;
+static pthread_once_t lu_kernel_once = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Kernel_Select()
+ *
+ * Selects the micro-kernel for the instructions of the CPU
+ */
+  static void
+Lu_Kernel_Select( void )
+{
+  int idx = 0;
+
+#ifdef LU_X86
+  __builtin_cpu_init();
+  if( !__builtin_cpu_supports("avx512f") )
+  {
+    idx++;
+    if( !__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma") )
+      idx++;
+  }
+#endif
+
+  lu_kernel = &lu_kernels[idx];
+  pr_info( "builtin blocked LU: %s micro-kernel\n", lu_kernel->name );
+
+} /* Lu_Kernel_Select() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Axpy()
+ *
+ * y -= a*x for the n elements of a and y, in real
+ * arithmetic so that the loop is vectorized
+ */
+  static inline void
+Lu_Axpy( int n, complex double x, const complex double *a, complex double *y )
+{
+  const double *ad = (const double *)a;
+  double *yd = (double *)y;
+  double xr = creal( x ), xi = cimag( x );
+  int i;
+
+  for( i = 0; i < 2 * n; i += 2 )
+  {
+    yd[i]   -= ad[i] * xr - ad[i+1] * xi;
+    yd[i+1] -= ad[i] * xi + ad[i+1] * xr;
+  }
+
+} /* Lu_Axpy() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Pack_A()
+ *
+ * Packs the mc by kc block a into slivers of mr rows, each
+ * with the mr elements of a column contiguous, zero padded
+ */
+  static void
+Lu_Pack_A( int mc, int kc, const complex double *a, int lda, int mr,
+    complex double *ap )
+{
+  const complex double *col;
+  int i0, i, p, rows;
+
+  for( i0 = 0; i0 < mc; i0 += mr )
+  {
+    rows = mc - i0;
+    if( rows > mr ) rows = mr;
+
+    for( p = 0; p < kc; p++ )
+    {
+      col = &a[i0 + (size_t)p * (size_t)lda];
+      for( i = 0; i < rows; i++ )
+        *ap++ = col[i];
+      for( ; i < mr; i++ )
+        *ap++ = CPLX_00;
+    }
+  }
+
+} /* Lu_Pack_A() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Pack_B()
+ *
+ * Packs the kc by nc block b into slivers of nr columns, each
+ * with the nr elements of a row contiguous, zero padded
+ */
+  static void
+Lu_Pack_B( int kc, int nc, const complex double *b, int ldb, int nr,
+    complex double *bp )
+{
+  int j0, j, p, cols;
+
+  for( j0 = 0; j0 < nc; j0 += nr )
+  {
+    cols = nc - j0;
+    if( cols > nr ) cols = nr;
+
+    for( p = 0; p < kc; p++ )
+    {
+      for( j = 0; j < cols; j++ )
+        *bp++ = b[p + (size_t)(j0 + j) * (size_t)ldb];
+      for( ; j < nr; j++ )
+        *bp++ = CPLX_00;
+    }
+  }
+
+} /* Lu_Pack_B() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Gemm_Serial()
+ *
+ * C -= A*B in the calling thread. Products of a few
+ * columns, as in the solutions, are not worth packing
+ */
+  static void
+Lu_Gemm_Serial( lu_gemm_t *g )
+{
+  const lu_kernel_desc_t *kern;
+  complex double tile[LU_MR_MAX * LU_NR_MAX], *ap, *bp, *cij;
+  int mr, nr, jc, pc, ic, jr, ir, nc, kc, mc, mt, nt, i, j;
+
+  if( g->n < LU_PACKED_COLS )
+  {
+    for( j = 0; j < g->n; j++ )
+      for( i = 0; i < g->k; i++ )
+        Lu_Axpy( g->m, g->b[i + (size_t)j * (size_t)g->ldb],
+            &g->a[(size_t)i * (size_t)g->lda], &g->c[(size_t)j * (size_t)g->ldc] );
+    return;
+  }
+
+  pthread_once( &lu_kernel_once, Lu_Kernel_Select );
+  kern = lu_kernel;
+  mr = kern->mr;
+  nr = kern->nr;
+  ap = g->pack;
+  bp = &g->pack[LU_MC * LU_KC];
+
+  for( jc = 0; jc < g->n; jc += LU_NC )
+  {
+    nc = g->n - jc;
+    if( nc > LU_NC ) nc = LU_NC;
+
+    for( pc = 0; pc < g->k; pc += LU_KC )
+    {
+      kc = g->k - pc;
+      if( kc > LU_KC ) kc = LU_KC;
+      Lu_Pack_B( kc, nc, &g->b[pc + (size_t)jc * (size_t)g->ldb], g->ldb, nr, bp );
+
+      for( ic = 0; ic < g->m; ic += LU_MC )
+      {
+        mc = g->m - ic;
+        if( mc > LU_MC ) mc = LU_MC;
+        Lu_Pack_A( mc, kc, &g->a[ic + (size_t)pc * (size_t)g->lda], g->lda, mr, ap );
+
+        for( jr = 0; jr < nc; jr += nr )
+        {
+          nt = nc - jr;
+          if( nt > nr ) nt = nr;
+
+          for( ir = 0; ir < mc; ir += mr )
+          {
+            mt = mc - ir;
+            if( mt > mr ) mt = mr;
+            cij = &g->c[ic + ir + (size_t)(jc + jr) * (size_t)g->ldc];
+
+            if( (mt == mr) && (nt == nr) )
+            {
+              kern->func( kc, (const double *)&ap[ir * kc],
+                  (const double *)&bp[jr * kc], (double *)cij, g->ldc );
+              continue;
+            }
+
+            /* Edge tiles are computed apart */
+            memset( tile, 0, sizeof(tile) );
+            kern->func( kc, (const double *)&ap[ir * kc],
+                (const double *)&bp[jr * kc], (double *)tile, mr );
+            for( j = 0; j < nt; j++ )
+              for( i = 0; i < mt; i++ )
+                cij[i + (size_t)j * (size_t)g->ldc] += tile[i + j * mr];
+          }
+        }
+      }
+    }
+  }
+
+} /* Lu_Gemm_Serial() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Gemm_Thread()
+ *
+ * Entry point of the matrix product threads
+ */
+  static void *
+Lu_Gemm_Thread( void *arg )
+{
+  Lu_Gemm_Serial( (lu_gemm_t *)arg );
+  return( NULL );
+} /* Lu_Gemm_Thread() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Gemm()
+ *
+ * C -= A*B, the m by n C, m by k A and k by n B with their
+ * leading dimensions. Large products are split between the
+ * threads of ws along the columns of C, or its rows if it
+ * has fewer columns than rows
+ */
+  static void
+Lu_Gemm( lu_work_t *ws, int m, int n, int k,
+    const complex double *a, int lda, const complex double *b, int ldb,
+    complex double *c, int ldc )
+{
+  lu_gemm_t *part = NULL;
+  pthread_t *thrd = NULL;
+  gboolean by_cols;
+  int nthr, num, idx, lo, hi, started;
+
+  if( (m <= 0) || (n <= 0) || (k <= 0) )
+    return;
+
+  by_cols = ( n >= m );
+  nthr = ws->nthr;
+  num  = ( by_cols ? n : m ) / LU_THREAD_MIN;
+  if( nthr > num )
+    nthr = num;
+  if( (double)m * (double)n * (double)k < LU_THREADED )
+    nthr = 1;
+  if( nthr < 1 )
+    nthr = 1;
+
+  size_t mreq = (size_t)nthr * sizeof(lu_gemm_t);
+  mem_alloc( (void **)&part, mreq, "in matrix_lu.c" );
+  for( idx = 0; idx < nthr; idx++ )
+  {
+    lo = (int)( (long)(by_cols ? n : m) * idx / nthr );
+    hi = (int)( (long)(by_cols ? n : m) * (idx + 1) / nthr );
+
+    part[idx].k    = k;
+    part[idx].lda  = lda;
+    part[idx].ldb  = ldb;
+    part[idx].ldc  = ldc;
+    part[idx].pack = NULL;
+    if( ws->pack != NULL )
+      part[idx].pack = &ws->pack[(size_t)idx * LU_PACK_SIZE];
+    if( by_cols )
+    {
+      part[idx].m = m;
+      part[idx].n = hi - lo;
+      part[idx].a = a;
+      part[idx].b = &b[(size_t)lo * (size_t)ldb];
+      part[idx].c = &c[(size_t)lo * (size_t)ldc];
+    }
+    else
+    {
+      part[idx].m = hi - lo;
+      part[idx].n = n;
+      part[idx].a = &a[lo];
+      part[idx].b = b;
+      part[idx].c = &c[lo];
+    }
+  }
+
+  /* The calling thread does the first share */
+  started = 0;
+  if( nthr > 1 )
+  {
+    mreq = (size_t)(nthr-1) * sizeof(pthread_t);
+    mem_alloc( (void **)&thrd, mreq, "in matrix_lu.c" );
+    for( started = 0; started < nthr-1; started++ )
+      if( pthread_create(&thrd[started], NULL, Lu_Gemm_Thread, &part[started+1]) != 0 )
+      {
+        perror( "xnec2c: pthread_create()" );
+        break;
+      }
+  }
+
+  Lu_Gemm_Serial( &part[0] );
+  for( idx = started + 1; idx < nthr; idx++ )
+    Lu_Gemm_Serial( &part[idx] );
+
+  while( started-- > 0 )
+    pthread_join( thrd[started], NULL );
+
+  free_ptr( (void **)&thrd );
+  free_ptr( (void **)&part );
+
+} /* Lu_Gemm() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Trsm_Lower()
+ *
+ * Solves L*X = B in place of the n by ncol B, L being the
+ * unit lower triangle of the n by n l, by halves of L
+ */
+  static void
+Lu_Trsm_Lower( lu_work_t *ws, int n, int ncol, const complex double *l,
+    int ldl, complex double *b, int ldb )
+{
+  complex double *bc;
+  int c, j, n1;
+
+  if( n <= LU_TRSM_COLS )
+  {
+    for( c = 0; c < ncol; c++ )
+    {
+      bc = &b[(size_t)c * (size_t)ldb];
+      for( j = 0; j < n; j++ )
+        if( bc[j] != CPLX_00 )
+          Lu_Axpy( n - j - 1, bc[j], &l[j + 1 + (size_t)j * (size_t)ldl], &bc[j + 1] );
+    }
+    return;
+  }
+
+  n1 = n / 2;
+  Lu_Trsm_Lower( ws, n1, ncol, l, ldl, b, ldb );
+  Lu_Gemm( ws, n - n1, ncol, n1, &l[n1], ldl, b, ldb, &b[n1], ldb );
+  Lu_Trsm_Lower( ws, n - n1, ncol,
+      &l[n1 + (size_t)n1 * (size_t)ldl], ldl, &b[n1], ldb );
+
+} /* Lu_Trsm_Lower() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Trsm_Upper()
+ *
+ * Solves U*X = B in place of the n by ncol B, U being the
+ * upper triangle of the n by n u, by halves of U
+ */
+  static void
+Lu_Trsm_Upper( lu_work_t *ws, int n, int ncol, const complex double *u,
+    int ldu, complex double *b, int ldb )
+{
+  complex double *bc;
+  int c, j, n1;
+
+  if( n <= LU_TRSM_COLS )
+  {
+    for( c = 0; c < ncol; c++ )
+    {
+      bc = &b[(size_t)c * (size_t)ldb];
+      for( j = n - 1; j >= 0; j-- )
+      {
+        bc[j] /= u[j + (size_t)j * (size_t)ldu];
+        if( bc[j] != CPLX_00 )
+          Lu_Axpy( j, bc[j], &u[(size_t)j * (size_t)ldu], bc );
+      }
+    }
+    return;
+  }
+
+  n1 = n / 2;
+  Lu_Trsm_Upper( ws, n - n1, ncol,
+      &u[n1 + (size_t)n1 * (size_t)ldu], ldu, &b[n1], ldb );
+  Lu_Gemm( ws, n1, ncol, n - n1,
+      &u[(size_t)n1 * (size_t)ldu], ldu, &b[n1], ldb, b, ldb );
+  Lu_Trsm_Upper( ws, n1, ncol, u, ldu, b, ldb );
+
+} /* Lu_Trsm_Upper() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Unblocked()
+ *
+ * LU with partial pivoting of the m by n (m >= n) a, one column
+ * at a time, as zgetf2() of LAPACK. Returns 0, or the column of
+ * the first zero pivot
+ */
+  static int
+Lu_Unblocked( int m, int n, complex double *a, int lda, int *ip )
+{
+  complex double x, *aj, *ac;
+  double amax, aa;
+  int info = 0, i, j, c, p;
+
+  for( j = 0; j < n; j++ )
+  {
+    aj = &a[(size_t)j * (size_t)lda];
+
+    p = j;
+    amax = 0.0;
+    for( i = j; i < m; i++ )
+    {
+      aa = creal(aj[i]) * creal(aj[i]) + cimag(aj[i]) * cimag(aj[i]);
+      if( aa > amax )
+      {
+        amax = aa;
+        p = i;
+      }
+    }
+    ip[j] = p + 1;
+
+    if( amax == 0.0 )
+    {
+      if( info == 0 ) info = j + 1;
+      continue;
+    }
+
+    if( p != j )
+      for( c = 0; c < n; c++ )
+      {
+        ac = &a[(size_t)c * (size_t)lda];
+        x     = ac[j];
+        ac[j] = ac[p];
+        ac[p] = x;
+      }
+
+    x = 1.0 / aj[j];
+    for( i = j + 1; i < m; i++ )
+      aj[i] *= x;
+
+    for( c = j + 1; c < n; c++ )
+    {
+      ac = &a[(size_t)c * (size_t)lda];
+      if( ac[j] != CPLX_00 )
+        Lu_Axpy( m - j - 1, ac[j], &aj[j + 1], &ac[j + 1] );
+    }
+  }
+
+  return( info );
+} /* Lu_Unblocked() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Recursive()
+ *
+ * Recursive LU with partial pivoting of the m by n (m >= n) a,
+ * factoring the left half of the columns, updating the right
+ * half with it and factoring that in turn
+ */
+  static int
+Lu_Recursive( lu_work_t *ws, int m, int n, complex double *a, int lda, int *ip )
+{
+  complex double *a12, *a22;
+  int n1, n2, i, info, info2;
+
+  if( n <= LU_COLS )
+    return( Lu_Unblocked(m, n, a, lda, ip) );
+
+  n1 = n / 2;
+  n2 = n - n1;
+  a12 = &a[(size_t)n1 * (size_t)lda];
+  a22 = &a12[n1];
+
+  /* Factor the left half and update the right one with it */
+  info = Lu_Recursive( ws, m, n1, a, lda, ip );
+  Matrix_Lu_Swap( a12, lda, n2, ip, 0, n1 );
+  Lu_Trsm_Lower( ws, n1, n2, a, lda, a12, lda );
+  Lu_Gemm( ws, m - n1, n2, n1, &a[n1], lda, a12, lda, a22, lda );
+
+  /* Factor the right half and apply its swaps to the left one */
+  info2 = Lu_Recursive( ws, m - n1, n2, a22, lda, &ip[n1] );
+  if( (info == 0) && (info2 != 0) )
+    info = info2 + n1;
+  for( i = n1; i < n; i++ )
+    ip[i] += n1;
+  Matrix_Lu_Swap( a, lda, n1, ip, n1, n );
+
+  return( info );
+} /* Lu_Recursive() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Lu_Work_Alloc()
+ *
+ * Sets the threads for a problem of about ops complex multiply-
+ * adds and allocates their packing buffers, if packed is TRUE.
+ * The threads are shared with the other concurrent factorizations
+ */
+  static void
+Lu_Work_Alloc( lu_work_t *ws, double ops, gboolean packed )
+{
+  ws->nthr = ( lu_threads > 0 ) ? lu_threads : rc_config.fill_threads;
+  ws->nthr /= lu_concurrent;
+  if( (ws->nthr < 1) || (ops < LU_THREADED) )
+    ws->nthr = 1;
+
+  ws->pack = NULL;
+  if( !packed ) return;
+  size_t mreq = (size_t)ws->nthr * LU_PACK_SIZE * sizeof(complex double);
+  mem_alloc( (void **)&ws->pack, mreq, "in matrix_lu.c" );
+
+} /* Lu_Work_Alloc() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Set_Threads()
+ *
+ * Sets the threads of the builtin LU, 0 for --fill-threads
+ */
+  void
+Matrix_Lu_Set_Threads( int threads )
+{
+  lu_threads = threads;
+} /* Matrix_Lu_Set_Threads() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Set_Concurrent()
+ *
+ * Sets the number of factorizations that run at once, between
+ * which the threads of the builtin LU are divided. Only changed
+ * while none of them is running
+ */
+  void
+Matrix_Lu_Set_Concurrent( int num )
+{
+  lu_concurrent = ( num > 1 ) ? num : 1;
+} /* Matrix_Lu_Set_Concurrent() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Swap()
+ *
+ * Applies the row swaps k1 to k2-1 of ip (1 based,
+ * in order) to ncol columns of a with leading dimension lda
+ */
+  void
+Matrix_Lu_Swap( complex double *a, int lda, int ncol, const int *ip, int k1, int k2 )
+{
+  complex double tmp, *col;
+  int c, i, p;
+
+  for( c = 0; c < ncol; c++ )
+  {
+    col = &a[(size_t)c * (size_t)lda];
+    for( i = k1; i < k2; i++ )
+    {
+      p = ip[i] - 1;
+      if( p == i ) continue;
+      tmp    = col[i];
+      col[i] = col[p];
+      col[p] = tmp;
+    }
+  }
+
+} /* Matrix_Lu_Swap() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Gemm()
+ *
+ * C -= A*B, see Lu_Gemm()
+ */
+  void
+Matrix_Lu_Gemm( int m, int n, int k, const complex double *a, int lda,
+    const complex double *b, int ldb, complex double *c, int ldc )
+{
+  lu_work_t ws;
+
+  Lu_Work_Alloc( &ws, (double)m * (double)n * (double)k, n >= LU_PACKED_COLS );
+  Lu_Gemm( &ws, m, n, k, a, lda, b, ldb, c, ldc );
+  free_ptr( (void **)&ws.pack );
+
+} /* Matrix_Lu_Gemm() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Trsm()
+ *
+ * Solves L*X = B for unit lower L, see Lu_Trsm_Lower()
+ */
+  void
+Matrix_Lu_Trsm( int n, int ncol, const complex double *l, int ldl,
+    complex double *b, int ldb )
+{
+  lu_work_t ws;
+
+  Lu_Work_Alloc( &ws, (double)n * (double)n * (double)ncol / 2.0,
+      ncol >= LU_PACKED_COLS );
+  Lu_Trsm_Lower( &ws, n, ncol, l, ldl, b, ldb );
+  free_ptr( (void **)&ws.pack );
+
+} /* Matrix_Lu_Trsm() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Factor()
+ *
+ * LU factorization with partial pivoting of the m by n (m >= n)
+ * a of leading dimension lda, as zgetrf() of LAPACK. Returns 0,
+ * or the column of the first zero pivot
+ */
+  int
+Matrix_Lu_Factor( int m, int n, complex double *a, int lda, int *ip )
+{
+  lu_work_t ws;
+  int info;
+
+  Lu_Work_Alloc( &ws, (double)m * (double)n * (double)n / 2.0, TRUE );
+  info = Lu_Recursive( &ws, m, n, a, lda, ip );
+  free_ptr( (void **)&ws.pack );
+
+  return( info );
+} /* Matrix_Lu_Factor() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Lu_Solve()
+ *
+ * Solves A*X = B in place of the n by nrhs B with the factors
+ * and pivots of the n by n A from Matrix_Lu_Factor(), as zgetrs()
+ */
+  int
+Matrix_Lu_Solve( int n, int nrhs, complex double *a, int lda, int *ip,
+    complex double *b, int ldb )
+{
+  lu_work_t ws;
+
+  Lu_Work_Alloc( &ws, (double)n * (double)n * (double)nrhs,
+      nrhs >= LU_PACKED_COLS );
+  Matrix_Lu_Swap( b, ldb, nrhs, ip, 0, n );
+  Lu_Trsm_Lower( &ws, n, nrhs, a, lda, b, ldb );
+  Lu_Trsm_Upper( &ws, n, nrhs, a, lda, b, ldb );
+  free_ptr( (void **)&ws.pack );
+
+  return( 0 );
+} /* Matrix_Lu_Solve() */
+
+/*-----------------------------------------------------------------------*/
+
@@ -0,0 +1,90 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef MATRIX_LU_H
+#define MATRIX_LU_H    1
+
+#include "common.h"
+#include <pthread.h>
+
+/* SIMD micro-kernels selected at run time on x86 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LU_X86    1
+#endif
+
+/* Columns of a panel factored, and order of a
+ * triangle solved, without further recursion */
+#define LU_COLS         16
+#define LU_TRSM_COLS    32
+
+/* Blocking of the matrix product for the caches: rows of A
+ * (a multiple of all LU_MR) and columns of B packed, and their
+ * inner dimension. A block of A stays in L2, a panel of B in L3 */
+#define LU_MC           96
+#define LU_NC           512
+#define LU_KC           128
+
+/* Largest tile of C of the micro-kernels */
+#define LU_MR_MAX       8
+#define LU_NR_MAX       4
+
+/* Products with fewer columns are not packed */
+#define LU_PACKED_COLS  4
+
+/* Smallest matrix product, in complex multiply-adds, split
+ * between the threads, and the smallest share of a thread */
+#define LU_THREADED     1.0E6
+#define LU_THREAD_MIN   32
+
+/* A micro-kernel: C -= A*B for an mr by nr tile of C of leading
+ * dimension ldc, A and B packed by Lu_Pack_A() and Lu_Pack_B() */
+typedef void (*lu_kernel_t)( int kc, const double *ap, const double *bp,
+    double *c, int ldc );
+
+typedef struct
+{
+  const char *name;
+  int mr, nr;
+  lu_kernel_t func;
+
+} lu_kernel_desc_t;
+
+/* Workspace of the factoring and solving threads, with
+ * the packed blocks of A and B of each thread */
+typedef struct
+{
+  int nthr;
+  complex double *pack;
+
+} lu_work_t;
+
+/* A matrix product C -= A*B, or the share of a thread */
+typedef struct
+{
+  int m, n, k, lda, ldb, ldc;
+  const complex double *a, *b;
+  complex double *c;
+
+  /* Packing buffers of the thread */
+  complex double *pack;
+
+} lu_gemm_t;
+
+#endif
+
@@ -0,0 +1,592 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Out-of-core interaction matrix. With --out-of-core, a matrix
+ * larger than the memory budget is kept in a temporary file
+ * instead of cm. It is filled by cmset_columns() a panel of
+ * observation columns at a time, as wide as the budget allows,
+ * and each symmetry mode block of the panel is updated with the
+ * factors of the panels to its left (a left looking blocked LU),
+ * factored in memory by zgetrf() and written to the file. The
+ * factored panels are read back by a prefetch thread while the
+ * previous one is being used, so that the disk and the CPU work
+ * at the same time, and the solutions stream them the same way.
+ *
+ * The matrix is filled and stored transposed, as in NEC2, so each
+ * block is factored as B = A^T = P*L*U and A*x = b is solved as
+ * U^T*L^T*P^T*x = b. The row swaps of a panel are applied to
+ * the panels on its left only when they are read back, which
+ * saves a pass over the whole file at the end of the factoring.
+ */
+
+#include "matrix_ooc.h"
+#include "shared.h"
+#include "utils.h"
+#include "mathlib.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Descriptor of the unlinked matrix file, -1 until it is
+ * created, and the process that created it, since forked
+ * processes would otherwise share the same file */
+static int ooc_fd = -1;
+static pid_t ooc_pid = 0;
+
+/* Rows and columns of the matrix, 0 if it is kept in
+ * cm, width of the panels factored and memory budget */
+static int ooc_nrow = 0, ooc_ncol = 0;
+static int ooc_width = 0;
+static size_t ooc_budget = 0;
+
+/* Set to 1 by Ooc_Io() on a read or write error, which may be
+ * in the prefetch threads, and to 2 once Stop() has been called */
+static gint ooc_failed = 0;
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Close()
+ *
+ * Closes the matrix file, which is removed with it
+ */
+  void
+Matrix_Ooc_Close( void )
+{
+  if( ooc_fd >= 0 )
+    close( ooc_fd );
+  ooc_fd = -1;
+
+} /* Matrix_Ooc_Close() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Open()
+ *
+ * Decides if an interaction matrix of nrow by ncol elements is
+ * to be kept in a file, when it is larger than the --out-of-core
+ * budget. Returns TRUE if so, in which case cm is not needed.
+ * The file is only created by the process that fills the matrix
+ */
+  gboolean
+Matrix_Ooc_Open( int nrow, int ncol )
+{
+  size_t size = (size_t)nrow * (size_t)ncol * sizeof(complex double);
+
+  Matrix_Ooc_Close();
+  ooc_nrow = ooc_ncol = 0;
+  ooc_budget = (size_t)rc_config.ooc_mb << 20;
+  if( (rc_config.ooc_mb <= 0) || (size <= ooc_budget) )
+    return( FALSE );
+
+  /* The panel factored and two panels read back */
+  ooc_width = (int)( ooc_budget /
+      ((size_t)(nrow + 2 * ncol) * sizeof(complex double)) );
+  if( ooc_width < 1 )
+    ooc_width = 1;
+  if( ooc_width > ncol )
+    ooc_width = ncol;
+
+  if( rc_config.mixed_precision )
+    pr_notice( "--mixed-precision is not used for out-of-core matrices\n" );
+
+  ooc_nrow = nrow;
+  ooc_ncol = ncol;
+  return( TRUE );
+
+} /* Matrix_Ooc_Open() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_File_Create()
+ *
+ * Creates the matrix file in this process, if it has not yet.
+ * Returns FALSE, after Stop(), if it could not be created
+ */
+  static gboolean
+Ooc_File_Create( void )
+{
+  size_t size = (size_t)ooc_nrow * (size_t)ooc_ncol * sizeof(complex double);
+  char fname[FILENAME_LEN], mesg[MESG_SIZE];
+  const char *dir;
+  int err;
+
+  if( (ooc_fd >= 0) && (ooc_pid == getpid()) )
+    return( TRUE );
+
+  /* Not the file of the process this one was forked from */
+  Matrix_Ooc_Close();
+
+  dir = getenv( "TMPDIR" );
+  if( (dir == NULL) || (dir[0] == '\0') )
+    dir = "/tmp";
+  snprintf( fname, sizeof(fname), "%s/xnec2c-matrix-XXXXXX", dir );
+
+  ooc_fd = mkstemp( fname );
+  if( ooc_fd < 0 )
+  {
+    pr_err( "cannot create out-of-core matrix file %s: %s\n",
+        fname, strerror(errno) );
+    Stop( _("Cannot create the out-of-core matrix file"), ERR_STOP );
+    return( FALSE );
+  }
+  unlink( fname );
+
+  /* Reserve the disk space now rather than fail half way */
+  err = posix_fallocate( ooc_fd, 0, (off_t)size );
+  if( err != 0 )
+  {
+    Matrix_Ooc_Close();
+    snprintf( mesg, sizeof(mesg),
+        _("Cannot allocate %.1f MB for the out-of-core matrix in %s: %s"),
+        (double)size / 1048576.0, dir, strerror(err) );
+    pr_err( "%s\n", mesg );
+    Stop( mesg, ERR_STOP );
+    return( FALSE );
+  }
+
+  ooc_pid = getpid();
+  pr_info( "out-of-core matrix of %.1f MB in %s, in panels of %d columns\n",
+      (double)size / 1048576.0, dir, ooc_width );
+
+  return( TRUE );
+} /* Ooc_File_Create() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Failed()
+ *
+ * Returns TRUE if reading or writing the matrix file failed
+ * since it was last filled, as the factors are then wrong.
+ * Calls Stop() the first time, so not from worker threads
+ */
+  gboolean
+Matrix_Ooc_Failed( void )
+{
+  int failed = g_atomic_int_get( &ooc_failed );
+
+  if( failed == 1 )
+  {
+    g_atomic_int_set( &ooc_failed, 2 );
+    Stop( _("Reading or writing the out-of-core matrix file failed"), ERR_STOP );
+  }
+
+  return( failed != 0 );
+} /* Matrix_Ooc_Failed() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Active()
+ *
+ * Returns TRUE if the interaction matrix is kept in the file
+ */
+  gboolean
+Matrix_Ooc_Active( void )
+{
+  return( ooc_nrow > 0 );
+} /* Matrix_Ooc_Active() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Io()
+ *
+ * Writes (write TRUE) or reads len bytes of buf at offset
+ * off of the matrix file. Returns FALSE on errors
+ */
+  static gboolean
+Ooc_Io( gboolean write, void *buf, size_t len, off_t off )
+{
+  char *ptr = (char *)buf;
+  ssize_t ret;
+
+  while( len > 0 )
+  {
+    if( write )
+      ret = pwrite( ooc_fd, ptr, len, off );
+    else
+      ret = pread( ooc_fd, ptr, len, off );
+
+    if( (ret < 0) && (errno == EINTR) )
+      continue;
+    if( ret <= 0 )
+    {
+      pr_err( "out-of-core matrix file %s failed: %s\n",
+          write ? "write" : "read",
+          (ret < 0) ? strerror(errno) : "end of file" );
+      g_atomic_int_compare_and_exchange( &ooc_failed, 0, 1 );
+      return( FALSE );
+    }
+
+    ptr += ret;
+    off += ret;
+    len -= (size_t)ret;
+  }
+
+  return( TRUE );
+} /* Ooc_Io() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Panel_Read()
+ *
+ * Reads the rows of the columns of pan from the matrix file
+ */
+  static void
+Ooc_Panel_Read( ooc_panel_t *pan )
+{
+  int np = ooc_ncol, j, col, lo, hi;
+  size_t bytes = 0;
+  off_t off;
+
+  for( j = 0; j < pan->w; j++ )
+  {
+    col = pan->c0 + j;
+    switch( pan->rows )
+    {
+      case OOC_ROWS_UPPER:
+        lo = 0;
+        hi = col + 1;
+        break;
+
+      case OOC_ROWS_LOWER:
+        lo = col + 1;
+        hi = np;
+        break;
+
+      default:
+        lo = pan->lo;
+        hi = np;
+    }
+    if( lo >= hi )
+      continue;
+
+    off = ( (off_t)col * ooc_nrow + (off_t)pan->blk * np + lo ) *
+      (off_t)sizeof(complex double);
+    if( !Ooc_Io(FALSE, &pan->buf[lo + (size_t)j * (size_t)np],
+          (size_t)(hi - lo) * sizeof(complex double), off) )
+      break;
+    bytes += (size_t)(hi - lo) * sizeof(complex double);
+  }
+
+  Perf_Count_Bytes( pan->phase, bytes );
+
+} /* Ooc_Panel_Read() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Panel_Thread()
+ *
+ * Entry point of the prefetch thread of a panel
+ */
+  static void *
+Ooc_Panel_Thread( void *arg )
+{
+  Ooc_Panel_Read( (ooc_panel_t *)arg );
+  return( NULL );
+} /* Ooc_Panel_Thread() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Panel_Start()
+ *
+ * Starts reading w columns of mode block blk from column c0,
+ * the rows given by rows and lo, into pan in the background
+ */
+  static void
+Ooc_Panel_Start( ooc_panel_t *pan, int blk, int c0, int w,
+    int rows, int lo, int phase )
+{
+  pan->blk   = blk;
+  pan->c0    = c0;
+  pan->w     = w;
+  pan->rows  = rows;
+  pan->lo    = lo;
+  pan->phase = phase;
+
+  pan->busy = ( pthread_create(&pan->thrd, NULL, Ooc_Panel_Thread, pan) == 0 );
+  if( !pan->busy )
+    Ooc_Panel_Read( pan );
+
+} /* Ooc_Panel_Start() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Panel_Wait()
+ *
+ * Waits for the columns of pan to be read
+ */
+  static void
+Ooc_Panel_Wait( ooc_panel_t *pan )
+{
+  if( pan->busy )
+    pthread_join( pan->thrd, NULL );
+  pan->busy = FALSE;
+
+} /* Ooc_Panel_Wait() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Ooc_Lu()
+ *
+ * Factors a panel with the selected mathlib, or with the builtin
+ * blocked LU if it is the NEC2 one, which only factors squares
+ */
+  static int
+Ooc_Lu( int m, int n, complex double *a, int lda, int *ip )
+{
+  int info, i;
+
+  if( (current_mathlib == NULL) || (current_mathlib->type == MATHLIB_NEC2) )
+    return( Matrix_Lu_Factor(m, n, a, lda, ip) );
+
+  info = zgetrf( CblasColMajor, m, n, a, lda, ip );
+
+  /* The clapack pivots of ATLAS are 0 based */
+  if( current_mathlib->type == MATHLIB_ATLAS )
+    for( i = 0; i < n; i++ )
+      ip[i]++;
+
+  return( info );
+} /* Ooc_Lu() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Fill_Factor()
+ *
+ * Fills and factors the np by np symmetry mode blocks of the
+ * matrix of nrow rows into the matrix file, a panel of columns
+ * at a time, leaving the pivots in ip as factrs() does. It
+ * stops at the first error of the file, after calling Stop()
+ */
+  void
+Matrix_Ooc_Fill_Factor( int np, int nrow, int *ip, double rkh, int iexk )
+{
+  complex double *pnl = NULL, *a, *q;
+  ooc_panel_t rd[2];
+  perf_mark_t mark;
+  size_t mreq;
+  int nop, w, c0, k, npan, iq, d0, d1, s, cur, info, i;
+  int *ipk;
+
+  g_atomic_int_set( &ooc_failed, 0 );
+  if( !Ooc_File_Create() )
+  {
+    g_atomic_int_set( &ooc_failed, 2 );
+    return;
+  }
+
+  nop = nrow / np;
+  mreq = (size_t)nrow * (size_t)ooc_width * sizeof(complex double);
+  mem_alloc( (void **)&pnl, mreq, "in matrix_ooc.c" );
+  mreq = (size_t)np * (size_t)ooc_width * sizeof(complex double);
+  rd[0].buf = rd[1].buf = NULL;
+  mem_alloc( (void **)&rd[0].buf, mreq, "in matrix_ooc.c" );
+  mem_alloc( (void **)&rd[1].buf, mreq, "in matrix_ooc.c" );
+  rd[0].busy = rd[1].busy = FALSE;
+
+  for( c0 = 0; c0 < np; c0 += ooc_width )
+  {
+    w = np - c0;
+    if( w > ooc_width )
+      w = ooc_width;
+
+    /* The panels on the left are read back in the order
+     * they are used, starting while this one is filled */
+    npan = c0 / ooc_width;
+    cur  = 0;
+    if( npan > 0 )
+      Ooc_Panel_Start( &rd[0], 0, 0, ooc_width, OOC_ROWS_BELOW, 0, PERF_FACTOR );
+
+    Perf_Start( &mark );
+    cmset_columns( nrow, pnl, c0 + 1, c0 + w, rkh, iexk, TRUE );
+    Perf_Stop( &mark, PERF_FILL );
+
+    for( k = 0; k < nop; k++ )
+    {
+      a   = &pnl[k * np];
+      ipk = &ip[k * np];
+
+      /* Update with the factors of the panels on the left, in
+       * the row order left by all their swaps, as is L once the
+       * swaps of the later panels are applied to it too */
+      Matrix_Lu_Swap( a, nrow, w, ipk, 0, c0 );
+      for( iq = 0; iq < npan; iq++ )
+      {
+        d0 = iq * ooc_width;
+        d1 = d0 + ooc_width;
+
+        Ooc_Panel_Wait( &rd[cur] );
+        s = k * npan + iq + 1;
+        if( s < nop * npan )
+          Ooc_Panel_Start( &rd[1-cur], s / npan, (s % npan) * ooc_width,
+              ooc_width, OOC_ROWS_BELOW, (s % npan) * ooc_width, PERF_FACTOR );
+
+        /* Swaps of the panels factored after the one read */
+        q = rd[cur].buf;
+        Matrix_Lu_Swap( q, np, ooc_width, ipk, d1, c0 );
+
+        Matrix_Lu_Trsm( ooc_width, w, &q[d0], np, &a[d0], nrow );
+        Matrix_Lu_Gemm( np - d1, w, ooc_width, &q[d1], np, &a[d0], nrow, &a[d1], nrow );
+
+        cur = 1 - cur;
+      }
+
+      /* Factor the panel below the diagonal */
+      info = Ooc_Lu( np - c0, w, &a[c0], nrow, &ipk[c0] );
+      if( info != 0 )
+        pr_err( "LU Decomposition Failed: mode block %d column %d\n",
+            k + 1, c0 + info );
+      for( i = c0; i < c0 + w; i++ )
+        ipk[i] += c0;
+    }
+
+    mreq = (size_t)nrow * (size_t)w * sizeof(complex double);
+    Ooc_Io( TRUE, pnl, mreq, (off_t)c0 * nrow * (off_t)sizeof(complex double) );
+    Perf_Count_Bytes( PERF_FACTOR, mreq );
+
+    /* The next panels would be updated with wrong factors */
+    if( Matrix_Ooc_Failed() )
+      break;
+  }
+
+  free_ptr( (void **)&rd[0].buf );
+  free_ptr( (void **)&rd[1].buf );
+  free_ptr( (void **)&pnl );
+
+} /* Matrix_Ooc_Fill_Factor() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Matrix_Ooc_Solve()
+ *
+ * Solves the nrh right hand sides, of leading dimension ldb, of
+ * symmetry mode block blk with its np by np factors and pivots
+ * ip, reading the factors from the matrix file in two passes.
+ * Errors are left for Matrix_Ooc_Failed(), as it may be called
+ * by the threads of the mode blocks
+ */
+  void
+Matrix_Ooc_Solve( int blk, int np, int *ip, complex double *b, int nrh, int ldb )
+{
+  complex double *u, *bc, sum, tmp;
+  ooc_panel_t rd[2];
+  size_t mreq;
+  int nthr, ws, npan, p, c0, cur, j, col, r, i, d1;
+
+  /* The factors are wrong or missing */
+  if( g_atomic_int_get(&ooc_failed) )
+    return;
+
+  /* Buffers of the mode blocks solved at the same time */
+  nthr = rc_config.fill_threads;
+  if( nthr > smat.nop )
+    nthr = smat.nop;
+  if( nthr < 1 )
+    nthr = 1;
+  ws = (int)( ooc_budget / ((size_t)(2 * nthr * np) * sizeof(complex double)) );
+  if( ws < 1 )
+    ws = 1;
+  if( ws > np )
+    ws = np;
+  npan = (np + ws - 1) / ws;
+
+  mreq = (size_t)np * (size_t)ws * sizeof(complex double);
+  rd[0].buf = rd[1].buf = NULL;
+  mem_alloc( (void **)&rd[0].buf, mreq, "in matrix_ooc.c" );
+  mem_alloc( (void **)&rd[1].buf, mreq, "in matrix_ooc.c" );
+
+  /* U^T*y = b, forward from the first column */
+  cur = 0;
+  Ooc_Panel_Start( &rd[0], blk, 0, ws, OOC_ROWS_UPPER, 0, PERF_SOLVE );
+  for( p = 0; p < npan; p++ )
+  {
+    Ooc_Panel_Wait( &rd[cur] );
+    c0 = (p + 1) * ws;
+    if( c0 < np )
+      Ooc_Panel_Start( &rd[1-cur], blk, c0, MIN(ws, np - c0),
+          OOC_ROWS_UPPER, 0, PERF_SOLVE );
+
+    for( j = 0; j < rd[cur].w; j++ )
+    {
+      col = rd[cur].c0 + j;
+      u = &rd[cur].buf[(size_t)j * (size_t)np];
+      for( r = 0; r < nrh; r++ )
+      {
+        bc = &b[(size_t)r * (size_t)ldb];
+        sum = CPLX_00;
+        for( i = 0; i < col; i++ )
+          sum += u[i] * bc[i];
+        bc[col] = ( bc[col] - sum ) / u[col];
+      }
+    }
+    cur = 1 - cur;
+  }
+
+  /* L^T*z = y, backward from the last column */
+  c0 = (npan - 1) * ws;
+  Ooc_Panel_Start( &rd[cur], blk, c0, np - c0, OOC_ROWS_LOWER, 0, PERF_SOLVE );
+  for( p = npan - 1; p >= 0; p-- )
+  {
+    Ooc_Panel_Wait( &rd[cur] );
+    if( p > 0 )
+      Ooc_Panel_Start( &rd[1-cur], blk, (p - 1) * ws, ws,
+          OOC_ROWS_LOWER, 0, PERF_SOLVE );
+
+    for( j = rd[cur].w - 1; j >= 0; j-- )
+    {
+      col = rd[cur].c0 + j;
+      u = &rd[cur].buf[(size_t)j * (size_t)np];
+
+      /* Swaps of the panels factored after this column */
+      d1 = ( col / ooc_width + 1 ) * ooc_width;
+      if( d1 < np )
+        Matrix_Lu_Swap( u, np, 1, ip, d1, np );
+
+      for( r = 0; r < nrh; r++ )
+      {
+        bc = &b[(size_t)r * (size_t)ldb];
+        sum = CPLX_00;
+        for( i = col + 1; i < np; i++ )
+          sum += u[i] * bc[i];
+        bc[col] -= sum;
+      }
+    }
+    cur = 1 - cur;
+  }
+
+  /* x = P*z, the swaps in reverse order */
+  for( r = 0; r < nrh; r++ )
+  {
+    bc = &b[(size_t)r * (size_t)ldb];
+    for( i = np - 1; i >= 0; i-- )
+    {
+      j = ip[i] - 1;
+      if( j == i ) continue;
+      tmp   = bc[i];
+      bc[i] = bc[j];
+      bc[j] = tmp;
+    }
+  }
+
+  free_ptr( (void **)&rd[0].buf );
+  free_ptr( (void **)&rd[1].buf );
+
+} /* Matrix_Ooc_Solve() */
+
+/*-----------------------------------------------------------------------*/
+
@@ -0,0 +1,55 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef MATRIX_OOC_H
+#define MATRIX_OOC_H    1
+
+#include "common.h"
+#include <pthread.h>
+
+/* Rows of the columns of a panel read from the matrix file */
+enum OOC_ROWS
+{
+  OOC_ROWS_BELOW = 0, /* From row lo down, for the panel updates */
+  OOC_ROWS_UPPER,     /* U above and on the diagonal */
+  OOC_ROWS_LOWER      /* L below the diagonal */
+};
+
+/* A panel of factored columns of a mode block, read from the matrix
+ * file by a prefetch thread while the previous one is being used */
+typedef struct
+{
+  int
+    blk,  /* Symmetry mode block */
+    c0,   /* First column of the panel in the block */
+    w,    /* Columns in the panel */
+    rows, /* See enum OOC_ROWS */
+    lo,   /* First row read, for OOC_ROWS_BELOW */
+    phase;/* Solver phase the bytes read are counted in */
+
+  /* Columns of the block order, at their row index */
+  complex double *buf;
+
+  pthread_t thrd;
+  gboolean busy;
+
+} ooc_panel_t;
+
+#endif
+
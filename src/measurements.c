@@ -54,8 +54,7 @@ void meas_calc(measurement_t *m, int idx)
 
 	double complex cs11 = 20*clog10( cgamma );
 
-	double fbdir;
-	int fbidx, nth, nph;
+	int fbidx;
 
 	// Start with invalidated values (-1) in case something cannot be
 	// calculated due to NEC state or card configuration:
@@ -100,7 +99,9 @@ void meas_calc(measurement_t *m, int idx)
 		mem_backtrace(rad_pattern[idx].max_gain_idx);
 		return;
 	}
-	m->gain_max = rad_pattern[idx].gtot[mgidx] + Polarization_Factor(pol, idx, mgidx);
+	// The gains come from the summary of the pattern, which
+	// is kept in memory for all steps even with --rdpat-mb
+	m->gain_max = rad_pattern[idx].max_gain[pol];
 	m->gain_net = m->gain_max + net_gain_adjust;
 
 	m->gain_viewer = Viewer_Gain(structure_proj_params, idx);
@@ -109,44 +110,18 @@ void meas_calc(measurement_t *m, int idx)
 	m->gain_max_theta = 90.0 - rad_pattern[idx].max_gain_tht[pol];
 	m->gain_max_phi = rad_pattern[idx].max_gain_phi[pol];
 
-	// Find F/B direction in theta
-	fbdir = 180.0 - rad_pattern[idx].max_gain_tht[pol];
-	if (fpat.dth == 0.0)
-		nth = 0;
-	else
-		nth = (int) (fbdir / fpat.dth + 0.5);
-
-	/* If the antenna is modelled over ground, then use the same
-	   theta as the max gain direction, relying on phi alone to take
-	   us to the back. Patch supplied by Rik van Riel AB1KW */
-	if ((nth >= fpat.nth) || (nth < 0))
-	{
-		fbdir = rad_pattern[idx].max_gain_tht[pol];
-		if (fpat.dth == 0.0)
-			nth = 0;
-		else
-			nth = (int) (fbdir / fpat.dth + 0.5);
-	}
-
-	// Find F/B direction in phi
-	fbdir = m->gain_max_phi + 180.0;
-	if (fbdir >= 360.0)
-		fbdir -= 360.0;
-	nph = (int) (fbdir / fpat.dph + 0.5);
-
-	// No F/B calc. possible if no phi step at +180 from max gain
-	if ((nph >= fpat.nph) || (nph < 0))
+	// No F/B calc. possible if no phi step at +180 from max gain,
+	// see Rdpat_Back_Gain() for the F/B direction
+	fbidx = rad_pattern[idx].back_gain_idx[pol];
+	if (fbidx < 0)
 	{
 		m->fb_ratio = -1;
 	}
 	else
 	{
-		// Index to gtot buffer for gain in back direction
-		fbidx = nth + nph * fpat.nth;
-
 		// Front to back ratio 
 		m->fb_ratio = pow(10.0, m->gain_max / 10.0);
-		m->fb_ratio /= pow(10.0, (rad_pattern[idx].gtot[fbidx] + Polarization_Factor(pol, idx, fbidx)) / 10.0);
+		m->fb_ratio /= pow(10.0, rad_pattern[idx].back_gain[pol] / 10.0);
 		m->fb_ratio = 10.0 * log10(m->fb_ratio);
 	}
 
@@ -20,6 +20,10 @@
 #include "nec2_model.h"
 #include "shared.h"
 
+/* The model listed has SY variables, its cards are shown with
+ * the values of their expressions so it may not be edited */
+static gboolean nec2_sym_model = FALSE;
+
 /*------------------------------------------------------------------------*/
 
 /* Zero_Store()
@@ -477,8 +481,9 @@ List_Commands( void )
         ain, &iv[0], &iv[1], &iv[2], &iv[3], &fv[0],
         &fv[1], &fv[2], &fv[3], &fv[4], &fv[5] );
 
-    /* Ignore in-data (NEC4 style) comments */
-    if( strcmp(ain, "CM") == 0 ) continue;
+    /* Ignore in-data (NEC4 style) comments and SY
+     * cards, their variables are assigned by readmn() */
+    if( (strcmp(ain, "CM") == 0) || (strcmp(ain, "SY") == 0) ) continue;
 
     /* Append a command row if needed */
     if( !ret )
@@ -531,6 +536,7 @@ Nec2_Input_File_Treeview( int action )
       Create_List_Stores(); /* Only done if needed */
       Create_Default_File();
       ClearFlag( OPEN_NEW_NEC2 );
+      nec2_sym_model = FALSE;
       return;
 
     case NEC2_EDITOR_RELOAD: /* Just reload input file */
@@ -548,6 +554,9 @@ Nec2_Input_File_Treeview( int action )
   /* Rewind NEC2 input file */
   rewind( input_fp );
 
+  /* SY variables of a previous input file */
+  Sym_Clear( FALSE );
+
   /*** List Comment cards ***/
   List_Comments();
 
@@ -557,6 +566,18 @@ Nec2_Input_File_Treeview( int action )
   /*** Read Command cards ***/
   List_Commands();
 
+  /* SY cards and the expressions in the fields of the other
+   * cards can not be saved back, the editor is read-only */
+  nec2_sym_model = ( Sym_Count() > 0 );
+  if( nec2_sym_model )
+  {
+    ClearFlag( NEC2_EDIT_SAVE );
+    pr_notice( "NEC2 editor: the input file has SY cards, it is read-only\n" );
+    Stop( _("The input file has SY variables\n"
+          "The NEC2 editor shows the values\n"
+          "of its expressions and is read-only"), ERR_OK );
+  }
+
   return;
 } /* Nec2_Input_File_Treeview() */
 
@@ -578,6 +599,9 @@ cell_edited_callback(
   GtkTreeIter       iter;
   guint column;
 
+  /* Models with SY variables are read-only */
+  if( nec2_sym_model ) return;
+
   column = GPOINTER_TO_UINT(
       g_object_get_data(G_OBJECT(cell), "column") );
   selection = gtk_tree_view_get_selection( GTK_TREE_VIEW(user_data) );
@@ -709,6 +733,17 @@ Save_Nec2_Input_File( GtkWidget *treeview_window, char *nec2_file )
 {
   FILE *nec2_fp = NULL;
 
+  /* Saving would replace the SY cards and expressions
+   * of the model with the values of the expressions */
+  if( nec2_sym_model )
+  {
+    Stop( _("The input file has SY variables\n"
+          "The NEC2 editor can not save it"), ERR_OK );
+    ClearFlag( NEC2_SAVE );
+    ClearFlag( NEC2_EDIT_SAVE );
+    return;
+  }
+
   setlocale(LC_NUMERIC, "C");
   /* Abort if editor window is not opened */
   if( nec2_edit_window == NULL ) return;
@@ -49,9 +49,10 @@
 
 /* subroutine netwk solves for structure currents for a given */
 /* excitation including the effect of non-radiating networks if */
-/* present. */
+/* present. if solved is true, einc has already been solved by */
+/* solves() along with other excitations, only without networks */
 void
-netwk( complex double *cmx, int *ip, complex double *einc )
+netwk( complex double *cmx, int *ip, complex double *einc, int solved )
 {
   int *ipnt = NULL, *nteqa = NULL, *ntsca = NULL;
   int nteq=0, ntsc=0, j, ndimn;
@@ -511,8 +512,9 @@ netwk( complex double *cmx, int *ip, complex double *einc )
   else
   {
     /* solve for currents when no networks are present */
-    solves( cmx, ip, einc, netcx.neq, 1,
-        data.np, data.n, data.mp, data.m);
+    if( !solved )
+      solves( cmx, ip, einc, netcx.neq, 1,
+          data.np, data.n, data.mp, data.m);
     cabc( einc);
     ntsc=0;
   }
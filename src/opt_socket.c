@@ -0,0 +1,498 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Optimizer socket. With --optimizer-socket, xnec2c-batch serves an
+ * external optimizer on a unix socket instead of running one input
+ * file. The optimizer sends a model, or changes to some of its cards,
+ * and asks for it to be evaluated: the model is read from memory, its
+ * frequency loop is run and the meas_calc() measurements of each step
+ * are sent back. Unlike rewriting the input file for Optimizer_Output()
+ * to notice and parsing the files of Write_Optimizer_Data(), nothing
+ * goes through the filesystem.
+ *
+ * Requests are lines of text, answered in turn:
+ *
+ *   MODEL <bytes>       followed by the bytes of an input file,
+ *                       which replaces the model. Answer: OK
+ *   CARD <line> <card>  replaces line number <line> of the model,
+ *                       counted from 1, by <card>. Answer: OK
+ *   EVAL [JSON|BIN]     runs the frequency loop of the model. Answer:
+ *                       OK JSON <bytes>, or OK BIN <bytes> <rows>
+ *                       <columns>, followed by the measurements
+ *   QUIT                closes the connection
+ *
+ * A failed request is answered by ERR and the reason. The JSON reply
+ * has the names of the columns from meas_names[], the wall clock time
+ * of the evaluation and a row of measurements for each frequency step,
+ * with null for values that are not finite. The BIN reply has the same
+ * rows, as doubles in the byte order of the machine.
+ */
+
+#include "opt_socket.h"
+#include "shared.h"
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* The model that EVAL runs */
+static opt_model_t model = { NULL, 0 };
+
+/*-----------------------------------------------------------------------*/
+
+/* Model_Free()
+ *
+ * Frees the lines of the model
+ */
+  static void
+Model_Free( void )
+{
+  int idx;
+
+  for( idx = 0; idx < model.nlines; idx++ )
+    free_ptr( (void **)&model.lines[idx] );
+  free_ptr( (void **)&model.lines );
+  model.nlines = 0;
+
+} /* Model_Free() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Model_Set()
+ *
+ * Replaces the model by the len bytes of input file in text
+ */
+  static void
+Model_Set( const char *text, size_t len )
+{
+  const char *end = text + len, *eol;
+  size_t mreq, llen;
+  int num = 0;
+
+  Model_Free();
+
+  for( eol = text; eol < end; eol++ )
+    if( *eol == '\n' ) num++;
+  if( (len > 0) && (end[-1] != '\n') ) num++;
+  if( num == 0 ) return;
+
+  mreq = (size_t)num * sizeof(char *);
+  mem_alloc( (void **)&model.lines, mreq, "in opt_socket.c" );
+
+  while( text < end )
+  {
+    eol = memchr( text, '\n', (size_t)(end - text) );
+    if( eol == NULL ) eol = end;
+    llen = (size_t)(eol - text);
+    if( (llen > 0) && (text[llen - 1] == '\r') ) llen--;
+
+    mem_alloc( (void **)&model.lines[model.nlines], llen + 1, "in opt_socket.c" );
+    memcpy( model.lines[model.nlines], text, llen );
+    model.lines[model.nlines][llen] = '\0';
+    model.nlines++;
+
+    text = eol + 1;
+  }
+
+} /* Model_Set() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Model_Set_Card()
+ *
+ * Replaces line number line of the model, counted from 1,
+ * by card. Returns FALSE if the model has no such line
+ */
+  static gboolean
+Model_Set_Card( int line, const char *card )
+{
+  size_t len = strlen( card );
+
+  if( (line < 1) || (line > model.nlines) )
+    return( FALSE );
+  line--;
+
+  free_ptr( (void **)&model.lines[line] );
+  mem_alloc( (void **)&model.lines[line], len + 1, "in opt_socket.c" );
+  memcpy( model.lines[line], card, len + 1 );
+
+  return( TRUE );
+} /* Model_Set_Card() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Model_Read()
+ *
+ * Reads the input file fname as the initial model
+ */
+  static gboolean
+Model_Read( char *fname )
+{
+  char *text = NULL;
+  size_t len;
+
+  if( !Load_File(fname, OPT_SOCKET_MAX_MODEL, &text, &len) )
+    return( FALSE );
+  Model_Set( text, len );
+  free_ptr( (void **)&text );
+
+  return( TRUE );
+} /* Model_Read() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Model_Eval()
+ *
+ * Reads the model as the input file, from memory, and runs its
+ * frequency loop. Returns NULL on success, else the reason. With
+ * STOP_RETURNS set, errors in the model do not end the server
+ */
+  static const char *
+Model_Eval( void )
+{
+  char *text = NULL;
+  size_t len = 0, llen;
+  gboolean ok;
+  int idx;
+
+  if( model.nlines == 0 )
+    return( "no model" );
+
+  for( idx = 0; idx < model.nlines; idx++ )
+    len += strlen( model.lines[idx] ) + 1;
+  mem_alloc( (void **)&text, len, "in opt_socket.c" );
+  for( len = 0, idx = 0; idx < model.nlines; idx++ )
+  {
+    llen = strlen( model.lines[idx] );
+    memcpy( text + len, model.lines[idx], llen );
+    len += llen;
+    text[len++] = '\n';
+  }
+
+  /* The next read starts over from the
+   * model, whatever state a failure left */
+  ok = Read_Input_Text( text, len ) && Run_Frequency_Loop();
+  free_ptr( (void **)&text );
+  if( ok ) return( NULL );
+
+  /* The reason given to Stop(), if it was called */
+  if( *Stop_Message() != '\0' )
+    return( Stop_Message() );
+
+  return( "the model has errors" );
+} /* Model_Eval() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Send_All()
+ *
+ * Writes len bytes of buf to the connection fd,
+ * returns FALSE if the optimizer has gone away
+ */
+  static gboolean
+Send_All( int fd, const char *buf, size_t len )
+{
+  ssize_t ret;
+
+  while( len > 0 )
+  {
+    ret = send( fd, buf, len, MSG_NOSIGNAL );
+    if( (ret < 0) && (errno == EINTR) )
+      continue;
+    if( ret <= 0 )
+      return( FALSE );
+    buf += ret;
+    len -= (size_t)ret;
+  }
+
+  return( TRUE );
+} /* Send_All() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Send_Reply()
+ *
+ * Writes the reply line printed from format to the connection fd
+ */
+  static gboolean
+Send_Reply( int fd, const char *format, ... )
+{
+  char line[LINE_LEN];
+  va_list args;
+  int len;
+
+  va_start( args, format );
+  len = vsnprintf( line, sizeof(line) - 1, format, args );
+  va_end( args );
+
+  if( (len < 0) || (len > (int)sizeof(line) - 2) )
+    len = (int)sizeof(line) - 2;
+  line[len++] = '\n';
+
+  return( Send_All(fd, line, (size_t)len) );
+} /* Send_Reply() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Send_Measurements()
+ *
+ * Writes the measurements of the frequency steps
+ * to the connection fd, in the format of EVAL
+ */
+  static gboolean
+Send_Measurements( int fd, int format, double wall )
+{
+  measurement_t meas;
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *fp;
+  int idx, col, rows = 0;
+  gboolean ok;
+
+  if( format == OPT_SOCKET_BIN )
+  {
+    len = (size_t)calc_data.steps_total * MEAS_COUNT * sizeof(double);
+    mem_alloc( (void **)&buf, len + 1, "in opt_socket.c" );
+    for( idx = 0; idx < calc_data.steps_total; idx++ )
+    {
+      if( !save.fstep[idx] ) continue;
+      meas_calc( &meas, idx );
+      memcpy( buf + (size_t)rows * MEAS_COUNT * sizeof(double),
+          meas.a, MEAS_COUNT * sizeof(double) );
+      rows++;
+    }
+    len = (size_t)rows * MEAS_COUNT * sizeof(double);
+
+    ok = Send_Reply( fd, "OK BIN %lu %d %d",
+        (unsigned long)len, rows, MEAS_COUNT ) &&
+      Send_All( fd, buf, len );
+    free_ptr( (void **)&buf );
+    return( ok );
+  }
+
+  fp = open_memstream( &buf, &len );
+  if( fp == NULL )
+    return( Send_Reply(fd, "ERR %s", strerror(errno)) );
+
+  setlocale( LC_NUMERIC, "C" );
+
+  fprintf( fp, "{\"seconds\": %.6f, \"columns\": [", wall );
+  for( col = 0; col < MEAS_COUNT; col++ )
+    fprintf( fp, "%s\"%s\"", col ? ", " : "", meas_names[col] );
+  fprintf( fp, "], \"rows\": [" );
+
+  for( idx = 0; idx < calc_data.steps_total; idx++ )
+  {
+    if( !save.fstep[idx] ) continue;
+    meas_calc( &meas, idx );
+    fprintf( fp, "%s\n  [", rows ? "," : "" );
+    for( col = 0; col < MEAS_COUNT; col++ )
+    {
+      if( isfinite(meas.a[col]) )
+        fprintf( fp, "%s%.17g", col ? ", " : "", meas.a[col] );
+      else
+        fprintf( fp, "%snull", col ? ", " : "" );
+    }
+    fprintf( fp, "]" );
+    rows++;
+  }
+  fprintf( fp, "]}\n" );
+
+  setlocale( LC_NUMERIC, orig_numeric_locale );
+  fclose( fp );
+
+  ok = Send_Reply( fd, "OK JSON %lu", (unsigned long)len ) &&
+    Send_All( fd, buf, len );
+  free( buf );
+
+  return( ok );
+} /* Send_Measurements() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Serve_Connection()
+ *
+ * Answers the requests of the optimizer connected on fd
+ * until it sends QUIT or closes the connection
+ */
+  static void
+Serve_Connection( int fd )
+{
+  struct timespec start, end;
+  char *req = NULL, *arg, *text = NULL;
+  const char *err;
+  size_t siz = 0;
+  ssize_t len;
+  FILE *fp;
+  long num;
+  gboolean ok = TRUE;
+
+  /* Requests are read through a stream, replies written to fd */
+  fp = fdopen( dup(fd), "r" );
+  if( fp == NULL )
+  {
+    pr_err( "optimizer socket: %s\n", strerror(errno) );
+    return;
+  }
+
+  while( ok && ((len = getline(&req, &siz, fp)) > 0) )
+  {
+    /* Split the request from its arguments */
+    while( (len > 0) && ((req[len - 1] == '\n') || (req[len - 1] == '\r')) )
+      req[--len] = '\0';
+    arg = req + strcspn( req, " \t" );
+    if( *arg != '\0' ) *arg++ = '\0';
+    arg += strspn( arg, " \t" );
+
+    if( strcasecmp(req, "MODEL") == 0 )
+    {
+      num = strtol( arg, NULL, 10 );
+      if( (num < 0) || (num > OPT_SOCKET_MAX_MODEL) )
+      {
+        ok = Send_Reply( fd, "ERR model size out of range" );
+        break;
+      }
+
+      mem_alloc( (void **)&text, (size_t)num + 1, "in opt_socket.c" );
+      if( fread(text, 1, (size_t)num, fp) != (size_t)num )
+        break;
+      Model_Set( text, (size_t)num );
+      free_ptr( (void **)&text );
+      ok = Send_Reply( fd, "OK" );
+    }
+    else if( strcasecmp(req, "CARD") == 0 )
+    {
+      num = strtol( arg, &arg, 10 );
+      if( *arg != '\0' ) arg++;
+      if( Model_Set_Card((int)num, arg) )
+        ok = Send_Reply( fd, "OK" );
+      else
+        ok = Send_Reply( fd, "ERR no line %ld in the model", num );
+    }
+    else if( strcasecmp(req, "EVAL") == 0 )
+    {
+      int format = OPT_SOCKET_JSON;
+
+      if( strcasecmp(arg, "BIN") == 0 )
+        format = OPT_SOCKET_BIN;
+      else if( (*arg != '\0') && (strcasecmp(arg, "JSON") != 0) )
+      {
+        ok = Send_Reply( fd, "ERR unknown format %s", arg );
+        continue;
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &start );
+      err = Model_Eval();
+      clock_gettime( CLOCK_MONOTONIC, &end );
+
+      if( err != NULL )
+        ok = Send_Reply( fd, "ERR %s", err );
+      else
+        ok = Send_Measurements( fd, format,
+            (double)(end.tv_sec - start.tv_sec) +
+            (double)(end.tv_nsec - start.tv_nsec) / 1.0E9 );
+    }
+    else if( strcasecmp(req, "QUIT") == 0 )
+      break;
+    else if( req[0] != '\0' )
+      ok = Send_Reply( fd, "ERR unknown request %s", req );
+
+  } /* while( ok && getline(...) > 0 ) */
+
+  free_ptr( (void **)&text );
+  free( req );
+  fclose( fp );
+
+} /* Serve_Connection() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Opt_Socket_Serve()
+ *
+ * Listens on the unix socket path and serves the optimizers
+ * that connect to it, one at a time. The input file, if given,
+ * is the initial model. Returns the exit status on failure
+ */
+  int
+Opt_Socket_Serve( char *path )
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  int sfd, cfd;
+
+  if( strlen(rc_config.input_file) > 0 )
+  {
+    Get_Dirname( rc_config.input_file, rc_config.working_dir, NULL );
+    if( !Model_Read(rc_config.input_file) )
+      return( 1 );
+  }
+
+  /* Errors in the models are sent back to the optimizer */
+  SetFlag( STOP_RETURNS );
+
+  memset( &addr, 0, sizeof(addr) );
+  addr.sun_family = AF_UNIX;
+  if( strlen(path) >= sizeof(addr.sun_path) )
+  {
+    pr_crit( "optimizer socket path name too long ( > %d char )\n",
+        (int)sizeof(addr.sun_path) - 1 );
+    return( 1 );
+  }
+  Strlcpy( addr.sun_path, path, sizeof(addr.sun_path) );
+
+  /* Remove the socket left by a previous run, but no other file */
+  if( (stat(path, &st) == 0) && S_ISSOCK(st.st_mode) )
+    unlink( path );
+
+  sfd = socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( (sfd < 0) ||
+      (bind(sfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+      (listen(sfd, OPT_SOCKET_BACKLOG) < 0) )
+  {
+    pr_crit( "optimizer socket %s: %s\n", path, strerror(errno) );
+    if( sfd >= 0 ) close( sfd );
+    return( 1 );
+  }
+  pr_notice( "waiting for the optimizer on %s\n", path );
+
+  while( TRUE )
+  {
+    cfd = accept( sfd, NULL, NULL );
+    if( cfd < 0 )
+    {
+      if( errno == EINTR ) continue;
+      pr_crit( "optimizer socket %s: %s\n", path, strerror(errno) );
+      break;
+    }
+
+    pr_info( "optimizer connected\n" );
+    Serve_Connection( cfd );
+    close( cfd );
+    pr_info( "optimizer disconnected\n" );
+  }
+
+  close( sfd );
+  unlink( path );
+  Model_Free();
+
+  return( 1 );
+} /* Opt_Socket_Serve() */
+
+/*-----------------------------------------------------------------------*/
+
@@ -0,0 +1,47 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef OPT_SOCKET_H
+#define OPT_SOCKET_H    1
+
+#include "common.h"
+
+/* Largest model accepted by the MODEL request, in bytes */
+#define OPT_SOCKET_MAX_MODEL   (64 * 1024 * 1024)
+
+/* Connections waiting to be accepted */
+#define OPT_SOCKET_BACKLOG     4
+
+/* Format of the measurements in the reply to EVAL */
+enum OPT_SOCKET_FORMAT
+{
+  OPT_SOCKET_JSON = 0,
+  OPT_SOCKET_BIN
+};
+
+/* The model being optimized, one line of the input file each */
+typedef struct
+{
+  char **lines;
+  int nlines;
+
+} opt_model_t;
+
+#endif
+
@@ -38,7 +38,9 @@ int opt_have_files_to_save(void)
 		rc_config.filename_s2p_max_gain ||
 		rc_config.filename_s2p_viewer_gain ||
 		rc_config.filename_rdpat ||
-		rc_config.filename_currents
+		rc_config.filename_currents ||
+		rc_config.filename_rdpat_bin ||
+		rc_config.filename_currents_bin
 	);
 }
 
@@ -105,8 +107,9 @@ void Write_Optimizer_Data( void )
 }
 
 
-// If inotify was not detected then create stubs:
-#ifndef HAVE_INOTIFY
+// If inotify was not detected, or there is no GUI to reload the
+// input file (xnec2c-batch), then create stubs:
+#if !defined(HAVE_INOTIFY) || defined(XNEC2C_BATCH)
 
 void *Optimizer_Output( void *arg ) { pr_err("xnec2c was built without inotify.\n"); return NULL; }
 
@@ -0,0 +1,678 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Timers of the solver phases: geometry, segment connections,
+ * ground parameters, matrix fill, factoring, solving, radiation
+ * and near field patterns, and the transfer of frequency data
+ * between processes. A phase is timed between Perf_Start() and
+ * Perf_Stop(), and the times of phases nested in it, like the
+ * geometry scaling done for an interpolated matrix fill, are not
+ * counted twice. Wall clock and process CPU time are accumulated
+ * per phase from the reading of the structure, or Perf_Reset().
+ * Child processes pass the times of each frequency step to the
+ * parent with its data, where they are added to its own.
+ *
+ * The times are read by xnec2c-batch --benchmark, which writes
+ * them to a JSON file with Perf_Write_Bench() and compares them to
+ * those of a previous run with Perf_Compare_Bench(), written to
+ * the --stats file after each frequency loop, and shown in the
+ * Performance window of the GUI.
+ */
+
+#include "perf.h"
+#include "shared.h"
+#include "mathlib.h"
+
+/* Accumulated phase times and their lock */
+static perf_phase_t perf_phases[PERF_NUM_PHASES];
+static GMutex perf_lock;
+
+/* Innermost running phase of this thread */
+static __thread perf_mark_t *perf_top = NULL;
+
+/* Phase names, in the order of enum PERF_PHASE */
+static const char *perf_names[PERF_NUM_PHASES] =
+{
+  "geometry",
+  "conect",
+  "ground",
+  "fill",
+  "factor",
+  "solve",
+  "rdpat",
+  "nfpat",
+  "ipc"
+};
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Clock()
+ *
+ * Returns the time of clock id in seconds
+ */
+  static double
+Perf_Clock( clockid_t id )
+{
+  struct timespec ts;
+
+  clock_gettime( id, &ts );
+  return( (double)ts.tv_sec + (double)ts.tv_nsec / 1.0E9 );
+
+} /* Perf_Clock() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Start()
+ *
+ * Starts timing a phase at mark, which must
+ * be stopped before the phase it is nested in
+ */
+  void
+Perf_Start( perf_mark_t *mark )
+{
+  mark->wall = Perf_Clock( CLOCK_MONOTONIC );
+  mark->cpu  = Perf_Clock( CLOCK_PROCESS_CPUTIME_ID );
+  mark->child_wall = 0.0;
+  mark->child_cpu  = 0.0;
+  mark->parent = perf_top;
+  perf_top = mark;
+
+} /* Perf_Start() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Stop()
+ *
+ * Stops timing at mark and adds the time, less that of
+ * the phases nested in it, to phase. CPU time is that
+ * of the whole process, including other threads
+ */
+  void
+Perf_Stop( perf_mark_t *mark, int phase )
+{
+  double wall, cpu;
+
+  wall = Perf_Clock( CLOCK_MONOTONIC ) - mark->wall;
+  cpu  = Perf_Clock( CLOCK_PROCESS_CPUTIME_ID ) - mark->cpu;
+
+  perf_top = mark->parent;
+  if( perf_top != NULL )
+  {
+    perf_top->child_wall += wall;
+    perf_top->child_cpu  += cpu;
+  }
+
+  g_mutex_lock( &perf_lock );
+  perf_phases[phase].wall += wall - mark->child_wall;
+  perf_phases[phase].cpu  += cpu  - mark->child_cpu;
+  perf_phases[phase].count++;
+  g_mutex_unlock( &perf_lock );
+
+} /* Perf_Stop() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Count_Bytes()
+ *
+ * Adds bytes to the data moved in phase
+ */
+  void
+Perf_Count_Bytes( int phase, size_t bytes )
+{
+  g_mutex_lock( &perf_lock );
+  perf_phases[phase].bytes += bytes;
+  g_mutex_unlock( &perf_lock );
+
+} /* Perf_Count_Bytes() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Reset()
+ *
+ * Clears the accumulated phase times
+ */
+  void
+Perf_Reset( void )
+{
+  g_mutex_lock( &perf_lock );
+  memset( perf_phases, 0, sizeof(perf_phases) );
+  g_mutex_unlock( &perf_lock );
+
+} /* Perf_Reset() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Get()
+ *
+ * Copies the accumulated phase times to phases,
+ * which must have PERF_NUM_PHASES elements
+ */
+  void
+Perf_Get( perf_phase_t *phases )
+{
+  g_mutex_lock( &perf_lock );
+  memcpy( phases, perf_phases, sizeof(perf_phases) );
+  g_mutex_unlock( &perf_lock );
+
+} /* Perf_Get() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Add()
+ *
+ * Adds the phase times in phases, of a child
+ * process, to the accumulated ones
+ */
+  void
+Perf_Add( perf_phase_t *phases )
+{
+  int ph;
+
+  g_mutex_lock( &perf_lock );
+  for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+  {
+    perf_phases[ph].wall  += phases[ph].wall;
+    perf_phases[ph].cpu   += phases[ph].cpu;
+    perf_phases[ph].count += phases[ph].count;
+    perf_phases[ph].bytes += phases[ph].bytes;
+  }
+  g_mutex_unlock( &perf_lock );
+
+} /* Perf_Add() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Phase_Name()
+ *
+ * Returns the name of phase, as used in benchmark files
+ */
+  const char *
+Perf_Phase_Name( int phase )
+{
+  if( (phase < 0) || (phase >= PERF_NUM_PHASES) )
+    return( "unknown" );
+  return( perf_names[phase] );
+
+} /* Perf_Phase_Name() */
+
+/*-----------------------------------------------------------------------*/
+
+
+/* Perf_Write_String()
+ *
+ * Writes str to fp as a quoted JSON string
+ */
+  static void
+Perf_Write_String( FILE *fp, const char *str )
+{
+  fputc( '"', fp );
+  for( ; *str != '\0'; str++ )
+  {
+    if( (*str == '"') || (*str == '\\') )
+      fprintf( fp, "\\%c", *str );
+    else if( (unsigned char)*str < 0x20 )
+      fprintf( fp, "\\u%04x", (unsigned char)*str );
+    else
+      fputc( *str, fp );
+  }
+  fputc( '"', fp );
+
+} /* Perf_Write_String() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Write_Phase()
+ *
+ * Writes the time of a phase to fp as a JSON
+ * member on a line of its own, see Perf_Read_Bench()
+ */
+  static void
+Perf_Write_Phase( FILE *fp, const char *name, perf_phase_t *time, gboolean last )
+{
+  fprintf( fp, "        \"%s\": { \"wall\": %.6f, \"cpu\": %.6f, "
+      "\"count\": %llu, \"bytes\": %llu }%s\n",
+      name, time->wall, time->cpu, (unsigned long long)time->count,
+      (unsigned long long)time->bytes, last ? "" : "," );
+
+} /* Perf_Write_Phase() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Write_Bench()
+ *
+ * Writes the benchmark results of num models to file
+ * fname in JSON format, returns FALSE on error
+ */
+  gboolean
+Perf_Write_Bench( char *fname, perf_model_t *models, int num )
+{
+  FILE *fp = NULL;
+  int idx, ph;
+
+  if( !Open_File(&fp, fname, "w") )
+    return( FALSE );
+
+  setlocale( LC_NUMERIC, "C" );
+
+  fprintf( fp, "{\n" );
+  fprintf( fp, "  \"program\": " );
+  Perf_Write_String( fp, PACKAGE_STRING );
+  fprintf( fp, ",\n  \"mathlib\": " );
+  Perf_Write_String( fp, (current_mathlib != NULL) ? current_mathlib->name : "" );
+  fprintf( fp, ",\n  \"fill_threads\": %d,\n", rc_config.fill_threads );
+  fprintf( fp, "  \"models\": [\n" );
+
+  for( idx = 0; idx < num; idx++ )
+  {
+    perf_model_t *mod = &models[idx];
+
+    fprintf( fp, "    {\n      \"file\": " );
+    Perf_Write_String( fp, mod->file );
+    fprintf( fp, ",\n      \"ok\": %s,\n", mod->ok ? "true" : "false" );
+    fprintf( fp, "      \"segments\": %d,\n", mod->segments );
+    fprintf( fp, "      \"patches\": %d,\n", mod->patches );
+    fprintf( fp, "      \"steps\": %d,\n", mod->steps );
+    fprintf( fp, "      \"phases\": {\n" );
+    Perf_Write_Phase( fp, "total", &mod->total, FALSE );
+    for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+      Perf_Write_Phase( fp, Perf_Phase_Name(ph),
+          &mod->phase[ph], ph == PERF_NUM_PHASES - 1 );
+    fprintf( fp, "      }\n    }%s\n", (idx < num - 1) ? "," : "" );
+  }
+
+  fprintf( fp, "  ]\n}\n" );
+
+  setlocale( LC_NUMERIC, orig_numeric_locale );
+
+  if( ferror(fp) )
+  {
+    pr_err( "%s: error writing benchmark results\n", fname );
+    Close_File( &fp );
+    return( FALSE );
+  }
+  Close_File( &fp );
+
+  return( TRUE );
+} /* Perf_Write_Bench() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Read_String()
+ *
+ * Reads the JSON string starting at the quote in
+ * src to dst of size siz, returns FALSE if invalid
+ */
+  static gboolean
+Perf_Read_String( const char *src, char *dst, size_t siz )
+{
+  size_t len = 0;
+
+  if( *src++ != '"' )
+    return( FALSE );
+
+  for( ; (*src != '"') && (*src != '\0'); src++ )
+  {
+    if( *src == '\\' )
+    {
+      unsigned int chr;
+
+      src++;
+      if( *src == 'u' )
+      {
+        if( sscanf(src + 1, "%4x", &chr) != 1 )
+          return( FALSE );
+        src += 4;
+      }
+      else if( *src == '\0' )
+        return( FALSE );
+      else
+        chr = (unsigned char)*src;
+
+      if( len + 1 < siz )
+        dst[len++] = (char)chr;
+    }
+    else if( len + 1 < siz )
+      dst[len++] = *src;
+  }
+  dst[len] = '\0';
+
+  return( *src == '"' );
+} /* Perf_Read_String() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Read_Bench()
+ *
+ * Reads the benchmark results written by Perf_Write_Bench()
+ * to file fname into *models, allocated here. Returns the
+ * number of models, or -1 on error
+ */
+  int
+Perf_Read_Bench( char *fname, perf_model_t **models )
+{
+  FILE *fp = NULL;
+  char line[LINE_LEN + FILENAME_LEN], name[16];
+  perf_model_t *mod = NULL;
+  perf_phase_t time;
+  unsigned long long count, bytes;
+  int num = 0, ph, cnt;
+  size_t mreq;
+  char *str;
+
+  *models = NULL;
+  if( !Open_File(&fp, fname, "r") )
+    return( -1 );
+
+  setlocale( LC_NUMERIC, "C" );
+
+  while( fgets(line, sizeof(line), fp) != NULL )
+  {
+    str = line + strspn( line, " \t" );
+
+    /* Each model starts with its file name */
+    if( strncmp(str, "\"file\":", 7) == 0 )
+    {
+      mreq = (size_t)(num + 1) * sizeof(perf_model_t);
+      mem_realloc( (void **)models, mreq, "in perf.c" );
+      mod = &(*models)[num++];
+      memset( mod, 0, sizeof(perf_model_t) );
+
+      str += 7 + strspn( str + 7, " " );
+      if( !Perf_Read_String(str, mod->file, sizeof(mod->file)) )
+        break;
+    }
+    else if( mod == NULL )
+      continue;
+    else if( strncmp(str, "\"ok\":", 5) == 0 )
+      mod->ok = ( strstr(str, "true") != NULL );
+    else if( sscanf(str, "\"segments\": %d", &mod->segments) == 1 )
+      continue;
+    else if( sscanf(str, "\"patches\": %d", &mod->patches) == 1 )
+      continue;
+    else if( sscanf(str, "\"steps\": %d", &mod->steps) == 1 )
+      continue;
+    else if( (cnt = sscanf(str, "\"%15[a-z_]\": { \"wall\": %lf, "
+            "\"cpu\": %lf, \"count\": %llu, \"bytes\": %llu",
+            name, &time.wall, &time.cpu, &count, &bytes)) >= 4 )
+    {
+      time.count = (guint64)count;
+      time.bytes = (cnt == 5) ? (guint64)bytes : 0;
+      if( strcmp(name, "total") == 0 )
+        mod->total = time;
+      else for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+        if( strcmp(name, Perf_Phase_Name(ph)) == 0 )
+          mod->phase[ph] = time;
+    }
+  } /* while( fgets(line, sizeof(line), fp) != NULL ) */
+
+  setlocale( LC_NUMERIC, orig_numeric_locale );
+
+  if( !feof(fp) )
+  {
+    pr_err( "%s: invalid benchmark file\n", fname );
+    free_ptr( (void **)models );
+    num = -1;
+  }
+  Close_File( &fp );
+
+  return( num );
+} /* Perf_Read_Bench() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Basename()
+ *
+ * Returns the file name part of path
+ */
+  static const char *
+Perf_Basename( const char *path )
+{
+  const char *name = strrchr( path, '/' );
+  return( (name == NULL) ? path : name + 1 );
+} /* Perf_Basename() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Compare_Phase()
+ *
+ * Prints the time of a phase and its change from the
+ * baseline, returns TRUE if it is slower by more than
+ * tol percent. Phases too short in the baseline are
+ * printed without comparing them
+ */
+  static gboolean
+Perf_Compare_Phase( const char *file, const char *name,
+    perf_phase_t *time, perf_phase_t *base, double tol )
+{
+  double change;
+
+  if( base->wall < PERF_MIN_TIME )
+  {
+    if( time->wall >= PERF_MIN_TIME )
+      printf( "%-40s %-9s %10.3f %10.3f\n",
+          file, name, base->wall, time->wall );
+    return( FALSE );
+  }
+
+  change = 100.0 * (time->wall - base->wall) / base->wall;
+  printf( "%-40s %-9s %10.3f %10.3f %+8.1f%%%s\n",
+      file, name, base->wall, time->wall, change,
+      (change > tol) ? "  REGRESSION" : "" );
+
+  return( change > tol );
+} /* Perf_Compare_Phase() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Compare_Bench()
+ *
+ * Compares the wall clock times of num models to those of
+ * the same input files among the nbase baseline models, and
+ * prints them. Returns the number of phases slower by more
+ * than tol percent
+ */
+  int
+Perf_Compare_Bench( perf_model_t *models, int num,
+    perf_model_t *base, int nbase, double tol )
+{
+  int idx, bdx, ph, regress = 0;
+  const char *file;
+
+  printf( "%-40s %-9s %10s %10s %9s\n",
+      "model", "phase", "base (s)", "now (s)", "change" );
+
+  for( idx = 0; idx < num; idx++ )
+  {
+    perf_model_t *mod = &models[idx];
+
+    /* Models are matched by input file name, so that a
+     * baseline run from another directory can be used */
+    file = Perf_Basename( mod->file );
+    for( bdx = 0; bdx < nbase; bdx++ )
+      if( strcmp(Perf_Basename(base[bdx].file), file) == 0 )
+        break;
+
+    if( (bdx == nbase) || !base[bdx].ok || !mod->ok )
+    {
+      printf( "%-40s %s\n", file,
+          (bdx == nbase) ? "not in baseline" : "failed, not compared" );
+      continue;
+    }
+
+    if( Perf_Compare_Phase(file, "total", &mod->total, &base[bdx].total, tol) )
+      regress++;
+    for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+      if( Perf_Compare_Phase(file, Perf_Phase_Name(ph),
+            &mod->phase[ph], &base[bdx].phase[ph], tol) )
+        regress++;
+  } /* for( idx = 0; idx < num; idx++ ) */
+
+  return( regress );
+} /* Perf_Compare_Bench() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Perf_Write_Stats()
+ *
+ * Writes the phase times to the --stats file, if given, in
+ * the format of Perf_Write_Bench(). The total wall time is
+ * that of the frequency loop, wall, and the total CPU time
+ * is that of all the phases, in all processes
+ */
+  void
+Perf_Write_Stats( double wall )
+{
+  perf_model_t mod;
+  int ph;
+
+  if( rc_config.filename_stats == NULL )
+    return;
+
+  memset( &mod, 0, sizeof(mod) );
+  Strlcpy( mod.file, rc_config.input_file, sizeof(mod.file) );
+  mod.ok       = 1;
+  mod.segments = data.n;
+  mod.patches  = data.m;
+  mod.steps    = calc_data.steps_total;
+  Perf_Get( mod.phase );
+
+  mod.total.wall  = wall;
+  mod.total.count = 1;
+  for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+    mod.total.cpu += mod.phase[ph].cpu;
+
+  Perf_Write_Bench( rc_config.filename_stats, &mod, 1 );
+
+} /* Perf_Write_Stats() */
+
+/*-----------------------------------------------------------------------*/
+
+// The performance window below needs the GUI:
+#ifndef XNEC2C_BATCH
+
+static GtkWidget *perf_window = NULL;
+static GtkLabel  *perf_label  = NULL;
+static guint      perf_timer  = 0;
+
+/* Perf_Window_Update()
+ *
+ * Shows the phase times in the performance window, and
+ * the phase that takes most of the time. Runs every second
+ */
+  static gboolean
+Perf_Window_Update( gpointer udata )
+{
+  perf_phase_t phases[PERF_NUM_PHASES];
+  double wall = 0.0, cpu = 0.0;
+  char text[2048];
+  size_t len;
+  int ph, top = 0;
+
+  Perf_Get( phases );
+  for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+  {
+    wall += phases[ph].wall;
+    cpu  += phases[ph].cpu;
+    if( phases[ph].wall > phases[top].wall )
+      top = ph;
+  }
+
+  len = (size_t)snprintf( text, sizeof(text), "%-9s %8s %10s %10s %7s %12s\n",
+      _("Phase"), _("Calls"), _("Wall (s)"), _("CPU (s)"), _("Wall %"), _("Bytes") );
+  for( ph = 0; ph < PERF_NUM_PHASES; ph++ )
+    len += (size_t)snprintf( text + len, sizeof(text) - len,
+        "%-9s %8llu %10.3f %10.3f %7.1f %12llu\n",
+        Perf_Phase_Name(ph), (unsigned long long)phases[ph].count,
+        phases[ph].wall, phases[ph].cpu,
+        (wall > 0.0) ? 100.0 * phases[ph].wall / wall : 0.0,
+        (unsigned long long)phases[ph].bytes );
+  len += (size_t)snprintf( text + len, sizeof(text) - len,
+      "%-9s %8s %10.3f %10.3f\n\n", _("Total"), "", wall, cpu );
+
+  if( wall > 0.0 )
+    snprintf( text + len, sizeof(text) - len, _("Bound by %s: %.0f%% of the time"),
+        Perf_Phase_Name(top), 100.0 * phases[top].wall / wall );
+  else
+    snprintf( text + len, sizeof(text) - len, "%s", _("Nothing timed yet") );
+
+  gtk_label_set_text( perf_label, text );
+
+  return( TRUE );
+} /* Perf_Window_Update() */
+
+/*-----------------------------------------------------------------------*/
+
+/* on_perf_window_destroy()
+ *
+ * Stops the updates when the performance window is closed
+ */
+  void
+on_perf_window_destroy( GObject *object, gpointer user_data )
+{
+  if( perf_timer ) g_source_remove( perf_timer );
+  perf_timer  = 0;
+  perf_window = NULL;
+  perf_label  = NULL;
+
+} /* on_perf_window_destroy() */
+
+/*-----------------------------------------------------------------------*/
+
+/* on_perf_reset_button_clicked()
+ *
+ * Clears the phase times shown in the performance window
+ */
+  void
+on_perf_reset_button_clicked( GtkButton *button, gpointer user_data )
+{
+  Perf_Reset();
+  Perf_Window_Update( NULL );
+
+} /* on_perf_reset_button_clicked() */
+
+/*-----------------------------------------------------------------------*/
+
+/* on_main_performance_activate()
+ *
+ * Opens the performance window from the View menu,
+ * or raises it if already open
+ */
+  void
+on_main_performance_activate( GtkMenuItem *menuitem, gpointer user_data )
+{
+  GtkBuilder *builder;
+
+  if( perf_window != NULL )
+  {
+    gtk_window_present( GTK_WINDOW(perf_window) );
+    return;
+  }
+
+  perf_window = create_perf_window( &builder );
+  perf_label  = GTK_LABEL( Builder_Get_Object(builder, "perf_label") );
+  g_object_unref( builder );
+  gtk_window_set_transient_for( GTK_WINDOW(perf_window), GTK_WINDOW(main_window) );
+
+  Perf_Window_Update( NULL );
+  perf_timer = g_timeout_add_seconds( 1, Perf_Window_Update, NULL );
+  gtk_widget_show( perf_window );
+
+} /* on_main_performance_activate() */
+
+#endif
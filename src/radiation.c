@@ -44,6 +44,7 @@
 
 #include "radiation.h"
 #include "shared.h"
+#include <pthread.h>
 
 /* Radiation pattern data */
 
@@ -92,34 +93,109 @@ fflds( double rox, double roy, double roz,
 
 /*-----------------------------------------------------------------------*/
 
+/* ffld_patches()
+ *
+ * Adds the far fields of the surface patches, and of their
+ * image if any, to the wire segment integral cix, ciy, ciz
+ * summed by ffld() and returns the theta and phi components
+ */
+  static void
+ffld_patches( double thet, double phi,
+    complex double cix, complex double ciy, complex double ciz,
+    complex double *eth, complex double *eph )
+{
+  int ip;
+  double phx, phy, roz, thx, thy, thz, rox, roy, rfl, rrz;
+  complex double rrv, rrh, gx, gy, gz;
+  complex double ex=CPLX_00, ey=CPLX_00, ez=CPLX_00;
+
+  phx= -sin( phi);
+  phy= cos( phi);
+  roz= cos( thet);
+  thx= roz* phy;
+  thy= -roz* phx;
+  thz= -sin( thet);
+  rox= -thz* phy;
+  roy= thz* phx;
+
+  /* electric field components */
+  rfl=-1.0;
+  for( ip = 0; ip < gnd.ksymp; ip++ )
+  {
+    rfl= -rfl;
+    rrz= roz* rfl;
+    fflds( rox, roy, rrz, &crnt.cur[data.n], &gx, &gy, &gz);
+
+    if( ip != 1 )
+    {
+      ex= gx;
+      ey= gy;
+      ez= gz;
+      continue;
+    }
+
+    if( gnd.iperf == 1)
+    {
+      gx= -gx;
+      gy= -gy;
+      gz= -gz;
+    }
+    else
+    {
+      rrv= csqrt(1.0- gnd.zrati* gnd.zrati* thz* thz);
+      rrh= gnd.zrati* roz;
+      rrh=( rrh- rrv)/( rrh+ rrv);
+      rrv= gnd.zrati* rrv;
+      rrv=-( roz- rrv)/( roz+ rrv);
+      *eth=( gx* phx+ gy* phy)*( rrh- rrv);
+      gx= gx* rrv+ *eth* phx;
+      gy= gy* rrv+ *eth* phy;
+      gz= gz* rrv;
+
+    } /* if( gnd.iperf == 1) */
+
+    ex= ex+ gx;
+    ey= ey+ gy;
+    ez= ez- gz;
+
+  } /* for( ip = 0; ip < gnd.ksymp; ip++ ) */
+
+  ex = ex + cix * CONST3;
+  ey = ey + ciy * CONST3;
+  ez = ez + ciz * CONST3;
+
+  *eth = ex * thx + ey * thy + ez * thz;
+  *eph = ex * phx + ey * phy;
+
+} /* ffld_patches() */
+
+/*-----------------------------------------------------------------------*/
+
 /* ffld calculates the far zone radiated electric fields, */
 /* the factor exp(j*k*r)/(r/lamda) not included */
 static void
 ffld( double thet, double phi,
     complex double *eth, complex double *eph )
 {
-  int k, i, ip, jump;
-  double phx, phy, roz, rozs, thx, thy, thz, rox, roy;
+  int k, i;
+  double phx, phy, roz, thx, thy, thz, rox, roy;
   double tthet=0.0, darg=0.0, omega, el, sill, top, bot, a;
-  double too, boo, b, c, d, rr, ri, arg, dr, rfl, rrz;
+  double too, boo, b, c, d, rr, ri, arg, dr;
   complex double cix=CPLX_00, ciy=CPLX_00, ciz=CPLX_00, ccx=CPLX_00;
   complex double ccy=CPLX_00, ccz=CPLX_00, exa, cdp;
   complex double zrsin, rrv=CPLX_00, rrh=CPLX_00, rrv1=CPLX_00;
   complex double rrh1=CPLX_00, rrv2=CPLX_00, rrh2=CPLX_00;
-  complex double tix, tiy, tiz, zscrn, ex=CPLX_00;
-  complex double ey=CPLX_00, ez=CPLX_00, gx, gy, gz;
+  complex double tix, tiy, tiz, zscrn;
 
   phx= -sin( phi);
   phy= cos( phi);
   roz= cos( thet);
-  rozs= roz;
   thx= roz* phy;
   thy= -roz* phx;
   thz= -sin( thet);
   rox= -thz* phy;
   roy= thz* phx;
 
-  jump = FALSE;
   if( data.n != 0)
   {
     /* loop for structure image if any */
@@ -324,9 +400,7 @@ ffld( double thet, double phi,
 
     } /* for( k=0; k < gnd.ksymp; k++ ) */
 
-    if( data.m > 0)
-      jump = TRUE;
-    else
+    if( data.m == 0 )
     {
       *eth = ( cix * thx + ciy * thy + ciz * thz ) * CONST3;
       *eph = ( cix * phx + ciy * phy ) * CONST3;
@@ -335,65 +409,262 @@ ffld( double thet, double phi,
 
   } /* if( n != 0) */
 
-  if( ! jump )
+  ffld_patches( thet, phi, cix, ciy, ciz, eth, eph );
+
+  return;
+}
+
+/*-----------------------------------------------------------------------*/
+
+/* ffld_sincos()
+ *
+ * Sine and cosine of x for ffld_wires(), free of branches and
+ * of library calls so that the loop calling it is vectorized.
+ * x is reduced to r in [-pi/4, pi/4] by a multiple n of pi/2,
+ * and the fdlibm kernel polynomials of r are combined according
+ * to the quadrant n mod 4. The error is within a few ulp for
+ * |x| < 1e5, beyond any structure in wavelengths here
+ */
+  static inline void
+ffld_sincos( double x, double *s, double *c )
+{
+  double n, r, z, sp, cp, k, m, h;
+
+  /* n = round( x / (pi/2) ), r = x - n * pi/2 in three parts */
+  n = ( x* M_2_PI + 0x1.8p52 ) - 0x1.8p52;
+  r = x - n* 1.57079632673412561417e+00;
+  r = r - n* 6.07710050630396597660e-11;
+  r = r - n* 2.02226624871116645580e-21;
+
+  /* Quadrant m = n mod 4, split as m = 2h + m with h and m
+   * 0 or 1. The rounding of values off by 1/4 or 3/8 from an
+   * integer gives the floor without a branch */
+  k = ( (n - 1.5)* 0.25 + 0x1.8p52 ) - 0x1.8p52;
+  m = n - 4.0* k;
+  h = ( (m - 0.5)* 0.5 + 0x1.8p52 ) - 0x1.8p52;
+  m = m - 2.0* h;
+
+  z  = r* r;
+  sp = r + r* z*( -1.66666666666666324348e-01 +
+      z*(  8.33333333332248946124e-03 +
+      z*( -1.98412698298579493134e-04 +
+      z*(  2.75573137070700676789e-06 +
+      z*( -2.50507602534068634195e-08 +
+      z*   1.58969099521155010221e-10 )))));
+  cp = 1.0 - 0.5* z + z* z*( 4.16666666666666019037e-02 +
+      z*( -1.38888888888741095749e-03 +
+      z*(  2.48015872894767294178e-05 +
+      z*( -2.75573143513906633035e-07 +
+      z*(  2.08757232129817482790e-09 +
+      z*  -1.13596475577881948265e-11 )))));
+
+  /* m and h are exactly 0 or 1, so these select without error */
+  h  = 1.0 - 2.0* h;
+  *s = h*( m* cp + (1.0 - m)* sp );
+  *c = h*( (1.0 - m)* cp - m* sp );
+
+} /* ffld_sincos() */
+
+/*-----------------------------------------------------------------------*/
+
+/* ffld_wires()
+ *
+ * Sums the far field integral of the wire segments, as in ffld(),
+ * for the FFLD_BLOCK directions whose unit vectors are in rox, roy
+ * and roz. The segment loop is outermost so that each segment's data
+ * is read once per block, and the loop over directions has a fixed
+ * count and no branches or library calls, so that the compiler turns
+ * it into vector code in each clone. The small argument forms of
+ * the sin(x)/x terms are blended in by weights that are 0 or 1, as
+ * conditionally computed values would not be vectorized with the
+ * default -ftrapping-math. The real and imaginary parts of the sums
+ * are returned in cxr ... czi.
+ */
+  static void FFLD_TARGET_CLONES
+ffld_wires(
+    const double *restrict rox, const double *restrict roy,
+    const double *restrict roz,
+    double *restrict cxr, double *restrict cxi,
+    double *restrict cyr, double *restrict cyi,
+    double *restrict czr, double *restrict czi )
+{
+  int i, j;
+
+  for( j = 0; j < FFLD_BLOCK; j++ )
   {
-    cix=CPLX_00;
-    ciy=CPLX_00;
-    ciz=CPLX_00;
+    cxr[j] = cxi[j] = 0.0;
+    cyr[j] = cyi[j] = 0.0;
+    czr[j] = czi[j] = 0.0;
   }
 
-  /* electric field components */
-  roz= rozs;
-  rfl=-1.0;
-  for( ip = 0; ip < gnd.ksymp; ip++ )
+  /* loop over structure segments */
+  for( i = 0; i < data.n; i++ )
   {
-    rfl= -rfl;
-    rrz= roz* rfl;
-    fflds( rox, roy, rrz, &crnt.cur[data.n], &gx, &gy, &gz);
-
-    if( ip != 1 )
+    double cab  = data.cab[i];
+    double sab  = data.sab[i];
+    double salp = data.salp[i];
+    double x2   = M_2PI * data.x[i];
+    double y2   = M_2PI * data.y[i];
+    double z2   = M_2PI * data.z[i];
+    double el   = M_PI  * data.si[i];
+    double air  = crnt.air[i], aii = crnt.aii[i];
+    double bir  = crnt.bir[i], bii = crnt.bii[i];
+    double cir  = crnt.cir[i], cii = crnt.cii[i];
+
+    for( j = 0; j < FFLD_BLOCK; j++ )
     {
-      ex= gx;
-      ey= gy;
-      ez= gz;
-      continue;
-    }
+      double omega, sill, top, bot, a, too, boo, b, c;
+      double wo, wt, wb, ss, st, sb, cs;
+      double rr, ri, arg, ca, sa, er, ei;
 
-    if( gnd.iperf == 1)
+      omega=-( rox[j]* cab+ roy[j]* sab+ roz[j]* salp);
+      sill= omega* el;
+      top= el+ sill;
+      bot= el- sill;
+
+      /* Weights of the full forms, 1 above the small arguments */
+      wo = fabs( omega) >= 1.0e-7 ? 1.0 : 0.0;
+      wt = fabs( top)   >= 1.0e-7 ? 1.0 : 0.0;
+      wb = fabs( bot)   >= 1.0e-7 ? 1.0 : 0.0;
+
+      ffld_sincos( sill, &ss, &cs );
+      ffld_sincos( top,  &st, &cs );
+      ffld_sincos( bot,  &sb, &cs );
+
+      /* The divisors are 1 where the weight is 0 */
+      a   = wo* 2.0* ss/( omega+ 1.0- wo ) +
+        ( 1.0- wo )*( 2.0- omega* omega* el* el/3.0)* el;
+      too = wt* st/( top+ 1.0- wt ) + ( 1.0- wt )*( 1.0- top* top/6.0 );
+      boo = wb* sb/( bot+ 1.0- wb ) + ( 1.0- wb )*( 1.0- bot* bot/6.0 );
+
+      b= el*( boo- too);
+      c= el*( boo+ too);
+      rr= a* air+ b* bii+ c* cir;
+      ri= a* aii- b* bir+ c* cii;
+      arg= x2* rox[j]+ y2* roy[j]+ z2* roz[j];
+
+      /* summation for far field integral */
+      ffld_sincos( arg, &sa, &ca );
+      er = ca* rr- sa* ri;
+      ei = ca* ri+ sa* rr;
+      cxr[j] += er* cab;
+      cxi[j] += ei* cab;
+      cyr[j] += er* sab;
+      cyi[j] += ei* sab;
+      czr[j] += er* salp;
+      czi[j] += ei* salp;
+
+    } /* for( j = 0; j < FFLD_BLOCK; j++ ) */
+  } /* for( i = 0; i < data.n; i++ ) */
+
+} /* ffld_wires() */
+
+/*-----------------------------------------------------------------------*/
+
+/* ffld_block()
+ *
+ * Calculates the far zone fields like ffld() for the nb theta
+ * angles in thet[] at one phi angle, evaluating FFLD_BLOCK
+ * directions at a time against all the wire segments. The
+ * cliff and radial ground screen cases, and structures with
+ * no wires, are passed on to ffld() one direction at a time.
+ */
+  static void
+ffld_block( int nb, const double *thet, double phi,
+    complex double *eth, complex double *eph )
+{
+  double rox[FFLD_BLOCK], roy[FFLD_BLOCK], roz[FFLD_BLOCK], rzi[FFLD_BLOCK];
+  double cxr[FFLD_BLOCK], cxi[FFLD_BLOCK], cyr[FFLD_BLOCK];
+  double cyi[FFLD_BLOCK], czr[FFLD_BLOCK], czi[FFLD_BLOCK];
+  double ixr[FFLD_BLOCK], ixi[FFLD_BLOCK], iyr[FFLD_BLOCK];
+  double iyi[FFLD_BLOCK], izr[FFLD_BLOCK], izi[FFLD_BLOCK];
+  double phx, phy, thx, thy, thz, cth;
+  complex double cix, ciy, ciz, ccx, ccy, ccz, cdp, zrsin, rrv, rrh;
+  int j, jb, nj;
+
+  if( (data.n == 0) || ((gnd.ksymp == 2) && (gnd.ifar > 1)) )
+  {
+    for( j = 0; j < nb; j++ )
+      ffld( thet[j], phi, &eth[j], &eph[j] );
+    return;
+  }
+
+  phx= -sin( phi);
+  phy= cos( phi);
+
+  for( jb = 0; jb < nb; jb += FFLD_BLOCK )
+  {
+    nj = nb - jb;
+    if( nj > FFLD_BLOCK ) nj = FFLD_BLOCK;
+
+    /* Directions of this block and of their image,
+     * the unused end of a short block is zeroed */
+    for( j = 0; j < FFLD_BLOCK; j++ )
     {
-      gx= -gx;
-      gy= -gy;
-      gz= -gz;
+      rox[j] = roy[j] = roz[j] = rzi[j] = 0.0;
+      if( j >= nj ) continue;
+      thz= -sin( thet[jb+j]);
+      rox[j]= -thz* phy;
+      roy[j]= thz* phx;
+      roz[j]= cos( thet[jb+j]);
+      rzi[j]= -roz[j];
     }
-    else
+
+    ffld_wires( rox, roy, roz, cxr, cxi, cyr, cyi, czr, czi );
+    if( gnd.ksymp == 2 )
+      ffld_wires( rox, roy, rzi, ixr, ixi, iyr, iyi, izr, izi );
+
+    for( j = 0; j < nj; j++ )
     {
-      rrv= csqrt(1.0- gnd.zrati* gnd.zrati* thz* thz);
-      rrh= gnd.zrati* roz;
-      rrh=( rrh- rrv)/( rrh+ rrv);
-      rrv= gnd.zrati* rrv;
-      rrv=-( roz- rrv)/( roz+ rrv);
-      *eth=( gx* phx+ gy* phy)*( rrh- rrv);
-      gx= gx* rrv+ *eth* phx;
-      gy= gy* rrv+ *eth* phy;
-      gz= gz* rrv;
+      cth= roz[j];
+      thx= cth* phy;
+      thy= -cth* phx;
+      thz= -sin( thet[jb+j]);
 
-    } /* if( gnd.iperf == 1) */
+      cix= cmplx( cxr[j], cxi[j] );
+      ciy= cmplx( cyr[j], cyi[j] );
+      ciz= cmplx( czr[j], czi[j] );
 
-    ex= ex+ gx;
-    ey= ey+ gy;
-    ez= ez- gz;
+      /* contribution of structure image for infinite ground */
+      if( gnd.ksymp == 2 )
+      {
+        if( gnd.iperf == 1)
+        {
+          rrv=-CPLX_10;
+          rrh=-CPLX_10;
+        }
+        else
+        {
+          zrsin= csqrt(1.0- gnd.zrati* gnd.zrati* thz* thz);
+          rrv=-( cth- gnd.zrati* zrsin)/( cth+ gnd.zrati* zrsin);
+          rrh=( gnd.zrati* cth- zrsin)/( gnd.zrati* cth+ zrsin);
+        }
 
-  } /* for( ip = 0; ip < gnd.ksymp; ip++ ) */
+        ccx= cix;
+        ccy= ciy;
+        ccz= ciz;
+        cix= cmplx( ixr[j], ixi[j] );
+        ciy= cmplx( iyr[j], iyi[j] );
+        ciz= cmplx( izr[j], izi[j] );
 
-  ex = ex + cix * CONST3;
-  ey = ey + ciy * CONST3;
-  ez = ez + ciz * CONST3;
+        cdp=( cix* phx+ ciy* phy)*( rrh- rrv);
+        cix= ccx+ cix* rrv+ cdp* phx;
+        ciy= ccy+ ciy* rrv+ cdp* phy;
+        ciz= ccz- ciz* rrv;
+      } /* if( gnd.ksymp == 2 ) */
 
-  *eth = ex * thx + ey * thy + ez * thz;
-  *eph = ex * phx + ey * phy;
+      if( data.m > 0 )
+        ffld_patches( thet[jb+j], phi, cix, ciy, ciz, &eth[jb+j], &eph[jb+j] );
+      else
+      {
+        eth[jb+j] = ( cix * thx + ciy * thy + ciz * thz ) * CONST3;
+        eph[jb+j] = ( cix * phx + ciy * phy ) * CONST3;
+      }
 
-  return;
-}
+    } /* for( j = 0; j < nj; j++ ) */
+  } /* for( jb = 0; jb < nb; jb += FFLD_BLOCK ) */
+
+} /* ffld_block() */
 
 /*-----------------------------------------------------------------------*/
 
@@ -571,20 +842,362 @@ gfld( double rho, double phi, double rz,
 
 /*-----------------------------------------------------------------------*/
 
-/* compute radiation pattern, gain, normalized gain */
-  void
-rdpat( void )
+/* Rdpat_Extremes_Init()
+ *
+ * Primes the max and min gains and their indices
+ */
+  static void
+Rdpat_Extremes_Init( rdpat_extremes_t *ext )
+{
+  int pol;
+
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    ext->max_gain[pol] = -10000.0;
+    ext->min_gain[pol] =  10000.0;
+    ext->max_gain_idx[pol] = 0;
+    ext->min_gain_idx[pol] = 0;
+    ext->max_gain_tht[pol] = 0;
+    ext->max_gain_phi[pol] = 0;
+  }
+
+} /* Rdpat_Extremes_Init() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Extremes_Merge()
+ *
+ * Merges the gain extremes found by a thread into dst. Of equal
+ * gains the one at the lower buffer index is kept, as the serial
+ * scan of the pattern would have found it first
+ */
+  static void
+Rdpat_Extremes_Merge( rdpat_extremes_t *dst, const rdpat_extremes_t *src )
+{
+  int pol;
+
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    if( (dst->max_gain[pol] < src->max_gain[pol]) ||
+        ((dst->max_gain[pol] == src->max_gain[pol]) &&
+         (dst->max_gain_idx[pol] > src->max_gain_idx[pol])) )
+    {
+      dst->max_gain[pol]     = src->max_gain[pol];
+      dst->max_gain_tht[pol] = src->max_gain_tht[pol];
+      dst->max_gain_phi[pol] = src->max_gain_phi[pol];
+      dst->max_gain_idx[pol] = src->max_gain_idx[pol];
+    }
+
+    if( (dst->min_gain[pol] > src->min_gain[pol]) ||
+        ((dst->min_gain[pol] == src->min_gain[pol]) &&
+         (dst->min_gain_idx[pol] > src->min_gain_idx[pol])) )
+    {
+      dst->min_gain[pol]     = src->min_gain[pol];
+      dst->min_gain_idx[pol] = src->min_gain_idx[pol];
+    }
+  }
+
+} /* Rdpat_Extremes_Merge() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Extremes_Add()
+ *
+ * Updates the gain extremes in ext with the gain of
+ * pattern buffer idx, in direction thet, phi
+ */
+  static void
+Rdpat_Extremes_Add( rdpat_extremes_t *ext,
+    int fstep, int idx, double thet, double phi )
 {
-  int kth, kph, isens;
-  double  prad, gcon, gcop;
-  double phi, pha, thet;
-  double tha, ethm2, ethm;
+  int pol;
+  double gain;
+
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    gain = rad_pattern[fstep].gtot[idx] + Polarization_Factor( pol, fstep, idx );
+    if( gain < -999.99 ) gain = -999.99;
+
+    /* Find and save max value of gain and direction */
+    if( ext->max_gain[pol] < gain )
+    {
+      ext->max_gain[pol]     = gain;
+      ext->max_gain_tht[pol] = thet;
+      ext->max_gain_phi[pol] = phi;
+      ext->max_gain_idx[pol] = idx;
+    }
+
+    /* Find and save min value of gain and buffer idx */
+    if( ext->min_gain[pol] > gain )
+    {
+      ext->min_gain[pol]     = gain;
+      ext->min_gain_idx[pol] = idx;
+    }
+
+  } /* for( pol = 0; pol < NUM_POL; pol++ ) */
+
+} /* Rdpat_Extremes_Add() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Rows()
+ *
+ * Computes the radiation pattern at the phi angle rows taken
+ * from the job, until none are left, and merges the gain
+ * extremes found into those of the job
+ */
+  static void
+Rdpat_Rows( rdpat_job_t *job )
+{
+  int kth, kph, isens, idx;
+  double phi, pha, thet, gcon;
+  double ethm2, ethm;
   double etha, ephm2, ephm, epha, tilta, emajr2, eminr2;
   double dfaz, axrat, dfaz2, cdfaz, tstor1=0.0, tstor2;
   double gnmn, stilta, gnmj, gnv, gnh, gtot;
   complex double eth, eph, erd;
-  int idx, pol; /* Gain buffer and pol type index */
-  double gain;
+  rdpat_extremes_t ext;
+  rad_pattern_t *rp = &rad_pattern[job->fstep];
+
+  /* Theta angles and far fields of one phi row */
+  double *tha_row = NULL;
+  complex double *eth_row = NULL, *eph_row = NULL;
+
+  if( gnd.ifar != 1 )
+  {
+    size_t mreq = (size_t)fpat.nth * sizeof(double);
+    mem_alloc( (void **)&tha_row, mreq, "in radiation.c" );
+    mreq = (size_t)fpat.nth * sizeof(complex double);
+    mem_alloc( (void **)&eth_row, mreq, "in radiation.c" );
+    mem_alloc( (void **)&eph_row, mreq, "in radiation.c" );
+  }
+
+  Rdpat_Extremes_Init( &ext );
+  gcon = job->gcon;
+
+  /* Step over phi angle rows and theta angles */
+  while( (kph = g_atomic_int_add(&job->next, 1)) < fpat.nph )
+  {
+    phi= fpat.phis + fpat.dph * (double)kph;
+    pha= phi* TORAD;
+
+    /* Far fields of the whole theta row at this phi */
+    if( gnd.ifar != 1 )
+    {
+      for( kth = 0; kth < fpat.nth; kth++ )
+        tha_row[kth] = ( fpat.thets + fpat.dth * (double)kth )* TORAD;
+      ffld_block( fpat.nth, tha_row, pha, eth_row, eph_row );
+    }
+
+    for( kth = 0; kth < fpat.nth; kth++ )
+    {
+      thet= fpat.thets + fpat.dth * (double)kth;
+
+      if( gnd.ifar != 1)
+      {
+        eth = eth_row[kth];
+        eph = eph_row[kth];
+      }
+      else
+      {
+        gfld( fpat.rfld/data.wlam, pha, thet/data.wlam,
+            &eth, &eph, &erd, gnd.zrati, gnd.ksymp);
+        continue;
+      }
+
+      ethm2= creal( eth* conj( eth));
+      ethm= sqrt( ethm2);
+      etha= cang( eth);
+      ephm2= creal( eph* conj( eph));
+      ephm= sqrt( ephm2);
+      epha= cang( eph);
+
+      /* elliptical polarization calc. */
+      if( (ethm2 <= 1.0e-20) && (ephm2 <= 1.0e-20) )
+      {
+        tilta=0.0;
+        emajr2=0.0;
+        eminr2=0.0;
+        axrat=0.0;
+        isens= 0;
+      }
+      else
+      {
+        dfaz= epha- etha;
+        if( epha >= 0.0)
+          dfaz2= dfaz-360.0;
+        else
+          dfaz2= dfaz+360.0;
+
+        if( fabs(dfaz) > fabs(dfaz2) )
+          dfaz= dfaz2;
+
+        cdfaz= cos( dfaz* TORAD);
+        tstor1= ethm2- ephm2;
+        tstor2=2.0* ephm* ethm* cdfaz;
+        tilta=atan2( tstor2, tstor1)/2.0;
+        stilta= sin( tilta);
+        tstor1= tstor1* stilta* stilta;
+        tstor2= tstor2* stilta* cos( tilta);
+        emajr2= -tstor1+ tstor2+ ethm2;
+        eminr2= tstor1- tstor2+ ephm2;
+        if( eminr2 < 0.0) eminr2=0.0;
+
+        axrat= sqrt( eminr2/ emajr2);
+        if( axrat <= 1.0e-5)
+          isens= 1;
+        else if( dfaz <= 0.0)
+          isens= 2;
+        else
+          isens= 3;
+
+      } /* if( (ethm2 <= 1.0e-20) && (ephm2 <= 1.0e-20) ) */
+
+      gnmj= db10( gcon* emajr2);
+      gnmn= db10( gcon* eminr2);
+      gnv = db10( gcon* ethm2);
+      gnh = db10( gcon* ephm2);
+      gtot= db10( gcon* (ethm2+ ephm2) );
+
+      switch( fpat.inor )
+      {
+        case 0:
+          tstor1= gtot;
+          break;
+
+        case 1:
+          tstor1= gnmj;
+          break;
+
+        case 2:
+          tstor1= gnmn;
+          break;
+
+        case 3:
+          tstor1= gnv;
+          break;
+
+        case 4:
+          tstor1= gnh;
+          break;
+
+        case 5:
+          tstor1= gtot;
+      }
+
+      /* Save rad pattern gains */
+      idx = kph * fpat.nth + kth;
+      rp->gtot[idx] = tstor1;
+
+      /* Save axial ratio, tilt and pol sense */
+      if( isens == 2 )
+        rp->axrt[idx] = -axrat;
+      else
+        rp->axrt[idx] = axrat;
+      rp->tilt[idx] = tilta;
+      rp->sens[idx] = isens;
+
+      /* Find and save max value of gain and direction */
+      Rdpat_Extremes_Add( &ext, job->fstep, idx, thet, phi );
+
+    } /* for( kth = 0; kth < fpat.nth; kth++ ) */
+  } /* while( (kph = ...) < fpat.nph ) */
+
+  g_mutex_lock( &job->lock );
+  Rdpat_Extremes_Merge( &job->ext, &ext );
+  g_mutex_unlock( &job->lock );
+
+  free_ptr( (void **)&tha_row );
+  free_ptr( (void **)&eth_row );
+  free_ptr( (void **)&eph_row );
+
+} /* Rdpat_Rows() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Thread()
+ *
+ * Entry point of the rdpat() threads. gfld() uses the
+ * ground wave common, so each thread has its own copy
+ */
+  static void *
+Rdpat_Thread( void *arg )
+{
+  rdpat_job_t *job = (rdpat_job_t *)arg;
+  gwav_t gwav_thr = job->caller_gwav;
+
+  gwav_p = &gwav_thr;
+  Rdpat_Rows( job );
+
+  return( NULL );
+} /* Rdpat_Thread() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Back_Gain()
+ *
+ * Saves the gain of each polarization type in the direction
+ * opposite its maximum gain, for the front to back ratio of
+ * meas_calc(), so that it is known without the full pattern
+ */
+  static void
+Rdpat_Back_Gain( int fstep )
+{
+  rad_pattern_t *rp = &rad_pattern[fstep];
+  double fbdir;
+  int pol, nth, nph, idx;
+
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    /* Find F/B direction in theta */
+    fbdir = 180.0 - rp->max_gain_tht[pol];
+    if( fpat.dth == 0.0 )
+      nth = 0;
+    else
+      nth = (int)( fbdir / fpat.dth + 0.5 );
+
+    /* If the antenna is modelled over ground, then use the same
+     * theta as the max gain direction, relying on phi alone to take
+     * us to the back. Patch supplied by Rik van Riel AB1KW */
+    if( (nth >= fpat.nth) || (nth < 0) )
+    {
+      fbdir = rp->max_gain_tht[pol];
+      if( fpat.dth == 0.0 )
+        nth = 0;
+      else
+        nth = (int)( fbdir / fpat.dth + 0.5 );
+    }
+
+    /* Find F/B direction in phi */
+    fbdir = rp->max_gain_phi[pol] + 180.0;
+    if( fbdir >= 360.0 )
+      fbdir -= 360.0;
+    nph = (int)( fbdir / fpat.dph + 0.5 );
+
+    /* No F/B calc. possible if no phi step at +180 from max gain */
+    rp->back_gain_idx[pol] = -1;
+    rp->back_gain[pol] = 0.0;
+    if( (nph >= fpat.nph) || (nph < 0) )
+      continue;
+
+    /* Index to gtot buffer for gain in back direction */
+    idx = nth + nph * fpat.nth;
+    rp->back_gain_idx[pol] = idx;
+    rp->back_gain[pol] = rp->gtot[idx] + Polarization_Factor( pol, fstep, idx );
+  }
+
+} /* Rdpat_Back_Gain() */
+
+/*-----------------------------------------------------------------------*/
+
+/* compute radiation pattern, gain, normalized gain */
+  void
+rdpat( void )
+{
+  int kth, nthr, idx, pol;
+  double prad, gcon, gcop, thet;
+  pthread_t *thrd = NULL;
+  rdpat_job_t job;
 
 
   if( gnd.ifar != 4 )
@@ -617,188 +1230,452 @@ rdpat( void )
   else gcon=4.0* M_PI/(1.0+ calc_data.xpr6* calc_data.xpr6);
   /*** Incident field source ***/
 
-  phi  = fpat.phis - fpat.dph;
-
   /*** Save radiation pattern data ***/
-  /* Prime max and min gains and index */
   int fstep = calc_data.freq_step;
   if (fstep < 0)
 	  return;
 
-  for( pol = 0; pol < NUM_POL; pol++ )
-  {
-    rad_pattern[fstep].max_gain[pol] = -10000.0;
-    rad_pattern[fstep].min_gain[pol] =  10000.0;
-    rad_pattern[fstep].max_gain_idx[pol] = 0;
-    rad_pattern[fstep].min_gain_idx[pol] = 0;
-    rad_pattern[fstep].max_gain_tht[pol] = 0;
-    rad_pattern[fstep].max_gain_phi[pol] = 0;
-  }
-
   /* Signal new rad pattern data */
   SetFlag( DRAW_NEW_RDPAT );
 
-  /* Step over theta and phi angles */
-  idx = 0;
-  for( kph = 1; kph <= fpat.nph; kph++ )
-  {
-    phi += fpat.dph;
-    pha= phi* TORAD;
-    thet= fpat.thets - fpat.dth;
-
-    for( kth = 1; kth <= fpat.nth; kth++ )
+  /* Stop() may open a dialog so the theta
+   * angles are checked here, not in the threads */
+  if( (gnd.ksymp == 2) && (gnd.ifar != 1) )
+    for( kth = 0; kth < fpat.nth; kth++ )
     {
-      thet += fpat.dth;
-
-      if( (gnd.ksymp == 2) && (thet > 90.01) && (gnd.ifar != 1) )
+      thet= fpat.thets + fpat.dth * (double)kth;
+      if( thet > 90.01 )
       {
+#ifndef XNEC2C_BATCH
         Gtk_Widget_Destroy( &rdpattern_window );
+#endif
         pr_err("Theta > 90 deg with ground specified: Please check RP card data and correct\n");
         Stop( _("Theta > 90 deg with ground specified\n"
               "Please check RP card data and correct"), ERR_STOP );
+        break;
       }
+    }
 
-      tha= thet* TORAD;
-      if( gnd.ifar != 1)
-        ffld( tha, pha, &eth, &eph);
-      else
+  /* Make room for the pattern if it is kept in the store */
+  Rdpat_Store_New( fstep );
+
+  job.fstep = fstep;
+  job.gcon  = gcon;
+  job.next  = 0;
+  job.caller_gwav = gwav;
+  g_mutex_init( &job.lock );
+  Rdpat_Extremes_Init( &job.ext );
+
+  /* Phi angle rows are shared out to the threads,
+   * the calling thread computes rows too */
+  nthr = rc_config.fill_threads;
+  if( nthr > fpat.nph )
+    nthr = fpat.nph;
+
+  idx = 0;
+  if( nthr > 1 )
+  {
+    size_t mreq = (size_t)(nthr-1) * sizeof(pthread_t);
+    mem_alloc( (void **)&thrd, mreq, "in radiation.c" );
+    for( idx = 0; idx < nthr-1; idx++ )
+      if( pthread_create(&thrd[idx], NULL, Rdpat_Thread, &job) != 0 )
       {
-        gfld( fpat.rfld/data.wlam, pha, thet/data.wlam,
-            &eth, &eph, &erd, gnd.zrati, gnd.ksymp);
+        perror( "xnec2c: pthread_create()" );
+        break;
       }
+  }
 
-      ethm2= creal( eth* conj( eth));
-      ethm= sqrt( ethm2);
-      etha= cang( eth);
-      ephm2= creal( eph* conj( eph));
-      ephm= sqrt( ephm2);
-      epha= cang( eph);
+  Rdpat_Rows( &job );
 
-      /* elliptical polarization calc. */
-      if( gnd.ifar != 1)
-      {
-        if( (ethm2 <= 1.0e-20) && (ephm2 <= 1.0e-20) )
-        {
-          tilta=0.0;
-          emajr2=0.0;
-          eminr2=0.0;
-          axrat=0.0;
-          isens= 0;
-        }
-        else
-        {
-          dfaz= epha- etha;
-          if( epha >= 0.0)
-            dfaz2= dfaz-360.0;
-          else
-            dfaz2= dfaz+360.0;
-
-          if( fabs(dfaz) > fabs(dfaz2) )
-            dfaz= dfaz2;
-
-          cdfaz= cos( dfaz* TORAD);
-          tstor1= ethm2- ephm2;
-          tstor2=2.0* ephm* ethm* cdfaz;
-          tilta=atan2( tstor2, tstor1)/2.0;
-          stilta= sin( tilta);
-          tstor1= tstor1* stilta* stilta;
-          tstor2= tstor2* stilta* cos( tilta);
-          emajr2= -tstor1+ tstor2+ ethm2;
-          eminr2= tstor1- tstor2+ ephm2;
-          if( eminr2 < 0.0) eminr2=0.0;
-
-          axrat= sqrt( eminr2/ emajr2);
-          if( axrat <= 1.0e-5)
-            isens= 1;
-          else if( dfaz <= 0.0)
-            isens= 2;
-          else
-            isens= 3;
+  while( idx-- > 0 )
+    pthread_join( thrd[idx], NULL );
 
-        } /* if( (ethm2 <= 1.0e-20) && (ephm2 <= 1.0e-20) ) */
+  free_ptr( (void **)&thrd );
+  g_mutex_clear( &job.lock );
 
-        gnmj= db10( gcon* emajr2);
-        gnmn= db10( gcon* eminr2);
-        gnv = db10( gcon* ethm2);
-        gnh = db10( gcon* ephm2);
-        gtot= db10( gcon* (ethm2+ ephm2) );
+  /* Save max and min gains and their direction */
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    rad_pattern[fstep].max_gain[pol]     = job.ext.max_gain[pol];
+    rad_pattern[fstep].min_gain[pol]     = job.ext.min_gain[pol];
+    rad_pattern[fstep].max_gain_idx[pol] = job.ext.max_gain_idx[pol];
+    rad_pattern[fstep].min_gain_idx[pol] = job.ext.min_gain_idx[pol];
+    rad_pattern[fstep].max_gain_tht[pol] = job.ext.max_gain_tht[pol];
+    rad_pattern[fstep].max_gain_phi[pol] = job.ext.max_gain_phi[pol];
+  }
+  Rdpat_Back_Gain( fstep );
 
-        switch( fpat.inor )
-        {
-          case 0:
-            tstor1= gtot;
-            break;
+  return;
 
-          case 1:
-            tstor1= gnmj;
-            break;
+} /* void rdpat() */
 
-          case 2:
-            tstor1= gnmn;
-            break;
+/*-----------------------------------------------------------------------*/
 
-          case 3:
-            tstor1= gnv;
-            break;
+/* Rdpat_Set_Extremes()
+ *
+ * Finds the gain extremes of the pattern of frequency step
+ * fstep from its buffers, for patterns not made by rdpat()
+ */
+  void
+Rdpat_Set_Extremes( int fstep )
+{
+  int kth, kph, idx, pol;
+  rdpat_extremes_t ext;
 
-          case 4:
-            tstor1= gnh;
-            break;
+  Rdpat_Extremes_Init( &ext );
+  for( kph = 0; kph < fpat.nph; kph++ )
+    for( kth = 0; kth < fpat.nth; kth++ )
+    {
+      idx = kph * fpat.nth + kth;
+      Rdpat_Extremes_Add( &ext, fstep, idx,
+          fpat.thets + fpat.dth * (double)kth,
+          fpat.phis  + fpat.dph * (double)kph );
+    }
 
-          case 5:
-            tstor1= gtot;
-        }
+  for( pol = 0; pol < NUM_POL; pol++ )
+  {
+    rad_pattern[fstep].max_gain[pol]     = ext.max_gain[pol];
+    rad_pattern[fstep].min_gain[pol]     = ext.min_gain[pol];
+    rad_pattern[fstep].max_gain_idx[pol] = ext.max_gain_idx[pol];
+    rad_pattern[fstep].min_gain_idx[pol] = ext.min_gain_idx[pol];
+    rad_pattern[fstep].max_gain_tht[pol] = ext.max_gain_tht[pol];
+    rad_pattern[fstep].max_gain_phi[pol] = ext.max_gain_phi[pol];
+  }
+  Rdpat_Back_Gain( fstep );
 
-        /* Save rad pattern gains */
-        int fstep = calc_data.freq_step;
-		if (fstep < 0)
-			return;
+} /* Rdpat_Set_Extremes() */
 
-        rad_pattern[fstep].gtot[idx] = tstor1;
+/*-----------------------------------------------------------------------*/
 
-        /* Save axial ratio, tilt and pol sense */
-        if( isens == 2 )
-          rad_pattern[fstep].axrt[idx] = -axrat;
-        else
-          rad_pattern[fstep].axrt[idx] = axrat;
-        rad_pattern[fstep].tilt[idx] = tilta;
-        rad_pattern[fstep].sens[idx] = isens;
+/* Polarization_Factor()
+ *
+ * Calculates polarization factor from axial
+ * ratio and tilt of polarization ellipse
+ */
+  double
+Polarization_Factor( int pol_type, int fstep, int idx )
+{
+  double axrt = 0.0, tilt = 0.0, axrt2, tilt2, polf = 1.0;
 
-        /* Find and save max value of gain and direction */
-        for( pol = 0; pol < NUM_POL; pol++ )
-        {
-          gain = rad_pattern[fstep].gtot[idx] +
-            Polarization_Factor( pol, fstep, idx);
-          if( gain < -999.99 ) gain = -999.99;
+  /* Patterns not in memory are read from the store file */
+  if( pol_type != POL_TOTAL )
+  {
+    if( rad_pattern[fstep].axrt == NULL )
+      Rdpat_Store_Point( fstep, idx, NULL, &axrt, &tilt );
+    else
+    {
+      axrt = rad_pattern[fstep].axrt[idx];
+      tilt = rad_pattern[fstep].tilt[idx];
+    }
+  }
 
-          /* Find and save max value of gain and direction */
-          if( rad_pattern[fstep].max_gain[pol] < gain )
-          {
-            rad_pattern[fstep].max_gain[pol]     = gain;
-            rad_pattern[fstep].max_gain_tht[pol] = thet;
-            rad_pattern[fstep].max_gain_phi[pol] = phi;
-            rad_pattern[fstep].max_gain_idx[pol] = idx;
-          }
+  switch( pol_type )
+  {
+    case POL_TOTAL:
+      polf = 1.0;
+      break;
+
+    case POL_HORIZ:
+      axrt2  = axrt * axrt;
+      tilt2  = sin( tilt );
+      tilt2 *= tilt2;
+      polf = (axrt2 + (1.0 - axrt2) * tilt2) / (1.0 + axrt2);
+      break;
+
+    case POL_VERT:
+      axrt2  = axrt * axrt;
+      tilt2  = cos( tilt );
+      tilt2 *= tilt2;
+      polf = (axrt2 + (1.0 - axrt2) * tilt2) / (1.0 + axrt2);
+      break;
+
+    case POL_LHCP:
+      axrt2 = axrt * axrt;
+      polf  = (1.0 + 2.0 * axrt + axrt2) / 2.0 / (1.0 + axrt2);
+      break;
+
+    case POL_RHCP:
+      axrt2 = axrt * axrt;
+      polf  = (1.0 - 2.0 * axrt + axrt2) / 2.0 / (1.0 + axrt2);
+  }
 
-          /* Find and save min value of gain and buffer idx */
-          if( rad_pattern[fstep].min_gain[pol] > gain )
-          {
-            rad_pattern[fstep].min_gain[pol]     = gain;
-            rad_pattern[fstep].min_gain_idx[pol] = idx;
-          }
+  if( polf < 1.0E-200 ) polf = 1.0E-200;
+  polf = 10.0 * log10( polf );
 
-        } /* for( pol = 0; pol < NUM_POL; pol++ ) */
+  return( polf );
+} /* Polarization_Factor() */
 
-        idx++;
-        continue;
-      } /* if( gnd.ifar != 1) */
+/*-----------------------------------------------------------------------*/
 
-    } /* for( kth = 1; kth <= fpat.nth; kth++ ) */
-  } /* for( kph = 1; kph <= fpat.nph; kph++ ) */
+/* Scale_Gain()
+ *
+ * Scales radiation pattern gain according to selected style
+ * ( ARRL style, logarithmic or linear voltage/power )
+ */
+double Scale_Gain( double gain, int fstep, int idx )
+{
+  /* Scaled rad pattern gain and pol factor */
+  double scaled_rad = 0.0;
 
-  return;
+  gain += Polarization_Factor( calc_data.pol_type, fstep, idx );
 
-} /* void rdpat() */
+  switch( rc_config.gain_style )
+  {
+    case GS_LINP:
+      scaled_rad = pow(10.0, (gain/10.0));
+      break;
+
+    case GS_LINV:
+      scaled_rad = pow(10.0, (gain/20.0));
+      break;
+
+    case GS_ARRL:
+      scaled_rad = exp( 0.058267 * gain );
+      break;
+
+    case GS_LOG:
+      scaled_rad = gain;
+      if( scaled_rad < -40 )
+        scaled_rad = 0.0;
+      else
+        scaled_rad = scaled_rad /40.0 + 1.0;
+
+  } /* switch( rc_config.gain_style ) */
+
+  return( scaled_rad );
+
+} /* Scale_Gain() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Number of rad_pattern buffers and of those
+ * that point into the shared frequency data slots */
+static int last_nfrq   = 0;
+static int last_nslots = 0;
+
+/* Rdpattern_Slots_Remap()
+ *
+ * Re-reads the pointers of the rad_pattern buffers kept in the
+ * shared frequency data slots after these are (re)mapped, as
+ * the old mapping is gone. Buffers no longer in the slots are
+ * cleared, Alloc_Rdpattern_Buffers() allocates them again
+ */
+  void
+Rdpattern_Slots_Remap( void )
+{
+  int idx;
+
+  g_mutex_lock( &freq_data_lock );
+  for( idx = 0; idx < last_nslots; idx++ )
+    if( !Freq_Slot_Rdpattern(idx, &rad_pattern[idx]) )
+      memset( &rad_pattern[idx], 0, sizeof(rad_pattern_t) );
+  g_mutex_unlock( &freq_data_lock );
+
+} /* Rdpattern_Slots_Remap() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Alloc_Rdpattern_Buffers
+ *
+ * Allocates memory to the radiation pattern buffers
+ */
+  void
+_Alloc_Rdpattern_Buffers( int nfrq, int nth, int nph )
+{
+  int idx;
+  size_t mreq;
+  gboolean store;
+
+  /* Patterns in memory of the store are its own buffers */
+  Rdpat_Store_Unmap();
+
+  /* Free old gain buffers first, except those in shared slots */
+  for( idx = last_nslots; idx < last_nfrq; idx++ )
+  {
+    free_ptr( (void **)&rad_pattern[idx].gtot );
+    free_ptr( (void **)&rad_pattern[idx].max_gain );
+    free_ptr( (void **)&rad_pattern[idx].min_gain );
+    free_ptr( (void **)&rad_pattern[idx].max_gain_tht );
+    free_ptr( (void **)&rad_pattern[idx].max_gain_phi );
+    free_ptr( (void **)&rad_pattern[idx].back_gain );
+    free_ptr( (void **)&rad_pattern[idx].max_gain_idx );
+    free_ptr( (void **)&rad_pattern[idx].min_gain_idx );
+    free_ptr( (void **)&rad_pattern[idx].back_gain_idx );
+    free_ptr( (void **)&rad_pattern[idx].axrt );
+    free_ptr( (void **)&rad_pattern[idx].tilt );
+    free_ptr( (void **)&rad_pattern[idx].sens );
+  }
+  last_nfrq = nfrq;
+
+  /* Allocate rad pattern buffers */
+  mreq = (size_t)nfrq * sizeof(rad_pattern_t);
+  mem_realloc( (void **)&rad_pattern, mreq, "in radiation.c" );
+
+  /* When forked, patterns computed by the children
+   * are used in place in the shared frequency data slots */
+  for( idx = 0; idx < nfrq; idx++ )
+    if( !Freq_Slot_Rdpattern(idx, &rad_pattern[idx]) ) break;
+  last_nslots = idx;
+
+  /* With --rdpat-mb only the summaries of long sweeps are
+   * allocated here, the full patterns are in the store */
+  store = Rdpat_Store_Map( nfrq, nth, nph );
+
+  for( ; idx < nfrq; idx++ )
+  {
+    /* Memory request for allocs */
+    mreq = (size_t)(nph * nth) * sizeof(double);
+    rad_pattern[idx].gtot = NULL;
+    rad_pattern[idx].axrt = NULL;
+    rad_pattern[idx].tilt = NULL;
+    rad_pattern[idx].sens = NULL;
+    if( !store )
+    {
+      mem_alloc( (void **)&(rad_pattern[idx].gtot), mreq, "in radiation.c" );
+      mem_alloc( (void **)&(rad_pattern[idx].axrt), mreq, "in radiation.c" );
+      mem_alloc( (void **)&(rad_pattern[idx].tilt), mreq, "in radiation.c" );
+      mreq = (size_t)(nph * nth) * sizeof(int);
+      mem_alloc( (void **)&(rad_pattern[idx].sens), mreq, "in radiation.c" );
+    }
+
+    mreq = NUM_POL * sizeof(double);
+    rad_pattern[idx].max_gain = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].max_gain), mreq, "in radiation.c" );
+    rad_pattern[idx].min_gain = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].min_gain), mreq, "in radiation.c" );
+    rad_pattern[idx].max_gain_tht = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].max_gain_tht), mreq, "in radiation.c" );
+    rad_pattern[idx].max_gain_phi = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].max_gain_phi), mreq, "in radiation.c" );
+    rad_pattern[idx].back_gain = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].back_gain), mreq, "in radiation.c" );
+
+    mreq = NUM_POL * sizeof(int);
+    rad_pattern[idx].max_gain_idx = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].max_gain_idx), mreq, "in radiation.c" );
+    rad_pattern[idx].min_gain_idx = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].min_gain_idx), mreq, "in radiation.c" );
+    rad_pattern[idx].back_gain_idx = NULL;
+    mem_alloc( (void **)&(rad_pattern[idx].back_gain_idx), mreq, "in radiation.c" );
+  }
+
+} /* Alloc_Rdpattern_Buffers() */
+
+void Alloc_Rdpattern_Buffers( int nfrq, int nth, int nph )
+{
+	g_mutex_lock(&freq_data_lock);
+	_Alloc_Rdpattern_Buffers(nfrq, nth, nph);
+	g_mutex_unlock(&freq_data_lock);
+}
+
+/*-----------------------------------------------------------------------*/
+
+/* Alloc_Nearfield_Buffers
+ *
+ * Allocates memory to the radiation pattern buffers
+ */
+  void
+Alloc_Nearfield_Buffers( int n1, int n2, int n3 )
+{
+  size_t mreq;
+
+  if( isFlagClear(ALLOC_NEAREH_BUFF) ) return;
+  ClearFlag( ALLOC_NEAREH_BUFF );
+
+  /* Memory request for allocations */
+  mreq = (size_t)(n1 * n2 * n3) * sizeof( double );
+
+  /* Allocate near field buffers */
+  if( fpat.nfeh & NEAR_EFIELD )
+  {
+    mem_realloc( (void **)&near_field.ex,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.ey,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.ez,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fex, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fey, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fez, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.erx, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.ery, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.erz, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.er,  mreq, "in radiation.c" );
+  }
+
+  if( fpat.nfeh & NEAR_HFIELD )
+  {
+    mem_realloc( (void **)&near_field.hx,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hy,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hz,  mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fhx, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fhy, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.fhz, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hrx, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hry, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hrz, mreq, "in radiation.c" );
+    mem_realloc( (void **)&near_field.hr,  mreq, "in radiation.c" );
+  }
+
+  mem_realloc( (void **)&near_field.px, mreq, "in radiation.c" );
+  mem_realloc( (void **)&near_field.py, mreq, "in radiation.c" );
+  mem_realloc( (void **)&near_field.pz, mreq, "in radiation.c" );
+
+} /* Alloc_Nearfield_Buffers() */
 
 /*-----------------------------------------------------------------------*/
 
+/* Viewer_Gain()
+ *
+ * Calculate gain in direction of viewer
+ * (e.g. Perpenticular to the Screen)
+ */
+  double
+Viewer_Gain( projection_parameters_t proj_parameters, int fstep )
+{
+  double phi, gain;
+  int nth, nph, idx;
+
+  /* Calculate theta step from proj params */
+  phi = proj_parameters.Wr;
+  if( fpat.dth == 0.0 ) nth = 0;
+  else
+  {
+    double theta;
+    theta = fabs( 90.0 - proj_parameters.Wi );
+    if( theta > 180.0 )
+    {
+      theta = 360.0 - theta;
+      phi  -= 180.0;
+    }
+
+    if( (gnd.ksymp == 2) &&
+        (theta > 90.01)  &&
+        (gnd.ifar != 1) )
+      return( -999.99 );
+
+    nth = (int)( (theta - fpat.thets) / fpat.dth + 0.5 );
+    if( (nth >= fpat.nth) || (nth < 0) )
+      nth = fpat.nth-1;
+  }
+
+  /* Calculate phi step from proj params */
+  if( fpat.dph == 0.0 ) nph = 0;
+  else
+  {
+    while( phi < 0.0 ) phi += 360.0;
+    nph = (int)( (phi - fpat.phis) / fpat.dph + 0.5 );
+    if( (nph >= fpat.nph) || (nph < 0) )
+      nph = fpat.nph-1;
+  }
+
+  idx = nth + nph * fpat.nth;
+  if( rad_pattern[fstep].gtot == NULL )
+    Rdpat_Store_Point( fstep, idx, &gain, NULL, NULL );
+  else
+    gain = rad_pattern[fstep].gtot[idx];
+  gain += Polarization_Factor( calc_data.pol_type, fstep, idx );
+  if( gain < -999.99 ) gain = -999.99;
+
+  return( gain );
+
+} /* Viewer_Gain() */
+
+/*-----------------------------------------------------------------------*/
@@ -24,5 +24,49 @@
 
 #define CONST3  (0.0-I*29.97922085)
 
+/* Number of far field directions evaluated together by ffld_block(),
+ * a multiple of the vector lengths of ffld_wires() */
+#define FFLD_BLOCK  32
+
+/* Build the far field kernel for AVX-512, AVX2 and generic CPUs */
+#ifdef HAVE_FUNC_ATTRIBUTE_TARGET_CLONES
+#define FFLD_TARGET_CLONES  __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define FFLD_TARGET_CLONES
+#endif
+
+/* Gain extremes of the radiation pattern found by one rdpat() thread */
+typedef struct
+{
+  double
+    max_gain[NUM_POL],      /* Maximum gain for each polarization type */
+    min_gain[NUM_POL],      /* Minimum gain for each polarization type */
+    max_gain_tht[NUM_POL],  /* Theta angle where maximum gain occurs */
+    max_gain_phi[NUM_POL];  /*   Phi angle where maximum gain occurs */
+
+  int
+    max_gain_idx[NUM_POL],  /* Where in rad_pattern.gtot the max value occurs */
+    min_gain_idx[NUM_POL];  /* Where in rad_pattern.gtot the min value occurs */
+
+} rdpat_extremes_t;
+
+/* Radiation pattern job shared by the rdpat() threads */
+typedef struct
+{
+  int fstep;      /* Frequency step of the pattern */
+  double gcon;    /* Gain normalization constant */
+
+  /* Next phi angle row to compute */
+  gint next;
+
+  /* Gain extremes merged from all the threads */
+  GMutex lock;
+  rdpat_extremes_t ext;
+
+  /* Ground wave state of the calling thread, for gfld() */
+  gwav_t caller_gwav;
+
+} rdpat_job_t;
+
 #endif
 
@@ -163,6 +163,10 @@ rc_config_vars_t rc_config_vars[] = {
 		.parse = mathlib_config_benchmark_parse,
 		.save = mathlib_config_benchmark_save  },
 
+	{ .desc = "Mathlib Autotuner Table",
+		.parse = mathlib_config_autotune_parse,
+		.save = mathlib_config_autotune_save  },
+
 	{ .desc = "Selected fmhz_save Frequency", .format = "%lf",
 		.vars = { &calc_data.fmhz_save } },
 
@@ -676,7 +680,7 @@ Read_Config( void )
   char
     home[PATH_MAX],
     fpath[FILENAME_LEN], /* File path to xnec2crc */
-    line[LINE_LEN];
+    line[CONFIG_LINE_LEN];
   int lnum;
 
   struct stat st;
@@ -724,7 +728,7 @@ Read_Config( void )
   // their references defined by rc_config_vars[].
   lnum = 0;
 
-  while ( fgets(line, LINE_LEN, fp) != NULL)
+  while ( fgets(line, CONFIG_LINE_LEN, fp) != NULL)
   {
 	  lnum++;
       
@@ -738,7 +742,7 @@ Read_Config( void )
 		  continue;
 	  }
 	  
-	  if ( fgets(line, LINE_LEN, fp) == NULL)
+	  if ( fgets(line, CONFIG_LINE_LEN, fp) == NULL)
 	  {
 		  pr_err("%s:%d: Early end of file for %s: %s \n", fpath, lnum, v->desc, line);
 		  break;
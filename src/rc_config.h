@@ -27,6 +27,9 @@
 
 #define CONFIG_FILE     ".xnec2c/xnec2c.conf"
 
+// Longest line of the config file, the mathlib autotuner table is long:
+#define CONFIG_LINE_LEN 2048
+
 typedef struct rc_config_vars_t {
 	size_t size;
 	int ro;          // read-only field like version
@@ -0,0 +1,502 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Radiation pattern store. With --rdpat-mb, when the full patterns
+ * of all the frequency steps would take more than MB of memory,
+ * rad_pattern[] keeps only a summary of each step: the gain
+ * extremes, their directions and the gain in the back direction.
+ * The full patterns are kept in single precision in a temporary
+ * file, mapped in memory, and as many as fit in MB are kept in
+ * memory in double precision, where rad_pattern[fstep] points
+ * to them. Rdpat_Store_Load() brings a pattern into memory before
+ * it is used, writing back the one used least recently to make
+ * room, and Rdpat_Store_Point() reads the gain of one direction,
+ * as for the viewer gain of each step in the frequency plots.
+ *
+ * Child processes make each step in buffer 0 and write it to the
+ * file, which they share with the parent, before they pass the
+ * rest of the data of the step in the frequency data slots.
+ */
+
+#include "rdpat_store.h"
+#include "shared.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Descriptor of the unlinked store file, -1 if not in use */
+static int store_fd = -1;
+
+/* Mapping of the store file in the parent, its size, the size
+ * of the pattern of a step in it and the directions of a step */
+static char *store_mem = NULL;
+static size_t store_size = 0, store_stride = 0;
+static int store_nrp = 0;
+
+/* Pattern of a step converted for writing to the file */
+static char *store_buf = NULL;
+
+/* Patterns kept in memory and the slot of each step, -1 if
+ * it is only in the file. Slots are used under store_lock */
+static rdpat_slot_t *slots = NULL;
+static int nslots = 0, nsteps = 0;
+static int *step_slot = NULL;
+static guint64 slots_used = 0;
+static GMutex store_lock;
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Open()
+ *
+ * Creates the store file if --rdpat-mb is given. It is called
+ * before the child processes are forked, so they share it
+ */
+  void
+Rdpat_Store_Open( void )
+{
+  char fname[FILENAME_LEN];
+  const char *dir;
+
+  if( (rc_config.rdpat_mb <= 0) || (store_fd >= 0) )
+    return;
+
+  dir = getenv( "TMPDIR" );
+  if( (dir == NULL) || (dir[0] == '\0') )
+    dir = "/tmp";
+  snprintf( fname, sizeof(fname), "%s/xnec2c-rdpat-XXXXXX", dir );
+
+  store_fd = mkstemp( fname );
+  if( store_fd < 0 )
+  {
+    pr_err( "cannot create radiation pattern file %s: %s\n",
+        fname, strerror(errno) );
+    return;
+  }
+  unlink( fname );
+
+} /* Rdpat_Store_Open() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Needed()
+ *
+ * Returns TRUE if the patterns of nfrq frequency steps of nth by
+ * nph directions are to be kept in the store file. The layout of
+ * the data slots shared with the children depends on it, so it
+ * depends only on the input file and the options
+ */
+  gboolean
+Rdpat_Store_Needed( int nfrq, int nth, int nph )
+{
+  size_t size = (size_t)nfrq * (size_t)(nth * nph) *
+    (3 * sizeof(double) + sizeof(int));
+
+  return( (rc_config.rdpat_mb > 0) && (store_fd >= 0) &&
+      (size > ((size_t)rc_config.rdpat_mb << 20)) );
+} /* Rdpat_Store_Needed() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Slot_Detach()
+ *
+ * Takes the buffers of slot out of the pattern of its step
+ */
+  static void
+Slot_Detach( rdpat_slot_t *slot )
+{
+  if( slot->fstep >= 0 )
+  {
+    rad_pattern[slot->fstep].gtot = NULL;
+    rad_pattern[slot->fstep].axrt = NULL;
+    rad_pattern[slot->fstep].tilt = NULL;
+    rad_pattern[slot->fstep].sens = NULL;
+    step_slot[slot->fstep] = -1;
+  }
+  slot->fstep = -1;
+  slot->dirty = FALSE;
+  slot->used  = 0;
+
+} /* Slot_Detach() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Unmap()
+ *
+ * Frees the patterns kept in memory, taking their buffers out of
+ * rad_pattern[], and unmaps the store file. It is called before
+ * the buffers of rad_pattern[] are reallocated
+ */
+  void
+Rdpat_Store_Unmap( void )
+{
+  int idx;
+
+  for( idx = 0; idx < nslots; idx++ )
+  {
+    Slot_Detach( &slots[idx] );
+    free_ptr( (void **)&slots[idx].gtot );
+    free_ptr( (void **)&slots[idx].axrt );
+    free_ptr( (void **)&slots[idx].tilt );
+    free_ptr( (void **)&slots[idx].sens );
+  }
+  free_ptr( (void **)&slots );
+  free_ptr( (void **)&step_slot );
+  free_ptr( (void **)&store_buf );
+  nslots = nsteps = 0;
+
+  if( store_mem != NULL )
+    munmap( store_mem, store_size );
+  store_mem  = NULL;
+  store_size = 0;
+  store_nrp  = 0;
+
+} /* Rdpat_Store_Unmap() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Map()
+ *
+ * Sets up the store for the patterns of nfrq frequency steps of
+ * nth by nph directions. Returns TRUE if the full patterns are
+ * kept in the store, in which case rad_pattern[] needs only the
+ * buffers of the summaries
+ */
+  gboolean
+Rdpat_Store_Map( int nfrq, int nth, int nph )
+{
+  size_t mreq, budget;
+  int idx;
+
+  Rdpat_Store_Unmap();
+  if( !CHILD ) Rdpat_Store_Open();
+  if( !Rdpat_Store_Needed(nfrq, nth, nph) )
+    return( FALSE );
+
+  store_nrp = nth * nph;
+  budget = (size_t)rc_config.rdpat_mb << 20;
+  mreq = (size_t)store_nrp * (3 * sizeof(double) + sizeof(int));
+
+  /* Children make one step at a time, in buffer 0 */
+  nslots = (int)( budget / mreq );
+  if( nslots < RDPAT_STORE_MIN_SLOTS )
+    nslots = RDPAT_STORE_MIN_SLOTS;
+  if( nslots > nfrq )
+    nslots = nfrq;
+  if( CHILD )
+    nslots = 1;
+  nsteps = nfrq;
+
+  /* Gain, axial ratio and tilt as float, sense as a byte */
+  store_stride = (size_t)store_nrp * (3 * sizeof(float) + sizeof(signed char));
+  store_stride = (store_stride + RDPAT_STORE_ALIGN - 1) &
+    ~(size_t)(RDPAT_STORE_ALIGN - 1);
+  store_buf = NULL;
+  mem_alloc( (void **)&store_buf, store_stride, "in rdpat_store.c" );
+
+  slots = NULL;
+  mem_alloc( (void **)&slots, (size_t)nslots * sizeof(rdpat_slot_t), "in rdpat_store.c" );
+  for( idx = 0; idx < nslots; idx++ )
+  {
+    slots[idx].fstep = -1;
+    slots[idx].dirty = FALSE;
+    slots[idx].used  = 0;
+
+    mreq = (size_t)store_nrp * sizeof(double);
+    slots[idx].gtot = NULL;
+    mem_alloc( (void **)&slots[idx].gtot, mreq, "in rdpat_store.c" );
+    slots[idx].axrt = NULL;
+    mem_alloc( (void **)&slots[idx].axrt, mreq, "in rdpat_store.c" );
+    slots[idx].tilt = NULL;
+    mem_alloc( (void **)&slots[idx].tilt, mreq, "in rdpat_store.c" );
+
+    mreq = (size_t)store_nrp * sizeof(int);
+    slots[idx].sens = NULL;
+    mem_alloc( (void **)&slots[idx].sens, mreq, "in rdpat_store.c" );
+  }
+
+  step_slot = NULL;
+  mem_alloc( (void **)&step_slot, (size_t)nfrq * sizeof(int), "in rdpat_store.c" );
+  for( idx = 0; idx < nfrq; idx++ )
+    step_slot[idx] = -1;
+
+  /* Children only write their steps to the file */
+  if( CHILD ) return( TRUE );
+
+  /* Start from an empty file, steps not made read as 0 */
+  store_size = store_stride * (size_t)nfrq;
+  if( (ftruncate(store_fd, 0) < 0) ||
+      (ftruncate(store_fd, (off_t)store_size) < 0) )
+  {
+    perror( "xnec2c: ftruncate()" );
+    store_size = 0;
+    return( TRUE );
+  }
+
+  store_mem = mmap( NULL, store_size, PROT_READ, MAP_SHARED, store_fd, 0 );
+  if( store_mem == MAP_FAILED )
+  {
+    perror( "xnec2c: mmap()" );
+    store_mem  = NULL;
+    store_size = 0;
+    return( TRUE );
+  }
+
+  pr_info( "radiation patterns kept in a %.1f MB file, %d of %d steps in memory\n",
+      (double)store_size / 1048576.0, nslots, nfrq );
+
+  return( TRUE );
+} /* Rdpat_Store_Map() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Write()
+ *
+ * Writes the pattern in memory of frequency step fstep to the
+ * file as that of step dst. Returns the number of bytes written
+ */
+  size_t
+Rdpat_Store_Write( int fstep, int dst )
+{
+  rad_pattern_t *rp = &rad_pattern[fstep];
+  float *gtot, *axrt, *tilt;
+  signed char *sens;
+  char *ptr = store_buf;
+  size_t len = store_stride;
+  off_t off;
+  ssize_t ret;
+  int idx;
+
+  if( (nslots == 0) || (rp->gtot == NULL) || (dst < 0) || (dst >= nsteps) )
+    return( 0 );
+
+  gtot = (float *)store_buf;
+  axrt = gtot + store_nrp;
+  tilt = axrt + store_nrp;
+  sens = (signed char *)( tilt + store_nrp );
+  for( idx = 0; idx < store_nrp; idx++ )
+  {
+    gtot[idx] = (float)rp->gtot[idx];
+    axrt[idx] = (float)rp->axrt[idx];
+    tilt[idx] = (float)rp->tilt[idx];
+    sens[idx] = (signed char)rp->sens[idx];
+  }
+
+  off = (off_t)( (size_t)dst * store_stride );
+  while( len > 0 )
+  {
+    ret = pwrite( store_fd, ptr, len, off );
+    if( (ret < 0) && (errno == EINTR) )
+      continue;
+    if( ret < 0 )
+    {
+      pr_err( "radiation pattern file write failed: %s\n", strerror(errno) );
+      return( 0 );
+    }
+
+    ptr += ret;
+    off += ret;
+    len -= (size_t)ret;
+  }
+
+  return( store_stride );
+} /* Rdpat_Store_Write() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Slot_Take()
+ *
+ * Returns the slot of frequency step fstep, taking a free one or
+ * the one used least recently if it is not in memory. Sets *got
+ * to TRUE if the step was in memory already
+ */
+  static rdpat_slot_t *
+Slot_Take( int fstep, gboolean *got )
+{
+  rdpat_slot_t *slot;
+  int idx, old;
+
+  *got = (step_slot[fstep] >= 0);
+  if( *got )
+  {
+    slot = &slots[ step_slot[fstep] ];
+    slot->used = ++slots_used;
+    return( slot );
+  }
+
+  old = 0;
+  for( idx = 1; idx < nslots; idx++ )
+    if( slots[idx].used < slots[old].used )
+      old = idx;
+  slot = &slots[old];
+
+  /* Children make their steps in buffer 0 and write them
+   * with Rdpat_Store_Write() at the offset of the step */
+  if( slot->dirty && !CHILD )
+    Rdpat_Store_Write( slot->fstep, slot->fstep );
+  Slot_Detach( slot );
+
+  slot->fstep = fstep;
+  slot->used  = ++slots_used;
+  step_slot[fstep] = old;
+  rad_pattern[fstep].gtot = slot->gtot;
+  rad_pattern[fstep].axrt = slot->axrt;
+  rad_pattern[fstep].tilt = slot->tilt;
+  rad_pattern[fstep].sens = slot->sens;
+
+  return( slot );
+} /* Slot_Take() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Load()
+ *
+ * Reads the pattern of frequency step fstep from the file into
+ * memory unless it is there. Returns TRUE if the full pattern is
+ * in rad_pattern[fstep], where it stays until the patterns of
+ * RDPAT_STORE_MIN_SLOTS - 1 other steps are loaded
+ */
+  gboolean
+Rdpat_Store_Load( int fstep )
+{
+  rdpat_slot_t *slot;
+  const float *gtot, *axrt, *tilt;
+  const signed char *sens;
+  gboolean got;
+  int idx;
+
+  if( (rad_pattern == NULL) || (fstep < 0) )
+    return( FALSE );
+  if( (nslots == 0) || (fstep >= nsteps) )
+    return( rad_pattern[fstep].gtot != NULL );
+
+  g_mutex_lock( &store_lock );
+  slot = Slot_Take( fstep, &got );
+  if( !got )
+  {
+    if( store_mem == NULL )
+    {
+      memset( slot->gtot, 0, (size_t)store_nrp * sizeof(double) );
+      memset( slot->axrt, 0, (size_t)store_nrp * sizeof(double) );
+      memset( slot->tilt, 0, (size_t)store_nrp * sizeof(double) );
+      memset( slot->sens, 0, (size_t)store_nrp * sizeof(int) );
+    }
+    else
+    {
+      gtot = (const float *)&store_mem[ (size_t)fstep * store_stride ];
+      axrt = gtot + store_nrp;
+      tilt = axrt + store_nrp;
+      sens = (const signed char *)( tilt + store_nrp );
+      for( idx = 0; idx < store_nrp; idx++ )
+      {
+        slot->gtot[idx] = (double)gtot[idx];
+        slot->axrt[idx] = (double)axrt[idx];
+        slot->tilt[idx] = (double)tilt[idx];
+        slot->sens[idx] = (int)sens[idx];
+      }
+    }
+  }
+  g_mutex_unlock( &store_lock );
+
+  return( TRUE );
+} /* Rdpat_Store_Load() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_New()
+ *
+ * Brings the pattern of frequency step fstep into memory to be
+ * made anew, without reading it from the file. It is written
+ * there when its slot is taken by another step
+ */
+  void
+Rdpat_Store_New( int fstep )
+{
+  rdpat_slot_t *slot;
+  gboolean got;
+
+  if( (nslots == 0) || (fstep < 0) || (fstep >= nsteps) )
+    return;
+
+  g_mutex_lock( &store_lock );
+  slot = Slot_Take( fstep, &got );
+  slot->dirty = TRUE;
+  g_mutex_unlock( &store_lock );
+
+} /* Rdpat_Store_New() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Drop()
+ *
+ * Frees the slot of frequency step fstep without writing it,
+ * when a child process has written a newer pattern to the file
+ */
+  void
+Rdpat_Store_Drop( int fstep )
+{
+  if( (nslots == 0) || (fstep < 0) || (fstep >= nsteps) )
+    return;
+
+  g_mutex_lock( &store_lock );
+  if( step_slot[fstep] >= 0 )
+    Slot_Detach( &slots[ step_slot[fstep] ] );
+  g_mutex_unlock( &store_lock );
+
+} /* Rdpat_Store_Drop() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Rdpat_Store_Point()
+ *
+ * Reads the gain, axial ratio and tilt of direction idx of the
+ * pattern of frequency step fstep, from memory if it is there or
+ * else from the file. Any of the pointers may be NULL
+ */
+  void
+Rdpat_Store_Point( int fstep, int idx, double *gtot, double *axrt, double *tilt )
+{
+  rad_pattern_t *rp = &rad_pattern[fstep];
+  const float *ptr;
+
+  if( rp->gtot != NULL )
+  {
+    if( gtot != NULL ) *gtot = rp->gtot[idx];
+    if( axrt != NULL ) *axrt = rp->axrt[idx];
+    if( tilt != NULL ) *tilt = rp->tilt[idx];
+    return;
+  }
+
+  if( (store_mem == NULL) || (fstep >= nsteps) )
+  {
+    if( gtot != NULL ) *gtot = 0.0;
+    if( axrt != NULL ) *axrt = 0.0;
+    if( tilt != NULL ) *tilt = 0.0;
+    return;
+  }
+
+  ptr = (const float *)&store_mem[ (size_t)fstep * store_stride ];
+  if( gtot != NULL ) *gtot = (double)ptr[idx];
+  if( axrt != NULL ) *axrt = (double)ptr[store_nrp + idx];
+  if( tilt != NULL ) *tilt = (double)ptr[2 * store_nrp + idx];
+
+} /* Rdpat_Store_Point() */
+
+/*-----------------------------------------------------------------------*/
+
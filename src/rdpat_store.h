@@ -0,0 +1,48 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef RDPAT_STORE_H
+#define RDPAT_STORE_H    1
+
+#include "common.h"
+#include "adaptive.h"
+
+/* Fewest patterns kept in memory: the window of steps the
+ * adaptive sweep interpolates from, the step interpolated
+ * and the one on display */
+#define RDPAT_STORE_MIN_SLOTS   (ADAPTIVE_ORDER + 2)
+
+/* Alignment of the patterns in the store file */
+#define RDPAT_STORE_ALIGN       64
+
+/* A full resolution pattern kept in memory. Its buffers
+ * are those of rad_pattern[fstep] while it is there */
+typedef struct
+{
+  int fstep;        /* Frequency step, -1 if the slot is free */
+  gboolean dirty;   /* Newer than its copy in the store file */
+  guint64 used;     /* Last use, the oldest slot is reused first */
+
+  double *gtot, *axrt, *tilt;
+  int *sens;
+
+} rdpat_slot_t;
+
+#endif
+
@@ -174,6 +174,10 @@ GMutex global_lock;
    before it is done filling the data buffers.  */
 GMutex freq_data_lock;
 
+/* Lock held by Draw_Radiation() while it draws the part of a near
+ * field published so far, and by Near_Field_Pattern() to end that */
+GMutex near_field_lock;
+
 /* Program forked flag */
 gboolean FORKED = FALSE;
 
@@ -225,7 +229,8 @@ double
 crnt_t crnt;
 
 /* common  /dataj/ */
-dataj_t dataj;
+static dataj_t dataj_common;
+__thread dataj_t *dataj_p = &dataj_common;
 
 /* pointers to input/output files */
 FILE *input_fp = NULL;
@@ -240,10 +245,12 @@ ggrid_t ggrid;
 gnd_t gnd;
 
 /* common  /gwav/ */
-gwav_t gwav;
+static gwav_t gwav_common;
+__thread gwav_t *gwav_p = &gwav_common;
 
 /* common  /incom/ */
-incom_t incom;
+static incom_t incom_common;
+__thread incom_t *incom_p = &incom_common;
 
 /* common  /matpar/ */
 matpar_t matpar;
@@ -255,7 +262,8 @@ netcx_t netcx;
 save_t save;
 
 /* common  /segj/ */
-segj_t segj;
+static segj_t segj_common;
+__thread segj_t *segj_p = &segj_common;
 
 /* common  /smat/ */
 smat_t smat;
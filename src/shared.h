@@ -97,6 +97,9 @@ extern GMutex global_lock;
    before it is done filling the data buffers.  */
 extern GMutex freq_data_lock;
 
+/* Lock held while drawing a near field that is still being computed */
+extern GMutex near_field_lock;
+
 /* Program forked flag */
 extern gboolean FORKED;
 
@@ -236,8 +239,14 @@ extern double *cmag, *ct1m, *ct2m;
 /* common  /crnt/ */
 extern crnt_t crnt;
 
+/* The /dataj/, /gwav/, /incom/ and /segj/ commons hold the source
+ * segment state of the field routines. They are reached through
+ * thread-local pointers so that the cmset() fill threads can each
+ * work on a private copy, all other threads share one instance */
+
 /* common  /dataj/ */
-extern dataj_t dataj;
+extern __thread dataj_t *dataj_p;
+#define dataj (*dataj_p)
 
 /* common  /data/ */
 extern data_t data;
@@ -255,10 +264,12 @@ extern ggrid_t ggrid;
 extern gnd_t gnd;
 
 /* common  /gwav/ */
-extern gwav_t gwav;
+extern __thread gwav_t *gwav_p;
+#define gwav (*gwav_p)
 
 /* common  /incom/ */
-extern incom_t incom;
+extern __thread incom_t *incom_p;
+#define incom (*incom_p)
 
 /* common  /matpar/ */
 extern matpar_t matpar;
@@ -270,7 +281,8 @@ extern netcx_t netcx;
 extern save_t save;
 
 /* common  /segj/ */
-extern segj_t segj;
+extern __thread segj_t *segj_p;
+#define segj (*segj_p)
 
 /* common  /smat/ */
 extern smat_t smat;
@@ -39,6 +39,8 @@
 #include "somnec.h"
 #include "shared.h"
 
+#include <sys/stat.h>
+
 /* common /evlcom/ */
 static int jh;
 static double ck2, ck2sq, tkmag, tsmag, ck1r, zph, rho;
@@ -904,6 +906,230 @@ evlua( complex double *erv, complex double *ezv,
 
 /*-----------------------------------------------------------------------*/
 
+/* The grids only depend on the complex dielectric constant
+ * epscf, since distances are in wavelengths. They are cached by
+ * epscf in memory, least recently used grids are dropped, and
+ * in one file per epscf that survives restarts. Files are written
+ * under a temporary name and renamed, so that forked children and
+ * other xnec2c processes sharing the directory never read a
+ * partly written file. With a fixed epscf (sig <= 0 in the GN
+ * card) the grids are computed only once for all frequencies */
+static somnec_cache_t *scache = NULL;
+static int scache_num = 0;
+static guint64 scache_stamp = 0;
+
+/*-----------------------------------------------------------------------*/
+
+/* Grid_Get()
+ *
+ * Copies the ggrid interpolation grids to grid
+ */
+  static void
+Grid_Get( complex double *grid )
+{
+  memcpy( grid, ggrid.ar1, 11 * 10 * 4 * sizeof(complex double) );
+  grid += 11 * 10 * 4;
+  memcpy( grid, ggrid.ar2, 17 * 5 * 4 * sizeof(complex double) );
+  grid += 17 * 5 * 4;
+  memcpy( grid, ggrid.ar3, 9 * 8 * 4 * sizeof(complex double) );
+}
+
+/*-----------------------------------------------------------------------*/
+
+/* Grid_Put()
+ *
+ * Copies grid to the ggrid interpolation grids
+ */
+  static void
+Grid_Put( const complex double *grid )
+{
+  memcpy( ggrid.ar1, grid, 11 * 10 * 4 * sizeof(complex double) );
+  grid += 11 * 10 * 4;
+  memcpy( ggrid.ar2, grid, 17 * 5 * 4 * sizeof(complex double) );
+  grid += 17 * 5 * 4;
+  memcpy( ggrid.ar3, grid, 9 * 8 * 4 * sizeof(complex double) );
+}
+
+/*-----------------------------------------------------------------------*/
+
+/* Somnec_Cache_File()
+ *
+ * Makes the path name of the grid file of epscf in fpath,
+ * creating the cache directory if needed. Returns FALSE
+ * if grids are not to be kept on disk
+ */
+  static gboolean
+Somnec_Cache_File( complex double epscf, char *fpath, size_t len )
+{
+  static char dir[FILENAME_LEN] = "";
+  static gboolean disabled = FALSE;
+  double re = creal( epscf ), im = cimag( epscf );
+  guint64 bre, bim;
+
+  if( disabled ) return( FALSE );
+
+  if( dir[0] == '\0' )
+  {
+    if( rc_config.somnec_cache_dir != NULL )
+      Strlcpy( dir, rc_config.somnec_cache_dir, sizeof(dir) );
+    else
+    {
+      char *home = getenv( "HOME" );
+      if( (home != NULL) && (strlen(home) > 0) )
+      {
+        snprintf( dir, sizeof(dir), "%s/.xnec2c", home );
+        mkdir( dir, 0755 );
+        Strlcat( dir, "/somnec", sizeof(dir) );
+      }
+    }
+
+    if( (dir[0] == '\0') ||
+        ((mkdir(dir, 0755) < 0) && (errno != EEXIST)) )
+    {
+      if( dir[0] != '\0' )
+        pr_warn("cannot create %s: %s\n", dir, strerror(errno));
+      disabled = TRUE;
+      return( FALSE );
+    }
+  }
+
+  /* Name the file by the exact bits of epscf */
+  memcpy( &bre, &re, sizeof(bre) );
+  memcpy( &bim, &im, sizeof(bim) );
+  snprintf( fpath, len, "%s/%016llx%016llx.grid", dir,
+      (unsigned long long)bre, (unsigned long long)bim );
+
+  return( TRUE );
+} /* Somnec_Cache_File() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Somnec_Cache_Keep()
+ *
+ * Keeps the current ggrid grids of epscf in memory, replacing
+ * the least recently used grids if full. Returns the entry
+ */
+  static somnec_cache_t *
+Somnec_Cache_Keep( complex double epscf )
+{
+  somnec_cache_t *ent;
+  int idx, lru = 0;
+
+  if( scache == NULL )
+  {
+    size_t mreq = SOMNEC_CACHE_SIZE * sizeof(somnec_cache_t);
+    mem_alloc( (void **)&scache, mreq, "in somnec.c" );
+  }
+
+  if( scache_num < SOMNEC_CACHE_SIZE )
+  {
+    ent = &scache[scache_num++];
+    ent->grid = NULL;
+    mem_alloc( (void **)&ent->grid,
+        SOMNEC_GRID_SIZE * sizeof(complex double), "in somnec.c" );
+  }
+  else
+  {
+    for( idx = 1; idx < scache_num; idx++ )
+      if( scache[idx].used < scache[lru].used )
+        lru = idx;
+    ent = &scache[lru];
+  }
+
+  ent->epscf = epscf;
+  ent->used  = ++scache_stamp;
+  Grid_Get( ent->grid );
+
+  return( ent );
+} /* Somnec_Cache_Keep() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Somnec_Cache_Load()
+ *
+ * Sets the ggrid grids of epscf from memory or from
+ * its grid file. Returns FALSE if they are not cached
+ */
+  static gboolean
+Somnec_Cache_Load( complex double epscf )
+{
+  char fpath[FILENAME_LEN + 64];
+  char magic[sizeof(SOMNEC_FILE_MAGIC)];
+  complex double fepscf, *grid = NULL;
+  gboolean ok;
+  FILE *fp;
+  int idx;
+
+  for( idx = 0; idx < scache_num; idx++ )
+    if( scache[idx].epscf == epscf )
+    {
+      Grid_Put( scache[idx].grid );
+      scache[idx].used = ++scache_stamp;
+      return( TRUE );
+    }
+
+  if( !Somnec_Cache_File(epscf, fpath, sizeof(fpath)) )
+    return( FALSE );
+  fp = fopen( fpath, "r" );
+  if( fp == NULL ) return( FALSE );
+
+  mem_alloc( (void **)&grid,
+      SOMNEC_GRID_SIZE * sizeof(complex double), "in somnec.c" );
+  ok = (fread(magic, sizeof(magic), 1, fp) == 1) &&
+    (memcmp(magic, SOMNEC_FILE_MAGIC, sizeof(magic)) == 0) &&
+    (fread(&fepscf, sizeof(fepscf), 1, fp) == 1) &&
+    (fepscf == epscf) &&
+    (fread(grid, sizeof(complex double), SOMNEC_GRID_SIZE, fp) == SOMNEC_GRID_SIZE);
+  fclose( fp );
+
+  if( ok )
+  {
+    pr_debug("somnec: read grids from %s\n", fpath);
+    Grid_Put( grid );
+    Somnec_Cache_Keep( epscf );
+  }
+  else pr_warn("ignoring bad somnec grid file %s\n", fpath);
+  free_ptr( (void **)&grid );
+
+  return( ok );
+} /* Somnec_Cache_Load() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Somnec_Cache_Store()
+ *
+ * Keeps the ggrid grids just computed for epscf
+ * in memory and writes them to their grid file
+ */
+  static void
+Somnec_Cache_Store( complex double epscf )
+{
+  char fpath[FILENAME_LEN + 64], ftemp[FILENAME_LEN + 96];
+  complex double *grid = Somnec_Cache_Keep( epscf )->grid;
+  gboolean ok;
+  FILE *fp;
+
+  if( !Somnec_Cache_File(epscf, fpath, sizeof(fpath)) )
+    return;
+  snprintf( ftemp, sizeof(ftemp), "%s.%d", fpath, (int)getpid() );
+  fp = fopen( ftemp, "w" );
+  if( fp == NULL ) return;
+
+  ok = (fwrite(SOMNEC_FILE_MAGIC, sizeof(SOMNEC_FILE_MAGIC), 1, fp) == 1) &&
+    (fwrite(&epscf, sizeof(epscf), 1, fp) == 1) &&
+    (fwrite(grid, sizeof(complex double), SOMNEC_GRID_SIZE, fp) == SOMNEC_GRID_SIZE);
+  ok = (fclose(fp) == 0) && ok;
+
+  if( !ok || (rename(ftemp, fpath) < 0) )
+  {
+    pr_warn("cannot write somnec grid file %s\n", fpath);
+    unlink( ftemp );
+  }
+
+} /* Somnec_Cache_Store() */
+
+/*-----------------------------------------------------------------------*/
+
 /* This is the "main" of somnec */
   void
 somnec( double epr, double sig, double fmhz )
@@ -970,6 +1196,10 @@ somnec( double epr, double sig, double fmhz )
   }
   else ggrid.epscf=cmplx(epr,sig);
 
+  /* Grids of this epscf already computed */
+  if( Somnec_Cache_Load(ggrid.epscf) )
+    return;
+
   ck2=M_2PI;
   ck2sq=ck2*ck2;
 
@@ -1090,6 +1320,8 @@ somnec( double epr, double sig, double fmhz )
     ggrid.ar1[0+ith*11+330]=eph;
   }
 
+  Somnec_Cache_Store( ggrid.epscf );
+
   return;
 }
 
@@ -45,5 +45,23 @@
 #define NM      131072
 #define NTS     4
 
+/* Complex values in the three interpolation grids ar1, ar2 and ar3 */
+#define SOMNEC_GRID_SIZE    ((11 * 10 + 17 * 5 + 9 * 8) * 4)
+
+/* Grids kept in memory, about 17 kB each */
+#define SOMNEC_CACHE_SIZE   64
+
+/* Header of grid files, changes if the grid layout changes */
+#define SOMNEC_FILE_MAGIC   "xnec2c-somnec-1"
+
+/* Interpolation grids computed for a complex dielectric constant */
+typedef struct
+{
+  complex double epscf;   /* Complex dielectric constant of the grids */
+  guint64 used;           /* Stamp of last use, for LRU eviction */
+  complex double *grid;   /* ar1, ar2 and ar3 one after the other */
+
+} somnec_cache_t;
+
 #endif
 
@@ -0,0 +1,504 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* Parameter sweep. With --sweep name=start:stop:count, given once for
+ * each variable, xnec2c-batch runs the input file for every combination
+ * of the values of the variables, which take the place of those of its
+ * SY cards. The input file is read into memory once and the variants
+ * are shared out between --sweep-jobs forked processes. Each process
+ * reads a variant from memory, so that datagn() and conect() run with
+ * its variables, runs its frequency loop and passes the meas_calc()
+ * measurements of the steps to the parent through a pipe. The parent
+ * writes them all to the --write-csv file, a row for each variant and
+ * frequency step, with the values of the variables in the first columns.
+ */
+
+#include "sweep.h"
+#include "shared.h"
+#include <limits.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+/* The variables of the --sweep options */
+static sweep_var_t sweep_vars[SWEEP_MAX_VARS];
+static int sweep_nvars = 0;
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Add_Var()
+ *
+ * Adds the variable of a --sweep option, name=start:stop:count,
+ * or name=value for a fixed value. Returns FALSE if not valid
+ */
+  gboolean
+Sweep_Add_Var( char *spec )
+{
+  sweep_var_t *var;
+  char *val, *end;
+  size_t len;
+
+  if( sweep_nvars >= SWEEP_MAX_VARS )
+  {
+    pr_crit( "at most %d variables can be swept\n", SWEEP_MAX_VARS );
+    return( FALSE );
+  }
+  var = &sweep_vars[sweep_nvars];
+
+  val = strchr( spec, '=' );
+  len = (val != NULL) ? (size_t)(val - spec) : 0;
+  if( (len == 0) || (len >= sizeof(var->name)) )
+  {
+    pr_crit( "--sweep %s: expected name=start:stop:count\n", spec );
+    return( FALSE );
+  }
+  memcpy( var->name, spec, len );
+  var->name[len] = '\0';
+
+  var->start = Strtod( val + 1, &end );
+  var->stop  = var->start;
+  var->count = 1;
+  if( *end == ':' )
+  {
+    var->stop = Strtod( end + 1, &end );
+    if( *end == ':' )
+      var->count = (int)strtol( end + 1, &end, 10 );
+    else
+      var->count = 0;
+  }
+
+  if( (end == val + 1) || (*end != '\0') || (var->count < 1) )
+  {
+    pr_crit( "--sweep %s: expected name=start:stop:count\n", spec );
+    return( FALSE );
+  }
+  sweep_nvars++;
+
+  return( TRUE );
+} /* Sweep_Add_Var() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Values()
+ *
+ * Sets vals to the values of the variables in variant,
+ * the last variable changing from one variant to the next
+ */
+  static void
+Sweep_Values( int variant, double *vals )
+{
+  sweep_var_t *var;
+  int idx, step;
+
+  for( idx = sweep_nvars - 1; idx >= 0; idx-- )
+  {
+    var  = &sweep_vars[idx];
+    step = variant % var->count;
+    variant /= var->count;
+
+    if( var->count > 1 )
+      vals[idx] = var->start + (var->stop - var->start) *
+        (double)step / (double)(var->count - 1);
+    else
+      vals[idx] = var->start;
+  }
+
+} /* Sweep_Values() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Write_Full()
+ *
+ * Writes len bytes of buf to the pipe fd
+ */
+  static gboolean
+Write_Full( int fd, const void *buf, size_t len )
+{
+  const char *ptr = buf;
+  ssize_t ret;
+
+  while( len > 0 )
+  {
+    ret = write( fd, ptr, len );
+    if( (ret < 0) && (errno == EINTR) )
+      continue;
+    if( ret <= 0 )
+      return( FALSE );
+    ptr += ret;
+    len -= (size_t)ret;
+  }
+
+  return( TRUE );
+} /* Write_Full() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Read_Full()
+ *
+ * Reads len bytes from the pipe fd into buf,
+ * returns FALSE at the end of file or on error
+ */
+  static gboolean
+Read_Full( int fd, void *buf, size_t len )
+{
+  char *ptr = buf;
+  ssize_t ret;
+
+  while( len > 0 )
+  {
+    ret = read( fd, ptr, len );
+    if( (ret < 0) && (errno == EINTR) )
+      continue;
+    if( ret <= 0 )
+      return( FALSE );
+    ptr += ret;
+    len -= (size_t)ret;
+  }
+
+  return( TRUE );
+} /* Read_Full() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Job()
+ *
+ * Runs variants job, job + jobs... of the input file of len
+ * bytes at text, in a forked process, and writes their
+ * measurements to the pipe fd
+ */
+  static void
+Sweep_Job( char *text, size_t len, int job, int jobs, int nvariants, int fd )
+{
+  double vals[SWEEP_MAX_VARS], *meas = NULL;
+  sweep_record_t rec;
+  measurement_t m;
+  size_t mreq;
+  int variant, idx, fstep;
+
+  for( variant = job; variant < nvariants; variant += jobs )
+  {
+    Sweep_Values( variant, vals );
+    Sym_Clear( TRUE );
+    for( idx = 0; idx < sweep_nvars; idx++ )
+      Sym_Override( sweep_vars[idx].name, vals[idx] );
+
+    rec.variant = variant;
+    rec.rows    = -1;
+
+    /* With STOP_RETURNS a failed variant
+     * does not end the other variants */
+    if( Read_Input_Text(text, len) && Run_Frequency_Loop() )
+    {
+      mreq = (size_t)calc_data.steps_total * MEAS_COUNT * sizeof(double);
+      mem_realloc( (void **)&meas, mreq, "in sweep.c" );
+
+      rec.rows = 0;
+      for( fstep = 0; fstep < calc_data.steps_total; fstep++ )
+      {
+        if( !save.fstep[fstep] ) continue;
+        meas_calc( &m, fstep );
+        memcpy( meas + (size_t)rec.rows * MEAS_COUNT,
+            m.a, MEAS_COUNT * sizeof(double) );
+        rec.rows++;
+      }
+    }
+    else
+      pr_err( "sweep variant %d failed: %s\n",
+          variant + 1, Stop_Message() );
+
+    mreq = (rec.rows > 0) ?
+      (size_t)rec.rows * MEAS_COUNT * sizeof(double) : 0;
+    if( !Write_Full(fd, &rec, sizeof(rec)) ||
+        !Write_Full(fd, meas, mreq) )
+      break;
+  }
+
+  free_ptr( (void **)&meas );
+
+} /* Sweep_Job() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Read_Variant()
+ *
+ * Reads the measurements of a variant from the pipe fd into
+ * results, returns FALSE when the process has no more of them
+ */
+  static gboolean
+Read_Variant( int fd, sweep_result_t *results, int nvariants )
+{
+  sweep_record_t rec;
+  sweep_result_t *res;
+  size_t mreq;
+
+  if( !Read_Full(fd, &rec, sizeof(rec)) )
+    return( FALSE );
+  if( (rec.variant < 0) || (rec.variant >= nvariants) || (rec.rows < -1) )
+  {
+    pr_err( "sweep: invalid data from a sweep process\n" );
+    return( FALSE );
+  }
+
+  res = &results[rec.variant];
+  res->rows = rec.rows;
+  if( rec.rows <= 0 )
+    return( TRUE );
+
+  mreq = (size_t)rec.rows * MEAS_COUNT * sizeof(double);
+  mem_realloc( (void **)&res->meas, mreq, "in sweep.c" );
+  if( !Read_Full(fd, res->meas, mreq) )
+  {
+    res->rows = -1;
+    return( FALSE );
+  }
+
+  return( TRUE );
+} /* Read_Variant() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Write_Table()
+ *
+ * Writes the measurements of the variants in results to the CSV
+ * file fname, after the values of the variables. Returns the
+ * number of variants that failed, or -1 if fname is not written
+ */
+  static int
+Write_Table( char *fname, sweep_result_t *results, int nvariants )
+{
+  double vals[SWEEP_MAX_VARS];
+  FILE *fp = NULL;
+  int variant, row, idx, failed = 0;
+
+  if( !Open_File(&fp, fname, "w") )
+    return( -1 );
+  setlocale( LC_NUMERIC, "C" );
+
+  for( idx = 0; idx < sweep_nvars; idx++ )
+    fprintf( fp, "%s,", sweep_vars[idx].name );
+  meas_write_header( fp, "," );
+
+  for( variant = 0; variant < nvariants; variant++ )
+  {
+    sweep_result_t *res = &results[variant];
+
+    if( res->rows < 0 )
+    {
+      failed++;
+      continue;
+    }
+
+    Sweep_Values( variant, vals );
+    for( row = 0; row < res->rows; row++ )
+    {
+      for( idx = 0; idx < sweep_nvars; idx++ )
+        fprintf( fp, "%.17g,", vals[idx] );
+      for( idx = 0; idx < MEAS_COUNT; idx++ )
+        fprintf( fp, "%.17g%s", res->meas[(size_t)row * MEAS_COUNT + (size_t)idx],
+            (idx < MEAS_COUNT - 1) ? "," : "\n" );
+    }
+  }
+
+  setlocale( LC_NUMERIC, orig_numeric_locale );
+  if( ferror(fp) )
+  {
+    pr_err( "%s: error writing the sweep table\n", fname );
+    Close_File( &fp );
+    return( -1 );
+  }
+  Close_File( &fp );
+
+  return( failed );
+} /* Write_Table() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sweep_Run()
+ *
+ * Runs the variants of input file fname in jobs processes, all
+ * the processors if jobs is 0, and writes their measurements to
+ * the --write-csv file. Returns the exit status: 1 on errors,
+ * 0 if all the variants ran
+ */
+  int
+Sweep_Run( char *fname, int jobs )
+{
+  sweep_result_t *results = NULL;
+  struct pollfd *pfds = NULL;
+  pid_t *pids = NULL;
+  char *text = NULL;
+  size_t len, mreq;
+  int nvariants = 1, job, idx, open, failed = 0, status;
+
+  if( rc_config.filename_csv == NULL )
+  {
+    pr_crit( "--sweep writes its table to the --write-csv file\n" );
+    return( 1 );
+  }
+
+  for( idx = 0; idx < sweep_nvars; idx++ )
+  {
+    if( nvariants > INT_MAX / sweep_vars[idx].count )
+    {
+      pr_crit( "too many sweep variants\n" );
+      return( 1 );
+    }
+    nvariants *= sweep_vars[idx].count;
+  }
+
+  /* The processes would all write the same files */
+  if( (rc_config.filename_rdpat_bin != NULL) ||
+      (rc_config.filename_currents_bin != NULL) ||
+      (rc_config.filename_stats != NULL) )
+    pr_warn( "--write-*-bin and --stats are not written with --sweep\n" );
+  rc_config.filename_rdpat_bin    = NULL;
+  rc_config.filename_currents_bin = NULL;
+  rc_config.filename_stats        = NULL;
+
+  Get_Dirname( fname, rc_config.working_dir, NULL );
+  if( !Load_File(fname, SWEEP_MAX_INPUT, &text, &len) )
+    return( 1 );
+
+  if( jobs < 1 )
+    jobs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+  if( jobs < 1 )
+    jobs = 1;
+  if( jobs > nvariants )
+    jobs = nvariants;
+  pr_notice( "sweep: %d variants in %d processes\n", nvariants, jobs );
+
+  mreq = (size_t)nvariants * sizeof(sweep_result_t);
+  mem_alloc( (void **)&results, mreq, "in sweep.c" );
+  for( idx = 0; idx < nvariants; idx++ )
+    results[idx].rows = -1;
+  mreq = (size_t)jobs * sizeof(struct pollfd);
+  mem_alloc( (void **)&pfds, mreq, "in sweep.c" );
+  mreq = (size_t)jobs * sizeof(pid_t);
+  mem_alloc( (void **)&pids, mreq, "in sweep.c" );
+
+  /* Errors in a variant only fail that variant */
+  SetFlag( STOP_RETURNS );
+
+  fflush( stdout );
+  fflush( stderr );
+
+  /* Fork the processes, each with a pipe to pass back the data */
+  for( job = 0; job < jobs; job++ )
+  {
+    int pfd[2];
+
+    pids[job] = -1;
+    pfds[job].fd = -1;
+    pfds[job].events = POLLIN;
+
+    if( pipe(pfd) < 0 )
+    {
+      perror( "xnec2c-batch: pipe()" );
+      break;
+    }
+
+    pids[job] = fork();
+    if( pids[job] < 0 )
+    {
+      perror( "xnec2c-batch: fork()" );
+      close( pfd[0] );
+      close( pfd[1] );
+      break;
+    }
+
+    if( pids[job] == 0 )
+    {
+      for( idx = 0; idx < job; idx++ )
+        close( pfds[idx].fd );
+      close( pfd[0] );
+      Sweep_Job( text, len, job, jobs, nvariants, pfd[1] );
+      close( pfd[1] );
+      _exit( 0 );
+    }
+
+    close( pfd[1] );
+    pfds[job].fd = pfd[0];
+  }
+
+  /* Without all the processes their variants
+   * would be missing, stop the others */
+  if( job < jobs )
+  {
+    for( idx = 0; idx < job; idx++ )
+      kill( pids[idx], SIGTERM );
+    failed = 1;
+  }
+
+  /* Collect the variants as the processes make them */
+  open = job;
+  while( (job == jobs) && (open > 0) )
+  {
+    if( poll(pfds, (nfds_t)jobs, -1) < 0 )
+    {
+      if( errno == EINTR ) continue;
+      perror( "xnec2c-batch: poll()" );
+      failed = 1;
+      break;
+    }
+
+    for( idx = 0; idx < jobs; idx++ )
+    {
+      if( (pfds[idx].fd < 0) || !pfds[idx].revents )
+        continue;
+      if( !Read_Variant(pfds[idx].fd, results, nvariants) )
+      {
+        close( pfds[idx].fd );
+        pfds[idx].fd = -1;
+        open--;
+      }
+    }
+  }
+
+  for( idx = 0; idx < job; idx++ )
+  {
+    if( pfds[idx].fd >= 0 )
+      close( pfds[idx].fd );
+    if( (waitpid(pids[idx], &status, 0) < 0) ||
+        !WIFEXITED(status) || (WEXITSTATUS(status) != 0) )
+      failed = 1;
+  }
+
+  /* The table has the variants that ran, if all were started */
+  if( job == jobs )
+  {
+    idx = Write_Table( rc_config.filename_csv, results, nvariants );
+    if( idx != 0 )
+    {
+      if( idx > 0 )
+        pr_err( "sweep: %d of %d variants failed\n", idx, nvariants );
+      failed = 1;
+    }
+  }
+
+  for( idx = 0; idx < nvariants; idx++ )
+    free_ptr( (void **)&results[idx].meas );
+  free_ptr( (void **)&results );
+  free_ptr( (void **)&pfds );
+  free_ptr( (void **)&pids );
+  free_ptr( (void **)&text );
+
+  return( failed );
+} /* Sweep_Run() */
+
+/*-----------------------------------------------------------------------*/
+
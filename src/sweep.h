@@ -0,0 +1,61 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef SWEEP_H
+#define SWEEP_H    1
+
+#include "common.h"
+#include "symbols.h"
+
+/* Most variables swept at once */
+#define SWEEP_MAX_VARS     8
+
+/* Largest input file swept, in bytes */
+#define SWEEP_MAX_INPUT    (64 * 1024 * 1024)
+
+/* A variable swept over count values from start to stop */
+typedef struct
+{
+  char name[SYM_NAME_LEN];
+  double start, stop;
+  int count;
+
+} sweep_var_t;
+
+/* Header of the rows of a variant that a sweep
+ * process passes to the parent, rows is -1 if
+ * the variant failed */
+typedef struct
+{
+  int variant;
+  int rows;
+
+} sweep_record_t;
+
+/* Measurements of a variant collected by the parent,
+ * rows of MEAS_COUNT values, rows is -1 until they come */
+typedef struct
+{
+  int rows;
+  double *meas;
+
+} sweep_result_t;
+
+#endif
+
@@ -0,0 +1,575 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+/* SY symbolic variables, as in 4nec2. An SY card assigns variables,
+ * "SY name=expression, name=expression...", and the numeric fields of
+ * the geometry and command cards after it may be expressions of them,
+ * as in "GW 1 nseg 0 0 -len/2 0 0 len/2 rad". Expressions have the
+ * operators + - * / ^, parentheses, the constant pi and the functions
+ * below, with angles in radians. Names are not case sensitive.
+ *
+ * Variables set by Sym_Override(), as by the --sweep option of
+ * xnec2c-batch, keep their value over the SY cards that assign them.
+ */
+
+#include "symbols.h"
+#include "shared.h"
+#include <ctype.h>
+
+/* The variables, in the order they were first assigned */
+static sym_var_t *vars = NULL;
+static int nvars = 0;
+
+/* Functions of expressions, with the names used by 4nec2 */
+static const sym_func_t funcs[] =
+{
+  { "sin",   sin   },
+  { "cos",   cos   },
+  { "tan",   tan   },
+  { "atn",   atan  },
+  { "atan",  atan  },
+  { "sqr",   sqrt  },
+  { "sqrt",  sqrt  },
+  { "exp",   exp   },
+  { "log",   log   },
+  { "log10", log10 },
+  { "abs",   fabs  },
+  { "int",   trunc },
+  { NULL,    NULL  }
+};
+
+static double Parse_Expr( sym_parser_t *p );
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Find()
+ *
+ * Returns the index of variable name, -1 if it is not assigned
+ */
+  static int
+Sym_Find( const char *name )
+{
+  int idx;
+
+  for( idx = 0; idx < nvars; idx++ )
+    if( strcasecmp(vars[idx].name, name) == 0 )
+      return( idx );
+
+  return( -1 );
+} /* Sym_Find() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Set()
+ *
+ * Assigns value to variable name, unless it has been fixed
+ * by Sym_Override(). Fixes it if fixed is TRUE
+ */
+  static void
+Sym_Set( const char *name, double value, gboolean fixed )
+{
+  size_t mreq;
+  int idx;
+
+  idx = Sym_Find( name );
+  if( idx < 0 )
+  {
+    idx = nvars++;
+    mreq = (size_t)nvars * sizeof(sym_var_t);
+    mem_realloc( (void **)&vars, mreq, "in symbols.c" );
+    Strlcpy( vars[idx].name, name, sizeof(vars[idx].name) );
+    vars[idx].fixed = FALSE;
+  }
+  else if( vars[idx].fixed && !fixed )
+    return;
+
+  vars[idx].value = value;
+  if( fixed ) vars[idx].fixed = TRUE;
+
+} /* Sym_Set() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Skip_Space()
+ *
+ * Moves the parser past blanks
+ */
+  static void
+Skip_Space( sym_parser_t *p )
+{
+  while( (*p->pos == ' ') || (*p->pos == '\t') )
+    p->pos++;
+} /* Skip_Space() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Number()
+ *
+ * Reads a number, copied for Strtod() which changes
+ * the decimal point of the string to that of the locale
+ */
+  static double
+Parse_Number( sym_parser_t *p )
+{
+  char num[SYM_NUMBER_LEN], *end;
+  size_t len, exp;
+  double val;
+
+  len = strspn( p->pos, "0123456789." );
+  if( (p->pos[len] == 'e') || (p->pos[len] == 'E') )
+  {
+    exp = len + 1;
+    if( (p->pos[exp] == '+') || (p->pos[exp] == '-') )
+      exp++;
+    if( isdigit((unsigned char)p->pos[exp]) )
+      len = exp + strspn( p->pos + exp, "0123456789" );
+  }
+
+  if( len >= sizeof(num) )
+  {
+    p->err = TRUE;
+    return( 0.0 );
+  }
+  memcpy( num, p->pos, len );
+  num[len] = '\0';
+  p->pos += len;
+
+  val = Strtod( num, &end );
+  if( (end == num) || (*end != '\0') )
+    p->err = TRUE;
+
+  return( val );
+} /* Parse_Number() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Name()
+ *
+ * Reads a variable, a function of an expression or pi
+ */
+  static double
+Parse_Name( sym_parser_t *p )
+{
+  char name[SYM_NAME_LEN];
+  size_t len = 0;
+  double val;
+  int idx;
+
+  while( isalnum((unsigned char)p->pos[len]) || (p->pos[len] == '_') )
+    len++;
+  if( len >= sizeof(name) )
+  {
+    p->err = TRUE;
+    return( 0.0 );
+  }
+  memcpy( name, p->pos, len );
+  name[len] = '\0';
+  p->pos += len;
+  Skip_Space( p );
+
+  /* Function of the expression in parentheses */
+  if( *p->pos == '(' )
+  {
+    for( idx = 0; funcs[idx].name != NULL; idx++ )
+      if( strcasecmp(funcs[idx].name, name) == 0 )
+        break;
+    if( funcs[idx].name == NULL )
+    {
+      pr_err( "unknown function %s()\n", name );
+      p->err = TRUE;
+      return( 0.0 );
+    }
+
+    p->pos++;
+    val = Parse_Expr( p );
+    Skip_Space( p );
+    if( *p->pos != ')' )
+    {
+      p->err = TRUE;
+      return( 0.0 );
+    }
+    p->pos++;
+
+    return( funcs[idx].func(val) );
+  }
+
+  idx = Sym_Find( name );
+  if( idx >= 0 )
+    return( vars[idx].value );
+  if( strcasecmp(name, "pi") == 0 )
+    return( M_PI );
+
+  pr_err( "variable %s is not assigned by an SY card\n", name );
+  p->err = TRUE;
+
+  return( 0.0 );
+} /* Parse_Name() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Primary()
+ *
+ * Reads a number, a name or an expression in parentheses
+ */
+  static double
+Parse_Primary( sym_parser_t *p )
+{
+  double val;
+
+  Skip_Space( p );
+
+  if( *p->pos == '(' )
+  {
+    p->pos++;
+    val = Parse_Expr( p );
+    Skip_Space( p );
+    if( *p->pos != ')' )
+    {
+      p->err = TRUE;
+      return( 0.0 );
+    }
+    p->pos++;
+    return( val );
+  }
+
+  if( isdigit((unsigned char)*p->pos) || (*p->pos == '.') )
+    return( Parse_Number(p) );
+
+  if( isalpha((unsigned char)*p->pos) || (*p->pos == '_') )
+    return( Parse_Name(p) );
+
+  p->err = TRUE;
+  return( 0.0 );
+} /* Parse_Primary() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Unary()
+ *
+ * Reads a signed power, so that -a^2 is -(a^2)
+ */
+  static double
+Parse_Unary( sym_parser_t *p )
+{
+  double val;
+
+  Skip_Space( p );
+  if( *p->pos == '-' )
+  {
+    p->pos++;
+    return( -Parse_Unary(p) );
+  }
+  if( *p->pos == '+' )
+  {
+    p->pos++;
+    return( Parse_Unary(p) );
+  }
+
+  /* The exponent binds to the right, a^b^c is a^(b^c) */
+  val = Parse_Primary( p );
+  Skip_Space( p );
+  if( *p->pos == '^' )
+  {
+    p->pos++;
+    val = pow( val, Parse_Unary(p) );
+  }
+
+  return( val );
+} /* Parse_Unary() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Term()
+ *
+ * Reads products and quotients
+ */
+  static double
+Parse_Term( sym_parser_t *p )
+{
+  double val;
+
+  val = Parse_Unary( p );
+  while( !p->err )
+  {
+    Skip_Space( p );
+    if( *p->pos == '*' )
+    {
+      p->pos++;
+      val *= Parse_Unary( p );
+    }
+    else if( *p->pos == '/' )
+    {
+      p->pos++;
+      val /= Parse_Unary( p );
+    }
+    else break;
+  }
+
+  return( val );
+} /* Parse_Term() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Parse_Expr()
+ *
+ * Reads sums and differences
+ */
+  static double
+Parse_Expr( sym_parser_t *p )
+{
+  double val;
+
+  val = Parse_Term( p );
+  while( !p->err )
+  {
+    Skip_Space( p );
+    if( *p->pos == '+' )
+    {
+      p->pos++;
+      val += Parse_Term( p );
+    }
+    else if( *p->pos == '-' )
+    {
+      p->pos++;
+      val -= Parse_Term( p );
+    }
+    else break;
+  }
+
+  return( val );
+} /* Parse_Expr() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Eval()
+ *
+ * Evaluates the expression in text into val,
+ * returns FALSE if it is not valid or not finite
+ */
+  gboolean
+Sym_Eval( const char *text, double *val )
+{
+  sym_parser_t p;
+
+  p.pos = text;
+  p.err = FALSE;
+  *val  = Parse_Expr( &p );
+  Skip_Space( &p );
+
+  return( !p.err && (*p.pos == '\0') && isfinite(*val) );
+} /* Sym_Eval() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Next_Field()
+ *
+ * Returns the length of the field or assignment at text, which
+ * ends at a comma, or also at a blank if blank is TRUE, outside
+ * parentheses. Returns -1 if the parentheses do not match
+ */
+  static int
+Next_Field( const char *text, gboolean blank )
+{
+  int len, depth = 0;
+
+  for( len = 0; text[len] != '\0'; len++ )
+  {
+    if( text[len] == '(' )
+      depth++;
+    else if( (text[len] == ')') && (--depth < 0) )
+      return( -1 );
+    else if( (depth == 0) && ((text[len] == ',') ||
+          (blank && ((text[len] == ' ') || (text[len] == '\t')))) )
+      break;
+  }
+
+  return( (depth == 0) ? len : -1 );
+} /* Next_Field() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Assign()
+ *
+ * Assigns the variables of the SY card text, after the mnemonic.
+ * Returns FALSE after printing the reason if it is not valid
+ */
+  gboolean
+Sym_Assign( const char *text )
+{
+  char buf[LINE_LEN], *name, *expr, *end;
+  double val;
+  int len;
+
+  while( *text != '\0' )
+  {
+    /* A ' starts a comment, as in 4nec2 */
+    if( *text == '\'' ) break;
+    if( (*text == ' ') || (*text == '\t') || (*text == ',') )
+    {
+      text++;
+      continue;
+    }
+
+    len = Next_Field( text, FALSE );
+    if( (len < 0) || (len >= (int)sizeof(buf)) )
+    {
+      pr_err( "SY card error: %s\n", text );
+      return( FALSE );
+    }
+    memcpy( buf, text, (size_t)len );
+    buf[len] = '\0';
+    text += len;
+
+    /* Comment at the end of the last assignment */
+    end = strchr( buf, '\'' );
+    if( end != NULL ) *end = '\0';
+
+    expr = strchr( buf, '=' );
+    if( expr == NULL )
+    {
+      pr_err( "SY card error, no '=' in: %s\n", buf );
+      return( FALSE );
+    }
+    *expr++ = '\0';
+
+    /* The name without blanks around it */
+    name = buf + strspn( buf, " \t" );
+    end = name + strlen( name );
+    while( (end > name) && ((end[-1] == ' ') || (end[-1] == '\t')) )
+      *--end = '\0';
+    if( (end == name) || ((end - name) >= SYM_NAME_LEN) ||
+        isdigit((unsigned char)*name) ||
+        (name[strspn(name, "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                     "abcdefghijklmnopqrstuvwxyz0123456789_")] != '\0') )
+    {
+      pr_err( "SY card error, invalid variable name: %s\n", name );
+      return( FALSE );
+    }
+
+    if( !Sym_Eval(expr, &val) )
+    {
+      pr_err( "SY card error, invalid expression: %s=%s\n", name, expr );
+      return( FALSE );
+    }
+    Sym_Set( name, val, FALSE );
+  }
+
+  return( TRUE );
+} /* Sym_Assign() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Fields()
+ *
+ * Reads the fields of a card, text after the mnemonic, as
+ * expressions: nint integers into iarr and nflt numbers into
+ * rarr. Missing fields are left as they are. Returns FALSE
+ * after printing the reason if a field is not valid
+ */
+  gboolean
+Sym_Fields( const char *text, int *iarr, int nint, double *rarr, int nflt )
+{
+  char buf[LINE_LEN];
+  double val;
+  int fld = 0, len;
+
+  while( (*text != '\0') && (*text != '\'') && (fld < nint + nflt) )
+  {
+    if( (*text == ' ') || (*text == '\t') || (*text == ',') )
+    {
+      text++;
+      continue;
+    }
+
+    len = Next_Field( text, TRUE );
+    if( (len < 0) || (len >= (int)sizeof(buf)) )
+    {
+      pr_err( "invalid field %d: %s\n", fld + 1, text );
+      return( FALSE );
+    }
+    memcpy( buf, text, (size_t)len );
+    buf[len] = '\0';
+    text += len;
+
+    if( !Sym_Eval(buf, &val) )
+    {
+      pr_err( "invalid expression in field %d: %s\n", fld + 1, buf );
+      return( FALSE );
+    }
+
+    if( fld < nint )
+      iarr[fld] = (int)lround( val );
+    else
+      rarr[fld - nint] = val;
+    fld++;
+  }
+
+  return( TRUE );
+} /* Sym_Fields() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Override()
+ *
+ * Fixes variable name to value, over the SY cards
+ */
+  void
+Sym_Override( const char *name, double value )
+{
+  Sym_Set( name, value, TRUE );
+} /* Sym_Override() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Clear()
+ *
+ * Forgets the variables assigned by SY cards, before an input
+ * file is read. Those of Sym_Override() are forgotten too if
+ * overrides is TRUE
+ */
+  void
+Sym_Clear( gboolean overrides )
+{
+  int idx, num = 0;
+
+  for( idx = 0; idx < nvars; idx++ )
+    if( vars[idx].fixed && !overrides )
+      vars[num++] = vars[idx];
+  nvars = num;
+
+  if( nvars == 0 )
+    free_ptr( (void **)&vars );
+
+} /* Sym_Clear() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Sym_Count()
+ *
+ * Returns the number of variables, the fields of the cards
+ * are read as expressions only when there are some
+ */
+  int
+Sym_Count( void )
+{
+  return( nvars );
+} /* Sym_Count() */
+
+/*-----------------------------------------------------------------------*/
+
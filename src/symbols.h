@@ -0,0 +1,59 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ *  The official website and doumentation for xnec2c is available here:
+ *    https://www.xnec2c.org/
+ */
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H    1
+
+#include "common.h"
+
+/* Longest name of a variable, with the terminating nul */
+#define SYM_NAME_LEN   32
+
+/* Longest number in an expression */
+#define SYM_NUMBER_LEN 64
+
+/* A variable assigned by SY cards or on the command line */
+typedef struct
+{
+  char name[SYM_NAME_LEN];
+  double value;
+
+  /* Set by Sym_Override(), SY cards do not change it */
+  gboolean fixed;
+
+} sym_var_t;
+
+/* A function of expressions */
+typedef struct
+{
+  const char *name;
+  double (*func)( double );
+
+} sym_func_t;
+
+/* Position and state of the expression parser */
+typedef struct
+{
+  const char *pos;
+  gboolean err;
+
+} sym_parser_t;
+
+#endif
+
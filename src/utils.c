@@ -45,6 +45,26 @@ usage(void)
 		"  -j|--jobs  <number of processors in SMP machine> (-j0 disables forking)\n"
 		"  -b|--batch:        enable batch mode, exit after the frequency loop runs\n"
 		"     --optimize:     Activate the optimizer immediately.\n"
+		"     --fill-threads <N>: threads per job for the matrix and field patterns (0 = CPUs/jobs)\n"
+		"     --matrix-cache <MB>: memory per job to cache factored matrices (0 = off)\n"
+		"     --matrix-cache-disk <MB>: disk space per job for matrices spilled from the cache\n"
+		"     --somnec-cache-dir <dir>: directory of saved Sommerfeld ground grids\n"
+		"                       (default ~/.xnec2c/somnec, \"\" to not save them)\n"
+		"     --adaptive-sweep <tol>: solve only some frequency steps and interpolate\n"
+		"                       the others, to a relative impedance error of tol\n"
+		"     --matrix-interp <tol>: interpolate the interaction matrix between a few\n"
+		"                       frequencies of the sweep, to a relative error of tol\n"
+		"     --mixed-precision: factor the matrix in single precision and refine\n"
+		"                       the solutions to double precision (no matrix cache)\n"
+		"     --out-of-core <MB>: keep larger interaction matrices in a temporary\n"
+		"                       file and factor them by panels within MB of memory\n"
+		"     --rdpat-mb <MB>: keep the radiation patterns of the frequency steps in\n"
+		"                       a temporary file when they need more than MB of memory\n"
+		"     --stats <file>: write the time of each solver phase to file, in JSON\n"
+		"                       format, after each frequency loop\n"
+		"     --autotune:     time the math libraries with a few matrix sizes, jobs\n"
+		"                       and BLAS threads, save the fastest in the config file\n"
+		"                       for when an input file is opened, and exit\n"
 		"  -P|--no-pthreads:  disable pthreads and use the GTK loop for debugging\n"
 		"  -h|--help:         print usage information and exit\n"
 		"  -V|--version:      print xnec2c version number and exit\n"
@@ -62,11 +82,83 @@ usage(void)
 		"  --write-s2p-max-gain    <filename>  - write S2P file, port-2 is max-gain\n"
 		"  --write-s2p-viewer-gain <filename>  - write S2P file, port-2 is viewer-gain\n"
 		"  --write-rdpat           <filename>  - write CSV of the radiation pattern\n"
-		"  --write-currents        <filename>  - write CSV of currents and charges\n");
+		"  --write-currents        <filename>  - write CSV of currents and charges\n"
+		"\n"
+		"The following arguments write NumPy .npy files of the same columns, with\n"
+		"the rows of each frequency step appended as soon as it is calculated:\n"
+		"\n"
+		"  --write-rdpat-bin       <filename>  - write .npy of the radiation pattern\n"
+		"  --write-currents-bin    <filename>  - write .npy of currents and charges\n");
 
 } /* end of usage() */
 
 
+#ifdef XNEC2C_BATCH
+
+/* Without a GUI, notices only go to the console */
+int Notice(char *title, char *message,  GtkButtonsType buttons)
+{
+	pr_notice("\n=== Notice: %s ===\n%s\n\n", title, message);
+
+	return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Reason of the first Stop() since FREQ_LOOP_STOP was cleared */
+static char stop_mesg[MESG_SIZE];
+static GMutex stop_lock;
+
+/* Does the STOP function of fortran. Nobody is there to
+ * dismiss an error dialog, so fatal errors end the run,
+ * unless STOP_RETURNS is set by a server that goes on
+ * with its next model. Then, as in the GUI's children,
+ * the calculations carry on and their results are
+ * discarded since FREQ_LOOP_STOP is set */
+  int
+Stop( char *mesg, int err )
+{
+  pr_err("Stop: %s\n", mesg);
+
+  if( err && isFlagClear(STOP_RETURNS) ) exit( -1 );
+
+  /* Stop() may be called by the fill threads */
+  g_mutex_lock( &stop_lock );
+  if( isFlagClear(FREQ_LOOP_STOP) )
+    Strlcpy( stop_mesg, mesg, sizeof(stop_mesg) );
+  SetFlag(FREQ_LOOP_STOP);
+  g_mutex_unlock( &stop_lock );
+
+  return( err );
+} /* Stop() */
+
+/*------------------------------------------------------------------------*/
+
+/* Stop_Message()
+ *
+ * Returns the reason of the first Stop() since FREQ_LOOP_STOP
+ * was cleared, on one line, or an empty string if none
+ */
+  const char *
+Stop_Message( void )
+{
+  size_t len;
+  char *c;
+
+  if( isFlagClear(FREQ_LOOP_STOP) )
+    return( "" );
+
+  for( c = stop_mesg; *c != '\0'; c++ )
+    if( (*c == '\n') || (*c == '\r') ) *c = ' ';
+  len = strlen( stop_mesg );
+  while( (len > 0) && (stop_mesg[len - 1] == ' ') )
+    stop_mesg[--len] = '\0';
+
+  return( stop_mesg );
+} /* Stop_Message() */
+
+#else
+
 // May return GTK_RESPONSE_OK, GTK_RESPONSE_CANCEL, ...
 int Notice(char *title, char *message,  GtkButtonsType buttons)
 {
@@ -217,6 +309,8 @@ Nec2_Save_Warn( const gchar *mesg )
   return( TRUE );
 } /* Nec2_Save_Warn() */
 
+#endif
+
 /*------------------------------------------------------------------*/
 
 /*  Load_Line()
@@ -490,6 +584,47 @@ Close_File( FILE **fp )
 
 /*------------------------------------------------------------------------*/
 
+/*  Load_File()
+ *
+ *  Reads the whole of file fname into a buffer, nul terminated,
+ *  that the caller frees with free_ptr(). Returns FALSE on failure
+ *  or if the file is larger than max bytes
+ */
+  gboolean
+Load_File( char *fname, size_t max, char **text, size_t *len )
+{
+  FILE *fp = NULL;
+  long siz;
+
+  if( !Open_File(&fp, fname, "r") )
+    return( FALSE );
+
+  if( (fseek(fp, 0, SEEK_END) != 0) || ((siz = ftell(fp)) < 0) ||
+      ((size_t)siz > max) || (fseek(fp, 0, SEEK_SET) != 0) )
+  {
+    pr_err( "%s: cannot read the file\n", fname );
+    Close_File( &fp );
+    return( FALSE );
+  }
+
+  *text = NULL;
+  mem_alloc( (void **)text, (size_t)siz + 1, "in utils.c" );
+  if( fread(*text, 1, (size_t)siz, fp) != (size_t)siz )
+  {
+    pr_err( "%s: cannot read the file\n", fname );
+    free_ptr( (void **)text );
+    Close_File( &fp );
+    return( FALSE );
+  }
+  Close_File( &fp );
+  *len = (size_t)siz;
+
+  return( TRUE );
+} /* Load_File() */
+
+/*------------------------------------------------------------------------*/
+
+#ifndef XNEC2C_BATCH
 /* Display_Fstep()
  *
  * Displays the current frequency step number
@@ -502,6 +637,7 @@ Display_Fstep( GtkEntry *entry, int fstep )
   snprintf( str, sizeof(str), "%3d", fstep );
   gtk_entry_set_text( entry, str );
 }
+#endif
 
 /*------------------------------------------------------------------------*/
 
@@ -663,6 +799,28 @@ double Strtod( char *nptr, char **endptr )
   return( d );
 } /* End of Strtod() */
 
+/*------------------------------------------------------------------------*/
+
+/* Hash_Bytes()
+ *
+ * Adds cnt bytes at buf to the FNV-1a hash h
+ */
+  guint64
+Hash_Bytes( guint64 h, const void *buf, size_t cnt )
+{
+  const unsigned char *p = buf;
+  size_t idx;
+
+  if( buf == NULL ) return( h );
+  for( idx = 0; idx < cnt; idx++ )
+  {
+    h ^= p[idx];
+    h *= 0x100000001b3ULL;
+  }
+
+  return( h );
+} /* Hash_Bytes() */
+
 /*------------------------------------------------------------------*/
 
 /* str_append()
@@ -707,6 +865,7 @@ Get_Dirname( char *fpath, char *dirname, int *fname_idx )
 
 } /* Get_Dirname() */
 
+#ifndef XNEC2C_BATCH
 typedef struct 
 {
 	GSourceOnceFunc function;
@@ -847,6 +1006,7 @@ void xnec2_widget_queue_draw(GtkWidget *w)
 		g_idle_add_once((GSourceOnceFunc)gtk_widget_queue_draw, w);
 
 }
+#endif
 /*------------------------------------------------------------------*/
 
 
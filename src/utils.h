@@ -27,5 +27,10 @@
 #define CR  0x0d
 #define LF  0x0a
 
+/* FNV-1a hashes of variables and arrays, see Hash_Bytes() */
+#define HASH_INIT             0xcbf29ce484222325ULL
+#define HASH_VAR(h, v)        Hash_Bytes( (h), &(v), sizeof(v) )
+#define HASH_ARR(h, a, n)     Hash_Bytes( (h), (a), (size_t)(n) * sizeof(*(a)) )
+
 #endif
 
@@ -23,7 +23,9 @@
 #include "shared.h"
 #include "mathlib.h"
 
+#ifndef XNEC2C_BATCH
 static pthread_t *pth_freq_loop = NULL;
+#endif
 
 /* Left-overs from fortran code :-( */
 static double tmp1, tmp2, tmp3, tmp4, tmp5, tmp6;
@@ -89,6 +91,9 @@ Frequency_Scale_Geometry(void)
 {
   double fr;
   int idx;
+  perf_mark_t mark;
+
+  Perf_Start( &mark );
 
   /* Calculate wavelength */
   data.wlam= CVEL / calc_data.freq_mhz;
@@ -122,6 +127,8 @@ Frequency_Scale_Geometry(void)
     }
   }
 
+  Perf_Stop( &mark, PERF_GEOMETRY );
+
 } /* Frequency_Scale_Geometry() */
 
 /*-----------------------------------------------------------------------*/
@@ -153,6 +160,9 @@ Structure_Impedance_Loading( void )
 Ground_Parameters( void )
 {
   complex double epsc;
+  perf_mark_t mark;
+
+  Perf_Start( &mark );
 
   if( gnd.ksymp != 1)
   {
@@ -199,11 +209,43 @@ Ground_Parameters( void )
     }
   } /* if( gnd.ksymp != 1) */
 
-  return;
+  Perf_Stop( &mark, PERF_GROUND );
+
 } /* Ground_Parameters() */
 
 /*-----------------------------------------------------------------------*/
 
+/* Fill_Matrix_At()
+ *
+ * Fills the interaction matrix cmx at frequency fmhz, for
+ * Matrix_Interp_Fill(), then restores the current frequency.
+ * Only cmset() is timed as the fill, the scaling is timed
+ * as the geometry and ground phases
+ */
+  static void
+Fill_Matrix_At( double fmhz, complex double *cmx )
+{
+  double freq = calc_data.freq_mhz;
+  perf_mark_t mark;
+
+  calc_data.freq_mhz = fmhz;
+  Frequency_Scale_Geometry();
+  Structure_Impedance_Loading();
+  Ground_Parameters();
+
+  Perf_Start( &mark );
+  cmset( netcx.neq, cmx, calc_data.rkh, calc_data.iexk );
+  Perf_Stop( &mark, PERF_FILL );
+
+  calc_data.freq_mhz = freq;
+  Frequency_Scale_Geometry();
+  Structure_Impedance_Loading();
+  Ground_Parameters();
+
+} /* Fill_Matrix_At() */
+
+/*-----------------------------------------------------------------------*/
+
 /* Set_Interaction_Matrix()
  *
  * Sets and factors the interaction matrix
@@ -211,6 +253,9 @@ Ground_Parameters( void )
   static void
 Set_Interaction_Matrix( void )
 {
+  perf_mark_t mark;
+  gboolean interp;
+
   /* Memory allocation for symmetry array */
   smat.nop = netcx.neq/netcx.npeq;
   size_t mreq = (size_t)(smat.nop * smat.nop) * sizeof( complex double);
@@ -221,8 +266,43 @@ Set_Interaction_Matrix( void )
   if( matpar.imat == 0)
     fblock( netcx.npeq, netcx.neq, iresrv, data.ipsym);
 
-  cmset( netcx.neq, cm, calc_data.rkh, calc_data.iexk );
-  factrs( netcx.npeq, netcx.neq, cm, save.ip );
+  /* Filled and factored by panels if it is kept in a file */
+  if( Matrix_Ooc_Active() )
+  {
+    Perf_Start( &mark );
+    Matrix_Ooc_Fill_Factor( netcx.npeq, netcx.neq, save.ip,
+        calc_data.rkh, calc_data.iexk );
+    Perf_Stop( &mark, PERF_FACTOR );
+  }
+
+  /* Skip the fill and factoring if the matrix is cached */
+  else if( Matrix_Cache_Load(cm, save.ip) )
+  {
+    dataj.rkh  = calc_data.rkh;
+    dataj.iexk = calc_data.iexk;
+  }
+  else
+  {
+    /* Interpolated in a frequency sweep with --matrix-interp,
+     * which times its fill outside of the scaling to anchors */
+    interp = Matrix_Interp_Fill( netcx.neq, cm, Fill_Matrix_At );
+    if( !interp )
+    {
+      Perf_Start( &mark );
+      cmset( netcx.neq, cm, calc_data.rkh, calc_data.iexk );
+      Perf_Stop( &mark, PERF_FILL );
+    }
+
+    Perf_Start( &mark );
+    factrs( netcx.npeq, netcx.neq, cm, save.ip );
+    Perf_Stop( &mark, PERF_FACTOR );
+
+    /* The cache is looked up by the exact frequency, so
+     * not an approximation, nor a matrix filled while
+     * Stop() was called */
+    if( !interp && isFlagClear(FREQ_LOOP_STOP) )
+      Matrix_Cache_Store( cm, save.ip );
+  }
   netcx.ntsol = 0;
 
 } /* Set_Interaction_Matrix() */
@@ -231,10 +311,10 @@ Set_Interaction_Matrix( void )
 
 /* Set_Excitation()
  *
- * Sets the excitation part of the matrix
+ * Sets the excitation part of the matrix in e
  */
   static void
-Set_Excitation( void )
+Set_Excitation( complex double *e )
 {
   if( (fpat.ixtyp >= 1) && (fpat.ixtyp <= 4) )
   {
@@ -259,7 +339,7 @@ Set_Excitation( void )
   } /* if( (fpat.ixtyp >= 1) && (fpat.ixtyp <= 4) ) */
 
   /* fills e field right-hand matrix */
-  etmns( tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, fpat.ixtyp, crnt.cur );
+  etmns( tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, fpat.ixtyp, e );
 
 } /* Set_Excitation() */
 
@@ -267,11 +347,14 @@ Set_Excitation( void )
 
 /* Set_Network_Data()
  *
- * Sets up network data and solves for currents
+ * Sets up network data and solves for currents,
+ * unless solved, see netwk()
  */
   static void
-Set_Network_Data( void )
+Set_Network_Data( gboolean solved )
 {
+  perf_mark_t mark;
+
   if( netcx.nonet != 0 )
   {
     int i, j, itmp1, itmp2, itmp3;
@@ -311,7 +394,9 @@ Set_Network_Data( void )
   } /* if( netcx.nonet != 0 ) */
 
   /* Set network data */
-  netwk( cm, save.ip, crnt.cur );
+  Perf_Start( &mark );
+  netwk( cm, save.ip, crnt.cur, solved );
+  Perf_Stop( &mark, PERF_SOLVE );
   netcx.ntsol = 1;
 
   /* Save impedance data for normalization */
@@ -380,11 +465,15 @@ Power_Loss( void )
   static void
 Radiation_Pattern( void )
 {
+  perf_mark_t mark;
+
   if( (gnd.ifar != 1) && isFlagSet(ENABLE_RDPAT) )
   {
     fpat.pinr= netcx.pin;
     fpat.pnlr= netcx.pnls;
+    Perf_Start( &mark );
     rdpat();
+    Perf_Stop( &mark, PERF_RDPAT );
   }
 
 } /* Radiation_Pattern() */
@@ -398,16 +487,33 @@ Radiation_Pattern( void )
   void
 Near_Field_Pattern( void )
 {
+  perf_mark_t mark;
+
   if( near_field.valid ||
       isFlagClear(DRAW_EHFIELD) ||
       isFlagClear(ENABLE_NEAREH) )
     return;
 
+  /* Let Draw_Radiation() draw the field points as they
+   * are published, until both grids are complete. The
+   * buffers and counters are set up under the lock first,
+   * so that it never draws from reallocated buffers */
+  g_mutex_lock( &near_field_lock );
+  Nfpat_Init();
+  g_atomic_int_set( &near_field.partial, 1 );
+  g_mutex_unlock( &near_field_lock );
+
+  Perf_Start( &mark );
   if( fpat.nfeh & NEAR_EFIELD )
     nfpat(0);
 
   if( fpat.nfeh & NEAR_HFIELD )
     nfpat(1);
+  Perf_Stop( &mark, PERF_NFPAT );
+
+  g_mutex_lock( &near_field_lock );
+  g_atomic_int_set( &near_field.partial, 0 );
+  g_mutex_unlock( &near_field_lock );
 
 } /* Near_Field_Pattern() */
 
@@ -465,11 +571,11 @@ New_Frequency( void )
   Set_Interaction_Matrix();
 
   /* Fill excitation part of matrix */
-  Set_Excitation();
+  Set_Excitation( crnt.cur );
 
   /* Matrix solving (netwk calls solves) */
   crnt.valid = 0;
-  Set_Network_Data();
+  Set_Network_Data( FALSE );
 
   /* Calculate power loss */
   Power_Loss();
@@ -494,7 +600,9 @@ New_Frequency( void )
 
 /*-----------------------------------------------------------------------*/
 
+#ifndef XNEC2C_BATCH
 static gboolean retval; /* Function's return value */
+static int num_busy_procs = 0; /* Number of busy child processes */
 
 int update_freqplots_fmhz_entry(gpointer p)
 {
@@ -521,6 +629,293 @@ int update_fmhz_save_spin_button_value(GtkSpinButton *w)
 
 	return FALSE;
 }
+#endif
+
+/* Step_Frequency()
+ *
+ * Sets freq to the frequency of step fstep, going
+ * on to the next FR card when all its steps are done
+ */
+  static void
+Step_Frequency( int fstep, double *freq, int *fsteps_total )
+{
+  /* If all steps of current FR card are processed, go to the next */
+  if( fstep >= *fsteps_total )
+  {
+    calc_data.FR_index++;
+    if( calc_data.FR_index < calc_data.FR_cards )
+    {
+      /* Add steps of new FR card range to total */
+      *fsteps_total += calc_data.freq_loop_data[calc_data.FR_index].freq_steps;
+
+      /* Update loop frequency from new FR card
+       * FIXME:  We shrink it here just so we cang row it down
+       * below where it is commented "Increment frequency" */
+      *freq = calc_data.freq_loop_data[calc_data.FR_index].min_freq;
+      if( calc_data.freq_loop_data[calc_data.FR_index].ifreq == 1)
+        *freq /= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+      else
+        *freq -= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+    }
+    else
+    {
+      calc_data.FR_index--;   /* keep it in range, avoid off-by-1 error */
+    }
+  }
+
+  /* Increment frequency:
+   * ifreq is "IFRQ (I1) from the FR card specification:
+   *    0 - linear stepping
+   *    1 - multiplicative stepping */
+  if( calc_data.freq_loop_data[calc_data.FR_index].ifreq == 1)
+    *freq *= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+  else
+    *freq += calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+
+} /* Step_Frequency() */
+
+/*-----------------------------------------------------------------------*/
+
+#ifdef XNEC2C_BATCH
+
+/* Run_Frequency_Step()
+ *
+ * Calculates frequency step fstep at save.freq[fstep],
+ * returns FALSE if Stop() was called by the calculations
+ */
+  static gboolean
+Run_Frequency_Step( int fstep )
+{
+  save.fstep[fstep]   = 0;
+  calc_data.freq_mhz  = save.freq[fstep];
+  calc_data.freq_step = fstep;
+  calc_data.last_step = fstep;
+
+  New_Frequency();
+
+  if( isFlagSet(FREQ_LOOP_STOP) )
+    return( FALSE );
+  save.fstep[fstep] = 1;
+  Bin_Output_Step( fstep );
+
+  return( TRUE );
+} /* Run_Frequency_Step() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Run_Frequency_Loop()
+ *
+ * Calculates all frequency steps in turn, without a GUI
+ * to update or child processes to delegate them to. In an
+ * adaptive sweep only some of the steps are calculated
+ * and the others are interpolated
+ */
+  gboolean
+Run_Frequency_Loop( void )
+{
+  double freq;
+  int fstep, fsteps_total;
+  gboolean ok = TRUE;
+  struct timespec start, end;
+
+  if( (calc_data.freq_loop_data == NULL) ||
+      (calc_data.FR_cards < 1) || (calc_data.steps_total < 1) )
+    return( FALSE );
+
+  ClearFlag( FREQ_LOOP_STOP | FREQ_LOOP_DONE );
+  SetFlag( FREQ_LOOP_RUNNING );
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  Bin_Output_Open();
+
+  /* Step back the start frequency since
+   * Step_Frequency() increments it first */
+  freq = calc_data.freq_loop_data[0].min_freq;
+  if( calc_data.freq_loop_data[0].ifreq == 1)
+    freq /= calc_data.freq_loop_data[0].delta_freq;
+  else
+    freq -= calc_data.freq_loop_data[0].delta_freq;
+
+  calc_data.FR_index = 0;
+  fsteps_total = calc_data.freq_loop_data[0].freq_steps;
+  New_Frequency_Reset_Prev();
+
+  /* Inherited from NEC2 */
+  if( calc_data.zpnorm > 0.0 ) calc_data.iped = 2;
+
+  /* Frequencies of all the steps */
+  for( fstep = 0; fstep < calc_data.steps_total; fstep++ )
+  {
+    Step_Frequency( fstep, &freq, &fsteps_total );
+    save.freq[fstep]  = freq;
+    save.fstep[fstep] = 0;
+  }
+
+  if( rc_config.adaptive_tol > 0.0 )
+  {
+    Adaptive_Sweep_Start();
+    do
+    {
+      while( ok && ((fstep = Adaptive_Sweep_Next()) >= 0) )
+        ok = Run_Frequency_Step( fstep );
+      if( ok ) Adaptive_Sweep_Fill();
+    }
+    while( ok && Adaptive_Sweep_Refine() );
+
+    /* The currents and calc_data.freq_mhz
+     * stay those of the last step solved */
+    calc_data.freq_step = calc_data.last_step = calc_data.steps_total - 1;
+  }
+  else
+    for( fstep = 0; ok && (fstep < calc_data.steps_total); fstep++ )
+      ok = Run_Frequency_Step( fstep );
+
+  ClearFlag( FREQ_LOOP_RUNNING );
+  Bin_Output_Close();
+
+  /* Stop() was called by the calculations */
+  if( !ok ) return( FALSE );
+
+  SetFlag( FREQ_LOOP_DONE | FREQ_LOOP_READY );
+
+  clock_gettime( CLOCK_MONOTONIC, &end );
+  Perf_Write_Stats( (double)(end.tv_sec - start.tv_sec) +
+      (double)(end.tv_nsec - start.tv_nsec) / 1.0E9 );
+
+  return( TRUE );
+} /* Run_Frequency_Loop() */
+
+#else
+
+/* Wait_Child_Procs()
+ *
+ * Waits in select() for data from the child processes
+ */
+  static void
+Wait_Child_Procs( fd_set *read_fds )
+{
+  int idx, n;
+
+  do
+  {
+    /* Set read fd's to watch for child writes */
+    n = 0;
+    FD_ZERO( read_fds );
+    for( idx = 0; idx < calc_data.num_jobs; idx++ )
+    {
+      FD_SET( forked_proc_data[idx]->child2pnt_pipe[READ], read_fds );
+      if( n < forked_proc_data[idx]->child2pnt_pipe[READ] )
+        n = forked_proc_data[idx]->child2pnt_pipe[READ];
+    }
+
+    if( select( n+1, read_fds, NULL, NULL, NULL ) != -1 )
+      return;
+  }
+  while( errno == EINTR );
+
+  perror( "select()" );
+  _exit(0);
+
+} /* Wait_Child_Procs() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Drain_Child_Procs()
+ *
+ * Empties the frequency queue and waits for busy
+ * children to finish the steps they have taken
+ */
+  static void
+Drain_Child_Procs( void )
+{
+  fd_set read_fds;
+  int idx, fstep, ret;
+
+  if( !FORKED || (num_busy_procs == 0) ) return;
+  Freq_Queue_Stop();
+
+  while( num_busy_procs > 0 )
+  {
+    Wait_Child_Procs( &read_fds );
+
+    g_mutex_lock(&freq_data_lock);
+    for( idx = 0; idx < num_child_procs; idx++ )
+    {
+      if( !FD_ISSET(forked_proc_data[idx]->child2pnt_pipe[READ], &read_fds) )
+        continue;
+
+      /* Results of steps taken before the stop are dropped */
+      ret = Get_Freq_Data( idx, &fstep );
+      if( ret == FREQ_DATA_READ ) continue;
+      if( ret == FREQ_DATA_ERROR )
+        pr_err("Failed to read data from forked child %d\n", idx);
+
+      if( forked_proc_data[idx]->busy )
+      {
+        forked_proc_data[idx]->busy = FALSE;
+        num_busy_procs--;
+      }
+    }
+    g_mutex_unlock(&freq_data_lock);
+  }
+
+} /* Drain_Child_Procs() */
+
+/*-----------------------------------------------------------------------*/
+
+/* Start_Child_Procs()
+ *
+ * Queues all the frequency steps, or the steps of the current
+ * round of an adaptive sweep, and starts the children on them
+ */
+  static gboolean
+Start_Child_Procs( gboolean adaptive )
+{
+  int job_num, nsteps = 0, *steps = NULL, batch_idx;
+  size_t len;
+  gboolean ok;
+
+  if( adaptive )
+  {
+    len = (size_t)calc_data.steps_total * sizeof(int);
+    mem_alloc( (void **)&steps, len, "in xnec2c.c" );
+    while( (steps[nsteps] = Adaptive_Sweep_Next()) >= 0 )
+      nsteps++;
+    ok = Freq_Queue_Start( save.freq, steps, nsteps, calc_data.num_jobs );
+    free_ptr( (void **)&steps );
+  }
+  else
+    ok = Freq_Queue_Start( save.freq, NULL, calc_data.steps_total, calc_data.num_jobs );
+
+  if( !ok )
+  {
+    pr_err("Failed to queue frequency steps for forked children\n");
+    return( FALSE );
+  }
+
+  // Send the mathlib to use, try to lock it if it is Intel MKL.
+  batch_idx = mathlib_batch_idx();
+  mathlib_lock_intel_batch(batch_idx);
+
+  for( job_num = 0; job_num < calc_data.num_jobs; job_num++ )
+  {
+    Write_Pipe( job_num, fork_commands[MATHLIB], (ssize_t)strlen(fork_commands[MATHLIB]), TRUE );
+    Write_Pipe( job_num, (char*)&batch_idx, (ssize_t)sizeof(batch_idx), TRUE );
+    Write_Pipe( job_num, (char*)&rc_config.mathlib_batch_threads,
+        (ssize_t)sizeof(rc_config.mathlib_batch_threads), TRUE );
+
+    /* Tell process to calculate queued freq dependent data */
+    len = strlen( fork_commands[FRQDATA] );
+    Write_Pipe( job_num, fork_commands[FRQDATA], (ssize_t)len, TRUE );
+
+    /* Signal and count busy processes */
+    forked_proc_data[job_num]->busy = TRUE;
+    num_busy_procs++;
+  }
+
+  return( TRUE );
+} /* Start_Child_Procs() */
+
+/*-----------------------------------------------------------------------*/
 
 /* Frequency_Loop()
  *
@@ -530,17 +925,22 @@ int update_fmhz_save_spin_button_value(GtkSpinButton *w)
  * This function does the following:
 
 	0. If FREQ_LOOP_INIT, set initial state
-	1. For each job:
-		a. Set "freq" to the right value from FR_cards for the next job to assign
-		b. If FREQ_LOOP_STOP, then cleanup and disable loop
-		c. Increment frequency, set save.freq[fstep] = (double)freq;
-		d. Find an available child and give it the fstep
+	1. If FREQ_LOOP_STOP, then empty the queue and disable loop
+	2. If forked and not started yet:
+		a. Set save.freq[] for all steps from the FR_cards
+		b. Queue all steps in shared memory with Freq_Queue_Start()
+		c. Start all children, they take chunks of steps from the queue
+	3. If not forked, increment frequency and calculate that step
+	4. In an adaptive sweep (--adaptive-sweep) only the steps of the
+		current round are queued or calculated. When a round is done
+		the other steps are interpolated and the next round, of steps
+		where the interpolation is not good enough, is started
 	5. Wait until a child has frequency data ready.
 		- For each available child:
 			a. Load the data via Get_Freq_Data
-			     into the fstep'th index that was handed to that particular child
+			     for the fstep that the child reports
 			b. Set save.fstep[child_fstep]=1 to indicate the data is ready
-			c. Clear the child's busy flag
+			c. If the child found the queue empty, clear its busy flag
 	6. Set calc_data.freq_step to the highest available step with data. 
 		This is an index value, not a count.
 	7. Trigger a redraw if still have busy children
@@ -556,12 +956,13 @@ gboolean Frequency_Loop( gpointer udata )
 
   static int
     fstep,           /* Current frequency step */
-    fsteps_total,    /* Total number of frequency steps processed */
-    num_busy_procs;  /* Number of busy child processes */
+    fsteps_total;    /* Total number of frequency steps processed */
 
-  int idx, job_num = 0;
-  size_t len;
-  char *buff;      /* Used to pass on structure poiners */
+  /* An adaptive frequency sweep is in progress */
+  static gboolean adaptive;
+
+  int idx;
+  int ret, child_fstep, next_fstep;
   fd_set read_fds; /* Read file descriptors for select() */
 
   // Total freqloop time:
@@ -571,6 +972,9 @@ gboolean Frequency_Loop( gpointer udata )
   /* (Re) Initialize freq loop */
   if( isFlagSet(FREQ_LOOP_INIT) )
   {
+    /* Children may still be busy with a stopped loop */
+    Drain_Child_Procs();
+
     g_mutex_lock(&freq_data_lock);
 
     /* Clear global flags */
@@ -601,18 +1005,22 @@ gboolean Frequency_Loop( gpointer udata )
     /* Clear "last-used-frequency" buffer */
     New_Frequency_Reset_Prev();
 
-    /* Zero num of busy processes */
-    num_busy_procs = 0;
-
     /* Signal global freq step "illegal" FIXME */
     calc_data.freq_step = -1;
 
     /* Inherited from NEC2 */
     if( calc_data.zpnorm > 0.0 ) calc_data.iped = 2;
 
+    /* Only some of the steps are calculated in
+     * an adaptive sweep, the others interpolated */
+    adaptive = (rc_config.adaptive_tol > 0.0);
+
 	// Start the timer:
 	clock_gettime(CLOCK_MONOTONIC, &start);
 
+    /* Binary files of --write-*-bin are written as steps finish */
+    Bin_Output_Open();
+
     g_mutex_unlock(&freq_data_lock);
 
     /* Continue iterating this function.  (Returning FALSE would discontinue the frequency loop.) */
@@ -624,106 +1032,106 @@ gboolean Frequency_Loop( gpointer udata )
 
   // Prevent the optimizer from running this function in parallel:
   g_mutex_lock(&global_lock);
-  
-  /* Repeat freq stepping over number of child processes
-   * if forked. calc_data.num_jobs = 1 for non-forked runs.
-   * If not forked (no multi-threading), following block will
-   * execute only once, since only one instance is running */
-  for( idx = 0; idx < calc_data.num_jobs; idx++ )
+
+  /* Frequency loop was paused by user */
+  if( isFlagSet(FREQ_LOOP_STOP) )
   {
-    /* Up frequency step count. Note that this is initialized at -1 above so it
-	 * really does start the first loop with fstep==0 */
-    fstep++;
+    /* Points to last buffer in rad_pattern filled by loop */
+    fstep = calc_data.freq_step;
+
+    /* Re-enable pausing of freq loop */
+    ClearFlag( FREQ_LOOP_STOP );
+
+    /* Children only finish the steps they have taken */
+    if( FORKED ) Freq_Queue_Stop();
+
+    /* Cancel idle callbacks on exit */
+    retval = FALSE;
 
-    /* Set `freq` for use below
-     * If all steps of current FR card are processed, go to the next */
-    if( fstep >= fsteps_total )
+  } /* if( isFlagSet(FREQ_LOOP_STOP) ) */
+
+  /* Delegate calculations to child processes if forked. All
+   * frequency steps are queued at once and the children take
+   * chunks of steps from the queue until it is empty */
+  else if( FORKED )
+  {
+    if( fstep < 0 )
     {
-      calc_data.FR_index++;
-      if( calc_data.FR_index < calc_data.FR_cards )
+      /* Save frequencies for plotting and queue them */
+      for( fstep = 0; fstep < calc_data.steps_total; fstep++ )
       {
-        /* Add steps of new FR card range to total */
-        fsteps_total += calc_data.freq_loop_data[calc_data.FR_index].freq_steps;
-
-        /* Update loop frequency from new FR card
-         * FIXME:  We shrink it here just so we cang row it down
-         * below where it is commented "Increment frequency" */
-        freq = calc_data.freq_loop_data[calc_data.FR_index].min_freq;
-        if( calc_data.freq_loop_data[calc_data.FR_index].ifreq == 1)
-          freq /= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
-        else
-          freq -= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+        Step_Frequency( fstep, &freq, &fsteps_total );
+        save.freq[fstep] = (double)freq;
       }
-      else
+
+      if( adaptive ) Adaptive_Sweep_Start();
+      if( !Start_Child_Procs(adaptive) )
       {
-        calc_data.FR_index--;   /* keep it in range, avoid off-by-1 error */
+        SetFlag(FREQ_LOOP_STOP);
+        g_mutex_unlock(&global_lock);
+        return FALSE;
       }
     }
+  } /* if( FORKED ) */
 
-    /* Frequency loop was paused by user */
-    if( isFlagSet(FREQ_LOOP_STOP) )
+  /* Calculate the steps of an adaptive sweep (no fork) */
+  else if( adaptive )
+  {
+    if( fstep < 0 )
     {
-      /* Points to last buffer in rad_pattern filled by loop */
-      fstep = calc_data.freq_step;
-
-      /* Re-enable pausing of freq loop */
-      ClearFlag( FREQ_LOOP_STOP );
-
-      /* Cancel idle callbacks on exit */
-      retval = FALSE;
+      for( fstep = 0; fstep < calc_data.steps_total; fstep++ )
+      {
+        Step_Frequency( fstep, &freq, &fsteps_total );
+        save.freq[fstep] = (double)freq;
+      }
+      Adaptive_Sweep_Start();
+    }
 
-      break;
-    } /* if( isFlagSet(FREQ_LOOP_STOP) ) */
+    next_fstep = Adaptive_Sweep_Next();
+    if( next_fstep >= 0 )
+    {
+      g_mutex_lock(&freq_data_lock);
+      calc_data.freq_mhz  = save.freq[next_fstep];
+      calc_data.freq_step = next_fstep;
+      calc_data.last_step = next_fstep;
+      g_mutex_unlock(&freq_data_lock);
 
-    /* Increment frequency:
-	 * ifreq is "IFRQ (I1) from the FR card specification:
-	 *    0 - linear stepping
-	 *    1 - multiplicative stepping */
-    if( calc_data.freq_loop_data[calc_data.FR_index].ifreq == 1)
-      freq *= calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
+      New_Frequency();
+      save.fstep[next_fstep] = 1;
+      Bin_Output_Step( next_fstep );
+    }
     else
-      freq += calc_data.freq_loop_data[calc_data.FR_index].delta_freq;
-
-    /* Save frequencies for plotting */
-    if (fstep < calc_data.steps_total)
-		save.freq[fstep] = (double)freq;
+    {
+      /* End of a round, interpolate the other steps */
+      g_mutex_lock(&freq_data_lock);
+      Adaptive_Sweep_Fill();
+      if( !Adaptive_Sweep_Refine() )
+        retval = FALSE;
+      g_mutex_unlock(&freq_data_lock);
+    }
 
-    /* Delegate calculations to child processes if forked */
-    if( FORKED && fstep < calc_data.steps_total )
+    /* Find highest freq step that has
+     * no steps below it not yet done */
+    calc_data.freq_step = -1;
+    for( idx = 0; idx < calc_data.steps_total; idx++ )
     {
-      /* Look for an idle process */
-      for( job_num = 0; job_num < calc_data.num_jobs; job_num++ )
-      {
-        /* If an idle process is found, give it a job and
-         * then step the frequency loop by breaking out */
-        if( ! forked_proc_data[job_num]->busy )
-        {
-          /* Signal and count busy processes */
-          forked_proc_data[job_num]->busy  = TRUE;
-          forked_proc_data[job_num]->fstep = fstep;
-          num_busy_procs++;
-
-          // Send the mathlib to use, try to lock it if it is Intel MKL.
-		  mathlib_lock_intel_batch(rc_config.mathlib_batch_idx);
-          Write_Pipe( idx, fork_commands[MATHLIB], (ssize_t)strlen(fork_commands[MATHLIB]), TRUE );
-          Write_Pipe( idx, (char*)&rc_config.mathlib_batch_idx,
-			  (ssize_t)sizeof(rc_config.mathlib_batch_idx), TRUE );
-
-          /* Tell process to calculate freq dependent data */
-          len = strlen( fork_commands[FRQDATA] );
-          Write_Pipe( job_num, fork_commands[FRQDATA], (ssize_t)len, TRUE );
-
-          /* Give it the next frequency */
-          buff = (char *)&freq;
-          len = sizeof( double );
-          Write_Pipe( job_num, buff, (ssize_t)len, TRUE );
-          break;
-        }
-      } /* for( job_num = 0; job_num < calc_data.num_jobs; job_num++ ) */
+      if( save.fstep[idx] ) calc_data.freq_step = idx;
+      else break;
+    }
+  }
+
+  else /* Calculate freq dependent data (no fork) */
+  {
+    /* Up frequency step count. Note that this is initialized at -1 above so it
+	 * really does start the first loop with fstep==0 */
+    fstep++;
+    Step_Frequency( fstep, &freq, &fsteps_total );
 
-    } /* if( FORKED ) */
-    else if ( fstep < calc_data.steps_total ) /* Calculate freq dependent data (no fork) */
+    if( fstep < calc_data.steps_total )
     {
+      /* Save frequencies for plotting */
+      save.freq[fstep] = (double)freq;
+
       g_mutex_lock(&freq_data_lock);
       calc_data.freq_mhz  = freq;
       calc_data.freq_step = fstep;
@@ -731,43 +1139,20 @@ gboolean Frequency_Loop( gpointer udata )
       g_mutex_unlock(&freq_data_lock);
 
       New_Frequency();
+      Bin_Output_Step( fstep );
 
       // Be sure to exit if this was the last iteration:
       if (fstep >= calc_data.steps_total-1)
              retval = 0;
-
-      break;
     }
-
-    /* All idle processes are given a job */
-    if( num_busy_procs >= calc_data.num_jobs )
-      break;
-
-  } /* for( idx = 0; idx < calc_data.num_jobs; idx++ ) */
+  }
 
   /* Receive results from forked children */
   if( FORKED && num_busy_procs )
     do
     {
-      int n = 0;
-
-      /* Set read fd's to watch for child writes */
-      FD_ZERO( &read_fds );
-      for( idx = 0; idx < calc_data.num_jobs; idx++ )
-      {
-        FD_SET( forked_proc_data[idx]->child2pnt_pipe[READ], &read_fds );
-        if( n < forked_proc_data[idx]->child2pnt_pipe[READ] )
-          n = forked_proc_data[idx]->child2pnt_pipe[READ];
-      }
-
-      /* Wait for data from finished child processes */
-      if( select( n+1, &read_fds, NULL, NULL, NULL ) == -1 )
-      {
-        if (errno == EINTR)
-			continue;
-        perror( "select()" );
-        _exit(0);
-      }
+      /* Wait for data from child processes */
+      Wait_Child_Procs( &read_fds );
 
       /* Check for finished child processes */
       g_mutex_lock(&freq_data_lock);
@@ -776,8 +1161,9 @@ gboolean Frequency_Loop( gpointer udata )
       {
         if( FD_ISSET(forked_proc_data[idx]->child2pnt_pipe[READ], &read_fds) )
         {
-          /* Read data from finished child process */
-          if (!Get_Freq_Data( idx, forked_proc_data[idx]->fstep ))
+          /* Read data of the step finished by child process */
+          ret = Get_Freq_Data( idx, &child_fstep );
+          if( ret == FREQ_DATA_ERROR )
           {
             pr_err("Failed to read data from forked child\n");
             SetFlag(FREQ_LOOP_STOP);
@@ -786,21 +1172,34 @@ gboolean Frequency_Loop( gpointer udata )
             return FALSE;
           }
 
+          /* Child found the queue empty, mark it as idle */
+          if( ret == FREQ_CHILD_IDLE )
+          {
+            forked_proc_data[idx]->busy = FALSE;
+            num_busy_procs--;
+            continue;
+          }
+
           /* Clear "last-used-frequency" buffer, the local version of the data is
            * no longer what New_Frequency() set it to: */
           New_Frequency_Reset_Prev(); 
 
           /* Mark freq step in list of processed steps */
-          save.fstep[forked_proc_data[idx]->fstep] = 1;
-
-          /* Mark finished child process as ready for next job */
-          forked_proc_data[idx]->busy = FALSE;
-
-          /* Count down number of busy processes */
-          num_busy_procs--;
+          forked_proc_data[idx]->fstep = child_fstep;
+          save.fstep[child_fstep] = 1;
+          Bin_Output_Step( child_fstep );
         }
       } /* for( idx = 0; idx < num_child_procs; idx++ ) */
 
+      /* A round of an adaptive sweep is done when all the children
+       * are idle, interpolate the other steps and start the next */
+      if( adaptive && (num_busy_procs == 0) && retval )
+      {
+        Adaptive_Sweep_Fill();
+        if( !Adaptive_Sweep_Refine() || !Start_Child_Procs(TRUE) )
+          adaptive = FALSE;
+      }
+
       /* Find highest freq step that has no steps below it
        * that have not been processed by a child process */
       for( idx = 0; idx < calc_data.steps_total; idx++ )
@@ -809,27 +1208,10 @@ gboolean Frequency_Loop( gpointer udata )
         else break;
       }
 
-      if (calc_data.freq_step >= calc_data.steps_total-1)
-	  {
-		  /* Cancel idle callbacks on exit */
+      /* Cancel idle callbacks on exit, once
+       * the children have reported being idle */
+      if( (calc_data.freq_step >= calc_data.steps_total-1) && !adaptive )
 		  retval = FALSE;
-		  if (num_busy_procs != 0)
-		  {
-			  pr_debug("Frequency_Loop is done with all steps but num_busy_procs=%d (calc_data.freq_step=%d calc_data.steps_total=%d)?\n",
-                              num_busy_procs, calc_data.freq_step,
-                              calc_data.steps_total);
-				for( job_num = 0; job_num < calc_data.num_jobs; job_num++ )
-				{
-					if (forked_proc_data[job_num]->busy)
-					{
-						pr_debug("  busy job[%d]: fstep=%d freq=%f\n",
-							job_num,
-							forked_proc_data[job_num]->fstep,
-							save.freq[forked_proc_data[job_num]->fstep]);
-					}
-				}
-		  }
-	  }
 
       g_mutex_unlock(&freq_data_lock);
 
@@ -882,12 +1264,16 @@ gboolean Frequency_Loop( gpointer udata )
   {
     ClearFlag( FREQ_LOOP_RUNNING );
     SetFlag( FREQ_LOOP_DONE );
+    Bin_Output_Close();
 
 	clock_gettime(CLOCK_MONOTONIC, &end);
-	pr_notice("Frequency loop elapsed time: %f seconds. (%s)\n",
-                (end.tv_sec + (double)end.tv_nsec / 1e9) - (start.tv_sec + (double)start.tv_nsec / 1e9),
+	double elapsed = (end.tv_sec + (double)end.tv_nsec / 1e9) - (start.tv_sec + (double)start.tv_nsec / 1e9);
+	pr_notice("Frequency loop elapsed time: %f seconds. (%s)\n", elapsed,
 				(FORKED ? get_mathlib_by_idx(rc_config.mathlib_batch_idx)->name : current_mathlib->name));
 
+    /* Phase times of the loop, with those of the children */
+    Perf_Write_Stats( elapsed );
+
     /* After the loop is finished, re-set the saved frequency
      * that the user clicked on in the frequency plots window */
     double max_freq = calc_data.freq_loop_data[calc_data.FR_cards-1].max_freq;
@@ -1076,19 +1462,46 @@ Stop_Frequency_Loop( void )
 	g_source_remove( floop_tag );
 	floop_tag = 0;
   }
+
+  /* Don't leave children computing a stopped loop */
+  Drain_Child_Procs();
 } /* Stop_Frequency_Loop() */
 
+#endif
+
+/*-----------------------------------------------------------------------*/
+
+/* Incident_Angle()
+ *
+ * Sets the incident field direction of step ang
+ * of the loop over theta inside the loop over phi
+ */
+  static void
+Incident_Angle( int ang )
+{
+  calc_data.xpr1 = calc_data.thetis +
+    (double)( ang % calc_data.nthi ) * calc_data.xpr4;
+  calc_data.xpr2 = calc_data.phiss  +
+    (double)( ang / calc_data.nthi ) * calc_data.xpr5;
+} /* Incident_Angle() */
+
 /*-----------------------------------------------------------------------*/
 
 /* Incident_Field_Loop()
  *
- * Loops over incident field directions if
- * receiving pattern calculations are requested
+ * Loops over incident field directions if receiving pattern
+ * calculations are requested. Without networks, the matrix
+ * equations of up to EXCITATION_BATCH directions are solved
+ * together by solves(), then their currents are processed
+ * one direction at a time
  */
   void
 Incident_Field_Loop( void )
 {
-  int phi_step, theta_step;
+  int ang, nang, idx, nrh, batch;
+  complex double *eblk = NULL;
+  size_t mreq, neq = (size_t)netcx.neq;
+  perf_mark_t mark;
 
   /* Frequency scaling of geometric parameters */
   Frequency_Scale_Geometry();
@@ -1102,32 +1515,55 @@ Incident_Field_Loop( void )
   /* Fill and factor primary interaction matrix */
   Set_Interaction_Matrix();
 
+  /* netwk() solves each excitation if there are networks */
+  nang  = calc_data.nphi * calc_data.nthi;
+  batch = ( netcx.nonet == 0 ) ? EXCITATION_BATCH : 1;
+  if( batch > nang ) batch = nang;
+
+  mreq = (size_t)batch * neq * sizeof(complex double);
+  mem_alloc( (void **)&eblk, mreq, "in xnec2c.c" );
+
   /* Loop over incident field angles */
   netcx.nprint=0;
-  /* Loop over phi */
-  for( phi_step = 0; phi_step < calc_data.nphi; phi_step++ )
+  for( ang = 0; ang < nang; ang += nrh )
   {
-    /* Loop over theta */
-    for( theta_step = 0; theta_step < calc_data.nthi; theta_step++ )
+    nrh = nang - ang;
+    if( nrh > batch ) nrh = batch;
+
+    /* Fill excitation part of matrix for each angle */
+    for( idx = 0; idx < nrh; idx++ )
     {
-      /* Fill excitation part of matrix */
-      Set_Excitation();
+      Incident_Angle( ang + idx );
+      Set_Excitation( &eblk[(size_t)idx * neq] );
+    }
 
-      /* Matrix solving (netwk calls solves) */
-      Set_Network_Data();
+    /* Matrix solving of all the excitations */
+    if( batch > 1 )
+    {
+      Perf_Start( &mark );
+      solves( cm, save.ip, eblk, netcx.neq, nrh,
+          data.np, data.n, data.mp, data.m );
+      Perf_Stop( &mark, PERF_SOLVE );
+    }
 
-      /* Calculate power loss */
-      Power_Loss();
+    for( idx = 0; idx < nrh; idx++ )
+    {
+      Incident_Angle( ang + idx );
+      memcpy( crnt.cur, &eblk[(size_t)idx * neq], neq * sizeof(complex double) );
 
-      calc_data.xpr1 += calc_data.xpr4;
+      /* Currents from the solution, or matrix solving
+       * if not solved above (netwk calls solves) */
+      Set_Network_Data( batch > 1 );
 
-    } /* for( theta_step = 0; theta_step < calc_data.nthi.. */
+      /* Calculate power loss */
+      Power_Loss();
+    }
 
-    calc_data.xpr1= calc_data.thetis;
-    calc_data.xpr2= calc_data.xpr2+ calc_data.xpr5;
+  } /* for( ang = 0; ang < nang; ang += nrh ) */
 
-  } /* for( phi_step = 0; phi_step < calc_data.nphi.. */
+  free_ptr( (void **)&eblk );
 
+  calc_data.xpr1  = calc_data.thetis;
   calc_data.xpr2  = calc_data.phiss;
 
 } /* Incident_Field_Loop() */
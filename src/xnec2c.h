@@ -23,5 +23,9 @@
 #include "common.h"
 #include "fork.h"
 
+/* Incident field directions whose matrix equations
+ * are solved together by Incident_Field_Loop() */
+#define EXCITATION_BATCH    64
+
 #endif
 